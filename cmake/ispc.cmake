@@ -107,6 +107,11 @@ function(ispc_target_add_files target_name source_files)
         get_source_file_property(source_group_name ${source_file} ISPC_SOURCE_GROUP)
         get_source_file_property(target_arch ${source_file} ISPC_TARGET_ARCH)
         get_source_file_property(target_simd ${source_file} ISPC_TARGET_SIMD)
+        foreach (prop defs include_dirs output_dir compile_flags output_filename source_group_name target_arch target_simd)
+            if ("${${prop}}" STREQUAL "NOTFOUND")
+                set(${prop})
+            endif()
+        endforeach()
 
         if (ISPC_COMPILE_DEFINITIONS)
             set(defs ${defs} ${ISPC_COMPILE_DEFINITIONS})
@@ -167,16 +172,16 @@ function(ispc_target_add_files target_name source_files)
             message(FATAL_ERROR "ISPC_OUTPUT_DIRECTORY not set for file: ${source_file}")
         endif()
 
-        if (${output_filename} STREQUAL "NOTFOUND")
+        if (NOT output_filename)
             set(output_filename "${source_file}.o")
         endif()
         set(output_filepath "${output_dir}/${output_filename}")
 
         # arch: if not defined, set default for each platform
         if (NOT target_arch)
-            if (${glslcc_platform_name} STREQUAL "windows")
+            if (${ipsc_platform_name} STREQUAL "windows")
                 set(target_arch "x86-64")
-            elseif (${glslcc_platform_name} STREQUAL "android")
+            elseif (${ipsc_platform_name} STREQUAL "android")
                 if (ANDROID_ABI STREQUAL armeabi-v7a)
                     set(target_arch "arm")
                 elseif (ANDROID_ABI STREQUAL arm64-v8a)
@@ -186,9 +191,9 @@ function(ispc_target_add_files target_name source_files)
                 elseif (ANDROID_ABI STREQUAL x86_64)
                     set(target_arch "x86-64")
                 endif()
-            elseif (${glslcc_platform_name} STREQUAL "rpi")
+            elseif (${ipsc_platform_name} STREQUAL "rpi")
                 set(target_arch "arm")                
-            elseif (${glslcc_platform_name} STREQUAL "ios")
+            elseif (${ipsc_platform_name} STREQUAL "ios")
                 if (IOS_ARCH STREQUAL armv7 OR IOS_ARCH STREQUAL armv7s)
                     set(target_arch "arm")
                 elseif (IOS_ARCH STREQUAL arm64)
@@ -198,9 +203,9 @@ function(ispc_target_add_files target_name source_files)
                 elseif (IOS_ARCH STREQUAL x86_64)
                     set(target_arch "x86-64")
                 endif()
-            elseif (${glslcc_platform_name} STREQUAL "linux")
+            elseif (${ipsc_platform_name} STREQUAL "linux")
                 set(target_arch "x86-64")
-            elseif (${glslcc_platform_name} STREQUAL "darwin")
+            elseif (${ipsc_platform_name} STREQUAL "darwin")
                 set(target_arch "x86-64")
             else()
                 message(FATAL_ERROR "target architecture is not supported on this platform")
@@ -209,15 +214,15 @@ function(ispc_target_add_files target_name source_files)
 
         # SIMD ISA and width: set defaults for each platform if not set by user
         if (NOT target_simd)
-            if (${glslcc_platform_name} STREQUAL "windows" OR ${glslcc_platform_name} STREQUAL "linux" OR ${glslcc_platform_name} STREQUAL "darwin")
+            if (${ipsc_platform_name} STREQUAL "windows" OR ${ipsc_platform_name} STREQUAL "linux" OR ${ipsc_platform_name} STREQUAL "darwin")
                 set(target_simd "avx1-i32x8")
-            elseif (${glslcc_platform_name} STREQUAL "android" OR ${glslcc_platform_name} STREQUAL "ios")
+            elseif (${ipsc_platform_name} STREQUAL "android" OR ${ipsc_platform_name} STREQUAL "ios")
                 if (${target_arch} STREQUAL "x86-64" OR ${target_arch} STREQUAL "x86")
                     set(target_simd "sse4-i32x4")
                 else()
                     set(target_simd "neon-i32x4")
                 endif()
-            elseif (${glslcc_platform_name} STREQUAL "rpi")
+            elseif (${ipsc_platform_name} STREQUAL "rpi")
                 set(target_simd "neon-i32x4")                
             else()
                 message(FATAL_ERROR "target architecture is not supported on this platform")
@@ -259,7 +264,7 @@ function(ispc_target_add_files target_name source_files)
 
         if (source_group_name)
             source_group(${source_group_name} FILES ${source_file})
-            source_group(${source_group_name}\\${obj} FILES ${output_relpath})
+            source_group(${source_group_name}\\obj FILES ${output_relpath})
         endif()
     endforeach()
 endfunction()
\ No newline at end of file
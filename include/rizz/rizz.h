@@ -12,6 +12,7 @@
 #include "sx/jobs.h"
 #include "sx/math.h"
 #include "sx/platform.h"
+#include "sx/string.h"
 #include "sx/timer.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -28,6 +29,7 @@ typedef union  { uintptr_t id;  void* ptr; }    rizz_asset_obj;
 typedef struct { uint32_t id; } rizz_asset;
 typedef struct { uint32_t id; } rizz_asset_group;
 typedef struct { uint32_t id; } rizz_http;
+typedef struct { uint32_t id; } rizz_vfs_stream;
 typedef struct { uint32_t id; } rizz_gfx_stage;
 // clang-format on
 
@@ -275,7 +277,8 @@ enum rizz_vfs_flags_ {
     RIZZ_VFS_FLAG_NONE = 0x01,
     RIZZ_VFS_FLAG_ABSOLUTE_PATH = 0x02,
     RIZZ_VFS_FLAG_TEXT_FILE = 0x04,
-    RIZZ_VFS_FLAG_APPEND = 0x08
+    RIZZ_VFS_FLAG_APPEND = 0x08,
+    RIZZ_VFS_FLAG_MMAP = 0x10    // read: map the file (read-only) instead of loading it, see sx_file_map
 };
 typedef uint32_t rizz_vfs_flags;
 
@@ -286,12 +289,19 @@ typedef void(rizz_vfs_async_write_cb)(const char* path, int64_t bytes_written, s
 
 typedef void(rizz_vfs_async_modify_cb)(const char* path);
 
+// called on main-thread when a chunk requested by stream_read_async is read into 'buffer'
+// if bytes_read == -1, then there was an error reading the chunk
+// bytes_read can be smaller than chunk_size for the last chunk of the file
+typedef void(rizz_vfs_async_stream_cb)(rizz_vfs_stream stream, int chunk_index, void* buffer,
+                                       int64_t bytes_read, void* user);
+
 typedef struct rizz_api_vfs {
     void (*register_modify)(rizz_vfs_async_modify_cb* modify_fn);
 
     bool (*mount)(const char* path, const char* alias);
     void (*mount_mobile_assets)(const char* alias);
 
+    // async requests can be made from any thread, callbacks are always called on main-thread
     void (*read_async)(const char* path, rizz_vfs_flags flags, const sx_alloc* alloc,
                        rizz_vfs_async_read_cb* read_fn, void* user);
     void (*write_async)(const char* path, sx_mem_block* mem, rizz_vfs_flags flags,
@@ -304,6 +314,22 @@ typedef struct rizz_api_vfs {
     bool (*is_dir)(const char* path);
     bool (*is_file)(const char* path);
     uint64_t (*last_modified)(const char* path);
+
+    // streams read big files in fixed size chunks into user provided buffers, so processing can
+    // start before the whole file is read, and memory is bounded by 'max_inflight' chunks.
+    // stream functions should only be called from the main-thread
+    //  stream_open: opens the file and returns a zero id on failure (not supported for android assets)
+    //  stream_read_async: queues a read of chunk 'chunk_index' into 'buffer' (at least chunk_size bytes)
+    //                     returns false if index is out of range or 'max_inflight' chunks are pending
+    //  stream_close: if chunks are still pending, their callbacks are called as usual and the file is
+    //                closed after the last one, so keep the buffers alive until then
+    rizz_vfs_stream (*stream_open)(const char* path, rizz_vfs_flags flags, int chunk_size,
+                                   int max_inflight);
+    void (*stream_close)(rizz_vfs_stream stream);
+    bool (*stream_read_async)(rizz_vfs_stream stream, int chunk_index, void* buffer,
+                              rizz_vfs_async_stream_cb* stream_fn, void* user);
+    int64_t (*stream_size)(rizz_vfs_stream stream);
+    int (*stream_num_chunks)(rizz_vfs_stream stream);
 } rizz_api_vfs;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -312,7 +338,8 @@ enum rizz_asset_load_flags_ {
     RIZZ_ASSET_LOAD_FLAG_NONE = 0x0,
     RIZZ_ASSET_LOAD_FLAG_ABSOLUTE_PATH = 0x1,
     RIZZ_ASSET_LOAD_FLAG_WAIT_ON_LOAD = 0x2,
-    RIZZ_ASSET_LOAD_FLAG_RELOAD = 0x4
+    RIZZ_ASSET_LOAD_FLAG_RELOAD = 0x4,
+    RIZZ_ASSET_LOAD_FLAG_MMAP = 0x8    // loaders get read-only mapped file memory, see RIZZ_VFS_FLAG_MMAP
 };
 typedef uint32_t rizz_asset_load_flags;
 
@@ -377,9 +404,9 @@ typedef struct rizz_asset_callbacks {
 //      Internally, the asset system is offloading some work to worker threads, but the API is not
 //      thread-safe 
 //          1) Have to load all your assets on the main thread 
-//          2) You can only use `rizz_api_asset.obj()` in worker threads.
-//              So basically, you have to load the assets, and pass handles to threads, 
-//              and they can only fetch the object pointer
+//          2) You can only use `rizz_api_asset.obj()` and `rizz_api_asset.find()` in worker threads.
+//              So basically, you have to load the assets, and pass handles (or paths) to threads, 
+//              and they can only resolve the handles and fetch the object pointer
 //          3) Loading can be performed in the main thread while working threads are using the API 
 //             (rule #2) but without RIZZ_ASSET_LOAD_FLAG_RELOAD flag 
 //          4) Unloading can NOT be performed while working threads are using the API 
@@ -409,6 +436,12 @@ typedef struct rizz_api_asset {
                                 const sx_alloc* alloc, uint32_t tags);
     void (*unload)(rizz_asset handle);
 
+    // returns the handle of an already loaded asset without loading or adding a reference to it
+    // returns {0} if the asset is not loaded. `params` and `alloc` must match the `load` call
+    // thread-safe, see the threading rules above
+    rizz_asset (*find)(const char* name, const char* path, const void* params,
+                       const sx_alloc* alloc);
+
     rizz_asset_state (*state)(rizz_asset handle);
     const char* (*path)(rizz_asset handle);
     const char* (*type_name)(rizz_asset handle);
@@ -467,6 +500,19 @@ typedef struct rizz_api_camera {
     void (*calc_frustum_points_range)(const rizz_camera* cam, sx_vec3 frustum[8], float fnear,
                                       float ffar);
 
+    // frustum culling
+    // planes are extracted from a view-projection matrix (normals point inside), so both
+    // perspective and ortho cameras work. visible_bits receives 1 bit per item, see
+    // sx_aabb_cull_batch in sx/math-batch.h. To split culling across jobs, cull sub-ranges that
+    // start at multiples of 32 items
+    void (*calc_frustum_planes)(sx_plane planes[6], const sx_mat4* viewproj_mat);
+    void (*cull_aabbs)(uint32_t* visible_bits, const sx_aabb* aabbs, int count,
+                       const sx_plane planes[6]);
+    void (*cull_spheres)(uint32_t* visible_bits, const sx_vec4* spheres, int count,
+                         const sx_plane planes[6]);
+    void (*cull_rects)(uint32_t* visible_bits, const sx_rect* rects, int count,
+                       const sx_plane planes[6]);
+
     void (*fps_init)(rizz_camera_fps* cam, float fov_deg, const sx_rect viewport, float fnear,
                      float ffar);
     void (*fps_lookat)(rizz_camera_fps* cam, const sx_vec3 pos, const sx_vec3 target,
@@ -500,7 +546,9 @@ enum rizz_core_flags_ {
     RIZZ_CORE_FLAG_LOG_TO_PROFILER = 0x02,      // log to remote profiler
     RIZZ_CORE_FLAG_PROFILE_GPU = 0x04,          // enable GPU profiling
     RIZZ_CORE_FLAG_DUMP_UNUSED_ASSETS = 0x08,   // write `unused-assets.json` on exit
-    RIZZ_CORE_FLAG_DETECT_LEAKS = 0x10          // Detect memory leaks (default on in _DEBUG builds)
+    RIZZ_CORE_FLAG_DETECT_LEAKS = 0x10,         // Detect memory leaks (default on in _DEBUG builds)
+    RIZZ_CORE_FLAG_SLAB_HEAP = 0x20,            // use thread-caching slab allocator as heap backend
+    RIZZ_CORE_FLAG_LOG_ON_JOB_THREAD = 0x40     // run log backends on a job thread (see below)
 };
 typedef uint32_t rizz_core_flags;
 
@@ -539,11 +587,21 @@ typedef struct rizz_config {
     int job_num_threads;    // number of worker threads (default:-1, then it will be num_cores-1)
     int job_max_fibers;     // maximum active jobs at a time (default = 64)
     int job_stack_size;     // jobs stack size, in kbytes (default = 1mb)
+    int job_spin_count;     // idle worker tries with cpu pause before yielding (default = 64)
+    int job_yield_count;    // idle worker tries with thread yield before sleeping (default = 8)
+    sx_job_pin_mode job_pin_mode;              // pin worker threads to cpus (default = none)
+    sx_job_topology_tags job_topology_tags;    // tag pinned workers by socket/cache domain
 
     int coro_max_fibers;    // maximum running (active) coroutines at a time. (default = 64)
     int coro_stack_size;    // coroutine stack size (default = 2mb). in kbytes
 
     int tmp_mem_max;        // per-frame temp memory size. in kbytes (defaut: 5mb per-thread)
+    int frame_mem_max;      // frame allocator size, per lifetime. in kbytes (default: 5mb per-thread)
+    int track_sample_interval;    // memory tracker records one allocation per N bytes on average
+                                  // bigger allocations are more likely to be recorded
+                                  // (default: 0 = record all allocations)
+    int frame_stats_window;       // number of frames for frame-time statistics (default: 300)
+    float hitch_threshold_ms;     // frames longer than this are counted as hitches (default: 33.3)
 
     int profiler_listen_port;           // default: 17815
     int profiler_update_interval_ms;    // default: 10ms
@@ -623,11 +681,15 @@ typedef struct {
     int64_t peak;
 } rizz_trackalloc_info;
 
+// trackers[].items are merged from all threads by `get_mem_info` and are valid until next call
+// with `track_sample_interval`, items only contain sampled allocations, but sizes are exact
 typedef struct rizz_mem_info {
     rizz_trackalloc_info trackers[_RIZZ_MEMID_COUNT];
     rizz_linalloc_info temp_allocs[RIZZ_MAX_TEMP_ALLOCS];
+    rizz_linalloc_info frame_allocs[RIZZ_MAX_TEMP_ALLOCS];    // all lifetimes of each thread
     int num_trackers;
     int num_temp_allocs;
+    int num_frame_allocs;
     size_t heap;
     size_t heap_max;
     int heap_count;
@@ -639,12 +701,49 @@ typedef struct rizz_version {
     char git[32];
 } rizz_version;
 
+typedef enum rizz_frame_lifetime {
+    RIZZ_FRAME_LIFETIME_THIS_FRAME = 0,    // memory is valid until the end of current frame
+    RIZZ_FRAME_LIFETIME_NEXT_FRAME,        // memory is valid until the end of next frame
+    _RIZZ_FRAME_LIFETIME_COUNT
+} rizz_frame_lifetime;
+
 typedef enum rizz_profile_flag {
     RIZZ_PROFILE_FLAG_AGGREGATE = 1, // Search parent for same-named samples and merge timing instead of adding a new sample
     RIZZ_PROFILE_FLAG_RECURSIVE = 2, // Merge sample with parent if it's the same sample
 } rizz_profile_flag;
 typedef uint32_t rizz_profile_flags;
 
+#define RIZZ_MAX_FRAME_PHASES 16
+
+// statistics of the frame phases (vfs, asset, plugins, ...), same names as their profiler samples
+typedef struct rizz_frame_phase_stats {
+    const char* name;
+    float mean_ms;
+    float p95_ms;
+    float max_ms;
+    bool main_thread;    // false: the phase runs in the job system, in parallel with other phases
+} rizz_frame_phase_stats;
+
+// rolling frame-time statistics of the last `window` frames
+// frame time is the time between the start of two frames, hitches are the frames that took longer
+// than hitch_threshold_ms
+typedef struct rizz_frame_stats {
+    int window;
+    int num_frames;    // number of recorded frames in the window (<= window)
+    float mean_ms;
+    float p50_ms;
+    float p95_ms;
+    float p99_ms;
+    float max_ms;
+    float hitch_threshold_ms;
+    int num_hitches;          // hitches in the window
+    int64_t total_hitches;    // hitches since startup
+    const float* frame_ms;    // frame times of the window, oldest first (count = num_frames)
+                              // valid until the next `frame_stats` or `set_frame_stats_config`
+    int num_phases;
+    rizz_frame_phase_stats phases[RIZZ_MAX_FRAME_PHASES];
+} rizz_frame_stats;
+
 typedef struct rizz_api_core {
     // heap allocator: thread-safe, allocates dynamically from heap (libc->malloc)
     const sx_alloc* (*heap_alloc)(void);
@@ -656,6 +755,12 @@ typedef struct rizz_api_core {
     const sx_alloc* (*tmp_alloc_push)();
     void (*tmp_alloc_pop)();
 
+    // frame allocator: linear allocator, fast and thread-safe (per job thread only).
+    //                  free is a no-op, all memory is released when the lifetime ends.
+    //                  NEXT_FRAME memory is double-buffered, use it for data that is consumed on
+    //                  the next frame, like commands that are executed by the next frame
+    const sx_alloc* (*frame_alloc)(rizz_frame_lifetime lifetime);
+
     // TLS functions are used for setting TLS variables to worker threads by an external source
     // register: use name to identify the variable (Id). (not thread-safe)
     // tls_var: gets pointer to variable, (thread-safe)
@@ -671,6 +776,15 @@ typedef struct rizz_api_core {
 
     void (*get_mem_info)(rizz_mem_info* info);
 
+    // string interner: the global table of core, shared by all plugins (thread-safe)
+    //                  ids stay valid until the app exits, so plugins can keep them in their state
+    //                  across hot-reloads. intern_find returns 0 if the string is not interned
+    //                  Call these from the main thread or from jobs only, memory that the lookup
+    //                  table retires is freed after a grace period that only covers job threads
+    sx_istr_t (*intern)(const char* str);
+    sx_istr_t (*intern_find)(const char* str);
+    const char* (*intern_cstr)(sx_istr_t id);
+
     rizz_version (*version)(void);
 
     // random
@@ -685,6 +799,12 @@ typedef struct rizz_api_core {
     float (*fps_mean)(void);
     int64_t (*frame_index)(void);
 
+    // frame-time statistics (main thread only), see rizz_frame_stats
+    // set_frame_stats_config: values <= 0 keep the current setting. changing the window size
+    //                         discards the recorded frames
+    void (*frame_stats)(rizz_frame_stats* stats);
+    void (*set_frame_stats_config)(int window, float hitch_threshold_ms);
+
     void (*set_cache_dir)(const char* path);
     const char* (*cache_dir)();
     const char* (*data_dir)();
@@ -693,16 +813,39 @@ typedef struct rizz_api_core {
     sx_job_t (*job_dispatch)(int count,
                              void (*callback)(int start, int end, int thrd_index, void* user),
                              void* user, sx_job_priority priority, uint32_t tags);
+    // parallel_for: jobs grab chunks (at least `grain_size` items) of the remaining range
+    //               dynamically, use it instead of `job_dispatch` when per-item cost varies
+    sx_job_t (*job_parallel_for)(int count, int grain_size,
+                                 void (*callback)(int start, int end, int thrd_index, void* user),
+                                 void* user, sx_job_priority priority, uint32_t tags);
     void (*job_wait_and_del)(sx_job_t job);
     bool (*job_test_and_del)(sx_job_t job);
     int (*job_num_threads)();
     int (*job_thread_index)();
+    // busy/spin/park times of the thread (0..job_num_threads-1), accumulated since startup
+    void (*job_thread_stats)(int thread_index, sx_job_thread_stats* stats);
+
+    // job graphs: build dependent dispatches once and submit them every frame (see sx/jobs.h)
+    sx_job_graph* (*job_graph_create)(void);
+    void (*job_graph_destroy)(sx_job_graph* graph);
+    int (*job_graph_add_node)(sx_job_graph* graph, int count,
+                              void (*callback)(int start, int end, int thrd_index, void* user),
+                              void* user, sx_job_priority priority, uint32_t tags);
+    void (*job_graph_add_edge)(sx_job_graph* graph, int from_node, int to_node);
+    sx_job_t (*job_graph_submit)(sx_job_graph* graph);
 
     void (*coro_invoke)(void (*coro_cb)(sx_fiber_transfer), void* user);
     void (*coro_end)(void* pfrom);
     void (*coro_wait)(void* pfrom, int msecs);
     void (*coro_yield)(void* pfrom, int nframes);
 
+    // log backends: log_cb is called once per entry, in the order the entries were logged
+    // NOTE: log_cb runs on the main thread (the Log_update phase), after plugins are updated.
+    //       If RIZZ_CORE_FLAG_LOG_ON_JOB_THREAD is set, it runs on a job thread instead, in
+    //       parallel with the execution of command buffers. Only set the flag if every registered
+    //       backend stays off the gfx API and off data that the main thread uses at the same time.
+    //       Data written by log_cb is safe to read in the next frame's plugin update (or in ImGui
+    //       draw). register and unregister must be called from the main thread
     void (*register_log_backend)(const char* name,
                                  void (*log_cb)(const rizz_log_entry* entry, void* user),
                                  void* user);
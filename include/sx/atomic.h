@@ -167,6 +167,7 @@ SX_FORCE_INLINE void sx_compiler_barrier()
 #if SX_PLATFORM_WINDOWS
     _ReadWriteBarrier();
 #else
+    __asm__ __volatile__("" ::: "memory");
 #endif
 }
 
@@ -175,6 +176,7 @@ SX_FORCE_INLINE void sx_compiler_read_barrier()
 #if SX_PLATFORM_WINDOWS
     _ReadBarrier();
 #else
+    __asm__ __volatile__("" ::: "memory");
 #endif
 }
 
@@ -183,6 +185,7 @@ SX_FORCE_INLINE void sx_compiler_write_barrier()
 #if SX_PLATFORM_WINDOWS
     _WriteBarrier();
 #else
+    __asm__ __volatile__("" ::: "memory");
 #endif
 }
 
@@ -61,6 +61,11 @@
 #    define SX_CONFIG_HASHTBL_DEBUG 1
 #endif
 
+// Maximum load of hash-tables (in percent), before sx_hashtbl_add_and_grow grows them, see hash.h
+#ifndef SX_CONFIG_HASHTBL_MAX_LOAD
+#    define SX_CONFIG_HASHTBL_MAX_LOAD 75
+#endif
+
 // Use stdc math lib for basic math functions, see math.h
 #ifndef SX_CONFIG_STDMATH
 #    define SX_CONFIG_STDMATH 1
@@ -74,6 +79,16 @@
 #    define SX_CONFIG_SIMD_DISABLE 0
 #endif
 
+// Records job timeline events (dispatch, run, wait) of the job dispatcher, see jobs.h
+#ifndef SX_CONFIG_JOB_TRACE
+#    define SX_CONFIG_JOB_TRACE 0
+#endif
+
+// Number of job trace events that are kept for each thread, must be power of two
+#ifndef SX_CONFIG_JOB_TRACE_EVENTS
+#    define SX_CONFIG_JOB_TRACE_EVENTS 16384
+#endif
+
 #ifndef SX_CONFIG_ARRAY_INIT_SIZE
 #   define SX_CONFIG_ARRAY_INIT_SIZE 8
 #endif
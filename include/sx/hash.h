@@ -10,6 +10,11 @@
 //                                               situations
 //      sx_hash_xxh64                 xxhash64 - suitable for bigger data, collision of this is
 //                                               almost zero
+//      sx_hash_xxh3_64               xxh3 64bit - fastest of all for both small and big data,
+//                                               long inputs use SSE2/AVX2 (selected at runtime on
+//                                               x86) or NEON
+//      sx_hash_xxh3_128              xxh3 128bit - same as above, with 128bit output, suitable for
+//                                               content hashing (cache keys, dedupe)
 //      sx_hash_fnv32                 Fnv1a hashing, fast and robust for small data (<64 bytes)
 //      sx_hash_fnv32_str             utility function for hashing null-terminated strings
 //      sx_hash_crc32                 famous CRC32 hash, suitable for files and data that need CRC32
@@ -29,6 +34,8 @@
 //
 // XXHash Source: https://github.com/Cyan4973/xxHash
 // The functions above all have 64bit versions... sx_hash_create_xxh64, etc.
+// XXH3 streaming is the same, but with sx_hash_create_xxh3 and two digest functions
+// (sx_hash_xxh3_digest64 and sx_hash_xxh3_digest128) that can be used on the same state
 //
 // sx_hashtbl: hash-table based on fibonacci mult hashing
 //             Reference:
@@ -39,6 +46,8 @@
 //      sx_hashtbl_destroy           destroy hash-table that is created with sx_hashtbl_create
 //                                   (DO NOT use this on sx_hashtbl_init type of tables)
 //      sx_hashtbl_grow              grows hash-table that is created with sx_hashtbl_grow,
+//                                   if the load mostly comes from removed slots, the table is
+//                                   rehashed with the same capacity instead of doubling
 //                                   NOTE: pointer to hash-table will change after grow,
 //                                         so beware if the table is used in multiple locations
 //                                   alloc must be same as the one in create call (DO NOT use this
@@ -54,24 +63,60 @@
 //                                   can be used to allocate internal buffers manually for use in
 //                                   sx_hashtbl_init function
 //      sx_hashtbl_add               adds a key to the table
+//                                   NOTE: keys 0 and SX_HASHTBL_TOMBSTONE are reserved
 //      sx_hashtbl_remove            removes a key from table
 //      sx_hashtbl_full              returns true if table is full
+//      sx_hashtbl_needs_grow        returns true if the table is loaded more than
+//                                   SX_CONFIG_HASHTBL_MAX_LOAD percent (including removed slots)
+//      sx_hashtbl_add_and_grow      grows the table if it needs to and adds the key
+//                                   (DO NOT use this on sx_hashtbl_init type of tables)
 //      sx_hashtbl_get               returns the value of an index, similiar to tbl->values[index]
 //      sx_hashtbl_find              tries to find the key and returns index, -1 if not found
-//                                   NOTE: non-existent keys are the worst case and cause
-//                                   performance
-//                                         issues. so beware of such scenarios and try to use
-//                                         something else if this case happens alot
+//                                   keys are probed in groups of SX_HASHTBL_GROUP_SIZE slots with
+//                                   SIMD compares, and the search stops at the first group that
+//                                   has an empty slot. so misses are as cheap as hits as long as
+//                                   the table is not loaded close to it's capacity
 //      sx_hashtbl_find_get          combines 'find' and 'get', so it returns the actual value based
 //                                   on key returns the parameter 'not_found_val' if key is not
 //                                   found in table
 //      sx_hashtbl_clear             clears the table
 // 
+// sx_hashtbl64: same as sx_hashtbl, but with 64bit keys, useful for 64bit hashes and pointers
+//      The function are pretty much the same as sx_hashtbl, but with `sx_hashtbl64_` prefix.
+//      keys 0 and SX_HASHTBL64_TOMBSTONE are reserved
+//
 // sx_hashtbl_tval: hash-table based on fibonacci mult hashing, but with arbitary value types
 //                  the difference between this and norml sx_hashtbl is that the 'value' type is not
 //                  integer anymore. It can be any POD type. you just define the size of your type
 //      The function are pretty much the same as sx_hashtbl, but with `sx_hashtbltval_` prefix.
 //
+// sx_hashtbl_mt: thread-safe hash-table for read-mostly data (uint32_t keys, int values)
+//                The table is split into shards (selected by key), each shard is a normal
+//                sx_hashtbl that is guarded by a spin-lock for writers and a sequence counter for
+//                readers. Readers never lock or write shared memory, they just retry if a writer
+//                has touched the shard in the middle of the lookup. Writers on different shards
+//                don't block each other. The table grows automatically, grown shards keep their
+//                old tables alive until sx_hashtblmt_collect frees them after a grace period (or
+//                destroy), so readers never touch freed memory. Shards that are loaded with removed
+//                keys are rebuilt in place, so add/remove churn never keeps old tables. Keys 0 and
+//                SX_HASHTBL_TOMBSTONE are reserved.
+//      sx_hashtblmt_create         create table, num_shards is rounded to power of 2 (max 64)
+//      sx_hashtblmt_destroy        destroy table, no other thread must be accessing it
+//      sx_hashtblmt_add            adds a key, or replaces the value if key already exists
+//                                  returns false if out of memory
+//      sx_hashtblmt_remove         removes a key, returns false if key is not found
+//      sx_hashtblmt_find_get       returns the value of the key, or 'not_found_val' if not found
+//      sx_hashtblmt_count          number of keys in the table (approximate if writers are busy)
+//      sx_hashtblmt_clear          removes all keys
+//      sx_hashtblmt_collect        frees the old tables that are left from growing, once readers
+//                                  can't be using them anymore. Tables that are retired before the
+//                                  call are stamped with `epoch` (> 0, must never go back), and
+//                                  tables that are stamped with `safe_epoch` or older are freed.
+//                                  The caller decides when an epoch is safe: after it, no reader
+//                                  that started before that collect call is still running (see
+//                                  sx_job_quiescent_snapshot). With no concurrent readers, pass
+//                                  the same value for both to free everything right away
+//
 #pragma once
 
 #include "sx.h"
@@ -84,6 +129,15 @@ typedef struct sx_alloc sx_alloc;
 SX_API uint32_t sx_hash_xxh32(const void* data, size_t len, uint32_t seed);
 SX_API uint64_t sx_hash_xxh64(const void* data, size_t len, uint64_t seed);
 
+// XXH3: 64bit and 128bit, much faster than XXH32/XXH64 on all input sizes
+typedef struct sx_hash128 {
+    uint64_t low;
+    uint64_t high;
+} sx_hash128;
+
+SX_API uint64_t sx_hash_xxh3_64(const void* data, size_t len, uint64_t seed);
+SX_API sx_hash128 sx_hash_xxh3_128(const void* data, size_t len, uint64_t seed);
+
 // FNV1a: suitable for small data (usually less than 32 bytes), mainly small strings
 SX_API uint32_t sx_hash_fnv32(const void* data, size_t len);
 SX_API uint32_t sx_hash_fnv32_str(const char* str);
@@ -115,14 +169,29 @@ SX_API void sx_hash_xxh64_init(sx_hash_xxh64_t* state, uint64_t seed);
 SX_API void sx_hash_xxh64_update(sx_hash_xxh64_t* state, const void* data, size_t len);
 SX_API uint64_t sx_hash_xxh64_digest(sx_hash_xxh64_t* state);
 
+// Streaming (state based) hash using xxh3 (64bit and 128bit)
+typedef struct sx_hash_xxh3_s sx_hash_xxh3_t;
+
+SX_API sx_hash_xxh3_t* sx_hash_create_xxh3(const sx_alloc* alloc);
+SX_API void sx_hash_destroy_xxh3(sx_hash_xxh3_t* state, const sx_alloc* alloc);
+SX_API void sx_hash_xxh3_init(sx_hash_xxh3_t* state, uint64_t seed);
+SX_API void sx_hash_xxh3_update(sx_hash_xxh3_t* state, const void* data, size_t len);
+SX_API uint64_t sx_hash_xxh3_digest64(sx_hash_xxh3_t* state);
+SX_API sx_hash128 sx_hash_xxh3_digest128(sx_hash_xxh3_t* state);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Hash table
+#define SX_HASHTBL_GROUP_SIZE 4
+#define SX_HASHTBL_TOMBSTONE 0xffffffff
+#define SX_HASHTBL64_TOMBSTONE 0xffffffffffffffffull
+
 typedef struct sx_hashtbl {
     uint32_t* keys;
     int* values;
     int _bitshift;
     int count;
     int capacity;
+    int _num_tombstones;
 #if SX_CONFIG_HASHTBL_DEBUG
     int _miss_cnt;
     int _probe_cnt;
@@ -141,6 +210,20 @@ SX_API int sx_hashtbl_add(sx_hashtbl* tbl, uint32_t key, int value);
 SX_API int sx_hashtbl_find(const sx_hashtbl* tbl, uint32_t key);
 SX_API void sx_hashtbl_clear(sx_hashtbl* tbl);
 
+// If the group of the removed slot still has an empty slot, no key has ever been probed past it,
+// so the slot can become empty again. Otherwise it must be a tombstone to keep the probe chain
+static inline bool sx__hashtbl_group_has_empty(const uint32_t* keys, int index)
+{
+    const uint32_t* grp = keys + (index & ~(SX_HASHTBL_GROUP_SIZE - 1));
+    return grp[0] == 0 || grp[1] == 0 || grp[2] == 0 || grp[3] == 0;
+}
+
+static inline bool sx__hashtbl64_group_has_empty(const uint64_t* keys, int index)
+{
+    const uint64_t* grp = keys + (index & ~(SX_HASHTBL_GROUP_SIZE - 1));
+    return grp[0] == 0 || grp[1] == 0 || grp[2] == 0 || grp[3] == 0;
+}
+
 static inline int sx_hashtbl_get(const sx_hashtbl* tbl, int index)
 {
     sx_assert(index >= 0 && index < tbl->capacity);
@@ -156,8 +239,14 @@ static inline int sx_hashtbl_find_get(const sx_hashtbl* tbl, uint32_t key, int n
 static inline void sx_hashtbl_remove(sx_hashtbl* tbl, int index)
 {
     sx_assert(index >= 0 && index < tbl->capacity);
+    sx_assert(tbl->keys[index] != 0 && tbl->keys[index] != SX_HASHTBL_TOMBSTONE);
 
-    tbl->keys[index] = 0;
+    if (sx__hashtbl_group_has_empty(tbl->keys, index)) {
+        tbl->keys[index] = 0;
+    } else {
+        tbl->keys[index] = SX_HASHTBL_TOMBSTONE;
+        ++tbl->_num_tombstones;
+    }
     --tbl->count;
 }
 
@@ -174,10 +263,89 @@ static inline bool sx_hashtbl_full(const sx_hashtbl* tbl)
     return tbl->capacity == tbl->count;
 }
 
-#define sx_hashtbl_add_and_grow(_tbl, _key, _value, _alloc)        \
-    (sx_hashtbl_full(_tbl) ? sx_hashtbl_grow(&(_tbl), _alloc) : 0, \
+static inline bool sx_hashtbl_needs_grow(const sx_hashtbl* tbl)
+{
+    return (tbl->count + tbl->_num_tombstones + 1) * 100 > tbl->capacity * SX_CONFIG_HASHTBL_MAX_LOAD;
+}
+
+#define sx_hashtbl_add_and_grow(_tbl, _key, _value, _alloc)              \
+    (sx_hashtbl_needs_grow(_tbl) ? sx_hashtbl_grow(&(_tbl), _alloc) : 0, \
      sx_hashtbl_add(_tbl, _key, _value))
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hash table (64bit keys)
+typedef struct sx_hashtbl64 {
+    uint64_t* keys;
+    int* values;
+    int _bitshift;
+    int count;
+    int capacity;
+    int _num_tombstones;
+#if SX_CONFIG_HASHTBL_DEBUG
+    int _miss_cnt;
+    int _probe_cnt;
+#endif
+} sx_hashtbl64;
+
+SX_API sx_hashtbl64* sx_hashtbl64_create(const sx_alloc* alloc, int capacity);
+SX_API void sx_hashtbl64_destroy(sx_hashtbl64* tbl, const sx_alloc* alloc);
+SX_API bool sx_hashtbl64_grow(sx_hashtbl64** ptbl, const sx_alloc* alloc);
+
+SX_API void sx_hashtbl64_init(sx_hashtbl64* tbl, int capacity, uint64_t* keys_ptr, int* values_ptr);
+SX_API int sx_hashtbl64_valid_capacity(int capacity);
+SX_API int sx_hashtbl64_fixed_size(int capacity);
+
+SX_API int sx_hashtbl64_add(sx_hashtbl64* tbl, uint64_t key, int value);
+SX_API int sx_hashtbl64_find(const sx_hashtbl64* tbl, uint64_t key);
+SX_API void sx_hashtbl64_clear(sx_hashtbl64* tbl);
+
+static inline int sx_hashtbl64_get(const sx_hashtbl64* tbl, int index)
+{
+    sx_assert(index >= 0 && index < tbl->capacity);
+    return tbl->values[index];
+}
+
+static inline int sx_hashtbl64_find_get(const sx_hashtbl64* tbl, uint64_t key, int not_found_val)
+{
+    int index = sx_hashtbl64_find(tbl, key);
+    return index != -1 ? tbl->values[index] : not_found_val;
+}
+
+static inline void sx_hashtbl64_remove(sx_hashtbl64* tbl, int index)
+{
+    sx_assert(index >= 0 && index < tbl->capacity);
+    sx_assert(tbl->keys[index] != 0 && tbl->keys[index] != SX_HASHTBL64_TOMBSTONE);
+
+    if (sx__hashtbl64_group_has_empty(tbl->keys, index)) {
+        tbl->keys[index] = 0;
+    } else {
+        tbl->keys[index] = SX_HASHTBL64_TOMBSTONE;
+        ++tbl->_num_tombstones;
+    }
+    --tbl->count;
+}
+
+static inline void sx_hashtbl64_remove_if_found(sx_hashtbl64* tbl, uint64_t key)
+{
+    int index = sx_hashtbl64_find(tbl, key);
+    if (index != -1)
+        sx_hashtbl64_remove(tbl, index);
+}
+
+static inline bool sx_hashtbl64_full(const sx_hashtbl64* tbl)
+{
+    return tbl->capacity == tbl->count;
+}
+
+static inline bool sx_hashtbl64_needs_grow(const sx_hashtbl64* tbl)
+{
+    return (tbl->count + tbl->_num_tombstones + 1) * 100 > tbl->capacity * SX_CONFIG_HASHTBL_MAX_LOAD;
+}
+
+#define sx_hashtbl64_add_and_grow(_tbl, _key, _value, _alloc)                \
+    (sx_hashtbl64_needs_grow(_tbl) ? sx_hashtbl64_grow(&(_tbl), _alloc) : 0, \
+     sx_hashtbl64_add(_tbl, _key, _value))
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Hash table
 typedef struct sx_hashtbl_tval {
@@ -187,6 +355,7 @@ typedef struct sx_hashtbl_tval {
     int value_stride;
     int count;
     int capacity;
+    int _num_tombstones;
 #if SX_CONFIG_HASHTBL_DEBUG
     int _miss_cnt;
     int _probe_cnt;
@@ -222,8 +391,14 @@ static inline const void* sx_hashtbltval_find_get(const sx_hashtbl_tval* tbl, ui
 static inline void sx_hashtbltval_remove(sx_hashtbl_tval* tbl, int index)
 {
     sx_assert(index >= 0 && index < tbl->capacity);
+    sx_assert(tbl->keys[index] != 0 && tbl->keys[index] != SX_HASHTBL_TOMBSTONE);
 
-    tbl->keys[index] = 0;
+    if (sx__hashtbl_group_has_empty(tbl->keys, index)) {
+        tbl->keys[index] = 0;
+    } else {
+        tbl->keys[index] = SX_HASHTBL_TOMBSTONE;
+        ++tbl->_num_tombstones;
+    }
     --tbl->count;
 }
 
@@ -240,6 +415,25 @@ static inline bool sx_hashtbltval_full(const sx_hashtbl_tval* tbl)
     return tbl->capacity == tbl->count;
 }
 
-#define sx_hashtbltval_add_and_grow(_tbl, _key, _value, _alloc)        \
-    (sx_hashtbltval_full(_tbl) ? sx_hashtbltval_grow(&(_tbl), _alloc) : 0, \
+static inline bool sx_hashtbltval_needs_grow(const sx_hashtbl_tval* tbl)
+{
+    return (tbl->count + tbl->_num_tombstones + 1) * 100 > tbl->capacity * SX_CONFIG_HASHTBL_MAX_LOAD;
+}
+
+#define sx_hashtbltval_add_and_grow(_tbl, _key, _value, _alloc)                  \
+    (sx_hashtbltval_needs_grow(_tbl) ? sx_hashtbltval_grow(&(_tbl), _alloc) : 0, \
      sx_hashtbltval_add(_tbl, _key, _value))
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Thread-safe hash table (read-mostly)
+typedef struct sx_hashtbl_mt sx_hashtbl_mt;
+
+SX_API sx_hashtbl_mt* sx_hashtblmt_create(const sx_alloc* alloc, int capacity, int num_shards);
+SX_API void sx_hashtblmt_destroy(sx_hashtbl_mt* tbl, const sx_alloc* alloc);
+
+SX_API bool sx_hashtblmt_add(sx_hashtbl_mt* tbl, uint32_t key, int value);
+SX_API bool sx_hashtblmt_remove(sx_hashtbl_mt* tbl, uint32_t key);
+SX_API int sx_hashtblmt_find_get(const sx_hashtbl_mt* tbl, uint32_t key, int not_found_val);
+SX_API int sx_hashtblmt_count(const sx_hashtbl_mt* tbl);
+SX_API void sx_hashtblmt_clear(sx_hashtbl_mt* tbl);
+SX_API void sx_hashtblmt_collect(sx_hashtbl_mt* tbl, uint64_t epoch, uint64_t safe_epoch);
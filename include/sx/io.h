@@ -46,6 +46,9 @@
 //              
 //              sx_file_load_bin            allocates memory and loads the file data into it
 //              sx_file_load_text           Same as binary, but appends a null terminator to the end of the buffer
+//              sx_file_map                 maps the file into memory (read-only) instead of loading it, the pages
+//                                          are read on demand by the OS. only the block object is allocated
+//                                          from `alloc`, and the file is unmapped on sx_mem_destroy_block
 //              
 //              sx_file_write_var           Helper macro: writes a variable to file (no need for sizeof)
 //              sx_file_write_text          Helper macro: writes a string to file (no need for strlen)
@@ -106,6 +109,7 @@ typedef struct sx_mem_block {
     int64_t size;
     int align;
     int volatile refcount; 
+    bool mapped;    // data is a read-only file mapping (see sx_file_map), can't be written or grown
 } sx_mem_block;
 
 SX_API sx_mem_block* sx_mem_create_block(const sx_alloc* alloc, int64_t size,
@@ -185,6 +189,7 @@ SX_API int64_t sx_file_size(const sx_file* file);
 
 SX_API sx_mem_block* sx_file_load_text(const sx_alloc* alloc, const char* filepath);
 SX_API sx_mem_block* sx_file_load_bin(const sx_alloc* alloc, const char* filepath);
+SX_API sx_mem_block* sx_file_map(const sx_alloc* alloc, const char* filepath);
 
 #define sx_file_write_var(w, v) sx_file_write((w), &(v), sizeof(v))
 #define sx_file_write_text(w, s) sx_file_write((w), (s), sx_strlen(s))
@@ -7,8 +7,9 @@
 //
 // Job dispatcher is a multi-threaded task scheduler, that uses lightweight fibers to switch
 //      contexts and schedule jobs.
-//      Jobs are converted into fibers and pushed to a list that are picked up by worker threads
-//      Worker threads pickup fibers and switch to them. When dependencies and nested jobs are
+//      Jobs are converted into fibers and pushed to the dispatching thread's work-stealing deque
+//      Worker threads pop fibers from their own deque (or steal from other threads' deques when
+//      they run out of work) and switch to them. When dependencies and nested jobs are
 //      created, they are immediately rescheduled to threads and replace the current job they are
 //      doing. Threads can also get back and continue the job when dependencies are met.
 //      This makes this scheduler powerfull in terms of shceduling and not blocking the threads to
@@ -39,6 +40,26 @@
 //                                                    get stack overflow exception.
 //                                                    Usually a number between 128kb ~ 2mb is
 //                                                    sufficient.
+//                                  - spin_count, yield_count: Idle policy of the threads.
+//                                                Threads that run out of work first retry
+//                                                `spin_count` times with cpu pause, then
+//                                                `yield_count` times with yielding the thread,
+//                                                and then sleep until new jobs are dispatched.
+//                                                Higher values give faster wake ups for bursty
+//                                                work, lower values burn less cpu while idle.
+//                                                0 means default (64 and 8), negative means none
+//                                  - pin_mode: Pins worker threads to logical processors, see
+//                                              `sx_job_pin_mode`. With SX_JOB_PIN_PHYSICAL and
+//                                              num_threads <= 0, there will be one thread for each
+//                                              physical core (including main thread)
+//                                  - topology_tags: assigns tags of pinned worker threads by the
+//                                                   socket or last-level cache domain they are
+//                                                   pinned to, so jobs with tags=(1 << N) only run
+//                                                   on group N. Main thread keeps matching all
+//                                                   tags. See `sx_job_topology_tags` and
+//                                                   sx_os_cpu_topology
+//                                  NOTE: job system uses timer.h for idle stats and tracing, so
+//                                        `sx_tm_init` must be called before creating the context
 //      sx_job_destroy_context      Destroy the job context
 //      sx_job_dispatch             (Thread-Safe) Submit bunch of sub-jobs for the scheduler, this
 //                                  will return a valid sx_job_t handle that you can later wait on
@@ -57,9 +78,30 @@
 //                                              higher priority jobs gets executed earlier
 //                                  - tags: (default: 0) assigns work tag for the job. See below for
 //                                           more details on the concept of Tags
+//                                  - affinity: (default: 0) affinity key for the job. Dispatches
+//                                              with the same key are hashed to the same worker
+//                                              threads, so jobs that touch the same data every
+//                                              frame keep their caches warm. Other threads only
+//                                              pick up the job if the target thread is busy.
+//                                              Jobs with tags ignore the affinity key
+//                                  - flags: (default: 0) combination of `sx_job_flags`
+//                                           SX_JOB_FLAG_LEAF: the job never calls
+//                                           `sx_job_wait_and_del`, so it runs directly on the
+//                                           worker's stack without creating and switching to a
+//                                           fiber. Use this for small callbacks that don't
+//                                           dispatch and wait on other jobs
 //                                  NOTE: if max_fibers (running-jobs) is exceeded, job will be
 //                                        queued and automatically dispatched later on
 //                                        'sx_job_wait_and_del' and 'sx_job_test_and_del'
+//      sx_job_parallel_for         (Thread-Safe) Same as `sx_job_dispatch`, but instead of splitting
+//                                  `count` into equal ranges, every job grabs chunks of the
+//                                  remaining iterations until all of them are done. Chunks start
+//                                  big and get smaller towards the end, so workers that finish
+//                                  early take a share of the remaining work. Use this when the
+//                                  cost of each item varies a lot
+//                                  - grain_size: minimum number of iterations in each callback
+//                                  NOTE: callback is called multiple times per job, with
+//                                        different ranges
 //      sx_job_wait_and_del         (Thread-Safe) Blocks the program and waits on dispatched job.
 //                                  It deletes the sx_job_t handle if the job is done
 //                                  NOTE: If the sx_job_t is done this functions returns immediately
@@ -75,9 +117,52 @@
 //      sx_job_set_current_thread_tags Sets thread-tag for the current running thread.
 //                                     better call this inside `sx_job_thread_init_cb` callback
 //                                     function. See below for more details on the concept of Tags
+//      sx_job_quiescent_snapshot   Records what every thread (including main) is running right now
+//                                  into `snapshot`, count = sx_job_num_worker_threads() + 1
+//                                  Use it to find out when memory that jobs may still be reading
+//                                  can be freed: unlink/retire the memory first, take a snapshot,
+//                                  and free the memory after sx_job_quiescent_passed returns True
+//                                  NOTE: only covers code that runs inside jobs, the calling
+//                                        thread must not be running a job itself
+//      sx_job_quiescent_passed     (Thread-Safe) Returns True if every job that was running at the
+//                                  time of the snapshot is done or has been parked in
+//                                  sx_job_wait_and_del since. Non-blocking, call it once per frame
 //
 //      sx_job_thread_index         Get current working thread's index (0..num_workers)
 //      sx_job_thread_id            Get current working thread's Os Id
+//      sx_job_get_thread_stats     Get busy/spin/park times of a thread (0..num_workers).
+//                                  times are accumulated from the creation of the context and are
+//                                  in ticks (see timer.h). To get values for each frame, subtract
+//                                  the values of the previous frame
+//
+//  Tracing:
+//      Build with SX_CONFIG_JOB_TRACE=1 to record the timeline of the jobs. Every thread keeps the
+//      last SX_CONFIG_JOB_TRACE_EVENTS events (dispatch, run, wait and resume of each job) in it's
+//      own ring buffer, so recording doesn't take any locks. With tracing disabled, nothing is
+//      recorded and the functions below do nothing.
+//
+//      sx_job_trace_dump           Writes recorded events to a Chrome trace (JSON) file, that can be
+//                                  opened with chrome://tracing or https://ui.perfetto.dev
+//                                  Returns false if tracing is disabled or file cannot be written
+//                                  NOTE: runs of the jobs that are still running are not included
+//      sx_job_trace_reset          Discards recorded events, for example to only capture a frame
+//
+//  Job graphs:
+//      Chains of dependent work can be built as a graph instead of waiting inside jobs. Each node is
+//      a dispatch (same parameters as `sx_job_dispatch`), and edges declare which nodes should only
+//      start after others are finished. Successor nodes are dispatched by the thread that finishes
+//      the last job of their predecessors, so no fibers are parked while waiting.
+//      Graphs are kept after submit, so they can be built once and re-submitted every frame.
+//      The graph must be acyclic and must be finished before it is submitted again.
+//
+//      sx_job_graph_create         Create an empty job graph
+//      sx_job_graph_destroy        Destroy the job graph
+//      sx_job_graph_add_node       Add a node and return it's index.
+//                                  parameters are the same as `sx_job_dispatch`
+//      sx_job_graph_add_edge       Make `to_node` depend on `from_node`
+//      sx_job_graph_submit         (Thread-Safe) Dispatch the root nodes of the graph, returns a
+//                                  sx_job_t handle that is finished when all nodes are done.
+//                                  wait on it with `sx_job_wait_and_del` or `sx_job_test_and_del`
 //
 // clang-format off
 //  Tags (Advanced):
@@ -98,9 +183,11 @@
 
 #include "macros.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct sx_alloc sx_alloc;
 typedef struct sx_job_context sx_job_context;
+typedef struct sx_job_graph sx_job_graph;
 typedef volatile int* sx_job_t;
 
 typedef void(sx_job_cb)(int range_start, int range_end, int thread_index, void* user);
@@ -116,10 +203,31 @@ typedef enum sx_job_priority {
     SX_JOB_PRIORITY_COUNT
 } sx_job_priority;
 
+typedef enum sx_job_flags {
+    SX_JOB_FLAG_NONE = 0,
+    SX_JOB_FLAG_LEAF = 0x1    // job never waits, so it doesn't need a fiber
+} sx_job_flags;
+
+typedef enum sx_job_pin_mode {
+    SX_JOB_PIN_NONE = 0,    // threads are free to move between cpus (default)
+    SX_JOB_PIN_LOGICAL,     // pin each worker to a logical cpu, filling physical cores first
+    SX_JOB_PIN_PHYSICAL     // pin each worker to a physical core (it's first hardware thread)
+} sx_job_pin_mode;
+
+typedef enum sx_job_topology_tags {
+    SX_JOB_TOPOLOGY_TAGS_NONE = 0,    // worker tags are 0xffffffff (default)
+    SX_JOB_TOPOLOGY_TAGS_SOCKET,      // worker tags are (1 << socket index)
+    SX_JOB_TOPOLOGY_TAGS_CACHE        // worker tags are (1 << last-level cache domain index)
+} sx_job_topology_tags;
+
 typedef struct sx_job_context_desc {
     int num_threads;    // number of worker threads to spawn,exclude main (default: num_cpu_cores-1)
     int max_fibers;     // maximum fibers that are can be running at the same time (default: 64)
     int fiber_stack_sz;                               // fiber stack size (default: 1mb)
+    int spin_count;     // idle tries with cpu pause before yielding (default: 64, <0: none)
+    int yield_count;    // idle tries with thread yield before sleeping (default: 8, <0: none)
+    sx_job_pin_mode pin_mode;              // pinning of worker threads (default: none)
+    sx_job_topology_tags topology_tags;    // tags of pinned worker threads (default: none)
     sx_job_thread_init_cb* thread_init_cb;            // callback function that will be called on
                                                       // initiaslization of each worker thread
     sx_job_thread_shutdown_cb* thread_shutdown_cb;    // callback functions that will be called on
@@ -127,17 +235,48 @@ typedef struct sx_job_context_desc {
     void* thread_user_data;    // user-data to be passed to callback functions above
 } sx_job_context_desc;
 
+typedef struct sx_job_thread_stats {
+    uint64_t busy_tm;    // time spent on running jobs
+    uint64_t spin_tm;    // time spent on finding jobs, spinning and yielding
+    uint64_t park_tm;    // time spent on sleeping, waiting for new jobs
+    int num_parks;       // number of times that the thread went to sleep
+} sx_job_thread_stats;
+
 SX_API sx_job_context* sx_job_create_context(const sx_alloc* alloc,
                                              const sx_job_context_desc* desc);
 SX_API void sx_job_destroy_context(sx_job_context* ctx, const sx_alloc* alloc);
 
 SX_API sx_job_t sx_job_dispatch(sx_job_context* ctx, int count, sx_job_cb* callback, void* user,
                                 sx_job_priority priority sx_default(SX_JOB_PRIORITY_NORMAL),
-                                unsigned int tags sx_default(0));
+                                unsigned int tags sx_default(0),
+                                unsigned int affinity sx_default(0),
+                                unsigned int flags sx_default(0));
+SX_API sx_job_t sx_job_parallel_for(sx_job_context* ctx, int count, int grain_size,
+                                    sx_job_cb* callback, void* user,
+                                    sx_job_priority priority sx_default(SX_JOB_PRIORITY_NORMAL),
+                                    unsigned int tags sx_default(0),
+                                    unsigned int flags sx_default(0));
 SX_API void sx_job_wait_and_del(sx_job_context* ctx, sx_job_t job);
 SX_API bool sx_job_test_and_del(sx_job_context* ctx, sx_job_t job);
 SX_API int sx_job_num_worker_threads(sx_job_context* ctx);
 SX_API void sx_job_set_current_thread_tags(sx_job_context* ctx, unsigned int tags);
 
 SX_API int sx_job_thread_index(sx_job_context* ctx);
-SX_API unsigned int sx_job_thread_id(sx_job_context* ctx);
\ No newline at end of file
+SX_API unsigned int sx_job_thread_id(sx_job_context* ctx);
+SX_API void sx_job_get_thread_stats(sx_job_context* ctx, int thread_index,
+                                    sx_job_thread_stats* stats);
+
+SX_API void sx_job_quiescent_snapshot(sx_job_context* ctx, int* snapshot);
+SX_API bool sx_job_quiescent_passed(sx_job_context* ctx, const int* snapshot);
+
+SX_API bool sx_job_trace_dump(sx_job_context* ctx, const char* filepath);
+SX_API void sx_job_trace_reset(sx_job_context* ctx);
+
+SX_API sx_job_graph* sx_job_graph_create(const sx_alloc* alloc);
+SX_API void sx_job_graph_destroy(sx_job_graph* graph, const sx_alloc* alloc);
+SX_API int sx_job_graph_add_node(sx_job_graph* graph, int count, sx_job_cb* callback, void* user,
+                                 sx_job_priority priority sx_default(SX_JOB_PRIORITY_NORMAL),
+                                 unsigned int tags sx_default(0),
+                                 unsigned int flags sx_default(0));
+SX_API void sx_job_graph_add_edge(sx_job_graph* graph, int from_node, int to_node);
+SX_API sx_job_t sx_job_graph_submit(sx_job_context* ctx, sx_job_graph* graph);
@@ -16,9 +16,54 @@ SX_API bool sx_queue_spsc_grow(sx_queue_spsc* queue, const sx_alloc* alloc);
 SX_API bool sx_queue_spsc_full(const sx_queue_spsc* queue);
 
 #define sx_queue_spsc_produce_and_grow(_queue, _data, _alloc) \
-    if (!sx_queue_spsc_produce((_queue), (_data))) {          \
-        if (sx_queue_spsc_grow((_queue), (_alloc)))           \
-            sx_queue_spsc_produce((_queue), (_data));         \
-    }
+    do {                                                      \
+        if (!sx_queue_spsc_produce((_queue), (_data))) {      \
+            if (sx_queue_spsc_grow((_queue), (_alloc)))       \
+                sx_queue_spsc_produce((_queue), (_data));     \
+        }                                                     \
+    } while (0)
 
 
+
+// multi-producer / multi-consumer
+// bounded: capacity is rounded up to power of two and the queue does not grow. produce returns
+//          false if the queue is full, consume returns false if it's empty
+// batch functions move up to `count` items with a single claim on the queue and return the number
+// of items that are moved. They may briefly spin on cells that a slower thread is still copying
+// Reference: http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+typedef struct sx_queue_mpmc sx_queue_mpmc;
+SX_API sx_queue_mpmc* sx_queue_mpmc_create(const sx_alloc* alloc, int item_sz, int capacity);
+SX_API void sx_queue_mpmc_destroy(sx_queue_mpmc* queue, const sx_alloc* alloc);
+
+SX_API bool sx_queue_mpmc_produce(sx_queue_mpmc* queue, const void* data);
+SX_API bool sx_queue_mpmc_consume(sx_queue_mpmc* queue, void* data);
+SX_API int sx_queue_mpmc_produce_batch(sx_queue_mpmc* queue, const void* items, int count);
+SX_API int sx_queue_mpmc_consume_batch(sx_queue_mpmc* queue, void* items, int count);
+SX_API int sx_queue_mpmc_count(const sx_queue_mpmc* queue);    // approximate if threads are busy
+
+// multi-producer / single-consumer
+// intrusive and unbounded: embed sx_queue_mpsc_node in your items, the queue does not allocate or
+// copy anything, and a node must not be produced again before it's consumed
+// consume may return NULL while a producer is in the middle of producing, even if the queue is not
+// empty, so poll it again later
+// Reference: http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+//      typedef struct { sx_queue_mpsc_node node; int value; } item;
+//      sx_queue_mpsc_produce(&queue, &my_item->node);      // any thread
+//      item* i = (item*)sx_queue_mpsc_consume(&queue);     // consumer thread (node is first member)
+typedef struct sx_queue_mpsc_node {
+    struct sx_queue_mpsc_node* volatile next;
+} sx_queue_mpsc_node;
+
+typedef struct sx_queue_mpsc {
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_queue_mpsc_node* volatile) head;    // producers
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_queue_mpsc_node*) tail;             // consumer
+    sx_queue_mpsc_node stub;
+} sx_queue_mpsc;
+
+SX_API void sx_queue_mpsc_init(sx_queue_mpsc* queue);
+SX_API void sx_queue_mpsc_produce(sx_queue_mpsc* queue, sx_queue_mpsc_node* node);
+// `first` to `last` must already be linked with `next`
+SX_API void sx_queue_mpsc_produce_batch(sx_queue_mpsc* queue, sx_queue_mpsc_node* first,
+                                        sx_queue_mpsc_node* last);
+SX_API sx_queue_mpsc_node* sx_queue_mpsc_consume(sx_queue_mpsc* queue);
+SX_API int sx_queue_mpsc_consume_batch(sx_queue_mpsc* queue, sx_queue_mpsc_node** nodes, int count);
@@ -0,0 +1,92 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// math-batch.h - v1.0 - Array (batch) versions of hot math.h functions
+//
+// Functions in math.h work on one element per call. The functions here process whole arrays,
+// which lets them keep matrices in registers and use wide SIMD instructions.
+// On x86, SSE2 kernels are the baseline, and AVX2+FMA kernels are selected at runtime when the
+// cpu supports them (see sx_os_cpu_features). ARM uses NEON if it's available at compile-time.
+// Other platforms, or SX_CONFIG_SIMD_DISABLE=1 builds, use plain C loops.
+//
+// Layouts:
+//      AoS: (*_batch functions) arrays of math.h types (sx_vec3, sx_aabb, sx_mat4, ...)
+//      SoA: (*_soa functions) one array for each component, described by sx_vec3_soa, etc.
+//           fastest layout, because kernels process 4 (or 8 with AVX2) elements per instruction
+//
+// Results can differ from the scalar math.h functions by rounding errors, because FMA is used
+// on AVX2 and AABBs are transformed as center/extents (Arvo's method) instead of min/max.
+// Culling functions are the exception: they don't use FMA, and give the exact same bits on all
+// cpus and code paths.
+//
+// Input and output arrays can be the same array (in-place), but other than that, they should not
+// overlap. Arrays don't need any special alignment.
+//
+#pragma once
+
+#include "math.h"
+
+typedef struct sx_vec2_soa {
+    float* x;
+    float* y;
+} sx_vec2_soa;
+
+typedef struct sx_vec3_soa {
+    float* x;
+    float* y;
+    float* z;
+} sx_vec3_soa;
+
+typedef struct sx_aabb_soa {
+    float* xmin;
+    float* ymin;
+    float* zmin;
+    float* xmax;
+    float* ymax;
+    float* zmax;
+} sx_aabb_soa;
+
+// dst[i] = mat * src[i] (same as sx_mat4_mul_vec3)
+SX_API void sx_mat4_mul_vec3_batch(sx_vec3* dst, const sx_vec3* src, int count,
+                                   const sx_mat4* mat);
+SX_API void sx_mat4_mul_vec3_soa(sx_vec3_soa dst, sx_vec3_soa src, int count, const sx_mat4* mat);
+
+// dst[i] = mat * src[i] (same as sx_mat3_mul_vec2)
+SX_API void sx_mat3_mul_vec2_batch(sx_vec2* dst, const sx_vec2* src, int count,
+                                   const sx_mat3* mat);
+SX_API void sx_mat3_mul_vec2_soa(sx_vec2_soa dst, sx_vec2_soa src, int count, const sx_mat3* mat);
+
+// dst[i] = sx_aabb_transform(src[i], mats[i])
+SX_API void sx_aabb_transform_batch(sx_aabb* dst, const sx_aabb* src, const sx_mat4* mats,
+                                    int count);
+// dst[i] = sx_aabb_transform(src[i], mat)
+SX_API void sx_aabb_transform_soa(sx_aabb_soa dst, sx_aabb_soa src, int count, const sx_mat4* mat);
+
+// dst[i] = a[i] * b[i] (same as sx_mat4_mul)
+SX_API void sx_mat4_mul_batch(sx_mat4* dst, const sx_mat4* a, const sx_mat4* b, int count);
+
+// frustum culling: tests items against 'num_planes' planes (max 16) with normals pointing inside,
+// and writes 1 bit per item to 'visible_bits': bit (i % 32) of visible_bits[i / 32] is set if the
+// item is inside or intersects all the planes. The test is conservative, so items that are near
+// the corners of the frustum, but outside of it, can still be reported as visible.
+// visible_bits is overwritten and should have room for (count + 31) / 32 words. To split the work
+// across threads, pass sub-ranges that start at multiples of 32 items, so words are not shared.
+//      spheres: xyz = center, w = radius
+//      rects: 2d rectangles on the z=0 plane (sprites, tiles, etc.)
+SX_API void sx_aabb_cull_batch(uint32_t* visible_bits, const sx_aabb* aabbs, int count,
+                               const sx_plane* planes, int num_planes);
+SX_API void sx_sphere_cull_batch(uint32_t* visible_bits, const sx_vec4* spheres, int count,
+                                 const sx_plane* planes, int num_planes);
+SX_API void sx_rect_cull_batch(uint32_t* visible_bits, const sx_rect* rects, int count,
+                               const sx_plane* planes, int num_planes);
+
+// packs transforms into 3 rows of vec4 per item, which is the usual layout for instance buffers:
+//      row1 = (pos.x, pos.y, pos.z, rot.m11)
+//      row2 = (rot.m21, rot.m31, rot.m12, rot.m22)
+//      row3 = (rot.m32, rot.m13, rot.m23, rot.m33)
+// rotation is unpacked in shaders as: mat3(row1.w, row2.xy, row2.zw, row3.x, row3.yzw)
+// strides are the distance between items in bytes (>= sizeof(sx_tx3d)), so transforms can be read
+// from bigger structs (like sx_box), and rows are written at the start of each destination item
+SX_API void sx_tx3d_pack_batch(void* dst, int dst_stride, const sx_tx3d* src, int src_stride,
+                               int count);
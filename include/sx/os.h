@@ -28,6 +28,27 @@ typedef struct sx_file_info {
     uint64_t last_modified;    // time_t
 } sx_file_info;
 
+// Logical processor (hardware thread) and it's place in cpu topology
+// indexes are compact and zero based, so they can be used as indexes to arrays or as bit indexes
+typedef struct sx_os_cpu {
+    int id;        // os logical processor id, used for thread affinity (see sx_thread_setaffinity)
+    int core;      // physical core index, SMT siblings (hyper-threads) share the same core
+    int socket;    // physical package (socket) index
+    int cache;     // last-level cache domain index, cpus that share the last-level cache
+    int smt;       // hardware thread index within the core, 0 for the first one
+} sx_os_cpu;
+
+// Instruction set extensions that are detected at runtime, see sx_os_cpu_features
+typedef enum sx_cpu_feature {
+    SX_CPU_FEATURE_SSE2 = 0x01,
+    SX_CPU_FEATURE_SSE41 = 0x02,
+    SX_CPU_FEATURE_AVX = 0x04,
+    SX_CPU_FEATURE_AVX2 = 0x08,
+    SX_CPU_FEATURE_FMA = 0x10,
+    SX_CPU_FEATURE_NEON = 0x20
+} sx_cpu_feature;
+typedef uint32_t sx_cpu_features;
+
 typedef struct sx_pinfo {
     union {
         uintptr_t linux_pid;
@@ -76,3 +97,20 @@ SX_API char* sx_os_path_exepath(char* dst, int size);
 SX_API sx_file_info sx_os_stat(const char* filepath);
 
 SX_API int sx_os_numcores();
+
+// fills `cpus` with online logical processors ordered by id and returns the count
+// `cpus` should have room for at least `sx_os_numcores()` items. Topology is read from /sys on
+// linux/android and GetLogicalProcessorInformationEx on windows. Other platforms report each
+// logical processor as a separate core
+SX_API int sx_os_cpu_topology(sx_os_cpu* cpus, int max_cpus);
+
+// returns a combination of sx_cpu_feature flags for the current processor
+// AVX flags are only set if the OS also saves the YMM registers. NEON is a compile-time check
+// detection runs on the first call and the result is cached
+SX_API sx_cpu_features sx_os_cpu_features(void);
+
+// removes `features` from what sx_os_cpu_features reports for the rest of the process, so the
+// code paths that are selected at runtime fall back to the baseline (SSE2 instead of AVX2, ..)
+// used by tests and benchmarks to compare the paths. Not thread-safe, call it at startup or when
+// no other thread is running sx code
+SX_API void sx_os_disable_cpu_features(sx_cpu_features features);
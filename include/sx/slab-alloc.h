@@ -0,0 +1,54 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// slab-alloc.h - v1.0 - Thread-caching size-class heap allocator
+//
+// sx_slaballoc is a general purpose heap, meant to be used as a drop-in replacement for
+// sx_alloc_malloc in multi-threaded programs that do many small allocations.
+//
+// Small allocations (<= 8kb) are rounded up to one of 32 size classes and served from 64kb spans.
+// Every thread gets it's own cache (heap) of spans, so allocating and freeing blocks on the
+// owner thread does not take any locks or atomics.
+// Blocks that are freed by other threads are pushed to the owner heap's lock-free 'remote' list,
+// and the owner collects them the next time it runs out of blocks for a size class.
+// Spans are carved out of a single virtual memory reservation (see vmem.h), so the owning span of
+// a pointer is found with a range check and a mask, without any per-block header.
+// Bigger allocations (or small ones after the reservation is exhausted) are passed to the backing
+// allocator with a small header.
+//
+// Statistics are kept per thread and only aggregated when you call sx_slaballoc_get_stats. They
+// are approximate while other threads are allocating, and 'peak' is sampled at the time of each
+// call.
+//
+// NOTE: Thread caches are kept until the allocator is destroyed, even if their thread exits.
+//       Memory freed to the heap of a thread that no longer exists is not reused.
+//
+// Usage:
+//      sx_slaballoc* slab = sx_slaballoc_create(sx_alloc_malloc(), 0);
+//      const sx_alloc* alloc = sx_slaballoc_alloc(slab);
+//      void* p = sx_malloc(alloc, 100);     // can be freed on any thread
+//      sx_free(alloc, p);
+//      sx_slaballoc_destroy(slab, sx_alloc_malloc());
+//
+#pragma once
+
+#include "allocator.h"
+
+typedef struct sx_slaballoc sx_slaballoc;
+
+typedef struct sx_slaballoc_stats {
+    int64_t size;        // bytes in live allocations (rounded up to size classes)
+    int64_t peak;        // maximum 'size' that was seen by sx_slaballoc_get_stats
+    int64_t count;       // number of live allocations
+    int64_t reserved;    // bytes committed for spans + bytes of big allocations
+    int num_threads;     // number of thread caches
+} sx_slaballoc_stats;
+
+// max_span_mem: size of virtual memory reserved for small allocations (0 = default)
+//               default is 1GB on 64bit and 128MB on 32bit platforms
+SX_API sx_slaballoc* sx_slaballoc_create(const sx_alloc* alloc, size_t max_span_mem);
+SX_API void sx_slaballoc_destroy(sx_slaballoc* slab, const sx_alloc* alloc);
+SX_API const sx_alloc* sx_slaballoc_alloc(sx_slaballoc* slab);
+SX_API size_t sx_slaballoc_usable_size(const sx_slaballoc* slab, const void* ptr);
+SX_API void sx_slaballoc_get_stats(sx_slaballoc* slab, sx_slaballoc_stats* stats);
@@ -113,3 +113,55 @@ SX_API int sx_strpool_len(const sx_strpool* sp, sx_str_t handle);
 
 SX_API sx_strpool_collate_data sx_strpool_collate(const sx_strpool* sp);
 SX_API void sx_strpool_collate_free(const sx_strpool* sp, sx_strpool_collate_data data);
+
+// sx_strtbl: thread-safe string interner, built on sx_strpool
+//      Each unique string is stored once and never removed, so ids (sx_istr_t) are stable and two
+//      strings are equal only if their ids are equal. Each string keeps its hash (same as
+//      sx_hash_fnv32) and length, so they're never computed again, and the pointer returned by
+//      cstr is valid until the table is destroyed.
+//      Lookups (find, cstr, hash, len) never lock, adding new strings takes a spin-lock.
+//      Id 0 is reserved for "no string": cstr returns "", hash and len return 0.
+//      sx_strtbl_add       interns the string and returns its id (len < 0: null-terminated)
+//      sx_strtbl_find      returns the id if the string is already interned, or 0 (never adds)
+//      sx_strtbl_collect   frees memory left from growing the lookup table after a grace period,
+//                          `epoch` and `safe_epoch` work the same as sx_hashtblmt_collect
+//
+// sx_intern_*: global table for the module that links sx (the executable or a shared library),
+//              must be initialized with sx_intern_init before use
+typedef struct sx_strtbl sx_strtbl;
+typedef uint32_t sx_istr_t;
+
+SX_API sx_strtbl* sx_strtbl_create(const sx_alloc* alloc);
+SX_API void sx_strtbl_destroy(sx_strtbl* tbl, const sx_alloc* alloc);
+
+SX_API sx_istr_t sx_strtbl_add(sx_strtbl* tbl, const char* str, int len);
+SX_API sx_istr_t sx_strtbl_find(const sx_strtbl* tbl, const char* str, int len);
+SX_API const char* sx_strtbl_cstr(const sx_strtbl* tbl, sx_istr_t id);
+SX_API uint32_t sx_strtbl_hash(const sx_strtbl* tbl, sx_istr_t id);
+SX_API int sx_strtbl_len(const sx_strtbl* tbl, sx_istr_t id);
+SX_API int sx_strtbl_count(const sx_strtbl* tbl);
+SX_API void sx_strtbl_collect(sx_strtbl* tbl, uint64_t epoch, uint64_t safe_epoch);
+
+SX_API bool sx_intern_init(const sx_alloc* alloc);
+SX_API void sx_intern_release(void);
+SX_API sx_strtbl* sx_intern_tbl(void);
+
+static inline sx_istr_t sx_intern(const char* str)
+{
+    return sx_strtbl_add(sx_intern_tbl(), str, -1);
+}
+
+static inline sx_istr_t sx_intern_find(const char* str)
+{
+    return sx_strtbl_find(sx_intern_tbl(), str, -1);
+}
+
+static inline const char* sx_intern_cstr(sx_istr_t id)
+{
+    return sx_strtbl_cstr(sx_intern_tbl(), id);
+}
+
+static inline uint32_t sx_intern_hash(sx_istr_t id)
+{
+    return sx_strtbl_hash(sx_intern_tbl(), id);
+}
@@ -18,6 +18,11 @@
 //      sx_signal       Portable OS signals/events. simplified version of the semaphore,
 //                      where you 'wait' for signal to be triggered, then in another thread you
 //                      'raise' it and 'wait' will continue
+//      sx_futex        Wait on an integer address until another thread changes it's value and
+//                      wakes it up. 'wait' returns immediately if the value is not 'expected'.
+//                      This is the primitive for building custom lightweight waiting schemes, like
+//                      parking threads when they run out of work
+//                      Uses futex syscall on linux and WaitOnAddress on windows 8+
 //      sx_queue_spsc   Single producer/Single consumer self contained queue
 //
 #pragma once
@@ -42,6 +47,9 @@ SX_API bool sx_thread_running(sx_thread* thrd);
 SX_API void sx_thread_setname(sx_thread* thrd, const char* name);
 SX_API void sx_thread_yield();
 SX_API uint32_t sx_thread_tid();
+// pins the current thread to a logical processor (see sx_os_cpu_topology), returns false if failed
+// or the platform doesn't support it
+SX_API bool sx_thread_setaffinity(int cpu_id);
 
 // Tls data
 typedef void* sx_tls;
@@ -82,6 +90,11 @@ SX_API void sx_signal_release(sx_signal* sig);
 SX_API void sx_signal_raise(sx_signal* sig);
 SX_API bool sx_signal_wait(sx_signal* sig, int msecs sx_default(-1));
 
+// Futex
+// wait: returns false if timed out, true otherwise (note that it can also wake up spuriously)
+SX_API bool sx_futex_wait(sx_atomic_int* addr, int expected, int msecs sx_default(-1));
+SX_API void sx_futex_wake(sx_atomic_int* addr, int count sx_default(1));
+
 // Lock-Free single-producer/single-consumer self-contained-data queue
 typedef struct sx_queue_spsc sx_queue_spsc;
 SX_API sx_queue_spsc* sx_queue_spsc_create(const sx_alloc* alloc, int item_sz, int capacity);
@@ -119,8 +119,7 @@ typedef struct sprite__animctrl_transition {
 } sprite__animctrl_transition;
 
 typedef struct sprite__animctrl_param {
-    char name[32];
-    uint32_t name_hash;
+    sx_istr_t name;    // id-to: the_core->intern, =0 terminates the params array
     rizz_sprite_animctrl_param_type type;
     sprite__animctrl_value value;
 } sprite__animctrl_param;
@@ -472,9 +471,9 @@ static int sprite__animctrl_find_param_indesc(const char* name,
 
 static sprite__animctrl_param* sprite__animctrl_find_param(const char* name, sprite__animctrl* ctrl)
 {
-    uint32_t name_hash = sx_hash_fnv32_str(name);
-    for (sprite__animctrl_param* p = &ctrl->params[0]; p->name_hash; ++p) {
-        if (p->name_hash == name_hash) {
+    sx_istr_t name_id = the_core->intern_find(name);
+    for (sprite__animctrl_param* p = &ctrl->params[0]; name_id && p->name; ++p) {
+        if (p->name == name_id) {
             return p;
         }
     }
@@ -702,8 +701,7 @@ rizz_sprite_animctrl sprite__animctrl_create(const rizz_sprite_animctrl_desc* de
     ctrl.state = ctrl.start_state;
     int param_idx = 0;
     for (const rizz_sprite_animctrl_param_desc* p = &desc->params[0]; p->name; ++p, ++param_idx) {
-        sx_strcpy(ctrl.params[param_idx].name, sizeof(ctrl.params[param_idx].name), p->name);
-        ctrl.params[param_idx].name_hash = sx_hash_fnv32_str(p->name);
+        ctrl.params[param_idx].name = the_core->intern(p->name);
         ctrl.params[param_idx].type = p->type;
         ctrl.params[param_idx].value.i = 0;
     }
@@ -884,7 +882,7 @@ void sprite__animctrl_update_batch(const rizz_sprite_animctrl* handles, int num_
             }
         }    // foreach: transition
 
-        for (sprite__animctrl_param* p = &ctrl->params[0]; p->name_hash; ++p) {
+        for (sprite__animctrl_param* p = &ctrl->params[0]; p->name; ++p) {
             if (p->type == RIZZ_SPRITE_PARAMTYPE_BOOL_AUTO && p->value.b)
                 p->value.b = false;
         }
@@ -1600,6 +1598,23 @@ void sprite__set_flip(rizz_sprite handle, rizz_sprite_flip flip)
 }
 
 // draw-data
+static void sprite__gen_verts(rizz_sprite_vertex* dst, const rizz_sprite_vertex* src, int count,
+                              sx_vec2 origin, sx_vec2 size, sx_color color)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i].pos = sx_vec2_mul(sx_vec2_sub(src[i].pos, origin), size);
+        dst[i].uv = src[i].uv;
+        dst[i].color = color;
+    }
+}
+
+static void sprite__offset_indices(uint16_t* dst, const uint16_t* src, int count, int offset)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = (uint16_t)(src[i] + offset);
+    }
+}
+
 rizz_sprite_drawdata* sprite__drawdata_make_batch(const rizz_sprite* sprs, int num_sprites,
                                                   const sx_alloc* alloc)
 {
@@ -1709,51 +1724,30 @@ rizz_sprite_drawdata* sprite__drawdata_make_batch(const rizz_sprite* sprs, int n
 
             const rizz_sprite_vertex* src_verts = &atlas->vertices[aspr->vb_index];
             const uint16_t* src_indices = &atlas->indices[aspr->ib_index];
-            rizz_sprite_vertex* dst_verts = &verts[vertex_idx];
-            uint16_t* dst_indices = &indices[index_idx];
-
-            for (int ii = 0, c = aspr->num_verts; ii < c; ii++) {
-                dst_verts[ii].pos = sx_vec2_mul(sx_vec2_sub(src_verts[ii].pos, origin), size);
-                dst_verts[ii].uv = src_verts[ii].uv;
-                dst_verts[ii].color = color;
-            }
-
-            for (int ii = 0, c = aspr->num_indices; ii < c; ii += 3) {
-                dst_indices[ii] = src_indices[ii] + vertex_start;
-                dst_indices[ii + 1] = src_indices[ii + 1] + vertex_start;
-                dst_indices[ii + 2] = src_indices[ii + 2] + vertex_start;
-            }
-
+            sprite__gen_verts(&verts[vertex_idx], src_verts, aspr->num_verts, origin, size, color);
+            sprite__offset_indices(&indices[index_idx], src_indices, aspr->num_indices,
+                                   vertex_start);
 
             vertex_idx += aspr->num_verts;
             index_idx += aspr->num_indices;
         } else {
             // normal texture sprite: there is no atalas. sprite takes the whole texture
+            // clang-format off
+            static const rizz_sprite_vertex k_quad_verts[] = {
+                { {{-0.5f, -0.5f}}, {{0.0f, 1.0f}}, {{0}} },
+                { {{ 0.5f, -0.5f}}, {{1.0f, 1.0f}}, {{0}} },
+                { {{-0.5f,  0.5f}}, {{0.0f, 0.0f}}, {{0}} },
+                { {{ 0.5f,  0.5f}}, {{1.0f, 0.0f}}, {{0}} }
+            };
+            static const uint16_t k_quad_indices[] = { 1, 2, 3, 0, 2, 1 };
+            // clang-format on
+
             rizz_texture* tex = (rizz_texture*)the_asset->obj(spr->texture).ptr;
             sx_assert(tex);
             sx_vec2 base_size = sx_vec2f((float)tex->info.width, (float)tex->info.height);
             sx_vec2 size = sprite__calc_size(spr->size, base_size, spr->flip);
-            sx_vec2 origin = spr->origin;
-            sx_rect rect = sx_rectf(-0.5f, -0.5f, 0.5f, 0.5f);
-
-            verts[0].pos = sx_vec2_mul(sx_vec2_sub(sx_rect_corner(&rect, 0), origin), size);
-            verts[0].uv = sx_vec2f(0.0f, 1.0f);
-            verts[0].color = color;
-            verts[1].pos = sx_vec2_mul(sx_vec2_sub(sx_rect_corner(&rect, 1), origin), size);
-            verts[1].uv = sx_vec2f(1.0f, 1.0f);
-            verts[2].color = color;
-            verts[2].pos = sx_vec2_mul(sx_vec2_sub(sx_rect_corner(&rect, 2), origin), size);
-            verts[2].uv = sx_vec2f(0.0f, 0.0f);
-            verts[2].color = color;
-            verts[3].pos = sx_vec2_mul(sx_vec2_sub(sx_rect_corner(&rect, 3), origin), size);
-            verts[3].uv = sx_vec2f(1.0f, 0.0f);
-            verts[3].color = color;
-
-            // clang-format off
-            int v = vertex_start;
-            indices[3] = v;         indices[4] = v + 2;     indices[5] = v + 1;
-            indices[0] = v + 1;     indices[1] = v + 2;     indices[2] = v + 3;
-            // clang-format on            
+            sprite__gen_verts(&verts[vertex_idx], k_quad_verts, 4, spr->origin, size, color);
+            sprite__offset_indices(&indices[index_idx], k_quad_indices, 6, vertex_start);
 
             vertex_idx += 4;
             index_idx += 6;
@@ -2207,13 +2201,14 @@ static void sprite__show_animctrl_tab_contents(sprite__data* spr)
         the_imgui->BeginChildStr("params", SX_VEC2_ZERO, false, 0);
         the_imgui->Columns(2, "params_cols", false);
         the_imgui->SetColumnWidth(0, 80.0f);
-        for (sprite__animctrl_param* p = &ctrl->params[0]; p->name_hash; p++) {
-            the_imgui->Text(p->name);
+        for (sprite__animctrl_param* p = &ctrl->params[0]; p->name; p++) {
+            const char* name = the_core->intern_cstr(p->name);
+            the_imgui->Text(name);
             the_imgui->NextColumn();
 
             // check type
             char id[32];
-            sx_snprintf(id, sizeof(id), "param_%s", p->name);
+            sx_snprintf(id, sizeof(id), "param_%s", name);
             the_imgui->PushIDStr(id);
             switch (p->type) {
             case RIZZ_SPRITE_PARAMTYPE_BOOL:
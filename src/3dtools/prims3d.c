@@ -6,6 +6,7 @@
 
 #include "3dtools-internal.h"
 #include "sx/math.h"
+#include "sx/math-batch.h"
 
 #define MAX_INSTANCES 1000
 #define MAX_DYN_VERTICES 10000
@@ -25,7 +26,7 @@ typedef struct prims3d__shape {
 typedef struct prims3d__instance {
     sx_vec4 tx1;    // pos=(x, y, z) , rot(m11)
     sx_vec4 tx2;    // rot(m21, m31, m12, m22)
-    sx_vec4 tx3;    // rot(m23, m13, m23, m33)
+    sx_vec4 tx3;    // rot(m32, m13, m23, m33)
     sx_vec3 scale;  
     sx_color color;
 } prims3d__instance;
@@ -256,6 +257,36 @@ void prims3d__draw_box(const sx_box* box, const sx_mat4* viewproj_mat,
     prims3d__draw_boxes(box, 1, viewproj_mat, map_type, &tint);
 }
 
+static void prims3d__bounding_spheres(sx_vec4* spheres, const sx_box* boxes, int count)
+{
+    for (int i = 0; i < count; i++) {
+        spheres[i] = sx_vec4v3(boxes[i].tx.pos, sx_vec3_len(boxes[i].he));
+    }
+}
+
+// packs boxes[indices[i]] into instances[i], tints can be NULL
+static void prims3d__pack_instances(prims3d__instance* instances, const sx_box* boxes,
+                                    const sx_color* tints, const int* indices, int count)
+{
+    // visible indices are sorted, so pack each contiguous run of boxes with a single batch call
+    for (int i = 0; i < count;) {
+        int first = indices[i];
+        int n = 1;
+        while (i + n < count && indices[i + n] == first + n) {
+            n++;
+        }
+
+        sx_tx3d_pack_batch(&instances[i], sizeof(prims3d__instance), &boxes[first].tx,
+                           sizeof(sx_box), n);
+        for (int k = 0; k < n; k++) {
+            prims3d__instance* instance = &instances[i + k];
+            instance->scale = sx_box_extents(&boxes[first + k]);
+            instance->color = tints ? tints[first + k] : SX_COLOR_WHITE;
+        }
+        i += n;
+    }
+}
+
 void prims3d__draw_boxes(const sx_box* boxes, int num_boxes, const sx_mat4* viewproj_mat,
                          rizz_prims3d_map_type map_type, const sx_color* tints)
 {
@@ -288,17 +319,35 @@ void prims3d__draw_boxes(const sx_box* boxes, int num_boxes, const sx_mat4* view
         first_alpha = tints[0].a;
     }
 
+    // cull the boxes by their bounding spheres, and only pack the visible instances
+    sx_vec4* spheres = sx_malloc(tmp_alloc, sizeof(sx_vec4)*num_boxes);
+    uint32_t* visible_bits = sx_malloc(tmp_alloc, sizeof(uint32_t)*((num_boxes + 31) / 32));
+    int* visible_indices = sx_malloc(tmp_alloc, sizeof(int)*num_boxes);
+    if (!spheres || !visible_bits || !visible_indices) {
+        sx_out_of_memory();
+        return;
+    }
+    prims3d__bounding_spheres(spheres, boxes, num_boxes);
+
+    sx_plane planes[6];
+    the_camera->calc_frustum_planes(planes, viewproj_mat);
+    the_camera->cull_spheres(visible_bits, spheres, num_boxes, planes);
+
+    int num_instances = 0;
     for (int i = 0; i < num_boxes; i++) {
-        const sx_tx3d* tx = &boxes[i].tx;
-        prims3d__instance* instance = &instances[i];
-        instance->tx1 = sx_vec4f(tx->pos.x, tx->pos.y, tx->pos.z, tx->rot.m11);
-        instance->tx2 = sx_vec4f(tx->rot.m21, tx->rot.m31, tx->rot.m12, tx->rot.m22);
-        instance->tx3 = sx_vec4f(tx->rot.m23, tx->rot.m13, tx->rot.m23, tx->rot.m33);
-        instance->scale = sx_box_extents(&boxes[i]);
-        instance->color = tints ? tints[i] : SX_COLOR_WHITE;
+        if (visible_bits[i >> 5] & (1u << (i & 31))) {
+            visible_indices[num_instances++] = i;
+        }
         sx_assert(!tints || (first_alpha == tints[i].a));
     }
 
+    if (num_instances == 0) {
+        rizz_temp_alloc_end(tmp_alloc);
+        return;
+    }
+    num_boxes = num_instances;
+    prims3d__pack_instances(instances, boxes, tints, visible_indices, num_boxes);
+
     // in alpha-blend mode (transparent boxes), sort the boxes from back-to-front
     if (first_alpha != 255) {
         prims3d__instance_depth* sort_items = sx_malloc(tmp_alloc, sizeof(prims3d__instance_depth)*num_boxes);
@@ -308,7 +357,7 @@ void prims3d__draw_boxes(const sx_box* boxes, int num_boxes, const sx_mat4* view
         }
         for (int i = 0; i < num_boxes; i++) {
             sort_items[i].index = i;
-            sort_items[i].z = sx_mat4_mul_vec3(viewproj_mat, boxes[i].tx.pos).z;
+            sort_items[i].z = sx_mat4_mul_vec3(viewproj_mat, sx_vec3fv(instances[i].tx1.f)).z;
         }
 
         prims3d__instance_tim_sort(sort_items, num_boxes);
@@ -1540,6 +1540,78 @@ static void imgui__dual_progress_bar(float fraction1, float fraction2, const sx_
     the__imgui.NewLine();
 }
 
+static void imgui__frame_times_content(void)
+{
+    rizz_frame_stats stats;
+    the_core->frame_stats(&stats);
+
+    int window = stats.window;
+    float hitch_threshold = stats.hitch_threshold_ms;
+    bool changed = the__imgui.SliderInt("Window", &window, 30, 3600, "%d frames");
+    changed |= the__imgui.SliderFloat("Hitch threshold", &hitch_threshold, 1.0f, 100.0f, "%.1f ms",
+                                      1.0f);
+    if (changed) {
+        // resizing the window frees the memory of stats.frame_ms, so fetch the stats again
+        the_core->set_frame_stats_config(window, hitch_threshold);
+        the_core->frame_stats(&stats);
+    }
+    the__imgui.Separator();
+
+    the__imgui.LabelText("Mean", "%.2f ms", stats.mean_ms);
+    the__imgui.LabelText("P50", "%.2f ms", stats.p50_ms);
+    the__imgui.LabelText("P95", "%.2f ms", stats.p95_ms);
+    the__imgui.LabelText("P99", "%.2f ms", stats.p99_ms);
+    the__imgui.LabelText("Max", "%.2f ms", stats.max_ms);
+    the__imgui.LabelText("Hitches", "%d (total: %lld)", stats.num_hitches,
+                         (long long)stats.total_hitches);
+    the__imgui.Separator();
+
+    if (stats.num_frames == 0) {
+        return;
+    }
+
+    // frame times of the window, and their distribution between 0 and max
+    float scale_max = sx_max(stats.max_ms, stats.hitch_threshold_ms) * 1.1f;
+    the__imgui.PlotHistogramFloatPtr("##frame_times", stats.frame_ms, stats.num_frames, 0,
+                                     "frame times", 0, scale_max, sx_vec2f(0, 80.0f),
+                                     sizeof(float));
+
+    float bins[32] = { 0 };
+    const int num_bins = (int)(sizeof(bins) / sizeof(float));
+    for (int i = 0; i < stats.num_frames; i++) {
+        int bin = (int)(stats.frame_ms[i] * (float)num_bins / sx_max(stats.max_ms, 0.001f));
+        bins[sx_clamp(bin, 0, num_bins - 1)] += 1.0f;
+    }
+    char overlay[64];
+    sx_snprintf(overlay, sizeof(overlay), "distribution (0 .. %.1f ms)", stats.max_ms);
+    the__imgui.PlotHistogramFloatPtr("##frame_dist", bins, num_bins, 0, overlay, 0, FLT_MAX,
+                                     sx_vec2f(0, 80.0f), sizeof(float));
+    the__imgui.Separator();
+
+    // phases: "(job)" phases run in the job system, in parallel with main-thread phases
+    the__imgui.Columns(4, "frame_phases", false);
+    the__imgui.Text("Phase");
+    the__imgui.NextColumn();
+    the__imgui.Text("Mean");
+    the__imgui.NextColumn();
+    the__imgui.Text("P95");
+    the__imgui.NextColumn();
+    the__imgui.Text("Max");
+    the__imgui.NextColumn();
+    for (int i = 0; i < stats.num_phases; i++) {
+        const rizz_frame_phase_stats* phase = &stats.phases[i];
+        the__imgui.Text(phase->main_thread ? "%s" : "%s (job)", phase->name);
+        the__imgui.NextColumn();
+        the__imgui.Text("%.3f ms", phase->mean_ms);
+        the__imgui.NextColumn();
+        the__imgui.Text("%.3f ms", phase->p95_ms);
+        the__imgui.NextColumn();
+        the__imgui.Text("%.3f ms", phase->max_ms);
+        the__imgui.NextColumn();
+    }
+    the__imgui.Columns(1, NULL, false);
+}
+
 static void imgui__graphics_debugger(const rizz_gfx_trace_info* info, bool* p_open)
 {
     sx_assert(info);
@@ -1592,6 +1664,11 @@ static void imgui__graphics_debugger(const rizz_gfx_trace_info* info, bool* p_op
                 the__imgui.EndTabItem();
             }
 
+            if (the__imgui.BeginTabItem("Frame Times", NULL, 0)) {
+                imgui__frame_times_content();
+                the__imgui.EndTabItem();
+            }
+
             if (the__imgui.BeginTabItem("Capture", NULL, 0)) {
                 sg_imgui_draw_capture_content(&g_imgui.sg_imgui);
                 the__imgui.EndTabItem();
@@ -1788,6 +1865,25 @@ static void imgui__memory_debugger(const rizz_mem_info* info, bool* p_open)
 
             the__imgui.TreePop();
         }
+
+        if (the__imgui.TreeNodeExStr("Frame Allocators", 0)) {
+            char text[32];
+            char size_text[32];
+            char peak_text[32];
+            for (int i = 0; i < info->num_frame_allocs; i++) {
+                const rizz_linalloc_info* l = &info->frame_allocs[i];
+                sx_snprintf(text, sizeof(text), "Frame #%d", i + 1);
+                sx_snprintf(size_text, sizeof(size_text), "%$.2d", l->offset);
+                sx_snprintf(peak_text, sizeof(peak_text), "%$.2d", l->peak);
+                float o = (float)l->offset / (float)l->size;
+                float p = sx_min((float)l->peak / (float)l->size, 1.0f);
+                the__imgui.Text(text);
+                the__imgui.SameLine(100.0f, -1);
+                imgui__dual_progress_bar(o, p, sx_vec2f(-1.0f, 14.0f), size_text, peak_text);
+            }
+
+            the__imgui.TreePop();
+        }
     }
 
     the__imgui.End();
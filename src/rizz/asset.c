@@ -13,6 +13,8 @@
 #include "sx/pool.h"
 #include "sx/string.h"
 
+#include <alloca.h>
+
 // Asset managers are managers for each type of asset
 // For example, 'texture' has it's own manager, 'model' has it's manager, ...
 // They handle loading, unloading, reloading asset objects
@@ -51,19 +53,19 @@ typedef struct {
 // Resources are the actual files on the file-system
 // Each resource has a metadata
 // Likely to be populated by asset-db, but can grow on run-time
+// Paths are interned (sx_intern), so they are compared by id and their strings never move
 typedef struct {
-    char path[RIZZ_MAX_PATH];         // path that is referenced in database and code
-    char real_path[RIZZ_MAX_PATH];    // real path on disk, resolved by asset-db and variation
-    uint32_t path_hash;               // hash of 'real_path'
-    uint64_t last_modified;           // last-modified time-stamp
-    int asset_mgr_id;                 // index-to: rizz__asset_lib.asset_mgrs
+    sx_istr_t path;              // path that is referenced in database and code
+    sx_istr_t real_path;         // real path on disk, resolved by asset-db and variation
+    uint64_t last_modified;      // last-modified time-stamp
+    int asset_mgr_id;            // index-to: rizz__asset_lib.asset_mgrs
     bool used;
 } rizz__asset_resource;
 
 // Async loads are queued for each new async file loads
 // To track which file points to which asset
 typedef struct {
-    uint32_t path_hash;    // hash of real_path
+    sx_istr_t real_path;
     rizz_asset asset;
 } rizz__asset_async_load_req;
 
@@ -100,10 +102,9 @@ typedef struct {
     uint32_t* asset_name_hashes;               // sx_array (count = count(asset_mgrs))
     rizz__asset* assets;                       // loaded assets
     sx_handle_pool* asset_handles;
-    sx_hashtbl* asset_tbl;              // key: hash(path+params), value: handle (asset_handles)
-    sx_hashtbl* resource_tbl;           // key  hash(path), value: index-to resources
+    sx_hashtbl_mt* asset_tbl;           // key: hash(path+params), value: handle (asset_handles)
+    sx_hashtbl_mt* resource_tbl;        // key: interned path, value: index-to resources
     rizz__asset_resource* resources;    // resource database
-    sx_hash_xxh32_t* hasher;
     rizz__asset_async_load_req* async_reqs;
     rizz__asset_async_job* async_job_list;
     rizz__asset_async_job* async_job_list_last;
@@ -121,16 +122,27 @@ static rizz__asset_lib g_asset;
     else                                                                          \
         rizz__log_warn("%s asset '%s' failed", _msgpref, _path);
 
+#define rizz__asset_res_errmsg(_res, _msgpref) \
+    rizz__asset_errmsg(sx_intern_cstr((_res)->path), sx_intern_cstr((_res)->real_path), _msgpref)
+
 static rizz_asset rizz__asset_load_hashed(uint32_t name_hash, const char* path, const void* params,
                                           rizz_asset_load_flags flags, const sx_alloc* obj_alloc,
                                           uint32_t tags);
 
+static inline const char* rizz__asset_resource_path(uint32_t resource_id)
+{
+    return sx_intern_cstr(g_asset.resources[rizz_to_index(resource_id)].path);
+}
+
 static inline int rizz__asset_find_async_req(const char* path)
 {
-    uint32_t path_hash = sx_hash_fnv32_str(path);
+    sx_istr_t path_id = sx_intern_find(path);
+    if (!path_id)
+        return -1;
+
     for (int i = 0, c = sx_array_count(g_asset.async_reqs); i < c; i++) {
         rizz__asset_async_load_req* req = &g_asset.async_reqs[i];
-        if (req->path_hash == path_hash)
+        if (req->real_path == path_id)
             return i;
     }
 
@@ -178,6 +190,12 @@ static void rizz__asset_load_job_cb(int start, int end, int thrd_index, void* us
                       : ASSET_JOB_STATE_LOAD_FAILED;
 }
 
+static inline rizz_vfs_flags rizz__asset_vfs_flags(rizz_asset_load_flags flags)
+{
+    return ((flags & RIZZ_ASSET_LOAD_FLAG_ABSOLUTE_PATH) ? RIZZ_VFS_FLAG_ABSOLUTE_PATH : 0) |
+           ((flags & RIZZ_ASSET_LOAD_FLAG_MMAP) ? RIZZ_VFS_FLAG_MMAP : 0);
+}
+
 // async callback
 static void rizz__asset_on_read(const char* path, sx_mem_block* mem, void* user)
 {
@@ -195,7 +213,7 @@ static void rizz__asset_on_read(const char* path, sx_mem_block* mem, void* user)
             rizz__asset_resource* res = &g_asset.resources[rizz_to_index(a->resource_id)];
             rizz__asset_mgr* amgr = &g_asset.asset_mgrs[a->asset_mgr_id];
 
-            rizz__asset_errmsg(res->path, res->real_path, "opening");
+            rizz__asset_res_errmsg(res, "opening");
             a->state = RIZZ_ASSET_STATE_FAILED;
             a->obj = amgr->failed_obj;
 
@@ -218,7 +236,7 @@ static void rizz__asset_on_read(const char* path, sx_mem_block* mem, void* user)
     if (a->params_id)
         params_ptr = &amgr->params_buff[rizz_to_index(a->params_id)];
 
-    rizz_asset_load_params aparams = (rizz_asset_load_params){ .path = res->path,
+    rizz_asset_load_params aparams = (rizz_asset_load_params){ .path = sx_intern_cstr(res->path),
                                                                .params = params_ptr,
                                                                .alloc = a->alloc,
                                                                .tags = a->tags,
@@ -228,20 +246,16 @@ static void rizz__asset_on_read(const char* path, sx_mem_block* mem, void* user)
 
     sx_array_pop(g_asset.async_reqs, async_req_idx);
     if (!load_data.obj.id) {
-        rizz__asset_errmsg(res->path, res->real_path, "preparing");
+        rizz__asset_res_errmsg(res, "preparing");
         sx_mem_destroy_block(mem);
         return;
     }
 
     // dispatch job request for on_load
-    // save a copy of path and params
-    uint8_t* buff =
-        sx_malloc(g_asset.alloc, sizeof(rizz__asset_async_job) + amgr->params_size + RIZZ_MAX_PATH);
+    // save a copy of params, path is interned and stays valid
+    uint8_t* buff = sx_malloc(g_asset.alloc, sizeof(rizz__asset_async_job) + amgr->params_size);
     rizz__asset_async_job* ajob = (rizz__asset_async_job*)buff;
     buff += sizeof(rizz__asset_async_job);
-    aparams.path = (const char*)buff;
-    sx_memcpy(buff, res->path, RIZZ_MAX_PATH);
-    buff += RIZZ_MAX_PATH;
     if (params_ptr) {
         sx_assert((uintptr_t)buff % 8 == 0);
         aparams.params = buff;
@@ -262,11 +276,13 @@ static void rizz__asset_on_modified(const char* path)
 
     char unixpath[RIZZ_MAX_PATH];
     sx_os_path_unixpath(unixpath, sizeof(unixpath), path);
-    uint32_t path_hash = sx_hash_fnv32_str(unixpath);
+    sx_istr_t path_id = sx_intern_find(unixpath);
+    if (!path_id)
+        return;
 
     // search in resources
     for (int i = 0, c = sx_array_count(g_asset.resources); i < c; i++) {
-        if (g_asset.resources[i].path_hash == path_hash) {
+        if (g_asset.resources[i].real_path == path_id) {
             g_asset.resources[i].last_modified = the__vfs.last_modified(path);
 
             uint32_t resource_id = rizz_to_id(i);
@@ -292,15 +308,21 @@ static void rizz__asset_on_modified(const char* path)
 }
 // end: async callbacks
 
+// this can be called from worker threads (see rizz__asset_find), so it hashes a stack copy of the
+// data in one go. the 64bit xxh3 hash is folded to 32bits for the asset table
 static inline uint32_t rizz__asset_hash(const char* path, const void* params, int params_size,
                                         const sx_alloc* alloc)
 {
-    sx_hash_xxh32_init(g_asset.hasher, 0);
-    sx_hash_xxh32_update(g_asset.hasher, path, sx_strlen(path));
+    int path_len = sx_strlen(path);
+    int len = path_len + params_size + (int)sizeof(alloc);
+    uint8_t* buff = (uint8_t*)alloca(len);
+    sx_assert(buff);
+    sx_memcpy(buff, path, path_len);
     if (params_size)
-        sx_hash_xxh32_update(g_asset.hasher, params, params_size);
-    sx_hash_xxh32_update(g_asset.hasher, &alloc, sizeof(alloc));
-    return sx_hash_xxh32_digest(g_asset.hasher);
+        sx_memcpy(buff + path_len, params, params_size);
+    sx_memcpy(buff + path_len + params_size, &alloc, sizeof(alloc));
+    uint64_t h = sx_hash_xxh3_64(buff, (size_t)len, 0);
+    return (uint32_t)(h ^ (h >> 32));
 }
 
 static inline int rizz__asset_find_asset_mgr(uint32_t name_hash)
@@ -318,7 +340,7 @@ bool rizz__asset_dump_unused(const char* filepath)
     if (sx_file_open(&f, filepath, SX_FILE_WRITE)) {
         for (int i = 0, c = sx_array_count(g_asset.resources); i < c; i++) {
             if (!g_asset.resources[i].used) {
-                sx_file_write_text(&f, g_asset.resources[i].path);
+                sx_file_write_text(&f, sx_intern_cstr(g_asset.resources[i].path));
                 sx_file_write(&f, "\n", 1);
             }
         }
@@ -341,20 +363,19 @@ static rizz_asset rizz__asset_create_new(const char* path, const void* params, r
     rizz__asset_mgr* amgr = &g_asset.asset_mgrs[amgr_id];
 
     // check resources, if doesn't exist, add new resource
-    uint32_t path_hash = sx_hash_fnv32_str(path);
-    int res_idx = sx_hashtbl_find_get(g_asset.resource_tbl, path_hash, -1);
+    sx_istr_t path_id = sx_intern(path);
+    int res_idx = sx_hashtblmt_find_get(g_asset.resource_tbl, path_id, -1);
     if (res_idx == -1) {
         rizz__asset_resource res = { .used = true };
-        sx_strcpy(res.path, sizeof(res.path), path);
-        sx_strcpy(res.real_path, sizeof(res.real_path), path);
-        res.path_hash = path_hash;
+        res.path = path_id;
+        res.real_path = path_id;
         res.asset_mgr_id = amgr_id;
 #if !SX_PLATFORM_ANDROID && !SX_PLATFORM_IOS
-        res.last_modified = the__vfs.last_modified(res.real_path);
+        res.last_modified = the__vfs.last_modified(sx_intern_cstr(res.real_path));
 #endif
         res_idx = sx_array_count(g_asset.resources);
         sx_array_push(g_asset.alloc, g_asset.resources, res);
-        sx_hashtbl_add_and_grow(g_asset.resource_tbl, path_hash, res_idx, g_asset.alloc);
+        sx_hashtblmt_add(g_asset.resource_tbl, path_id, res_idx);
     } else {
         g_asset.resources[res_idx].used = true;
     }
@@ -392,7 +413,7 @@ static rizz_asset rizz__asset_create_new(const char* path, const void* params, r
     sx_array_push_byindex(g_asset.alloc, g_asset.assets, asset, sx_handle_index(handle));
     sx_unlock(&g_asset.assets_lk);
 
-    sx_hashtbl_add_and_grow(g_asset.asset_tbl, asset.hash, handle, g_asset.alloc);
+    sx_hashtblmt_add(g_asset.asset_tbl, asset.hash, (int)handle);
 
     return (rizz_asset){ handle };
 }
@@ -433,7 +454,7 @@ static void rizz__asset_destroy_delete(rizz_asset a, rizz__asset_mgr* amgr)
         asset->obj = amgr->failed_obj;
     }
 
-    sx_hashtbl_remove_if_found(g_asset.asset_tbl, asset->hash);
+    sx_hashtblmt_remove(g_asset.asset_tbl, asset->hash);
     sx_handle_del(g_asset.asset_handles, a.id);
 }
 
@@ -492,18 +513,19 @@ static rizz_asset rizz__asset_load_hashed(uint32_t name_hash, const char* path,
     }
 
     // find if asset is already loaded
-    rizz_asset asset = (rizz_asset){ sx_hashtbl_find_get(
+    rizz_asset asset = (rizz_asset){ sx_hashtblmt_find_get(
         g_asset.asset_tbl, rizz__asset_hash(path, params, amgr->params_size, obj_alloc), 0) };
     if (asset.id && !(flags & RIZZ_ASSET_LOAD_FLAG_RELOAD)) {
         ++g_asset.assets[sx_handle_index(asset.id)].ref_count;
     } else {
         // find resource and resolve the real file path
-        int res_idx = sx_hashtbl_find_get(g_asset.resource_tbl, sx_hash_fnv32_str(path), -1);
+        sx_istr_t path_id = sx_intern_find(path);
+        int res_idx = path_id ? sx_hashtblmt_find_get(g_asset.resource_tbl, path_id, -1) : -1;
         const char* real_path = path;
         rizz__asset_resource* res = NULL;
         if (res_idx != -1) {
             res = &g_asset.resources[res_idx];
-            real_path = res->real_path;
+            real_path = sx_intern_cstr(res->real_path);
         }
 
         if (!(flags & RIZZ_ASSET_LOAD_FLAG_WAIT_ON_LOAD)) {
@@ -514,13 +536,12 @@ static rizz_asset rizz__asset_load_hashed(uint32_t name_hash, const char* path,
             a->state = RIZZ_ASSET_STATE_LOADING;
 
             rizz__asset_async_load_req req =
-                (rizz__asset_async_load_req){ .path_hash = sx_hash_fnv32_str(real_path),
-                                              .asset = asset };
+                (rizz__asset_async_load_req){ .real_path = sx_intern(real_path), .asset = asset };
             sx_array_push(g_asset.alloc, g_asset.async_reqs, req);
 
             the__vfs.read_async(
                 real_path,
-                (flags & RIZZ_ASSET_LOAD_FLAG_ABSOLUTE_PATH) ? RIZZ_VFS_FLAG_ABSOLUTE_PATH : 0,
+                rizz__asset_vfs_flags(flags),
                 the__core.alloc(RIZZ_MEMID_CORE), rizz__asset_on_read, NULL);
         } else {
             // Blocking load (+ reloads)
@@ -530,7 +551,7 @@ static rizz_asset rizz__asset_load_hashed(uint32_t name_hash, const char* path,
 
             sx_mem_block* mem = the__vfs.read(
                 real_path,
-                (flags & RIZZ_ASSET_LOAD_FLAG_ABSOLUTE_PATH) ? RIZZ_VFS_FLAG_ABSOLUTE_PATH : 0,
+                rizz__asset_vfs_flags(flags),
                 the__core.alloc(RIZZ_MEMID_CORE));
 
             if (!mem) {
@@ -602,9 +623,9 @@ bool rizz__asset_init(const sx_alloc* alloc, const char* dbfile, const char* var
 
     the__vfs.register_modify(rizz__asset_on_modified);
 
-    g_asset.asset_tbl = sx_hashtbl_create(alloc, RIZZ_CONFIG_ASSET_POOL_SIZE);
-    g_asset.resource_tbl = sx_hashtbl_create(alloc, RIZZ_CONFIG_ASSET_POOL_SIZE);
-    sx_assert(g_asset.asset_tbl);
+    g_asset.asset_tbl = sx_hashtblmt_create(alloc, RIZZ_CONFIG_ASSET_POOL_SIZE, 8);
+    g_asset.resource_tbl = sx_hashtblmt_create(alloc, RIZZ_CONFIG_ASSET_POOL_SIZE, 8);
+    sx_assert(g_asset.asset_tbl && g_asset.resource_tbl);
 
     g_asset.asset_handles = sx_handle_create_pool(alloc, RIZZ_CONFIG_ASSET_POOL_SIZE);
     sx_assert(g_asset.asset_handles);
@@ -612,9 +633,6 @@ bool rizz__asset_init(const sx_alloc* alloc, const char* dbfile, const char* var
     g_asset.group_handles = sx_handle_create_pool(alloc, 32);
     sx_assert(g_asset.group_handles);
 
-    g_asset.hasher = sx_hash_create_xxh32(alloc);
-    sx_assert(g_asset.hasher);
-
     return true;
 }
 
@@ -632,7 +650,7 @@ void rizz__asset_release()
             if (a->state == RIZZ_ASSET_STATE_OK) {
                 sx_assert(a->resource_id);
                 rizz__log_warn("un-released asset: %s (ref_count = %d)",
-                               g_asset.resources[rizz_to_index(a->resource_id)].path, a->ref_count);
+                               rizz__asset_resource_path(a->resource_id), a->ref_count);
                 if (a->obj.id) {
                     rizz__asset_mgr* amgr = &g_asset.asset_mgrs[a->asset_mgr_id];
                     if (!amgr->unreg)
@@ -661,15 +679,12 @@ void rizz__asset_release()
     if (g_asset.asset_handles)
         sx_handle_destroy_pool(g_asset.asset_handles, alloc);
     if (g_asset.asset_tbl)
-        sx_hashtbl_destroy(g_asset.asset_tbl, alloc);
+        sx_hashtblmt_destroy(g_asset.asset_tbl, alloc);
     if (g_asset.resource_tbl)
-        sx_hashtbl_destroy(g_asset.resource_tbl, alloc);
+        sx_hashtblmt_destroy(g_asset.resource_tbl, alloc);
     if (g_asset.group_handles)
         sx_handle_destroy_pool(g_asset.group_handles, alloc);
 
-    if (g_asset.hasher)
-        sx_hash_destroy_xxh32(g_asset.hasher, g_asset.alloc);
-
     rizz__asset_async_job* ajob = g_asset.async_job_list;
     while (ajob) {
         rizz__asset_async_job* next = ajob->next;
@@ -681,6 +696,14 @@ void rizz__asset_release()
     g_asset.async_job_list = g_asset.async_job_list_last = NULL;
 }
 
+// called by the core at the end of the frame, see rizz__core_collect. loader callbacks of async
+// jobs run as jobs too, so they are covered by the same grace period
+void rizz__asset_collect(uint64_t epoch, uint64_t safe_epoch)
+{
+    sx_hashtblmt_collect(g_asset.asset_tbl, epoch, safe_epoch);
+    sx_hashtblmt_collect(g_asset.resource_tbl, epoch, safe_epoch);
+}
+
 void rizz__asset_update()
 {
     rizz__profile_begin(Asset_update, 0);
@@ -701,7 +724,7 @@ void rizz__asset_update()
                 break;
 
             case ASSET_JOB_STATE_LOAD_FAILED:
-                rizz__asset_errmsg(res->path, res->real_path, "loading");
+                rizz__asset_res_errmsg(res, "loading");
                 a->obj = ajob->amgr->failed_obj;
                 a->state = RIZZ_ASSET_STATE_FAILED;
 
@@ -759,19 +782,20 @@ static rizz_asset rizz__asset_load_from_mem(const char* name, const char* path_a
     flags |= amgr->forced_flags;
 
     // find if asset is already loaded
-    rizz_asset asset = (rizz_asset){ sx_hashtbl_find_get(
+    rizz_asset asset = (rizz_asset){ sx_hashtblmt_find_get(
         g_asset.asset_tbl, rizz__asset_hash(path_alias, params, amgr->params_size, alloc), 0) };
 
     if (asset.id && !(flags & RIZZ_ASSET_LOAD_FLAG_RELOAD)) {
         ++g_asset.assets[sx_handle_index(asset.id)].ref_count;
     } else {
         // find resource and resolve the real file path
-        int res_idx = sx_hashtbl_find_get(g_asset.resource_tbl, sx_hash_fnv32_str(path_alias), -1);
+        sx_istr_t path_id = sx_intern_find(path_alias);
+        int res_idx = path_id ? sx_hashtblmt_find_get(g_asset.resource_tbl, path_id, -1) : -1;
         const char* real_path = path_alias;
         rizz__asset_resource* res = NULL;
         if (res_idx != -1) {
             res = &g_asset.resources[res_idx];
-            real_path = res->real_path;
+            real_path = sx_intern_cstr(res->real_path);
         }
 
         if (!(flags & RIZZ_ASSET_LOAD_FLAG_WAIT_ON_LOAD)) {
@@ -782,8 +806,7 @@ static rizz_asset rizz__asset_load_from_mem(const char* name, const char* path_a
             a->state = RIZZ_ASSET_STATE_LOADING;
 
             rizz__asset_async_load_req req =
-                (rizz__asset_async_load_req){ .path_hash = sx_hash_fnv32_str(real_path),
-                                              .asset = asset };
+                (rizz__asset_async_load_req){ .real_path = sx_intern(real_path), .asset = asset };
             sx_array_push(g_asset.alloc, g_asset.async_reqs, req);
 
             rizz__asset_on_read(real_path, mem, NULL);
@@ -937,7 +960,7 @@ static const char* rizz__asset_path(rizz_asset asset)
 
     rizz__asset* a = &g_asset.assets[sx_handle_index(asset.id)];
     sx_assert(a->resource_id);
-    return g_asset.resources[rizz_to_index(a->resource_id)].path;
+    return rizz__asset_resource_path(a->resource_id);
 }
 
 static const char* rizz__asset_typename(rizz_asset asset)
@@ -966,6 +989,20 @@ static uint32_t rizz__asset_tags(rizz_asset asset)
     return a->tags;
 }
 
+// asset_tbl is thread-safe for reads, so this can be called from worker threads. asset managers
+// are only registered in the main thread on initialization
+static rizz_asset rizz__asset_find(const char* name, const char* path, const void* params,
+                                   const sx_alloc* alloc)
+{
+    int amgr_id = rizz__asset_find_asset_mgr(sx_hash_fnv32_str(name));
+    sx_assert(amgr_id != -1 && "asset type is not registered");
+    int params_size = g_asset.asset_mgrs[amgr_id].params_size;
+    sx_assert(!params_size || params);
+
+    return (rizz_asset){ (uint32_t)sx_hashtblmt_find_get(
+        g_asset.asset_tbl, rizz__asset_hash(path, params, params_size, alloc), 0) };
+}
+
 static rizz_asset_obj rizz__asset_obj_unsafe(rizz_asset asset)
 {
     sx_assert_rel(sx_handle_valid(g_asset.asset_handles, asset.id));
@@ -1019,7 +1056,7 @@ static void rizz__asset_reload_by_type(const char* name)
             if (a->asset_mgr_id == asset_mgr_id) {
                 sx_assert(a->resource_id);
                 rizz__asset_load_hashed(
-                    name_hash, g_asset.resources[rizz_to_index(a->resource_id)].path,
+                    name_hash, rizz__asset_resource_path(a->resource_id),
                     a->params_id ? &amgr->params_buff[rizz_to_index(a->params_id)] : NULL,
                     a->load_flags, a->alloc, a->tags);
             }
@@ -1091,7 +1128,7 @@ static void rizz__asset_reload_by_tags(uint32_t tags)
             sx_assert(a->resource_id);
             rizz__asset_mgr* amgr = &g_asset.asset_mgrs[a->asset_mgr_id];
             rizz__asset_load_hashed(
-                amgr->name_hash, g_asset.resources[rizz_to_index(a->resource_id)].path,
+                amgr->name_hash, rizz__asset_resource_path(a->resource_id),
                 a->params_id ? &amgr->params_buff[rizz_to_index(a->params_id)] : NULL,
                 a->load_flags, a->alloc, a->tags);
         }
@@ -1243,6 +1280,7 @@ rizz_api_asset the__asset = { .register_asset_type = rizz__register_asset_type,
                               .load = rizz__asset_load,
                               .load_from_mem = rizz__asset_load_from_mem,
                               .unload = rizz__asset_unload,
+                              .find = rizz__asset_find,
                               .state = rizz__asset_state,
                               .path = rizz__asset_path,
                               .type_name = rizz__asset_typename,
@@ -4,6 +4,8 @@
 //
 #include "internal.h"
 
+#include "sx/math-batch.h"
+
 static void rizz__cam_init(rizz_camera* cam, float fov_deg, const sx_rect viewport, float fnear,
                            float ffar)
 {
@@ -109,6 +111,46 @@ static void rizz__calc_frustum_points(const rizz_camera* cam, sx_vec3 frustum[8]
     rizz__calc_frustum_points_range(cam, frustum, cam->fnear, cam->ffar);
 }
 
+// Gribb/Hartmann: planes are sums and differences of the matrix rows
+static void rizz__calc_frustum_planes(sx_plane planes[6], const sx_mat4* vp)
+{
+    const sx_vec4 r1 = sx_vec4f(vp->m11, vp->m12, vp->m13, vp->m14);
+    const sx_vec4 r2 = sx_vec4f(vp->m21, vp->m22, vp->m23, vp->m24);
+    const sx_vec4 r3 = sx_vec4f(vp->m31, vp->m32, vp->m33, vp->m34);
+    const sx_vec4 r4 = sx_vec4f(vp->m41, vp->m42, vp->m43, vp->m44);
+
+    planes[0].p = sx_vec4_add(r4, r1);    // left
+    planes[1].p = sx_vec4_sub(r4, r1);    // right
+    planes[2].p = sx_vec4_add(r4, r2);    // bottom
+    planes[3].p = sx_vec4_sub(r4, r2);    // top
+    // near: depth range is [-1, 1] on GL and [0, 1] on other backends
+    planes[4].p = the__gfx.GL_family() ? sx_vec4_add(r4, r3) : r3;
+    planes[5].p = sx_vec4_sub(r4, r3);    // far
+
+    for (int i = 0; i < 6; i++) {
+        float ilen = 1.0f / sx_vec3_len(planes[i].normal);
+        planes[i].p = sx_vec4_mulf(planes[i].p, ilen);
+    }
+}
+
+static void rizz__cam_cull_aabbs(uint32_t* visible_bits, const sx_aabb* aabbs, int count,
+                                 const sx_plane planes[6])
+{
+    sx_aabb_cull_batch(visible_bits, aabbs, count, planes, 6);
+}
+
+static void rizz__cam_cull_spheres(uint32_t* visible_bits, const sx_vec4* spheres, int count,
+                                   const sx_plane planes[6])
+{
+    sx_sphere_cull_batch(visible_bits, spheres, count, planes, 6);
+}
+
+static void rizz__cam_cull_rects(uint32_t* visible_bits, const sx_rect* rects, int count,
+                                 const sx_plane planes[6])
+{
+    sx_rect_cull_batch(visible_bits, rects, count, planes, 6);
+}
+
 static void rizz__cam_fps_init(rizz_camera_fps* cam, float fov_deg, const sx_rect viewport,
                                float fnear, float ffar)
 {
@@ -175,6 +217,10 @@ rizz_api_camera the__camera = { .init = rizz__cam_init,
                                 .view_mat = rizz__cam_view_mat,
                                 .calc_frustum_points = rizz__calc_frustum_points,
                                 .calc_frustum_points_range = rizz__calc_frustum_points_range,
+                                .calc_frustum_planes = rizz__calc_frustum_planes,
+                                .cull_aabbs = rizz__cam_cull_aabbs,
+                                .cull_spheres = rizz__cam_cull_spheres,
+                                .cull_rects = rizz__cam_cull_rects,
                                 .fps_init = rizz__cam_fps_init,
                                 .fps_lookat = rizz__cam_fps_lookat,
                                 .fps_pitch = rizz__cam_fps_pitch,
@@ -13,9 +13,11 @@
 #include "sx/atomic.h"
 #include "sx/hash.h"
 #include "sx/jobs.h"
+#include "sx/lin-alloc.h"
 #include "sx/lockless.h"
 #include "sx/os.h"
 #include "sx/rng.h"
+#include "sx/slab-alloc.h"
 #include "sx/stack-alloc.h"
 #include "sx/string.h"
 #include "sx/threads.h"
@@ -46,6 +48,10 @@ __declspec(dllimport) void __stdcall OutputDebugStringA(const char* lpOutputStri
 #include "cj5/cj5.h"
 
 #define DEFAULT_TMP_SIZE    0x500000    // 5mb
+#define DEFAULT_FRAME_SIZE  0x500000    // 5mb
+#define DEFAULT_FRAME_STATS_WINDOW 300
+#define DEFAULT_HITCH_THRESHOLD_MS 33.3f
+#define MEM_TRIM_FRAMES     120         // frames of low usage, before decommitting tmp/frame pages
 
 #if SX_PLATFORM_WINDOWS || SX_PLATFORM_IOS || SX_PLATFORM_ANDROID
 #   define TERM_COLOR_RESET     ""
@@ -62,6 +68,8 @@ __declspec(dllimport) void __stdcall OutputDebugStringA(const char* lpOutputStri
 #endif
 // clang-format on
 
+#define RIZZ__TRACK_NUM_SHARDS 32
+
 static const char* k__memid_names[_RIZZ_MEMID_COUNT] = { "Core",          //
                                                          "Graphics",      //
                                                          "Audio",         //
@@ -74,13 +82,33 @@ static const char* k__memid_names[_RIZZ_MEMID_COUNT] = { "Core",          //
                                                          "Game" };
 
 
+// committed pages are kept between frames (high-water mark), and only decommitted after usage
+// stays under half of committed memory for MEM_TRIM_FRAMES frames
+typedef struct rizz__core_hwm {
+    size_t window_peak;
+    int num_low_frames;
+} rizz__core_hwm;
+
 typedef struct rizz__core_tmpalloc {
     sx_alloc alloc;
     sx_vmem_context vmem;
     sx_stackalloc stack_alloc;
     size_t* offset_stack;    // sx_array - keep offsets in a stack for push()/pop()
+    size_t peak;             // stack_alloc.peak is reset every frame
+    rizz__core_hwm hwm;
 } rizz__core_tmpalloc;
 
+// frame allocators for each thread: [THIS_FRAME, NEXT_FRAME(even), NEXT_FRAME(odd)]
+#define RIZZ__FRAME_ALLOCS_PER_THREAD 3
+
+typedef struct rizz__core_framealloc {
+    sx_alloc alloc;
+    sx_vmem_context vmem;
+    sx_linalloc linalloc;
+    size_t peak;             // linalloc.peak is reset on every reset
+    rizz__core_hwm hwm;
+} rizz__core_framealloc;
+
 typedef struct rizz__core_cmd {
     char name[32];
     rizz_core_cmd_cb* callback;
@@ -89,19 +117,49 @@ typedef struct rizz__core_cmd {
 typedef struct rizz__proxy_alloc_header {
     intptr_t size;
     uint32_t ptr_offset;
-    int track_item_idx;
+    int track_item_idx;     // -1 if the allocation is not recorded by the tracker
+    int track_shard_idx;
 } rizz__proxy_alloc_header;
 
 typedef struct rizz__track_alloc {
     sx_alloc alloc;
     int mem_id;
     const char* name;
-    int64_t size;
-    int64_t peak;
-    sx_lock_t _lk;
-    rizz_track_alloc_item* items;    // sx_array
+    int64_t peak;                    // merged from shard peaks in get_mem_info
+    rizz_track_alloc_item* items;    // sx_array - merged from all shards in get_mem_info
 } rizz__track_alloc;
 
+// file/func/line of an allocation call, strings are resolved once per shard and call site
+typedef struct rizz__track_site {
+    char file[32];
+    char func[64];
+    int line;
+} rizz__track_site;
+
+typedef struct rizz__track_item {
+    void* ptr;
+    int64_t size;
+    int site_idx;
+} rizz__track_item;
+
+// size and peak count the allocations that are made on the shard (including those that are not
+// sampled), they are also decremented by frees from other threads, so size never drifts
+typedef struct rizz__track_shard_mem {
+    rizz__track_item* items;    // sx_array
+    sx_atomic_int64 size;
+    sx_atomic_int64 peak;       // running peak of `size`
+} rizz__track_shard_mem;
+
+// every thread is assigned a shard on it's first tracked allocation, so unless there are more
+// threads than shards, the lock and counters are only contended by cross-thread frees
+typedef struct rizz__track_shard {
+    sx_lock_t lk;
+    rizz__track_site* sites;    // sx_array
+    sx_hashtbl64* site_tbl;     // key: hash of file/func pointers and line -> index to sites
+    rizz__track_shard_mem mems[_RIZZ_MEMID_COUNT];
+    uint8_t _pad[SX_CACHE_LINE_SIZE];
+} rizz__track_shard;
+
 typedef struct rizz__tls_var {
     uint32_t name_hash;
     void* user;
@@ -127,11 +185,43 @@ typedef struct rizz__log_entry_internal_ref {
     int pipe_idx;
 } rizz__log_entry_internal_ref;
 
+// strpool is written by the producer thread and the log flush, which can run on any thread (see
+// rizz__core_frame), so it's guarded by `lock`
 typedef struct rizz__log_pipe {
     sx_queue_spsc* queue;    // item_type = rizz__log_entry_internal
     sx_strpool* strpool;     //
+    sx_lock_t lock;
 } rizz__log_pipe;
 
+// frame phases, see rizz__core_run_phases
+typedef enum rizz__core_phase_id {
+    RIZZ__CORE_PHASE_HTTP_POLL = 0,
+    RIZZ__CORE_PHASE_VFS,
+    RIZZ__CORE_PHASE_ASSET,
+    RIZZ__CORE_PHASE_GFX,
+    RIZZ__CORE_PHASE_HTTP,
+    RIZZ__CORE_PHASE_COROUTINES,
+    RIZZ__CORE_PHASE_PLUGINS,
+    RIZZ__CORE_PHASE_LOG,
+    RIZZ__CORE_PHASE_COMMAND_BUFFERS,
+    RIZZ__CORE_PHASE_IMGUI,
+    _RIZZ__CORE_PHASE_COUNT
+} rizz__core_phase_id;
+
+#define RIZZ__CORE_PHASE(_id) (1u << RIZZ__CORE_PHASE_##_id)
+
+// rolling window of frame and phase times, see rizz__core_frame_stats
+typedef struct rizz__frame_stats {
+    float* frame_ms;    // ring-buffer (count = window)
+    float* phase_ms;    // ring-buffer (count = window*_RIZZ__CORE_PHASE_COUNT)
+    float* scratch;     // linear frame times and sorted values for queries (count = window*2)
+    int window;
+    int count;
+    int head;    // next write index
+    float hitch_threshold_ms;
+    int64_t total_hitches;
+} rizz__frame_stats;
+
 typedef struct rizz__show_debugger_deferred {
     bool show;
     bool* p_open;
@@ -139,8 +229,13 @@ typedef struct rizz__show_debugger_deferred {
 
 typedef struct rizz__core {
     const sx_alloc* heap_alloc;
+    sx_slaballoc* slab;    // heap_alloc backend, if RIZZ_CORE_FLAG_SLAB_HEAP is set
     sx_alloc heap_proxy_alloc;
     rizz__track_alloc track_allocs[_RIZZ_MEMID_COUNT];
+    rizz__track_shard track_shards[RIZZ__TRACK_NUM_SHARDS];
+    sx_atomic_int track_num_threads;
+    int track_sample_interval;
+    sx_lock_t track_merge_lk;
     sx_atomic_int heap_count;
     sx_atomic_size heap_size;
     sx_atomic_size heap_max;
@@ -167,7 +262,11 @@ typedef struct rizz__core {
     rizz_log_level log_level;
 
     rizz__core_tmpalloc* tmp_allocs;    // count: num_threads
+    rizz__core_framealloc* frame_allocs;    // count: num_threads*RIZZ__FRAME_ALLOCS_PER_THREAD
     rizz__log_pipe* log_pipes;          // count: num_threads
+    int* qs_snapshot;                   // count: num_threads, see rizz__core_collect
+    uint64_t qs_epoch;                  // epoch of qs_snapshot, 0 if no grace period is running
+    uint64_t safe_epoch;                // retired memory up to this epoch can be freed
 
     Remotery* rmt;
     rizz__core_cmd* console_cmds;       // sx_array
@@ -175,6 +274,9 @@ typedef struct rizz__core {
     rizz__tls_var* tls_vars;            // sx_array
     sx_atomic_int num_log_backends;
 
+    rizz__frame_stats frame_stats;
+    float phase_ms[_RIZZ__CORE_PHASE_COUNT];    // phase times of the current frame
+
     rizz__show_debugger_deferred show_memory;
     rizz__show_debugger_deferred show_graphics;
     rizz__show_debugger_deferred show_log;
@@ -190,6 +292,10 @@ SX_PRAGMA_DIAGNOSTIC_IGNORED_MSVC(4146)
 SX_PRAGMA_DIAGNOSTIC_IGNORED_CLANG_GCC("-Wunused-function")
 SX_PRAGMA_DIAGNOSTIC_IGNORED_CLANG("-Wshorten-64-to-32")
 #include "sort/sort.h"
+
+#define SORT_NAME rizz__frame_stats_sort
+#define SORT_TYPE float
+#include "sort/sort.h"
 SX_PRAGMA_DIAGNOSTIC_POP()
 
 static rizz__core g_core;
@@ -427,18 +533,20 @@ static void rizz__log_dispatch_entry(const rizz_log_entry* entry)
 #endif
 
     if (g_core.num_log_backends > 0) {
-        rizz__log_pipe pipe =
-            g_core.jobs ? g_core.log_pipes[sx_job_thread_index(g_core.jobs)] : g_core.log_pipes[0];
+        rizz__log_pipe* pipe = g_core.jobs ? &g_core.log_pipes[sx_job_thread_index(g_core.jobs)]
+                                           : &g_core.log_pipes[0];
 
-        sx_str_t text = sx_strpool_add(pipe.strpool, entry->text, entry->text_len);
-        sx_str_t source = entry->source_file ? sx_strpool_add(pipe.strpool, entry->source_file,
+        sx_lock(&pipe->lock);
+        sx_str_t text = sx_strpool_add(pipe->strpool, entry->text, entry->text_len);
+        sx_str_t source = entry->source_file ? sx_strpool_add(pipe->strpool, entry->source_file,
                                                               entry->source_file_len)
                                              : 0;
+        sx_unlock(&pipe->lock);
         rizz__log_entry_internal entry_internal = { .e = *entry,
                                                     .text_id = text,
                                                     .source_id = source,
                                                     .timestamp = sx_cycle_clock() };
-        sx_queue_spsc_produce_and_grow(pipe.queue, &entry_internal, rizz__alloc(RIZZ_MEMID_CORE));
+        sx_queue_spsc_produce_and_grow(pipe->queue, &entry_internal, rizz__alloc(RIZZ_MEMID_CORE));
     }
 }
 
@@ -601,13 +709,15 @@ static void rizz__log_update()
     
     // collect all log entries from threads and sort them by timestamp
     for (int ti = 0, tc = g_core.num_threads; ti < tc; ti++) {
-        rizz__log_pipe pipe = g_core.log_pipes[ti];
+        rizz__log_pipe* pipe = &g_core.log_pipes[ti];
         rizz__log_entry_internal_ref entry;
         entry.pipe_idx = ti;
-        while (sx_queue_spsc_consume(pipe.queue, &entry.e)) {
-            entry.e.e.text = sx_strpool_cstr(pipe.strpool, entry.e.text_id);
+        while (sx_queue_spsc_consume(pipe->queue, &entry.e)) {
+            sx_lock(&pipe->lock);
+            entry.e.e.text = sx_strpool_cstr(pipe->strpool, entry.e.text_id);
             entry.e.e.source_file =
-                entry.e.source_id ? sx_strpool_cstr(pipe.strpool, entry.e.source_id) : NULL;
+                entry.e.source_id ? sx_strpool_cstr(pipe->strpool, entry.e.source_id) : NULL;
+            sx_unlock(&pipe->lock);
             sx_array_push(tmp_alloc, entries, entry);
         }
     } // foreach thread
@@ -620,21 +730,25 @@ static void rizz__log_update()
     if (num_entries > 0) {
         for (int i = 0, c = sx_array_count(g_core.log_backends); i < c; i++) {
             const rizz__log_backend* backend = &g_core.log_backends[i];
-
             for (int ei = 0; ei < num_entries; ei++) {
-                rizz__log_entry_internal_ref entry = entries[ei];
-                rizz__log_pipe pipe = g_core.log_pipes[entry.pipe_idx];
+                backend->log_cb(&entries[ei].e.e, backend->user);
+            }
+        } // foreach backend
 
-                backend->log_cb(&entry.e.e, backend->user);
+        // strings are deleted after all backends received them
+        for (int ei = 0; ei < num_entries; ei++) {
+            rizz__log_entry_internal_ref entry = entries[ei];
+            rizz__log_pipe* pipe = &g_core.log_pipes[entry.pipe_idx];
 
-                if (entry.e.text_id) {
-                    sx_strpool_del(pipe.strpool, entry.e.text_id);
-                }
-                if (entry.e.source_id) {
-                    sx_strpool_del(pipe.strpool, entry.e.source_id);
-                }
-            }    // foreach entry
-        } // foreach backend
+            sx_lock(&pipe->lock);
+            if (entry.e.text_id) {
+                sx_strpool_del(pipe->strpool, entry.e.text_id);
+            }
+            if (entry.e.source_id) {
+                sx_strpool_del(pipe->strpool, entry.e.source_id);
+            }
+            sx_unlock(&pipe->lock);
+        }    // foreach entry
     }
     
     the__core.tmp_alloc_pop();
@@ -687,6 +801,36 @@ static float rizz__fps_mean(void)
     return g_core.fps_mean;
 }
 
+static bool rizz__frame_stats_resize(int window)
+{
+    rizz__frame_stats* fs = &g_core.frame_stats;
+    const sx_alloc* alloc = rizz__alloc(RIZZ_MEMID_CORE);
+    float* buff = sx_malloc(alloc, sizeof(float) * (size_t)window * (3 + _RIZZ__CORE_PHASE_COUNT));
+    if (!buff) {
+        sx_out_of_memory();
+        return false;
+    }
+
+    sx_free(alloc, fs->frame_ms);
+    fs->frame_ms = buff;
+    fs->scratch = buff + window;
+    fs->phase_ms = buff + window * 3;
+    fs->window = window;
+    fs->count = 0;
+    fs->head = 0;
+    return true;
+}
+
+static void rizz__set_frame_stats_config(int window, float hitch_threshold_ms)
+{
+    if (window > 0 && window != g_core.frame_stats.window) {
+        rizz__frame_stats_resize(window);
+    }
+    if (hitch_threshold_ms > 0) {
+        g_core.frame_stats.hitch_threshold_ms = hitch_threshold_ms;
+    }
+}
+
 int64_t rizz__frame_index(void)
 {
     return g_core.frame_idx;
@@ -830,31 +974,84 @@ static inline void rizz__atomic_max(sx_atomic_size* _max, intptr_t val)
     }
 }
 
+// commits pages at the end of committed memory, so it covers at least `size` bytes
+static bool rizz__vmem_grow(sx_vmem_context* vmem, size_t size)
+{
+    int num_pages = sx_vmem_get_needed_pages(size) - vmem->num_pages;
+    return num_pages <= 0 || sx_vmem_commit_pages(vmem, vmem->num_pages, num_pages) != NULL;
+}
+
 static void* rizz__tmp_alloc_cb(void* ptr, size_t size, uint32_t align, const char* file,
                                   const char* func, uint32_t line, void* user_data)
 {
     rizz__core_tmpalloc* alloc = user_data;
     size_t raw_size = sx_stackalloc_real_alloc_size(size, align);
-    if ((raw_size + alloc->stack_alloc.offset) > alloc->stack_alloc.size) {
-        // maximum reached, extend it by allocating new pages
-        // size_t size_needed = raw_size + alloc->stack_alloc.offset - alloc->stack_alloc.size;
-        // int num_pages = (int)(size_needed + alloc->vmem.page_size - 1) / alloc->vmem.page_size;
-        int num_pages = (int)(raw_size + alloc->vmem.page_size - 1) / alloc->vmem.page_size;
-        void* page_ptr = sx_vmem_commit_pages(&alloc->vmem, alloc->vmem.num_pages, num_pages);
-        if (page_ptr == NULL) {
+    size_t end_offset = raw_size + alloc->stack_alloc.offset;
+    if (end_offset > alloc->stack_alloc.size) {
+        // maximum reached, extend it by committing the pages right after the current ones
+        if (!rizz__vmem_grow(&alloc->vmem, end_offset)) {
             sx_out_of_memory();
             return NULL;
         }
         alloc->stack_alloc.size = sx_vmem_commit_size(&alloc->vmem);
-        // align offset to nearest page
-        size_t new_offset = (uintptr_t)page_ptr - (uintptr_t)alloc->vmem.ptr;
-        sx_assert(new_offset % alloc->vmem.page_size == 0);
-        alloc->stack_alloc.offset = new_offset;
     }
 
     return sx__realloc(&alloc->stack_alloc.alloc, ptr, size, align, file, func, line);
 }
 
+static void* rizz__frame_alloc_cb(void* ptr, size_t size, uint32_t align, const char* file,
+                                  const char* func, uint32_t line, void* user_data)
+{
+    rizz__core_framealloc* alloc = user_data;
+    if (size > 0) {
+        size_t end_offset = sx_linalloc_real_alloc_size(size, align) + alloc->linalloc.offset;
+        if (end_offset > alloc->linalloc.size) {
+            if (!rizz__vmem_grow(&alloc->vmem, end_offset)) {
+                sx_out_of_memory();
+                return NULL;
+            }
+            alloc->linalloc.size = sx_vmem_commit_size(&alloc->vmem);
+        }
+    }
+
+    return sx__realloc(&alloc->linalloc.alloc, ptr, size, align, file, func, line);
+}
+
+// `used` is the maximum number of bytes that was used since the last call
+static void rizz__vmem_trim(sx_vmem_context* vmem, rizz__core_hwm* hwm, size_t used)
+{
+    hwm->window_peak = sx_max(hwm->window_peak, used);
+    if (hwm->window_peak * 2 >= sx_vmem_commit_size(vmem)) {
+        hwm->window_peak = 0;
+        hwm->num_low_frames = 0;
+        return;
+    }
+
+    if (++hwm->num_low_frames >= MEM_TRIM_FRAMES) {
+        int keep_pages = sx_max(1, sx_vmem_get_needed_pages(hwm->window_peak));
+        sx_vmem_free_pages(vmem, keep_pages, vmem->num_pages - keep_pages);
+        hwm->window_peak = 0;
+        hwm->num_low_frames = 0;
+    }
+}
+
+// heap stats for malloc backend. slab backend keeps it's own per-thread stats instead of
+// contending on these atomics, see rizz__get_mem_info
+static inline void rizz__heap_stats_update(intptr_t size_diff, int count_diff)
+{
+    if (g_core.slab) {
+        return;
+    }
+
+    intptr_t size = sx_atomic_add_fetch_size(&g_core.heap_size, size_diff);
+    if (size_diff > 0) {
+        rizz__atomic_max(&g_core.heap_max, size);
+    }
+    if (count_diff != 0) {
+        sx_atomic_fetch_add(&g_core.heap_count, count_diff);
+    }
+}
+
 static void* rizz__proxy_alloc_cb(void* ptr, size_t size, uint32_t align, const char* file,
                                   const char* func, uint32_t line, void* user_data)
 {
@@ -868,8 +1065,7 @@ static void* rizz__proxy_alloc_cb(void* ptr, size_t size, uint32_t align, const
             rizz__proxy_alloc_header* header = (rizz__proxy_alloc_header*)ptr - 1;
             ptr = aligned - header->ptr_offset;
 
-            sx_atomic_fetch_add_size(&g_core.heap_size, -header->size);
-            sx_atomic_decr(&g_core.heap_count);
+            rizz__heap_stats_update(-header->size, -1);
 
             sx__free(heap_alloc, ptr, 0, file, func, line);
         }
@@ -892,10 +1088,9 @@ static void* rizz__proxy_alloc_cb(void* ptr, size_t size, uint32_t align, const
         header->size = total;
         header->ptr_offset = (uint32_t)(uintptr_t)(aligned - _ptr);
         header->track_item_idx = -1;
+        header->track_shard_idx = 0;
 
-        sx_atomic_fetch_add_size(&g_core.heap_size, total);
-        rizz__atomic_max(&g_core.heap_max, g_core.heap_size);
-        sx_atomic_incr(&g_core.heap_count);
+        rizz__heap_stats_update(total, 1);
 
         return aligned;
     } else {
@@ -905,7 +1100,6 @@ static void* rizz__proxy_alloc_cb(void* ptr, size_t size, uint32_t align, const
         uint32_t offset = header->ptr_offset;
         intptr_t prev_size = header->size;
         ptr = aligned - offset;
-        sx_atomic_fetch_add_size(&g_core.heap_size, -header->size);
 
         align = sx_max((int)align, SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT);
         intptr_t total = (intptr_t)size + sizeof(rizz__proxy_alloc_header) + align;
@@ -917,6 +1111,7 @@ static void* rizz__proxy_alloc_cb(void* ptr, size_t size, uint32_t align, const
         uint8_t* new_aligned = (uint8_t*)sx_align_ptr(ptr, sizeof(rizz__proxy_alloc_header), align);
         if (new_aligned == aligned) {
             header->size = total;
+            rizz__heap_stats_update(total - prev_size, 0);
             return aligned;
         }
 
@@ -926,24 +1121,143 @@ static void* rizz__proxy_alloc_cb(void* ptr, size_t size, uint32_t align, const
         header->size = total;
         header->ptr_offset = (uint32_t)(uintptr_t)(new_aligned - (uint8_t*)ptr);
 
-        intptr_t size_diff = total - prev_size;
-        sx_atomic_fetch_add_size(&g_core.heap_size, size_diff);
-        if (size_diff > 0)
-            rizz__atomic_max(&g_core.heap_max, g_core.heap_size);
+        rizz__heap_stats_update(total - prev_size, 0);
         return new_aligned;
     }
 }
 
+static thread_local int t__track_shard_idx = -1;
+static thread_local int64_t t__track_sample_bytes;
+static thread_local uint32_t t__track_rng;
+
+static inline rizz__track_shard* rizz__track_thread_shard(void)
+{
+    if (t__track_shard_idx < 0) {
+        t__track_shard_idx =
+            (sx_atomic_incr(&g_core.track_num_threads) - 1) % RIZZ__TRACK_NUM_SHARDS;
+    }
+    return &g_core.track_shards[t__track_shard_idx];
+}
+
+// sampling mode: record roughly one allocation for every `track_sample_interval` bytes
+// the distance to the next sample is exponentially distributed, so every allocated byte has the
+// same chance to be picked, and bigger allocations are recorded more often
+static bool rizz__track_should_sample(size_t size)
+{
+    if (g_core.track_sample_interval <= 0) {
+        return true;
+    }
+
+    t__track_sample_bytes -= (int64_t)size;
+    if (t__track_sample_bytes > 0) {
+        return false;
+    }
+
+    if (t__track_rng == 0) {
+        t__track_rng = sx_thread_tid() | 1;
+    }
+    // xorshift32
+    t__track_rng ^= t__track_rng << 13;
+    t__track_rng ^= t__track_rng >> 17;
+    t__track_rng ^= t__track_rng << 5;
+    float u = (float)((t__track_rng >> 8) + 1) / 16777217.0f;    // (0, 1)
+    t__track_sample_bytes = (int64_t)(-sx_log(u) * (float)g_core.track_sample_interval) + 1;
+    return true;
+}
+
+// NOTE: string literals are only unique per module, after a plugin is reloaded, a new call site
+//       may map to an old entry with the same pointers. This only affects the debugger labels
+static int rizz__track_get_site(rizz__track_shard* shard, const char* file, const char* func,
+                                uint32_t line)
+{
+    uint64_t key = sx_hash_u64((uint64_t)(uintptr_t)file ^ ((uint64_t)line << 48)) ^
+                   (uint64_t)(uintptr_t)func;
+    key = (key & ~(uint64_t)3) | 1;    // never zero or tombstone
+
+    if (!shard->site_tbl) {
+        shard->site_tbl = sx_hashtbl64_create(g_core.heap_alloc, 64);
+    }
+
+    int site_idx = sx_hashtbl64_find_get(shard->site_tbl, key, -1);
+    if (site_idx == -1) {
+        rizz__track_site site = { .line = (int)line };
+        if (file) {
+            sx_os_path_basename(site.file, sizeof(site.file), file);
+        }
+        if (func) {
+            sx_strcpy(site.func, sizeof(site.func), func);
+        }
+        site_idx = sx_array_count(shard->sites);
+        sx_array_push(g_core.heap_alloc, shard->sites, site);
+        sx_hashtbl64_add_and_grow(shard->site_tbl, key, site_idx, g_core.heap_alloc);
+    }
+    return site_idx;
+}
+
+static void rizz__track_add_item(rizz__track_shard* shard, int mem_id,
+                                 rizz__proxy_alloc_header* header, void* ptr, const char* file,
+                                 const char* func, uint32_t line)
+{
+    rizz__track_shard_mem* mem = &shard->mems[mem_id];
+
+    sx_lock(&shard->lk);
+    rizz__track_item item = { .ptr = ptr,
+                              .size = header->size,
+                              .site_idx = rizz__track_get_site(shard, file, func, line) };
+    header->track_item_idx = sx_array_count(mem->items);
+    sx_array_push(g_core.heap_alloc, mem->items, item);
+    sx_unlock(&shard->lk);
+}
+
+static inline void rizz__track_add_size(rizz__track_shard_mem* mem, int64_t size)
+{
+    int64_t new_size = sx_atomic_fetch_add64(&mem->size, size) + size;
+    if (size > 0) {
+        int64_t peak = mem->peak;
+        while (new_size > peak) {
+            int64_t prev = sx_atomic_cas64(&mem->peak, new_size, peak);
+            if (prev == peak) {
+                break;
+            }
+            peak = prev;
+        }
+    }
+}
+
+static void rizz__track_remove_item(int mem_id, const rizz__proxy_alloc_header* header, void* ptr)
+{
+    rizz__track_shard* shard = &g_core.track_shards[header->track_shard_idx];
+    rizz__track_shard_mem* mem = &shard->mems[mem_id];
+    int item_idx = header->track_item_idx;
+
+    sx_lock(&shard->lk);
+    sx_assert(item_idx < sx_array_count(mem->items));
+    sx_assert(mem->items[item_idx].ptr == ptr && "memory corruption");
+    sx_unused(ptr);
+
+    int last_idx = sx_array_count(mem->items) - 1;
+    if (item_idx != last_idx) {
+        rizz__proxy_alloc_header* last_header =
+            (rizz__proxy_alloc_header*)mem->items[last_idx].ptr - 1;
+        last_header->track_item_idx = item_idx;
+        sx_array_pop(mem->items, item_idx);
+    } else {
+        sx_array_pop_last(mem->items);
+    }
+    sx_unlock(&shard->lk);
+}
+
 // NOTE: this special tracker alloc, always assumes that the redirecting allocator is
 // proxy-allocator
 //       Thus is assumes that all our pointers have rizz__proxy_alloc_header
+//       Size counters and allocation items are kept on the shard of the thread that made the
+//       allocation (header->track_shard_idx). Everything is merged in rizz__get_mem_info
 // TODO: There is a catch and a possible bug:
 //       malloc and realloc can conflict in multi-threaded environment, where it is called on the
 //       same pointer on different threads
 static void* rizz__track_alloc_cb(void* ptr, size_t size, uint32_t align, const char* file,
                                   const char* func, uint32_t line, void* user_data)
 {
-
     rizz__track_alloc* talloc = user_data;
     const sx_alloc* proxy_alloc = &g_core.heap_proxy_alloc;
 
@@ -951,24 +1265,11 @@ static void* rizz__track_alloc_cb(void* ptr, size_t size, uint32_t align, const
         // free
         if (ptr) {
             const rizz__proxy_alloc_header* header = (rizz__proxy_alloc_header*)ptr - 1;
-            sx_lock(&talloc->_lk);
-            sx_assert(header->track_item_idx >= 0 &&
-                      header->track_item_idx < sx_array_count(talloc->items));
-            talloc->size -= header->size;
-            rizz_track_alloc_item* mem_item = &talloc->items[header->track_item_idx];
-            sx_assert(mem_item->ptr == ptr && "memory corruption");
-            mem_item->ptr = NULL;    // invalidate memory item pointer
-
-            if (header->track_item_idx != sx_array_count(talloc->items) - 1) {
-                void* last_ptr = sx_array_last(talloc->items).ptr;
-                sx_assert(last_ptr);
-                rizz__proxy_alloc_header* last_header = (rizz__proxy_alloc_header*)last_ptr - 1;
-                last_header->track_item_idx = header->track_item_idx;
-                sx_array_pop(talloc->items, header->track_item_idx);
-            } else {
-                sx_array_pop_last(talloc->items);
+            rizz__track_shard* shard = &g_core.track_shards[header->track_shard_idx];
+            rizz__track_add_size(&shard->mems[talloc->mem_id], -(int64_t)header->size);
+            if (header->track_item_idx >= 0) {
+                rizz__track_remove_item(talloc->mem_id, header, ptr);
             }
-            sx_unlock(&talloc->_lk);
             sx__free(proxy_alloc, ptr, align, file, func, line);
         }
 
@@ -978,59 +1279,60 @@ static void* rizz__track_alloc_cb(void* ptr, size_t size, uint32_t align, const
         ptr = sx__malloc(proxy_alloc, size, align, file, func, line);
         sx_assert(ptr);
         rizz__proxy_alloc_header* header = (rizz__proxy_alloc_header*)ptr - 1;
-        rizz_track_alloc_item mem_item = { .ptr = ptr, .line = line, .size = header->size };
-        if (file) {
-            sx_os_path_basename(mem_item.file, sizeof(mem_item.file), file);
+        rizz__track_shard* shard = rizz__track_thread_shard();
+        header->track_shard_idx = (int)(shard - g_core.track_shards);
+        rizz__track_add_size(&shard->mems[talloc->mem_id], (int64_t)header->size);
+        if (rizz__track_should_sample(size)) {
+            rizz__track_add_item(shard, talloc->mem_id, header, ptr, file, func, line);
         }
-        if (func) {
-            sx_strcpy(mem_item.func, sizeof(mem_item.func), func);
-        }
-
-        sx_lock(&talloc->_lk);
-        talloc->size += header->size;
-        talloc->peak = sx_max(talloc->peak, talloc->size);
-        header->track_item_idx = sx_array_count(talloc->items);
-        sx_array_push(g_core.heap_alloc, talloc->items, mem_item);
-        sx_unlock(&talloc->_lk);
 
         return ptr;
     } else {
         // realloc
         const rizz__proxy_alloc_header* prev_header = (rizz__proxy_alloc_header*)ptr - 1;
         int64_t prev_size = prev_header->size;
+        int item_idx = prev_header->track_item_idx;
+        int shard_idx = prev_header->track_shard_idx;
 
         ptr = sx__realloc(proxy_alloc, ptr, size, align, file, func, line);
         sx_assert(ptr);
-        const rizz__proxy_alloc_header* header = (rizz__proxy_alloc_header*)ptr - 1;
-
-        sx_lock(&talloc->_lk);
-        sx_assert(header->track_item_idx >= 0 &&
-                  header->track_item_idx < sx_array_count(talloc->items));
-        int64_t size_diff = header->size - prev_size;
-        talloc->size += size_diff;
-        if (size_diff > 0)
-            talloc->peak = sx_max(talloc->peak, talloc->size);
-        rizz_track_alloc_item* mem_item = &talloc->items[header->track_item_idx];
-        if (file) {
-            sx_os_path_basename(mem_item->file, sizeof(mem_item->file), file);
-        }
-        if (func) {
-            sx_strcpy(mem_item->func, sizeof(mem_item->func), func);
+
+        // proxy allocator may have moved the header, without copying our fields
+        rizz__proxy_alloc_header* header = (rizz__proxy_alloc_header*)ptr - 1;
+        header->track_item_idx = item_idx;
+        header->track_shard_idx = shard_idx;
+        rizz__track_shard* shard = &g_core.track_shards[shard_idx];
+        rizz__track_add_size(&shard->mems[talloc->mem_id], header->size - prev_size);
+
+        if (item_idx >= 0) {
+            sx_lock(&shard->lk);
+            rizz__track_item* item = &shard->mems[talloc->mem_id].items[item_idx];
+            item->ptr = ptr;
+            item->size = header->size;
+            item->site_idx = rizz__track_get_site(shard, file, func, line);
+            sx_unlock(&shard->lk);
         }
-        mem_item->ptr = ptr;
-        mem_item->line = line;
-        mem_item->size = header->size;
-        sx_unlock(&talloc->_lk);
 
         return ptr;
     }
 }
 
+static const sx_alloc* rizz__core_base_alloc(rizz_core_flags flags)
+{
+    return (flags & RIZZ_CORE_FLAG_DETECT_LEAKS) ? sx_alloc_malloc_leak_detect() : sx_alloc_malloc();
+}
+
 bool rizz__core_init(const rizz_config* conf)
 {
-    g_core.heap_alloc = (conf->core_flags & RIZZ_CORE_FLAG_DETECT_LEAKS)
-                            ? sx_alloc_malloc_leak_detect()
-                            : sx_alloc_malloc();
+    g_core.heap_alloc = rizz__core_base_alloc(conf->core_flags);
+    if (conf->core_flags & RIZZ_CORE_FLAG_SLAB_HEAP) {
+        // slab allocator takes it's spans from virtual memory, so leak detection only sees big
+        // allocations. But we still report the number of leaked allocations on release
+        g_core.slab = sx_slaballoc_create(g_core.heap_alloc, 0);
+        if (g_core.slab) {
+            g_core.heap_alloc = sx_slaballoc_alloc(g_core.slab);
+        }
+    }
 
 #ifdef RIZZ_VERSION
     rizz__parse_version(sx_stringize(RIZZ_VERSION), &g_core.ver.major, &g_core.ver.minor, 
@@ -1049,6 +1351,7 @@ bool rizz__core_init(const rizz_config* conf)
                                      .mem_id = (rizz_mem_id)i,
                                      .name = k__memid_names[i] };
         }
+        g_core.track_sample_interval = conf->track_sample_interval;
     } else {
         g_core.heap_proxy_alloc = *g_core.heap_alloc;
     }
@@ -1061,6 +1364,14 @@ bool rizz__core_init(const rizz_config* conf)
 
     int num_worker_threads =
         conf->job_num_threads >= 0 ? conf->job_num_threads : (sx_os_numcores() - 1);
+    if (conf->job_num_threads < 0 && conf->job_pin_mode == SX_JOB_PIN_PHYSICAL) {
+        // one thread per physical core
+        sx_os_cpu* cpus = alloca(sizeof(sx_os_cpu) * sx_os_numcores());
+        int num_cpus = sx_os_cpu_topology(cpus, sx_os_numcores());
+        num_worker_threads = -1;
+        for (int i = 0; i < num_cpus; i++)
+            num_worker_threads += cpus[i].smt == 0 ? 1 : 0;
+    }
     num_worker_threads =
         sx_max(1, num_worker_threads);              // we should have at least one worker thread
     g_core.num_threads = num_worker_threads + 1;    // include the main-thread
@@ -1075,6 +1386,7 @@ bool rizz__core_init(const rizz_config* conf)
         g_core.log_pipes[i].queue =
             sx_queue_spsc_create(alloc, sizeof(rizz__log_entry_internal), 32);
         g_core.log_pipes[i].strpool = sx_strpool_create(alloc, NULL);
+        g_core.log_pipes[i].lock = 0;
         if (!g_core.log_pipes[i].queue || !g_core.log_pipes[i].strpool) {
             sx_out_of_memory();
             return false;
@@ -1141,11 +1453,54 @@ bool rizz__core_init(const rizz_config* conf)
         rizz__log_info("(init) temp memory: %dx%d kb", g_core.num_threads, tmp_size / 1024);
     }
 
+    // Frame allocators
+    {
+        int num_frame_allocs = g_core.num_threads * RIZZ__FRAME_ALLOCS_PER_THREAD;
+        g_core.frame_allocs = sx_malloc(alloc, sizeof(rizz__core_framealloc) * num_frame_allocs);
+        if (!g_core.frame_allocs) {
+            sx_out_of_memory();
+            return false;
+        }
+        sx_memset(g_core.frame_allocs, 0x0, sizeof(rizz__core_framealloc) * num_frame_allocs);
+        size_t page_sz = sx_os_pagesz();
+        size_t frame_size = sx_align_mask(
+            conf->frame_mem_max > 0 ? conf->frame_mem_max * 1024 : DEFAULT_FRAME_SIZE, page_sz - 1);
+        int num_frame_pages = sx_vmem_get_needed_pages(frame_size);
+
+        for (int i = 0; i < num_frame_allocs; i++) {
+            rizz__core_framealloc* f = &g_core.frame_allocs[i];
+            f->alloc = (sx_alloc) {
+                .alloc_cb = rizz__frame_alloc_cb,
+                .user_data = f
+            };
+            if (!sx_vmem_init(&f->vmem, 0, num_frame_pages)) {
+                sx_out_of_memory();
+                return false;
+            }
+            sx_vmem_commit_page(&f->vmem, 0);
+            sx_linalloc_init(&f->linalloc, f->vmem.ptr, page_sz);
+        }
+        rizz__log_info("(init) frame memory: %dx%dx%d kb", g_core.num_threads,
+                       RIZZ__FRAME_ALLOCS_PER_THREAD, frame_size / 1024);
+    }
+
+    // frame-time statistics
+    if (!rizz__frame_stats_resize(conf->frame_stats_window > 0 ? conf->frame_stats_window
+                                                               : DEFAULT_FRAME_STATS_WINDOW)) {
+        return false;
+    }
+    g_core.frame_stats.hitch_threshold_ms =
+        conf->hitch_threshold_ms > 0 ? conf->hitch_threshold_ms : DEFAULT_HITCH_THRESHOLD_MS;
+
     // job dispatcher
     g_core.jobs = sx_job_create_context(
         alloc, &(sx_job_context_desc){ .num_threads = num_worker_threads,
                                        .max_fibers = conf->job_max_fibers,
                                        .fiber_stack_sz = conf->job_stack_size * 1024,
+                                       .spin_count = conf->job_spin_count,
+                                       .yield_count = conf->job_yield_count,
+                                       .pin_mode = conf->job_pin_mode,
+                                       .topology_tags = conf->job_topology_tags,
                                        .thread_init_cb = rizz__job_thread_init_cb,
                                        .thread_shutdown_cb = rizz__job_thread_shutdown_cb });
     if (!g_core.jobs) {
@@ -1155,6 +1510,17 @@ bool rizz__core_init(const rizz_config* conf)
     rizz__log_info("(init) jobs: threads=%d, max_fibers=%d, stack_size=%dkb",
                    sx_job_num_worker_threads(g_core.jobs), conf->job_max_fibers,
                    conf->job_stack_size);
+    g_core.qs_snapshot = sx_malloc(alloc, sizeof(int) * g_core.num_threads);
+    if (!g_core.qs_snapshot) {
+        sx_out_of_memory();
+        return false;
+    }
+
+    // string interner, used by reflection and assets to store names and paths
+    if (!sx_intern_init(rizz__alloc(RIZZ_MEMID_CORE))) {
+        rizz__log_error("initializing string interner failed");
+        return false;
+    }
 
     // reflection
     if (!rizz__refl_init(rizz__alloc(RIZZ_MEMID_REFLECT), 0)) {
@@ -1307,6 +1673,7 @@ void rizz__core_release()
     rizz__gfx_release();
     rizz__vfs_release();
     rizz__refl_release();
+    sx_intern_release();
 
     if (g_core.rmt) {
         rmt_DestroyGlobalInstance(g_core.rmt);
@@ -1321,6 +1688,15 @@ void rizz__core_release()
         sx_free(alloc, g_core.tmp_allocs);
     }
 
+    if (g_core.frame_allocs) {
+        for (int i = 0; i < g_core.num_threads * RIZZ__FRAME_ALLOCS_PER_THREAD; i++) {
+            sx_vmem_release(&g_core.frame_allocs[i].vmem);
+        }
+        sx_free(alloc, g_core.frame_allocs);
+    }
+
+    sx_free(alloc, g_core.frame_stats.frame_ms);
+
     // release log backends and queues
     for (int i = 0; i < g_core.num_threads; i++) {
         if (g_core.log_pipes[i].queue) {
@@ -1330,6 +1706,7 @@ void rizz__core_release()
             sx_strpool_destroy(g_core.log_pipes[i].strpool, alloc);
         }
     }
+    sx_free(alloc, g_core.qs_snapshot);
     sx_free(alloc, g_core.log_pipes);
     sx_array_free(alloc, g_core.log_backends);
     g_core.num_log_backends = 0;
@@ -1338,6 +1715,16 @@ void rizz__core_release()
         for (int i = 0; i < _RIZZ_MEMID_COUNT; i++) {
             sx_array_free(g_core.heap_alloc, g_core.track_allocs[i].items);
         }
+        for (int i = 0; i < RIZZ__TRACK_NUM_SHARDS; i++) {
+            rizz__track_shard* shard = &g_core.track_shards[i];
+            for (int k = 0; k < _RIZZ_MEMID_COUNT; k++) {
+                sx_array_free(g_core.heap_alloc, shard->mems[k].items);
+            }
+            sx_array_free(g_core.heap_alloc, shard->sites);
+            if (shard->site_tbl) {
+                sx_hashtbl64_destroy(shard->site_tbl, g_core.heap_alloc);
+            }
+        }
     }
 
     for (int i = 0; i < sx_array_count(g_core.tls_vars); i++) {
@@ -1348,6 +1735,16 @@ void rizz__core_release()
 
     sx_array_free(&g_core.heap_proxy_alloc, g_core.tls_vars);
 
+    if (g_core.slab) {
+        sx_slaballoc_stats stats;
+        sx_slaballoc_get_stats(g_core.slab, &stats);
+        if (stats.count > 0) {
+            rizz__log_warn("slab heap: %d allocations (%d bytes) are not freed", (int)stats.count,
+                           (int)stats.size);
+        }
+        sx_slaballoc_destroy(g_core.slab, rizz__core_base_alloc(g_core.flags));
+    }
+
     rizz__log_info("shutdown");
 
 #ifdef _DEBUG
@@ -1357,68 +1754,100 @@ void rizz__core_release()
     sx_memset(&g_core, 0x0, sizeof(g_core));
 }
 
-void rizz__core_frame()
+static void rizz__core_reset_framealloc(rizz__core_framealloc* f)
 {
-    rizz__profile_begin(FRAME, 0);
-    {
-        static uint32_t gpu_frame_hash = 0;
-        the__gfx.imm.begin_profile_sample("FRAME", &gpu_frame_hash);
-    }
-
-    // Measure timing and fps
-    g_core.delta_tick = sx_tm_laptime(&g_core.last_tick);
-    g_core.elapsed_tick += g_core.delta_tick;
-
-    uint64_t delta_tick = g_core.delta_tick;
-    float dt = (float)sx_tm_sec(delta_tick);
-
-    if (delta_tick > 0) {
-        double afps = g_core.fps_mean;
-        double fps = 1.0 / dt;
-
-        afps += (fps - afps) / (double)g_core.frame_idx;
-        g_core.fps_mean = (float)afps;
-        g_core.fps_frame = (float)fps;
-    }
+    f->peak = sx_max(f->peak, f->linalloc.peak);
+    rizz__vmem_trim(&f->vmem, &f->hwm, f->linalloc.peak);
+    sx_linalloc_reset(&f->linalloc);
+    f->linalloc.size = sx_vmem_commit_size(&f->vmem);
+    f->linalloc.peak = 0;
+}
 
-    // reset temp allocators
-    size_t page_sz = sx_os_pagesz();
+// called right after frame_idx is incremented. THIS_FRAME allocators are reset every frame and
+// the NEXT_FRAME allocator of the new frame is the one that was used two frames ago
+static void rizz__core_reset_frame_allocs(void)
+{
+    int next_idx = 1 + (int)(g_core.frame_idx & 1);
     for (int i = 0, c = g_core.num_threads; i < c; i++) {
-        rizz__core_tmpalloc* t = &g_core.tmp_allocs[i];
-        sx_vmem_free_pages(&t->vmem, 1, t->vmem.num_pages - 1);
-        sx_stackalloc_reset(&t->stack_alloc);
-        t->stack_alloc.size = page_sz;
+        rizz__core_framealloc* f = &g_core.frame_allocs[i * RIZZ__FRAME_ALLOCS_PER_THREAD];
+        rizz__core_reset_framealloc(&f[0]);
+        rizz__core_reset_framealloc(&f[next_idx]);
     }
+}
 
-    rizz__gfx_trace_reset_frame_stats(RIZZ_GFX_TRACE_COMMON);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// frame phases
+// every frame is a set of phases that declare which phases must be finished before them. phases
+// that are pinned to the main thread run in the order of the table below, unless their job_flag is
+// set in core flags. other phases are dispatched to the job system as soon as their dependencies
+// are finished, and the main thread only waits for them when a later main-thread phase depends on
+// them. dependencies must be declared before the phase in the table.
+//      Http_poll: processes sockets, but can't overlap with http API calls, which happen from
+//                 coroutines and plugins (and http callbacks, which are called in Http_update)
+//      Log_update: log backends are registered by plugins and the imgui log backend is drawn in
+//                  ImGui_draw, so log flush runs between the two. backends are plugin code, so it
+//                  only overlaps command-buffer execution with RIZZ_CORE_FLAG_LOG_ON_JOB_THREAD
+typedef struct rizz__core_phase {
+    const char* name;
+    void (*run_cb)(float dt);
+    uint32_t deps;    // RIZZ__CORE_PHASE(..) bits
+    bool main_thread;
+    uint32_t job_flag;    // rizz_core_flags bit that moves a main_thread phase to the job system
+} rizz__core_phase;
 
-    // update internal sub-systems
-    rizz__http_update();
+static void rizz__core_phase_http_poll(float dt)
+{
+    sx_unused(dt);
+    rizz__http_poll();
+}
+
+static void rizz__core_phase_vfs(float dt)
+{
+    sx_unused(dt);
     rizz__vfs_async_update();
+}
+
+static void rizz__core_phase_asset(float dt)
+{
+    sx_unused(dt);
     rizz__asset_update();
+}
+
+static void rizz__core_phase_gfx(float dt)
+{
+    sx_unused(dt);
     rizz__gfx_update();
+}
+
+static void rizz__core_phase_http(float dt)
+{
+    sx_unused(dt);
+    rizz__http_update();
+}
 
-    rizz__profile_begin(Coroutines, 0);
+static void rizz__core_phase_coroutines(float dt)
+{
     sx_coro_update(g_core.coro, dt);
-    rizz__profile_end(Coroutines);
+}
 
-    // update plugins and application
-    rizz__plugin_update(dt);
+static void rizz__core_phase_log(float dt)
+{
+    sx_unused(dt);
+    rizz__log_update();
+}
 
-    // execute remaining commands from the 'staged' API
-    rizz__profile_begin(Execute_command_buffers, 0);
+// execute remaining commands from the 'staged' API
+static void rizz__core_phase_command_buffers(float dt)
+{
+    sx_unused(dt);
     rizz__gfx_execute_command_buffers_final();
-    rizz__profile_end(Execute_command_buffers);
-
-    // flush queued logs
-    rizz__profile_begin(Log_update, 0);
-    rizz__log_update();
-    rizz__profile_end(Log_update);
+}
 
-    // draw imgui stuff
+static void rizz__core_phase_imgui(float dt)
+{
+    sx_unused(dt);
     rizz_api_imgui* the_imgui = the__plugin.get_api_byname("imgui", 0);
     if (the_imgui) {
-        rizz__profile_begin(ImGui_draw, 0);
         rizz_api_imgui_extra* the_imguix = the__plugin.get_api_byname("imgui_extra", 0);
         if (g_core.show_memory.show) {
             rizz_mem_info minfo;
@@ -1437,11 +1866,270 @@ void rizz__core_frame()
 
         rizz__gfx_trace_reset_frame_stats(RIZZ_GFX_TRACE_IMGUI);
         the_imgui->Render();
-        rizz__profile_end(ImGui_draw);
+    }
+}
+
+// clang-format off
+static const rizz__core_phase k_core_phases[_RIZZ__CORE_PHASE_COUNT] = {
+    [RIZZ__CORE_PHASE_HTTP_POLL] = { "Http_poll", rizz__core_phase_http_poll, 0, false },
+    [RIZZ__CORE_PHASE_VFS] = { "Vfs_update", rizz__core_phase_vfs, 0, true },
+    [RIZZ__CORE_PHASE_ASSET] = { "Asset_update", rizz__core_phase_asset,
+                                 RIZZ__CORE_PHASE(VFS), true },
+    [RIZZ__CORE_PHASE_GFX] = { "Gfx_update", rizz__core_phase_gfx, RIZZ__CORE_PHASE(ASSET), true },
+    [RIZZ__CORE_PHASE_HTTP] = { "Http_update", rizz__core_phase_http,
+                                RIZZ__CORE_PHASE(HTTP_POLL), true },
+    [RIZZ__CORE_PHASE_COROUTINES] = { "Coroutines", rizz__core_phase_coroutines,
+                                      RIZZ__CORE_PHASE(GFX) | RIZZ__CORE_PHASE(HTTP), true },
+    [RIZZ__CORE_PHASE_PLUGINS] = { "Plugins", rizz__plugin_update,
+                                   RIZZ__CORE_PHASE(COROUTINES), true },
+    [RIZZ__CORE_PHASE_LOG] = { "Log_update", rizz__core_phase_log,
+                               RIZZ__CORE_PHASE(PLUGINS), true, RIZZ_CORE_FLAG_LOG_ON_JOB_THREAD },
+    [RIZZ__CORE_PHASE_COMMAND_BUFFERS] = { "Execute_command_buffers",
+                                           rizz__core_phase_command_buffers,
+                                           RIZZ__CORE_PHASE(PLUGINS), true },
+    [RIZZ__CORE_PHASE_IMGUI] = { "ImGui_draw", rizz__core_phase_imgui,
+                                 RIZZ__CORE_PHASE(COMMAND_BUFFERS) | RIZZ__CORE_PHASE(LOG), true }
+};
+// clang-format on
+
+static void rizz__core_run_phase(int id)
+{
+    static uint32_t sample_hashes[_RIZZ__CORE_PHASE_COUNT];
+
+    const rizz__core_phase* phase = &k_core_phases[id];
+    the__core.begin_profile_sample(phase->name, 0, &sample_hashes[id]);
+    uint64_t start_tm = sx_tm_now();
+    phase->run_cb((float)sx_tm_sec(g_core.delta_tick));
+    g_core.phase_ms[id] = (float)sx_tm_ms(sx_tm_since(start_tm));
+    the__core.end_profile_sample();
+}
+
+static inline bool rizz__core_phase_on_main_thread(const rizz__core_phase* phase)
+{
+    return phase->main_thread && !(g_core.flags & phase->job_flag);
+}
+
+static void rizz__core_phase_job_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(range_start);
+    sx_unused(range_end);
+    sx_unused(thread_index);
+    rizz__core_run_phase((int)(intptr_t)user);
+}
+
+// dispatches worker phases that all their dependencies are finished
+static uint32_t rizz__core_dispatch_phases(sx_job_t* jobs, uint32_t dispatched, uint32_t done)
+{
+    for (int i = 0; i < _RIZZ__CORE_PHASE_COUNT; i++) {
+        const rizz__core_phase* phase = &k_core_phases[i];
+        if (!rizz__core_phase_on_main_thread(phase) && !(dispatched & (1u << i)) &&
+            (phase->deps & ~done) == 0) {
+            jobs[i] = sx_job_dispatch(g_core.jobs, 1, rizz__core_phase_job_cb, (void*)(intptr_t)i,
+                                      SX_JOB_PRIORITY_HIGH, 0, 0, SX_JOB_FLAG_LEAF);
+            dispatched |= 1u << i;
+        }
+    }
+    return dispatched;
+}
+
+static uint32_t rizz__core_wait_phases(sx_job_t* jobs, uint32_t mask)
+{
+    for (int i = 0; i < _RIZZ__CORE_PHASE_COUNT; i++) {
+        if (mask & (1u << i)) {
+            sx_job_wait_and_del(g_core.jobs, jobs[i]);
+        }
+    }
+    return mask;
+}
+
+static void rizz__core_run_phases(void)
+{
+    const uint32_t all = (1u << _RIZZ__CORE_PHASE_COUNT) - 1;
+    sx_job_t jobs[_RIZZ__CORE_PHASE_COUNT] = { 0 };
+    uint32_t done = 0;
+    uint32_t dispatched = rizz__core_dispatch_phases(jobs, 0, done);
+
+    for (int i = 0; i < _RIZZ__CORE_PHASE_COUNT; i++) {
+        const rizz__core_phase* phase = &k_core_phases[i];
+        if (!rizz__core_phase_on_main_thread(phase)) {
+            continue;
+        }
+
+        done |= rizz__core_wait_phases(jobs, phase->deps & dispatched & ~done);
+        sx_assert((phase->deps & ~done) == 0 && "phase dependencies must be declared before it");
+
+        rizz__core_run_phase(i);
+        done |= 1u << i;
+        dispatched = rizz__core_dispatch_phases(jobs, dispatched, done);
+    }
+
+    // wait for the remaining worker phases, and the ones that only depend on them
+    while (done != all) {
+        uint32_t pending = dispatched & ~done;
+        sx_assert(pending && "worker phases have unresolved dependencies");
+        if (!pending) {
+            break;
+        }
+        done |= rizz__core_wait_phases(jobs, pending);
+        dispatched = rizz__core_dispatch_phases(jobs, dispatched, done);
+    }
+}
+
+static void rizz__frame_stats_record(float frame_ms)
+{
+    rizz__frame_stats* fs = &g_core.frame_stats;
+    int index = fs->head;
+    fs->frame_ms[index] = frame_ms;
+    sx_memcpy(&fs->phase_ms[index * _RIZZ__CORE_PHASE_COUNT], g_core.phase_ms,
+              sizeof(g_core.phase_ms));
+    fs->head = (index + 1) % fs->window;
+    fs->count = sx_min(fs->count + 1, fs->window);
+    if (frame_ms > fs->hitch_threshold_ms) {
+        ++fs->total_hitches;
+    }
+}
+
+// nearest-rank percentile
+static inline float rizz__frame_stats_percentile(const float* sorted, int count, float p)
+{
+    int index = (int)sx_ceil(p * (float)count) - 1;
+    return sorted[sx_clamp(index, 0, count - 1)];
+}
+
+static void rizz__core_frame_stats(rizz_frame_stats* stats)
+{
+    sx_assert(stats);
+    const rizz__frame_stats* fs = &g_core.frame_stats;
+    int count = fs->count;
+    int first = (fs->head - count + fs->window) % fs->window;    // oldest frame
+    float* linear = fs->scratch;
+    float* sorted = fs->scratch + fs->window;
+
+    sx_memset(stats, 0x0, sizeof(rizz_frame_stats));
+    stats->window = fs->window;
+    stats->num_frames = count;
+    stats->hitch_threshold_ms = fs->hitch_threshold_ms;
+    stats->total_hitches = fs->total_hitches;
+    stats->frame_ms = linear;
+
+    static_assert(_RIZZ__CORE_PHASE_COUNT <= RIZZ_MAX_FRAME_PHASES, "too many frame phases");
+    stats->num_phases = _RIZZ__CORE_PHASE_COUNT;
+    for (int i = 0; i < _RIZZ__CORE_PHASE_COUNT; i++) {
+        stats->phases[i].name = k_core_phases[i].name;
+        stats->phases[i].main_thread = k_core_phases[i].main_thread;
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    float sum = 0;
+    for (int i = 0; i < count; i++) {
+        float ms = fs->frame_ms[(first + i) % fs->window];
+        linear[i] = ms;
+        sum += ms;
+        if (ms > fs->hitch_threshold_ms) {
+            ++stats->num_hitches;
+        }
+    }
+    sx_memcpy(sorted, linear, sizeof(float) * count);
+    rizz__frame_stats_sort_quick_sort(sorted, (size_t)count);
+
+    stats->mean_ms = sum / (float)count;
+    stats->p50_ms = rizz__frame_stats_percentile(sorted, count, 0.5f);
+    stats->p95_ms = rizz__frame_stats_percentile(sorted, count, 0.95f);
+    stats->p99_ms = rizz__frame_stats_percentile(sorted, count, 0.99f);
+    stats->max_ms = sorted[count - 1];
+
+    for (int pi = 0; pi < _RIZZ__CORE_PHASE_COUNT; pi++) {
+        sum = 0;
+        for (int i = 0; i < count; i++) {
+            float ms = fs->phase_ms[((first + i) % fs->window) * _RIZZ__CORE_PHASE_COUNT + pi];
+            sorted[i] = ms;
+            sum += ms;
+        }
+        rizz__frame_stats_sort_quick_sort(sorted, (size_t)count);
+
+        rizz_frame_phase_stats* phase = &stats->phases[pi];
+        phase->mean_ms = sum / (float)count;
+        phase->p95_ms = rizz__frame_stats_percentile(sorted, count, 0.95f);
+        phase->max_ms = sorted[count - 1];
+    }
+}
+
+// Lock-free tables (assets, reflection, interner) keep the memory they retire alive for readers,
+// and jobs that run across frames may still be reading it at the end of the frame. So retired
+// memory is stamped with the current epoch and freed only after every job that was running at that
+// point is done or has parked itself in wait (see sx_job_quiescent_snapshot). One grace period runs
+// at a time, so memory is freed at least one frame after it's retired, as soon as long running jobs
+// allow it. Lookups from threads that are not job threads are not covered
+static void rizz__core_collect()
+{
+    uint64_t epoch = (uint64_t)g_core.frame_idx + 1;
+    if (g_core.qs_epoch && sx_job_quiescent_passed(g_core.jobs, g_core.qs_snapshot)) {
+        g_core.safe_epoch = g_core.qs_epoch;
+        g_core.qs_epoch = 0;
+    }
+
+    rizz__asset_collect(epoch, g_core.safe_epoch);
+    rizz__refl_collect(epoch, g_core.safe_epoch);
+    sx_strtbl_collect(sx_intern_tbl(), epoch, g_core.safe_epoch);
+
+    // main thread is not running any jobs here, start the grace period of this epoch
+    if (!g_core.qs_epoch) {
+        sx_job_quiescent_snapshot(g_core.jobs, g_core.qs_snapshot);
+        g_core.qs_epoch = epoch;
+    }
+}
+
+void rizz__core_frame()
+{
+    rizz__profile_begin(FRAME, 0);
+    {
+        static uint32_t gpu_frame_hash = 0;
+        the__gfx.imm.begin_profile_sample("FRAME", &gpu_frame_hash);
+    }
+
+    // Measure timing and fps
+    g_core.delta_tick = sx_tm_laptime(&g_core.last_tick);
+    g_core.elapsed_tick += g_core.delta_tick;
+
+    uint64_t delta_tick = g_core.delta_tick;
+    float dt = (float)sx_tm_sec(delta_tick);
+
+    if (delta_tick > 0) {
+        double afps = g_core.fps_mean;
+        double fps = 1.0 / dt;
+
+        afps += (fps - afps) / (double)g_core.frame_idx;
+        g_core.fps_mean = (float)afps;
+        g_core.fps_frame = (float)fps;
+    }
+
+    // reset temp allocators, committed pages are kept, see rizz__vmem_trim
+    for (int i = 0, c = g_core.num_threads; i < c; i++) {
+        rizz__core_tmpalloc* t = &g_core.tmp_allocs[i];
+        t->peak = sx_max(t->peak, t->stack_alloc.peak);
+        rizz__vmem_trim(&t->vmem, &t->hwm, t->stack_alloc.peak);
+        sx_stackalloc_reset(&t->stack_alloc);
+        t->stack_alloc.size = sx_vmem_commit_size(&t->vmem);
+        t->stack_alloc.peak = 0;
+    }
+
+    rizz__gfx_trace_reset_frame_stats(RIZZ_GFX_TRACE_COMMON);
+
+    rizz__core_run_phases();
+
+    rizz__core_collect();
+
+    // first frame's delta includes the initialization time
+    if (g_core.frame_idx > 0) {
+        rizz__frame_stats_record((float)sx_tm_ms(delta_tick));
     }
 
     rizz__gfx_commit_gpu();
     ++g_core.frame_idx;
+    rizz__core_reset_frame_allocs();
 
     the__gfx.imm.end_profile_sample();
     rizz__profile_end(FRAME);
@@ -1454,6 +2142,16 @@ static const sx_alloc* rizz__core_tmp_alloc_push()
     return &talloc->alloc;
 }
 
+static const sx_alloc* rizz__core_frame_alloc(rizz_frame_lifetime lifetime)
+{
+    sx_assert(lifetime < _RIZZ_FRAME_LIFETIME_COUNT);
+    int idx = sx_job_thread_index(g_core.jobs) * RIZZ__FRAME_ALLOCS_PER_THREAD;
+    if (lifetime == RIZZ_FRAME_LIFETIME_NEXT_FRAME) {
+        idx += 1 + (int)(g_core.frame_idx & 1);
+    }
+    return &g_core.frame_allocs[idx].alloc;
+}
+
 static void rizz__core_tmp_alloc_pop()
 {
     rizz__core_tmpalloc* talloc = &g_core.tmp_allocs[sx_job_thread_index(g_core.jobs)];
@@ -1485,7 +2183,16 @@ static sx_job_t rizz__job_dispatch(int count,
                                    void* user, sx_job_priority priority, uint32_t tags)
 {
     sx_assert(g_core.jobs);
-    return sx_job_dispatch(g_core.jobs, count, callback, user, priority, tags);
+    return sx_job_dispatch(g_core.jobs, count, callback, user, priority, tags, 0, 0);
+}
+
+static sx_job_t rizz__job_parallel_for(int count, int grain_size,
+                                       void (*callback)(int start, int end, int thrd_index,
+                                                        void* user),
+                                       void* user, sx_job_priority priority, uint32_t tags)
+{
+    sx_assert(g_core.jobs);
+    return sx_job_parallel_for(g_core.jobs, count, grain_size, callback, user, priority, tags, 0);
 }
 
 static void rizz__job_wait_and_del(sx_job_t job)
@@ -1500,6 +2207,34 @@ static bool rizz__job_test_and_del(sx_job_t job)
     return sx_job_test_and_del(g_core.jobs, job);
 }
 
+static sx_job_graph* rizz__job_graph_create(void)
+{
+    return sx_job_graph_create(&g_core.heap_proxy_alloc);
+}
+
+static void rizz__job_graph_destroy(sx_job_graph* graph)
+{
+    sx_job_graph_destroy(graph, &g_core.heap_proxy_alloc);
+}
+
+static int rizz__job_graph_add_node(sx_job_graph* graph, int count,
+                                    void (*callback)(int start, int end, int thrd_index, void* user),
+                                    void* user, sx_job_priority priority, uint32_t tags)
+{
+    return sx_job_graph_add_node(graph, count, callback, user, priority, tags, 0);
+}
+
+static void rizz__job_graph_add_edge(sx_job_graph* graph, int from_node, int to_node)
+{
+    sx_job_graph_add_edge(graph, from_node, to_node);
+}
+
+static sx_job_t rizz__job_graph_submit(sx_job_graph* graph)
+{
+    sx_assert(g_core.jobs);
+    return sx_job_graph_submit(g_core.jobs, graph);
+}
+
 static int rizz__job_num_threads()
 {
     return g_core.num_threads;
@@ -1511,6 +2246,12 @@ static int rizz__job_thread_index()
     return sx_job_thread_index(g_core.jobs);
 }
 
+static void rizz__job_thread_stats(int thread_index, sx_job_thread_stats* stats)
+{
+    sx_assert(g_core.jobs);
+    sx_job_get_thread_stats(g_core.jobs, thread_index, stats);
+}
+
 static void rizz__begin_profile_sample(const char* name, rizz_profile_flags flags, uint32_t* hash_cache)
 {
     sx_unused(name);
@@ -1524,16 +2265,61 @@ static void rizz__end_profile_sample()
     rmt__end_cpu_sample();
 }
 
+// merges tracker shards into `track_allocs[].items`
+// returned items are valid until the next call
 static void rizz__get_mem_info(rizz_mem_info* info)
 {
-    for (int i = 0; i < _RIZZ_MEMID_COUNT; i++) {
-        rizz__track_alloc* t = &g_core.track_allocs[i];
-        info->trackers[i] = (rizz_trackalloc_info){ .name = t->name,
-                                                    .items = t->items,
-                                                    .num_items = sx_array_count(t->items),
-                                                    .mem_id = t->mem_id,
-                                                    .size = t->size,
-                                                    .peak = t->peak };
+    if (RIZZ_CONFIG_DEBUG_MEMORY) {
+        int64_t sizes[_RIZZ_MEMID_COUNT] = { 0 };
+        int64_t peaks[_RIZZ_MEMID_COUNT] = { 0 };
+
+        sx_lock(&g_core.track_merge_lk);
+        for (int i = 0; i < _RIZZ_MEMID_COUNT; i++) {
+            sx_array_clear(g_core.track_allocs[i].items);
+        }
+
+        for (int i = 0; i < RIZZ__TRACK_NUM_SHARDS; i++) {
+            rizz__track_shard* shard = &g_core.track_shards[i];
+            sx_lock(&shard->lk);
+            for (int k = 0; k < _RIZZ_MEMID_COUNT; k++) {
+                const rizz__track_shard_mem* mem = &shard->mems[k];
+                sizes[k] += mem->size;
+                peaks[k] += mem->peak;
+
+                int num_items = sx_array_count(mem->items);
+                if (num_items == 0) {
+                    continue;
+                }
+
+                rizz_track_alloc_item* dst =
+                    sx_array_add(g_core.heap_alloc, g_core.track_allocs[k].items, num_items);
+                for (int j = 0; j < num_items; j++) {
+                    const rizz__track_item* item = &mem->items[j];
+                    const rizz__track_site* site = &shard->sites[item->site_idx];
+                    sx_memcpy(dst[j].file, site->file, sizeof(site->file));
+                    sx_memcpy(dst[j].func, site->func, sizeof(site->func));
+                    dst[j].line = site->line;
+                    dst[j].ptr = item->ptr;
+                    dst[j].size = item->size;
+                }
+            }
+            sx_unlock(&shard->lk);
+        }
+
+        for (int i = 0; i < _RIZZ_MEMID_COUNT; i++) {
+            rizz__track_alloc* t = &g_core.track_allocs[i];
+            // sum of shard peaks: exact if the peaks of the threads overlap (or there is only one
+            // thread allocating), otherwise it's an upper bound of the real peak
+            int64_t peak = sx_max(peaks[i], sizes[i]);
+            t->peak = sx_max(t->peak, peak);
+            info->trackers[i] = (rizz_trackalloc_info){ .name = t->name,
+                                                        .items = t->items,
+                                                        .num_items = sx_array_count(t->items),
+                                                        .mem_id = t->mem_id,
+                                                        .size = sizes[i],
+                                                        .peak = t->peak };
+        }
+        sx_unlock(&g_core.track_merge_lk);
     }
 
     int num_temp_allocs = sx_min(g_core.num_threads, RIZZ_MAX_TEMP_ALLOCS);
@@ -1541,14 +2327,34 @@ static void rizz__get_mem_info(rizz_mem_info* info)
         info->temp_allocs[i] =
             (rizz_linalloc_info){ .offset = g_core.tmp_allocs[i].stack_alloc.offset,
                                   .size = g_core.tmp_allocs[i].stack_alloc.size,
-                                  .peak = g_core.tmp_allocs[i].stack_alloc.peak };
+                                  .peak = sx_max(g_core.tmp_allocs[i].peak,
+                                                 g_core.tmp_allocs[i].stack_alloc.peak) };
+
+        // sum of all lifetimes, peak is the sum of each lifetime's peak
+        const rizz__core_framealloc* f = &g_core.frame_allocs[i * RIZZ__FRAME_ALLOCS_PER_THREAD];
+        rizz_linalloc_info finfo = { 0 };
+        for (int k = 0; k < RIZZ__FRAME_ALLOCS_PER_THREAD; k++) {
+            finfo.offset += f[k].linalloc.offset;
+            finfo.size += f[k].linalloc.size;
+            finfo.peak += sx_max(f[k].peak, f[k].linalloc.peak);
+        }
+        info->frame_allocs[i] = finfo;
     }
 
     info->num_trackers = RIZZ_CONFIG_DEBUG_MEMORY ? _RIZZ_MEMID_COUNT : 0;
     info->num_temp_allocs = g_core.num_threads;
-    info->heap = g_core.heap_size;
-    info->heap_max = g_core.heap_max;
-    info->heap_count = g_core.heap_count;
+    info->num_frame_allocs = num_temp_allocs;
+    if (g_core.slab) {
+        sx_slaballoc_stats stats;
+        sx_slaballoc_get_stats(g_core.slab, &stats);
+        info->heap = (size_t)stats.size;
+        info->heap_max = (size_t)stats.peak;
+        info->heap_count = (int)stats.count;
+    } else {
+        info->heap = g_core.heap_size;
+        info->heap_max = g_core.heap_max;
+        info->heap_count = g_core.heap_count;
+    }
 }
 
 static void rizz__core_coro_invoke(void (*coro_cb)(sx_fiber_transfer), void* user)
@@ -1627,6 +2433,21 @@ static rizz_version rizz__version(void)
     return g_core.ver;
 }
 
+static sx_istr_t rizz__intern(const char* str)
+{
+    return sx_intern(str);
+}
+
+static sx_istr_t rizz__intern_find(const char* str)
+{
+    return sx_intern_find(str);
+}
+
+static const char* rizz__intern_cstr(sx_istr_t id)
+{
+    return sx_intern_cstr(id);
+}
+
 static void rizz__show_graphics_debugger(bool* p_open) 
 {
     g_core.show_graphics.show = true;
@@ -1649,10 +2470,14 @@ static void rizz__show_log(bool* p_open)
 rizz_api_core the__core = { .heap_alloc = rizz__heap_alloc,
                             .tmp_alloc_push = rizz__core_tmp_alloc_push,
                             .tmp_alloc_pop = rizz__core_tmp_alloc_pop,
+                            .frame_alloc = rizz__core_frame_alloc,
                             .tls_register = rizz__core_tls_register,
                             .tls_var = rizz__core_tls_var,
                             .alloc = rizz__alloc,
                             .get_mem_info = rizz__get_mem_info,
+                            .intern = rizz__intern,
+                            .intern_find = rizz__intern_find,
+                            .intern_cstr = rizz__intern_cstr,
                             .version = rizz__version,
                             .rand = rizz__rand,
                             .randf = rizz__randf,
@@ -1663,14 +2488,23 @@ rizz_api_core the__core = { .heap_alloc = rizz__heap_alloc,
                             .fps = rizz__fps,
                             .fps_mean = rizz__fps_mean,
                             .frame_index = rizz__frame_index,
+                            .frame_stats = rizz__core_frame_stats,
+                            .set_frame_stats_config = rizz__set_frame_stats_config,
                             .set_cache_dir = rizz__set_cache_dir,
                             .cache_dir = rizz__cache_dir,
                             .data_dir = rizz__data_dir,
                             .job_dispatch = rizz__job_dispatch,
+                            .job_parallel_for = rizz__job_parallel_for,
                             .job_wait_and_del = rizz__job_wait_and_del,
                             .job_test_and_del = rizz__job_test_and_del,
                             .job_num_threads = rizz__job_num_threads,
                             .job_thread_index = rizz__job_thread_index,
+                            .job_thread_stats = rizz__job_thread_stats,
+                            .job_graph_create = rizz__job_graph_create,
+                            .job_graph_destroy = rizz__job_graph_destroy,
+                            .job_graph_add_node = rizz__job_graph_add_node,
+                            .job_graph_add_edge = rizz__job_graph_add_edge,
+                            .job_graph_submit = rizz__job_graph_submit,
                             .coro_invoke = rizz__core_coro_invoke,
                             .coro_end = rizz__core_coro_end,
                             .coro_wait = rizz__core_coro_wait,
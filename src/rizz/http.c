@@ -82,21 +82,31 @@ void rizz__http_release()
     }
 }
 
+// only processes the sockets of pending requests and doesn't touch the handles or call callbacks,
+// so it can run on a worker thread, as long as the http API is not used at the same time
+void rizz__http_poll()
+{
+    for (int i = 0, c = g_http.num_pending; i < c; i++) {
+        rizz__http* http = &g_http.https[sx_handle_index(g_http.pending[i].id)];
+        sx_assert(http->h);
+        if (http->h->status == HTTP_STATUS_PENDING)
+            http_process(http->h);
+    }
+}
+
+// must be called after rizz__http_poll, on the main thread
 void rizz__http_update()
 {
     int remove_list[RIZZ_CONFIG_MAX_HTTP_REQUESTS];
     int num_removes = 0;
 
-    // process pending
     // for callback requests, call the callback and release the request automatically
     for (int i = 0, c = g_http.num_pending; i < c; i++) {
         rizz_http handle = g_http.pending[i];
         rizz__http* http = &g_http.https[sx_handle_index(handle.id)];
         sx_assert(http->h);
-        if (http->h->status != HTTP_STATUS_PENDING)
-            continue;
 
-        http_status_t status = http_process(http->h);
+        http_status_t status = http->h->status;
         if (status != HTTP_STATUS_PENDING && http->callback) {
             http->callback((const rizz_http_state*)http->h, http->callback_user);
             sx_assert(http->h && "must not `free` inside callback");
@@ -68,6 +68,7 @@ bool rizz__asset_save_meta_cache();
 bool rizz__asset_dump_unused(const char* filepath);
 void rizz__asset_release();
 void rizz__asset_update();
+void rizz__asset_collect(uint64_t epoch, uint64_t safe_epoch);
 
 bool rizz__gfx_init(const sx_alloc* alloc, const sg_desc* desc, bool enable_profile);
 void rizz__gfx_release();
@@ -78,6 +79,7 @@ void rizz__gfx_commit_gpu();
 
 bool rizz__refl_init(const sx_alloc* alloc, int max_regs sx_default(0));
 void rizz__refl_release();
+void rizz__refl_collect(uint64_t epoch, uint64_t safe_epoch);
 
 // clang-format off
 #define rizz__refl_enum(_type, _name)                    \
@@ -90,6 +92,7 @@ void rizz__refl_release();
 
 bool rizz__http_init(const sx_alloc* alloc);
 void rizz__http_release();
+void rizz__http_poll();
 void rizz__http_update();
 
 typedef struct sg_desc sg_desc;
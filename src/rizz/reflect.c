@@ -6,6 +6,7 @@
 #include "internal.h"
 
 #include "sx/array.h"
+#include "sx/atomic.h"
 #include "sx/hash.h"
 #include "sx/string.h"
 
@@ -13,32 +14,40 @@
 
 #define DEFAULT_REG_SIZE 512
 
+// type, name and base names are interned (see sx_intern), so they are compared by id and the
+// strings that are returned to the user stay valid after registration
 typedef struct rizz__refl_struct {
-    char type[32];
+    sx_istr_t type;
     int size;    // size of struct
     int num_fields;
 } rizz__refl_struct;
 
 typedef struct rizz__refl_enum {
-    char type[32];
+    sx_istr_t type;
     int* name_ids;    // index-to: rizz__reflect_context:regs
 } rizz__refl_enum;
 
 typedef struct rizz__refl_data {
     rizz_refl_info r;
     int base_id;
-    char type[64];    // keep the raw type name, cuz pointer types have '*' in their type names
-    char name[32];
-    char base[32];
+    sx_istr_t type;    // type name without '*' or '[]'
+    sx_istr_t name;
+    sx_istr_t base;
 } rizz__refl_data;
 
+typedef struct rizz__refl_retired {
+    rizz__refl_data* regs;
+    uint64_t epoch;    // 0: not seen by rizz__refl_collect yet
+} rizz__refl_retired;
+
 typedef struct rizz__reflect_context {
     rizz__refl_struct* structs;
     rizz__refl_enum* enums;
-    rizz__refl_data* regs;    // sx_array
+    rizz__refl_data* regs;             // sx_array (never reallocated in place, see rizz__refl_push)
+    rizz__refl_retired* retired_regs;    // sx_array: old `regs` buffers, see rizz__refl_collect
     const sx_alloc* alloc;
-    sx_hashtbl* reg_tbl;    // refl.name --> index(regs)
-    int max_regs;           // =0 if unlimited
+    sx_hashtbl_mt* reg_tbl;    // refl.name --> index(regs)
+    int max_regs;              // =0 if unlimited
 } rizz__reflect_context;
 
 static rizz__reflect_context g_reflect;
@@ -54,7 +63,7 @@ bool rizz__refl_init(const sx_alloc* alloc, int max_regs)
     }
 
     g_reflect.reg_tbl =
-        sx_hashtbl_create(alloc, (max_regs <= 0) ? (DEFAULT_REG_SIZE << 1) : (max_regs << 1));
+        sx_hashtblmt_create(alloc, (max_regs <= 0) ? (DEFAULT_REG_SIZE << 1) : (max_regs << 1), 4);
     if (!g_reflect.reg_tbl)
         return false;
 
@@ -66,11 +75,15 @@ void rizz__refl_release()
     if (g_reflect.alloc) {
         const sx_alloc* alloc = g_reflect.alloc;
         if (g_reflect.reg_tbl)
-            sx_hashtbl_destroy(g_reflect.reg_tbl, alloc);
+            sx_hashtblmt_destroy(g_reflect.reg_tbl, alloc);
         for (int i = 0; i < sx_array_count(g_reflect.enums); i++) {
             sx_array_free(g_reflect.alloc, g_reflect.enums[i].name_ids);
         }
         sx_array_free(alloc, g_reflect.regs);
+        for (int i = 0; i < sx_array_count(g_reflect.retired_regs); i++) {
+            sx_array_free(alloc, g_reflect.retired_regs[i].regs);
+        }
+        sx_array_free(alloc, g_reflect.retired_regs);
         sx_array_free(alloc, g_reflect.structs);
         sx_array_free(alloc, g_reflect.enums);
 
@@ -78,6 +91,30 @@ void rizz__refl_release()
     }
 }
 
+// called by the core at the end of the frame, see rizz__core_collect. old `regs` buffers are
+// stamped and freed the same way as the tables in sx_hashtblmt_collect
+void rizz__refl_collect(uint64_t epoch, uint64_t safe_epoch)
+{
+    int count = sx_array_count(g_reflect.retired_regs);
+    int num_retired = 0;
+    for (int i = 0; i < count; i++) {
+        rizz__refl_retired r = g_reflect.retired_regs[i];
+        r.epoch = r.epoch ? r.epoch : epoch;
+        if (r.epoch <= safe_epoch) {
+            sx_array_free(g_reflect.alloc, r.regs);
+        } else {
+            g_reflect.retired_regs[num_retired++] = r;
+        }
+    }
+    if (count > 0) {
+        sx_array_pop_lastn(g_reflect.retired_regs, count - num_retired);
+    }
+
+    if (g_reflect.reg_tbl) {
+        sx_hashtblmt_collect(g_reflect.reg_tbl, epoch, safe_epoch);
+    }
+}
+
 // clang-format off
 static inline int rizz__refl_type_size(const char* type_name) {
     if (sx_strequal(type_name, "int"))              return sizeof(int);
@@ -97,28 +134,63 @@ static inline int rizz__refl_type_size(const char* type_name) {
 }
 // clang-format on
 
+// lookups (get_func/get_field/..) can run in worker threads while new types are registered, so
+// `regs` is not reallocated in place: it's copied into a bigger array and the old one is kept alive
+// until rizz__refl_collect. reg_tbl publishes the new entry after it's written
+static void rizz__refl_push(const rizz__refl_data* r)
+{
+    rizz__refl_data* regs = g_reflect.regs;
+    int count = sx_array_count(regs);
+    if (sx__sbneedgrow(regs, 1)) {
+        rizz__refl_data* new_regs = NULL;
+        sx_array_reserve(g_reflect.alloc, new_regs, sx_max(count << 1, DEFAULT_REG_SIZE));
+        if (!new_regs) {
+            sx_out_of_memory();
+            return;
+        }
+        if (count > 0) {
+            sx_memcpy(sx_array_add(g_reflect.alloc, new_regs, count), regs,
+                      sizeof(rizz__refl_data) * count);
+        }
+        if (regs) {
+            sx_array_push(g_reflect.alloc, g_reflect.retired_regs,
+                          (rizz__refl_retired){ .regs = regs });
+        }
+        sx_memory_write_barrier();    // array must be populated before it's visible to readers
+        g_reflect.regs = regs = new_regs;
+    }
+
+    sx_array_push(g_reflect.alloc, regs, *r);
+    sx_assert(regs == g_reflect.regs);
+}
+
 static void* rizz__refl_get_func(const char* name)
 {
-    int index = sx_hashtbl_find_get(g_reflect.reg_tbl, sx_hash_fnv32_str(name), -1);
+    int index = sx_hashtblmt_find_get(g_reflect.reg_tbl, sx_hash_fnv32_str(name), -1);
     return (index != -1) ? (g_reflect.regs[index].r.any) : NULL;
 }
 
 static int rizz__refl_get_enum(const char* name, int not_found)
 {
-    int index = sx_hashtbl_find_get(g_reflect.reg_tbl, sx_hash_fnv32_str(name), -1);
+    int index = sx_hashtblmt_find_get(g_reflect.reg_tbl, sx_hash_fnv32_str(name), -1);
     return (index != -1) ? (int)g_reflect.regs[index].r.offset : not_found;
 }
 
 static const char* rizz__refl_get_enum_name(const char* type, int val)
 {
+    sx_istr_t type_id = sx_intern_find(type);
+    if (!type_id) {
+        return "";
+    }
+
     for (int i = 0, c = sx_array_count(g_reflect.enums); i < c; i++) {
-        if (sx_strequal(g_reflect.enums[i].type, type)) {
+        if (g_reflect.enums[i].type == type_id) {
             int* name_ids = g_reflect.enums[i].name_ids;
             for (int k = 0, kc = sx_array_count(name_ids); k < kc; k++) {
                 const rizz__refl_data* r = &g_reflect.regs[name_ids[k]];
                 sx_assert(r->r.internal_type == RIZZ_REFL_ENUM);
                 if (val == (int)r->r.offset)
-                    return r->name;
+                    return r->r.name;
             }
         }
     }
@@ -131,7 +203,8 @@ static void* rizz__refl_get_field(const char* base_type, void* obj, const char*
     char* base_name = (char*)alloca(len);
     sx_assert(base_name);
     sx_snprintf(base_name, len, "%s.%s", base_type, name);
-    int index = sx_hashtbl_find_get(g_reflect.reg_tbl, sx_hash_fnv32(name, (size_t)len - 1), -1);
+    int index =
+        sx_hashtblmt_find_get(g_reflect.reg_tbl, sx_hash_fnv32(base_name, (size_t)len - 1), -1);
     return (index != -1) ? ((uint8_t*)obj + g_reflect.regs[index].r.offset) : NULL;
 }
 
@@ -141,8 +214,8 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
 {
     if (g_reflect.max_regs > 0) {
         int count = sx_array_count(g_reflect.regs);
-        sx_assert(g_reflect.max_regs > count);
-        if (g_reflect.max_regs > count) {
+        sx_assert(count < g_reflect.max_regs);
+        if (count >= g_reflect.max_regs) {
             rizz__log_warn("maximum amount of reflection regs exceeded");
             return;
         }
@@ -150,6 +223,7 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
 
     int id = sx_array_count(g_reflect.regs);
     int ptr_str_end = 0;
+    sx_istr_t raw_type_id = sx_intern(type);
 
     // for field types, we construct the name by "base.name"
     const char* key;
@@ -164,7 +238,7 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
             // add enum entry (if doesn't exist)
             int found_idx = -1;
             for (int i = 0, c = sx_array_count(g_reflect.enums); i < c; i++) {
-                if (sx_strequal(g_reflect.enums[i].type, type)) {
+                if (g_reflect.enums[i].type == raw_type_id) {
                     found_idx = i;
                     break;
                 }
@@ -174,8 +248,7 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
                 rizz__refl_enum* _enum = &g_reflect.enums[found_idx];
                 sx_array_push(g_reflect.alloc, _enum->name_ids, id);
             } else {
-                rizz__refl_enum _enum = (rizz__refl_enum){ .name_ids = NULL };
-                sx_strcpy(_enum.type, sizeof(_enum.type), type);
+                rizz__refl_enum _enum = (rizz__refl_enum){ .type = raw_type_id, .name_ids = NULL };
                 sx_array_push(g_reflect.alloc, _enum.name_ids, id);
                 sx_array_push(g_reflect.alloc, g_reflect.enums, _enum);
             }
@@ -185,7 +258,7 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
     }
 
     // registery must not exist
-    if (sx_hashtbl_find(g_reflect.reg_tbl, sx_hash_fnv32_str(key)) >= 0) {
+    if (sx_hashtblmt_find_get(g_reflect.reg_tbl, sx_hash_fnv32_str(key), -1) >= 0) {
         rizz__log_warn("'%s' is already registered for reflection", key);
         return;
     }
@@ -200,9 +273,10 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
                                   .internal_type = internal_type,
                               },
                           .base_id = -1 };
-    sx_strcpy(r.name, sizeof(r.name), name);
-    if (base)
-        sx_strcpy(r.base, sizeof(r.base), base);
+    r.name = sx_intern(name);
+    r.base = base ? sx_intern(base) : 0;
+    r.r.name = sx_intern_cstr(r.name);
+    r.r.base = base ? sx_intern_cstr(r.base) : NULL;
 
     // check for array types []
     const char* bracket = sx_strchar(type, '[');
@@ -225,15 +299,11 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
     }
 
     // check if field is a struct (nested structs)
-    if (ptr_str_end) {
-        sx_strncpy(r.type, sizeof(r.type), type, ptr_str_end + 1);
-    } else {
-        sx_strcpy(r.type, sizeof(r.type), type);
-    }
-    r.r.type = r.type;
+    r.type = ptr_str_end ? sx_strtbl_add(sx_intern_tbl(), type, ptr_str_end + 1) : raw_type_id;
+    r.r.type = sx_intern_cstr(r.type);
 
     for (int i = 0, c = sx_array_count(g_reflect.structs); i < c; i++) {
-        if (sx_strequal(g_reflect.structs[i].type, r.type)) {
+        if (g_reflect.structs[i].type == r.type) {
             r.r.flags |= RIZZ_REFL_FLAG_IS_STRUCT;
             if (r.r.flags & RIZZ_REFL_FLAG_IS_ARRAY) {
                 r.r.array_size = size / g_reflect.structs[i].size;
@@ -244,7 +314,7 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
     }
 
     // determine size of array elements (built-in types)
-    int stride = rizz__refl_type_size(r.type);
+    int stride = rizz__refl_type_size(r.r.type);
     if ((r.r.flags & RIZZ_REFL_FLAG_IS_ARRAY) && !(r.r.flags & RIZZ_REFL_FLAG_IS_STRUCT)) {
         sx_assert(stride > 0 && "invalid built-in type for array");
         r.r.array_size = size / stride;
@@ -254,7 +324,7 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
     if (!stride && !(r.r.flags & RIZZ_REFL_FLAG_IS_STRUCT)) {
         // it's probably an enum
         for (int i = 0, c = sx_array_count(g_reflect.enums); i < c; i++) {
-            if (sx_strequal(g_reflect.enums[i].type, type)) {
+            if (g_reflect.enums[i].type == raw_type_id) {
                 r.r.flags |= RIZZ_REFL_FLAG_IS_ENUM;
                 break;
             }
@@ -267,15 +337,14 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
         // search to see if we already have the base type
         for (int i = 0, c = sx_array_count(g_reflect.structs); i < c; i++) {
             rizz__refl_struct* s = &g_reflect.structs[i];
-            if (sx_strequal(s->type, base)) {
+            if (s->type == r.base) {
                 base_id = i;
                 break;
             }
         }
 
         if (base_id == -1) {
-            rizz__refl_struct _base = (rizz__refl_struct){ .size = base_size };
-            sx_strcpy(_base.type, sizeof(_base.type), base);
+            rizz__refl_struct _base = (rizz__refl_struct){ .type = r.base, .size = base_size };
             sx_array_push(g_reflect.alloc, g_reflect.structs, _base);
             base_id = sx_array_count(g_reflect.structs) - 1;
         }
@@ -285,23 +354,22 @@ static void rizz__refl_reg(rizz_refl_type internal_type, void* any, const char*
     }
 
     //
-    sx_array_push(g_reflect.alloc, g_reflect.regs, r);
+    rizz__refl_push(&r);
 
-    if (g_reflect.max_regs <= 0 &&
-        g_reflect.reg_tbl->count > (g_reflect.reg_tbl->capacity * 2 / 3)) {
-        if (!sx_hashtbl_grow(&g_reflect.reg_tbl, g_reflect.alloc)) {
-            rizz__log_warn("refl: could not grow the hash-table");
-            return;
-        }
+    if (!sx_hashtblmt_add(g_reflect.reg_tbl, sx_hash_fnv32_str(key), id)) {
+        rizz__log_warn("refl: could not grow the hash-table");
     }
-
-    sx_hashtbl_add(g_reflect.reg_tbl, sx_hash_fnv32_str(key), id);
 }
 
 static int rizz__refl_size_of(const char* base_type)
 {
+    sx_istr_t type_id = sx_intern_find(base_type);
+    if (!type_id) {
+        return 0;
+    }
+
     for (int i = 0, c = sx_array_count(g_reflect.structs); i < c; i++) {
-        if (sx_strequal(g_reflect.structs[i].type, base_type))
+        if (g_reflect.structs[i].type == type_id)
             return g_reflect.structs[i].size;
     }
 
@@ -311,10 +379,15 @@ static int rizz__refl_size_of(const char* base_type)
 static int rizz__refl_get_fields(const char* base_type, void* obj, rizz__refl_field* fields,
                                  int max_fields)
 {
+    sx_istr_t base_id = sx_intern_find(base_type);
+    if (!base_id) {
+        return 0;
+    }
+
     int num_fields = 0;
     for (int i = 0, c = sx_array_count(g_reflect.regs); i < c; i++) {
         rizz__refl_data* r = &g_reflect.regs[i];
-        if (r->r.internal_type == RIZZ_REFL_FIELD && sx_strequal(r->base, base_type)) {
+        if (r->r.internal_type == RIZZ_REFL_FIELD && r->base == base_id) {
             sx_assert(r->base_id < sx_array_count(g_reflect.structs));
             sx_assert(g_reflect.structs);
             rizz__refl_struct* s = &g_reflect.structs[r->base_id];
@@ -323,9 +396,9 @@ static int rizz__refl_get_fields(const char* base_type, void* obj, rizz__refl_fi
                 bool value_nil = obj == NULL;
                 void* value = (uint8_t*)obj + r->r.offset;
                 rizz_refl_info rinfo = { .any = r->r.any,
-                                         .type = r->type,
-                                         .name = r->name,
-                                         .base = r->base,
+                                         .type = r->r.type,
+                                         .name = r->r.name,
+                                         .base = r->r.base,
                                          .desc = r->r.desc,
                                          .size = r->r.size,
                                          .array_size = r->r.array_size,
@@ -5,9 +5,11 @@
 #include "internal.h"
 
 #include "sx/array.h"
+#include "sx/handle.h"
 #include "sx/io.h"
 #include "sx/lockless.h"
 #include "sx/os.h"
+#include "sx/pool.h"
 #include "sx/string.h"
 #include "sx/threads.h"
 
@@ -18,17 +20,31 @@
 #endif
 
 typedef enum {
-    VFS_COMMAND_READ,    //
-    VFS_COMMAND_WRITE    //
+    VFS_COMMAND_READ,     //
+    VFS_COMMAND_WRITE,    //
+    VFS_COMMAND_READ_CHUNK
 } rizz__vfs_async_command;
 
 typedef enum {
     VFS_RESPONSE_READ_FAILED,
     VFS_RESPONSE_READ_OK,
     VFS_RESPONSE_WRITE_FAILED,
-    VFS_RESPONSE_WRITE_OK
+    VFS_RESPONSE_WRITE_OK,
+    VFS_RESPONSE_CHUNK_FAILED,
+    VFS_RESPONSE_CHUNK_OK
 } rizz__vfs_response_code;
 
+// chunk reads carry a copy of the stream's file handle, so the worker never touches the streams
+// array, which can be reallocated by the main-thread
+typedef struct {
+    sx_file file;
+    rizz_vfs_stream stream;
+    int chunk_index;
+    int64_t offset;
+    int64_t size;
+    void* buffer;
+} rizz__vfs_chunk_request;
+
 typedef struct {
     rizz__vfs_async_command cmd;
     rizz_vfs_flags flags;
@@ -38,10 +54,17 @@ typedef struct {
     union {
         rizz_vfs_async_read_cb* read_fn;
         rizz_vfs_async_write_cb* write_fn;
+        rizz_vfs_async_stream_cb* stream_fn;
     };
     void* user;
+    rizz__vfs_chunk_request chunk;    // VFS_COMMAND_READ_CHUNK
 } rizz__vfs_async_request;
 
+typedef struct {
+    sx_queue_mpsc_node node;    // must be the first member
+    rizz__vfs_async_request req;
+} rizz__vfs_request_node;
+
 typedef struct {
     rizz__vfs_response_code code;
     union {
@@ -51,10 +74,15 @@ typedef struct {
     union {
         rizz_vfs_async_read_cb* read_fn;
         rizz_vfs_async_write_cb* write_fn;
+        rizz_vfs_async_stream_cb* stream_fn;
     };
     void* user;
     int64_t write_bytes;    // on writes, it's the number of written bytes. on reads, it's -1
+                            // on chunk reads, it's the number of read bytes
     char path[RIZZ_MAX_PATH];
+    rizz_vfs_stream stream;
+    int chunk_index;
+    void* chunk_buffer;
 } rizz__vfs_async_response;
 
 typedef struct {
@@ -66,15 +94,28 @@ typedef struct {
 #endif
 } rizz__vfs_mount_point;
 
+typedef struct {
+    sx_file file;
+    int64_t size;
+    int chunk_size;
+    int num_chunks;
+    int max_inflight;
+    int num_inflight;
+    bool close_requested;    // close is deferred until all in-flight chunks are returned
+} rizz__vfs_stream;
+
 typedef struct {
     const sx_alloc* alloc;
     rizz__vfs_mount_point* mounts;
     rizz_vfs_async_modify_cb** modify_cbs;    // sx_array
     sx_thread* worker_thrd;
-    sx_queue_spsc* req_queue;    // producer: main, consumer: worker, data: rizz__vfs_async_request
+    sx_queue_mpsc req_queue;     // producer: any thread, consumer: worker, data: rizz__vfs_request_node
+    sx_pool_mt* req_pool;        // rizz__vfs_request_node, new: producers, del: worker
     sx_queue_spsc* res_queue;    // producer: worker, consumer: main, data: rizz__vfs_async_response
     sx_sem worker_sem;
     int quit;
+    sx_handle_pool* stream_handles;
+    rizz__vfs_stream* streams;    // sx_array, indexed by stream_handles
 
 #if RIZZ_CONFIG_HOT_LOADING
     sx_queue_spsc* dmon_queue;    // producer: efsw_cb, consumer: main, data: efsw__result
@@ -198,8 +239,19 @@ static sx_mem_block* rizz__vfs_read(const char* path, rizz_vfs_flags flags, cons
     rizz__vfs_resolve_path(resolved_path, sizeof(resolved_path), path, flags);
 #endif
 
-    return !(flags & RIZZ_VFS_FLAG_TEXT_FILE) ? sx_file_load_bin(alloc, resolved_path)
-                                              : sx_file_load_text(alloc, resolved_path);
+    if (flags & RIZZ_VFS_FLAG_TEXT_FILE) {
+        return sx_file_load_text(alloc, resolved_path);
+    }
+
+    // text files need a null-terminator, so they are always loaded
+    // if mapping fails (empty files, or file systems without mmap support), fallback to loading
+    if (flags & RIZZ_VFS_FLAG_MMAP) {
+        sx_mem_block* mem = sx_file_map(alloc, resolved_path);
+        if (mem) {
+            return mem;
+        }
+    }
+    return sx_file_load_bin(alloc, resolved_path);
 }
 
 static int64_t rizz__vfs_write(const char* path, const sx_mem_block* mem, rizz_vfs_flags flags)
@@ -231,8 +283,13 @@ static int rizz__vfs_worker(void* user1, void* user2)
     sx_unused(user1);
     sx_unused(user2);
     while (!g_vfs.quit) {
-        rizz__vfs_async_request req;
-        if (sx_queue_spsc_consume(g_vfs.req_queue, &req)) {
+        // producers post the semaphore after their request is linked, so drain everything that's
+        // visible now. requests that are not linked yet are picked up on the next wake up
+        rizz__vfs_request_node* node;
+        while ((node = (rizz__vfs_request_node*)sx_queue_mpsc_consume(&g_vfs.req_queue)) != NULL) {
+            rizz__vfs_async_request req = node->req;
+            sx_poolmt_del(g_vfs.req_pool, node);
+
             rizz__vfs_async_response res = { .write_bytes = -1 };
             sx_strcpy(res.path, sizeof(res.path), req.path);
             res.user = req.user;
@@ -266,8 +323,30 @@ static int rizz__vfs_worker(void* user1, void* user2)
                 sx_queue_spsc_produce_and_grow(g_vfs.res_queue, &res, g_vfs.alloc);
                 break;
             }
+
+            case VFS_COMMAND_READ_CHUNK: {
+                rizz__vfs_chunk_request* chunk = &req.chunk;
+                res.stream_fn = req.stream_fn;
+                res.stream = chunk->stream;
+                res.chunk_index = chunk->chunk_index;
+                res.chunk_buffer = chunk->buffer;
+
+                int64_t read_bytes = -1;
+                if (sx_file_seek(&chunk->file, chunk->offset, SX_WHENCE_BEGIN) == chunk->offset) {
+                    read_bytes = sx_file_read(&chunk->file, chunk->buffer, chunk->size);
+                }
+
+                if (read_bytes == chunk->size) {
+                    res.code = VFS_RESPONSE_CHUNK_OK;
+                    res.write_bytes = read_bytes;
+                } else {
+                    res.code = VFS_RESPONSE_CHUNK_FAILED;
+                }
+                sx_queue_spsc_produce_and_grow(g_vfs.res_queue, &res, g_vfs.alloc);
+                break;
             }
-        }    // if (queue_consume)
+            }
+        }    // while (queue_consume)
 
         // wait on more jobs
         sx_semaphore_wait(&g_vfs.worker_sem, -1);
@@ -320,9 +399,14 @@ bool rizz__vfs_init(const sx_alloc* alloc)
 {
     g_vfs.alloc = alloc;
 
-    g_vfs.req_queue = sx_queue_spsc_create(alloc, sizeof(rizz__vfs_async_request), 128);
+    sx_queue_mpsc_init(&g_vfs.req_queue);
+    g_vfs.req_pool = sx_poolmt_create(alloc, sizeof(rizz__vfs_request_node), 128, 0);
     g_vfs.res_queue = sx_queue_spsc_create(alloc, sizeof(rizz__vfs_async_response), 128);
-    if (!g_vfs.req_queue || !g_vfs.res_queue)
+    if (!g_vfs.req_pool || !g_vfs.res_queue)
+        return false;
+
+    g_vfs.stream_handles = sx_handle_create_pool(alloc, 32);
+    if (!g_vfs.stream_handles)
         return false;
 
     // create async worker thread and work queue
@@ -361,8 +445,19 @@ void rizz__vfs_release()
         sx_semaphore_release(&g_vfs.worker_sem);
     }
 
-    if (g_vfs.req_queue)
-        sx_queue_spsc_destroy(g_vfs.req_queue, g_vfs.alloc);
+    // worker is stopped, so pending chunks will never return
+    if (g_vfs.stream_handles) {
+        for (int i = 0, c = g_vfs.stream_handles->count; i < c; i++) {
+            sx_handle_t handle = sx_handle_at(g_vfs.stream_handles, i);
+            sx_file_close(&g_vfs.streams[sx_handle_index(handle)].file);
+        }
+        sx_handle_destroy_pool(g_vfs.stream_handles, g_vfs.alloc);
+    }
+    sx_array_free(g_vfs.alloc, g_vfs.streams);
+
+    // requests that are left in the queue are freed with the pool
+    if (g_vfs.req_pool)
+        sx_poolmt_destroy(g_vfs.req_pool, g_vfs.alloc);
     if (g_vfs.res_queue)
         sx_queue_spsc_destroy(g_vfs.res_queue, g_vfs.alloc);
 
@@ -394,6 +489,23 @@ void rizz__vfs_async_update()
         case VFS_RESPONSE_WRITE_FAILED:
             res.write_fn(res.path, res.write_bytes, res.write_mem, res.user);
             break;
+
+        case VFS_RESPONSE_CHUNK_OK:
+        case VFS_RESPONSE_CHUNK_FAILED: {
+            int index = sx_handle_index(res.stream.id);
+            sx_assert(g_vfs.streams[index].num_inflight > 0);
+            --g_vfs.streams[index].num_inflight;
+            res.stream_fn(res.stream, res.chunk_index, res.chunk_buffer, res.write_bytes,
+                          res.user);
+
+            // callback can open new streams and grow the array, so fetch the stream again
+            rizz__vfs_stream* stream = &g_vfs.streams[index];
+            if (stream->close_requested && stream->num_inflight == 0) {
+                sx_file_close(&stream->file);
+                sx_handle_del(g_vfs.stream_handles, res.stream.id);
+            }
+            break;
+        }
         }
     }
 
@@ -410,6 +522,19 @@ void rizz__vfs_async_update()
 #endif // RIZZ_CONFIG_HOT_LOADING
 }
 
+// request queue is unbounded, nodes come from a thread-safe pool and are freed by the worker
+static void rizz__vfs_push_request(const rizz__vfs_async_request* req)
+{
+    rizz__vfs_request_node* node = sx_poolmt_new(g_vfs.req_pool);
+    if (!node) {
+        sx_out_of_memory();
+        return;
+    }
+    node->req = *req;
+    sx_queue_mpsc_produce(&g_vfs.req_queue, &node->node);
+    sx_semaphore_post(&g_vfs.worker_sem, 1);
+}
+
 static void rizz__vfs_read_async(const char* path, rizz_vfs_flags flags, const sx_alloc* alloc,
                                  rizz_vfs_async_read_cb* read_fn, void* user)
 {
@@ -419,8 +544,7 @@ static void rizz__vfs_read_async(const char* path, rizz_vfs_flags flags, const s
                                     .read_fn = read_fn,
                                     .user = user };
     sx_strcpy(req.path, sizeof(req.path), path);
-    sx_queue_spsc_produce_and_grow(g_vfs.req_queue, &req, g_vfs.alloc);
-    sx_semaphore_post(&g_vfs.worker_sem, 1);
+    rizz__vfs_push_request(&req);
 }
 
 static void rizz__vfs_write_async(const char* path, sx_mem_block* mem, rizz_vfs_flags flags,
@@ -432,8 +556,111 @@ static void rizz__vfs_write_async(const char* path, sx_mem_block* mem, rizz_vfs_
                                     .write_fn = write_fn,
                                     .user = user };
     sx_strcpy(req.path, sizeof(req.path), path);
-    sx_queue_spsc_produce_and_grow(g_vfs.req_queue, &req, g_vfs.alloc);
-    sx_semaphore_post(&g_vfs.worker_sem, 1);
+    rizz__vfs_push_request(&req);
+}
+
+static rizz_vfs_stream rizz__vfs_stream_open(const char* path, rizz_vfs_flags flags,
+                                             int chunk_size, int max_inflight)
+{
+    sx_assert(chunk_size > 0);
+    sx_assert(max_inflight > 0);
+
+    char resolved_path[RIZZ_MAX_PATH];
+#if SX_PLATFORM_ANDROID
+    if (sx_strnequal(path, g_vfs.assets_alias, g_vfs.assets_alias_len)) {
+        rizz__log_error("vfs: streaming android assets is not supported: %s", path);
+        return (rizz_vfs_stream){ 0 };
+    }
+    rizz__vfs_resolve_path(resolved_path, sizeof(resolved_path), path, flags);
+#elif SX_PLATFORM_IOS
+    if (sx_strnequal(path, g_vfs.assets_alias, g_vfs.assets_alias_len)) {
+        rizz_ios_resolve_path(g_vfs.assets_bundle, path + g_vfs.assets_alias_len, resolved_path,
+                              sizeof(resolved_path));
+    } else {
+        rizz__vfs_resolve_path(resolved_path, sizeof(resolved_path), path, flags);
+    }
+#else
+    rizz__vfs_resolve_path(resolved_path, sizeof(resolved_path), path, flags);
+#endif
+
+    rizz__vfs_stream _stream = { .chunk_size = chunk_size, .max_inflight = max_inflight };
+    if (!sx_file_open(&_stream.file, resolved_path, SX_FILE_READ)) {
+        return (rizz_vfs_stream){ 0 };
+    }
+    _stream.size = sx_file_size(&_stream.file);
+    _stream.num_chunks = (int)((_stream.size + chunk_size - 1) / chunk_size);
+
+    rizz_vfs_stream handle =
+        (rizz_vfs_stream){ .id = sx_handle_new_and_grow(g_vfs.stream_handles, g_vfs.alloc) };
+    sx_assert(handle.id);
+
+    int index = sx_handle_index(handle.id);
+    if (index >= sx_array_count(g_vfs.streams))
+        sx_array_push(g_vfs.alloc, g_vfs.streams, _stream);
+    else
+        g_vfs.streams[index] = _stream;
+
+    return handle;
+}
+
+static void rizz__vfs_stream_close(rizz_vfs_stream handle)
+{
+    sx_assert(handle.id);
+    sx_assert_rel(sx_handle_valid(g_vfs.stream_handles, handle.id));
+
+    rizz__vfs_stream* stream = &g_vfs.streams[sx_handle_index(handle.id)];
+    sx_assert(!stream->close_requested && "double close?");
+    if (stream->num_inflight > 0) {
+        stream->close_requested = true;
+    } else {
+        sx_file_close(&stream->file);
+        sx_handle_del(g_vfs.stream_handles, handle.id);
+    }
+}
+
+static bool rizz__vfs_stream_read_async(rizz_vfs_stream handle, int chunk_index, void* buffer,
+                                        rizz_vfs_async_stream_cb* stream_fn, void* user)
+{
+    sx_assert(handle.id);
+    sx_assert_rel(sx_handle_valid(g_vfs.stream_handles, handle.id));
+    sx_assert(buffer);
+    sx_assert(stream_fn);
+
+    rizz__vfs_stream* stream = &g_vfs.streams[sx_handle_index(handle.id)];
+    sx_assert(!stream->close_requested);
+    if (chunk_index < 0 || chunk_index >= stream->num_chunks ||
+        stream->num_inflight >= stream->max_inflight) {
+        return false;
+    }
+
+    int64_t offset = (int64_t)chunk_index * stream->chunk_size;
+    int64_t remain = stream->size - offset;
+    rizz__vfs_async_request req = {
+        .cmd = VFS_COMMAND_READ_CHUNK,
+        .stream_fn = stream_fn,
+        .user = user,
+        .chunk = { .file = stream->file,
+                   .stream = handle,
+                   .chunk_index = chunk_index,
+                   .offset = offset,
+                   .size = remain < stream->chunk_size ? remain : stream->chunk_size,
+                   .buffer = buffer }
+    };
+    ++stream->num_inflight;
+    rizz__vfs_push_request(&req);
+    return true;
+}
+
+static int64_t rizz__vfs_stream_size(rizz_vfs_stream handle)
+{
+    sx_assert(handle.id);
+    return g_vfs.streams[sx_handle_index(handle.id)].size;
+}
+
+static int rizz__vfs_stream_num_chunks(rizz_vfs_stream handle)
+{
+    sx_assert(handle.id);
+    return g_vfs.streams[sx_handle_index(handle.id)].num_chunks;
 }
 
 static void rizz__vfs_register_modify(rizz_vfs_async_modify_cb* modify_cb)
@@ -532,4 +759,9 @@ rizz_api_vfs the__vfs = { .register_modify = rizz__vfs_register_modify,
                           .mkdir = rizz__vfs_mkdir,
                           .is_dir = rizz__vfs_is_dir,
                           .is_file = rizz__vfs_is_file,
-                          .last_modified = rizz__vfs_last_modified };
+                          .last_modified = rizz__vfs_last_modified,
+                          .stream_open = rizz__vfs_stream_open,
+                          .stream_close = rizz__vfs_stream_close,
+                          .stream_read_async = rizz__vfs_stream_read_async,
+                          .stream_size = rizz__vfs_stream_size,
+                          .stream_num_chunks = rizz__vfs_stream_num_chunks };
@@ -935,6 +935,30 @@ static int snd__resample_point(float* dst, int num_dst_samples, int sample_offse
     return new_pos != sample_offset ? new_pos : sample_offset + num_dst_samples;
 }
 
+static void snd__mix_stereo(float* dst, const float* src, int num_frames, float vol_left,
+                            float vol_right)
+{
+    for (int s = 0, p = 0; p < num_frames; s += 2, p++) {
+        dst[s] += src[p] * vol_left;
+        dst[s + 1] += src[p] * vol_right;
+    }
+}
+
+static void snd__mix_mono(float* dst, const float* src, int num_frames, float vol)
+{
+    for (int s = 0; s < num_frames; s++) {
+        dst[s] += src[s] * vol;
+    }
+}
+
+// A very naive clipping
+static void snd__clip(float* samples, int num_samples)
+{
+    for (int i = 0; i < num_samples; i++) {
+        samples[i] = sx_clamp(samples[i], -1.0f, 1.0f);
+    }
+}
+
 static void snd__mix(float* dst, int dst_num_frames, int dst_num_channels, int dst_sample_rate)
 {
     float dst_sample_ratef = (float)dst_sample_rate;
@@ -986,20 +1010,14 @@ static void snd__mix(float* dst, int dst_num_frames, int dst_num_channels, int d
         // add to destination buffer. upmix to device_channels if output is stereo
         float vol = inst->volume * src->volume * g_snd.master_volume;
 
-        int dst_num_samples = num_frames * dst_num_channels;
         if (dst_num_channels == 2) {
             float pan = inst->pan;
             float channel1 = master_pan_ch1 * (pan > 0 ? (1.0f - pan) : 1.0f) * vol;    // left
             float channel2 = master_pan_ch2 * (pan < 0 ? (1.0f + pan) : 1.0f) * vol;    // right
 
-            for (int s = 0, p = 0; s < dst_num_samples; s += dst_num_channels, p++) {
-                dst[s] += frames[p] * channel1;
-                dst[s + 1] += frames[p] * channel2;
-            }
+            snd__mix_stereo(dst, frames, num_frames, channel1, channel2);
         } else if (dst_num_channels == 1) {
-            for (int s = 0, p = 0; s < dst_num_samples; s += dst_num_channels, p++) {
-                dst[s] += frames[p] * vol;
-            }
+            snd__mix_mono(dst, frames, num_frames, vol);
         } else {
             sx_assert(0 && "not implemented");
         }
@@ -1008,11 +1026,7 @@ static void snd__mix(float* dst, int dst_num_frames, int dst_num_channels, int d
     }
     the_core->tmp_alloc_pop();
 
-    // A very naive clipping
-    int samples_written = frames_written * dst_num_channels;
-    for (int i = 0; i < samples_written; i++) {
-        dst[i] = sx_clamp(dst[i], -1.0f, 1.0f);
-    }
+    snd__clip(dst, frames_written * dst_num_channels);
 
     // fill remaining frames with zeros
     if (frames_written < dst_num_frames) {
@@ -4,6 +4,9 @@
 //
 #include "sx/hash.h"
 #include "sx/allocator.h"
+#include "sx/os.h"
+#include "sx/simd.h"
+#include "sx/threads.h"
 
 // https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
 static inline SX_CONSTFN int sx__nearest_pow2(int n)
@@ -60,9 +63,70 @@ uint32_t sx_hash_u64_to_u32(uint64_t key)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // XXH
+// On x86, XXH3 long-input loops are compiled for both SSE2 (baseline) and AVX2, and the AVX2 path
+// is selected at runtime (see sx__xxh3_use_avx2). Other platforms use whatever xxhash detects at
+// compile-time (NEON on arm, scalar otherwise)
 #define XXH_PRIVATE_API
+#if SX_CPU_X86 && (SX_COMPILER_GCC || SX_COMPILER_CLANG || SX_COMPILER_MSVC)
+#    define SX__XXH3_DISPATCH 1
+#    define XXH_X86DISPATCH
+#    define XXH_DISPATCH_AVX2 1
+#    include <immintrin.h>
+#    if !SX_COMPILER_MSVC
+#        define XXH_TARGET_SSE2 __attribute__((__target__("sse2")))
+#        define XXH_TARGET_AVX2 __attribute__((__target__("avx2")))
+#    else
+#        define XXH_TARGET_AVX2
+#    endif
+#else
+#    define SX__XXH3_DISPATCH 0
+#endif
 #include "../3rdparty/xxhash/xxhash.h"
 
+#define SX__XXH3_STATE_ALIGN 64    // XXH3_state_t has 64 byte aligned members
+
+#if SX__XXH3_DISPATCH
+static inline bool sx__xxh3_use_avx2(void)
+{
+    return (sx_os_cpu_features() & SX_CPU_FEATURE_AVX2) != 0;
+}
+
+// compilers don't always clear the upper halves of ymm registers when these functions return (gcc
+// leaves them dirty after the inlined xxhash loops), and then every SSE instruction that runs
+// afterwards pays for the AVX-SSE transition, in the whole process. So they clear it explicitly
+XXH_TARGET_AVX2 static XXH64_hash_t sx__xxh3_hashlong64_avx2(const void* XXH_RESTRICT input,
+                                                             size_t len, XXH64_hash_t seed,
+                                                             const xxh_u8* XXH_RESTRICT secret,
+                                                             size_t secret_len)
+{
+    sx_unused(secret);
+    sx_unused(secret_len);
+    XXH64_hash_t h = XXH3_hashLong_64b_withSeed_internal(
+        input, len, seed, XXH3_accumulate_avx2, XXH3_scrambleAcc_avx2, XXH3_initCustomSecret_avx2);
+    _mm256_zeroupper();
+    return h;
+}
+
+XXH_TARGET_AVX2 static XXH128_hash_t sx__xxh3_hashlong128_avx2(const void* XXH_RESTRICT input,
+                                                               size_t len, XXH64_hash_t seed,
+                                                               const void* XXH_RESTRICT secret,
+                                                               size_t secret_len)
+{
+    sx_unused(secret);
+    sx_unused(secret_len);
+    XXH128_hash_t h = XXH3_hashLong_128b_withSeed_internal(
+        input, len, seed, XXH3_accumulate_avx2, XXH3_scrambleAcc_avx2, XXH3_initCustomSecret_avx2);
+    _mm256_zeroupper();
+    return h;
+}
+
+XXH_TARGET_AVX2 static void sx__xxh3_update_avx2(XXH3_state_t* state, const void* data, size_t len)
+{
+    XXH3_update(state, (const xxh_u8*)data, len, XXH3_accumulate_avx2, XXH3_scrambleAcc_avx2);
+    _mm256_zeroupper();
+}
+#endif    // SX__XXH3_DISPATCH
+
 uint32_t sx_hash_xxh32(const void* data, size_t len, uint32_t seed)
 {
     return XXH32(data, len, seed);
@@ -129,6 +193,81 @@ uint64_t sx_hash_xxh64_digest(sx_hash_xxh64_t* state)
     return XXH64_digest(xstate);
 }
 
+uint64_t sx_hash_xxh3_64(const void* data, size_t len, uint64_t seed)
+{
+#if SX__XXH3_DISPATCH
+    if (len > XXH3_MIDSIZE_MAX && sx__xxh3_use_avx2()) {
+        return XXH3_64bits_internal(data, len, seed, XXH3_kSecret, sizeof(XXH3_kSecret),
+                                    sx__xxh3_hashlong64_avx2);
+    }
+#endif
+    return XXH3_64bits_withSeed(data, len, seed);
+}
+
+sx_hash128 sx_hash_xxh3_128(const void* data, size_t len, uint64_t seed)
+{
+    XXH128_hash_t h;
+#if SX__XXH3_DISPATCH
+    if (len > XXH3_MIDSIZE_MAX && sx__xxh3_use_avx2()) {
+        h = XXH3_128bits_internal(data, len, seed, XXH3_kSecret, sizeof(XXH3_kSecret),
+                                  sx__xxh3_hashlong128_avx2);
+    } else
+#endif
+    {
+        h = XXH3_128bits_withSeed(data, len, seed);
+    }
+    return (sx_hash128){ .low = h.low64, .high = h.high64 };
+}
+
+sx_hash_xxh3_t* sx_hash_create_xxh3(const sx_alloc* alloc)
+{
+    XXH3_state_t* xstate =
+        (XXH3_state_t*)sx_aligned_malloc(alloc, sizeof(XXH3_state_t), SX__XXH3_STATE_ALIGN);
+    if (!xstate) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    XXH3_INITSTATE(xstate);
+    return (sx_hash_xxh3_t*)xstate;
+}
+
+void sx_hash_destroy_xxh3(sx_hash_xxh3_t* state, const sx_alloc* alloc)
+{
+    sx_aligned_free(alloc, state, SX__XXH3_STATE_ALIGN);
+}
+
+void sx_hash_xxh3_init(sx_hash_xxh3_t* state, uint64_t seed)
+{
+    // 64bit and 128bit resets are the same, so the state can be digested in both forms
+    XXH3_state_t* xstate = (XXH3_state_t*)state;
+    XXH3_64bits_reset_withSeed(xstate, seed);
+}
+
+void sx_hash_xxh3_update(sx_hash_xxh3_t* state, const void* data, size_t len)
+{
+    XXH3_state_t* xstate = (XXH3_state_t*)state;
+#if SX__XXH3_DISPATCH
+    if (sx__xxh3_use_avx2()) {
+        sx__xxh3_update_avx2(xstate, data, len);
+        return;
+    }
+#endif
+    XXH3_64bits_update(xstate, data, len);
+}
+
+uint64_t sx_hash_xxh3_digest64(sx_hash_xxh3_t* state)
+{
+    XXH3_state_t* xstate = (XXH3_state_t*)state;
+    return XXH3_64bits_digest(xstate);
+}
+
+sx_hash128 sx_hash_xxh3_digest128(sx_hash_xxh3_t* state)
+{
+    XXH3_state_t* xstate = (XXH3_state_t*)state;
+    XXH128_hash_t h = XXH3_128bits_digest(xstate);
+    return (sx_hash128){ .low = h.low64, .high = h.high64 };
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // FNV1a
 // http://www.isthe.com/chongo/src/fnv/hash_32a.c
@@ -260,6 +399,12 @@ static inline uint32_t sx__fib_hash(uint32_t h, int bits)
     return (uint32_t)((h64 * 11400714819323198485llu) >> bits);
 }
 
+static inline uint32_t sx__fib_hash64(uint64_t h, int bits)
+{
+    h ^= (h >> bits);
+    return (uint32_t)((h * 11400714819323198485llu) >> bits);
+}
+
 // https://www.exploringbinary.com/number-of-bits-in-a-decimal-integer/
 static inline int sx__calc_bitshift(int n)
 {
@@ -273,11 +418,183 @@ static inline int sx__calc_bitshift(int n)
     return 64 - c;
 }
 
+// Group probing (Swiss-table style):
+//  The keys array is divided into groups of SX_HASHTBL_GROUP_SIZE slots, the hash selects the
+//  first group and the groups are probed linearly after that. Each probe compares the key against
+//  the whole group at once and produces two bitmasks (bit N = slot N in the group): slots that match
+//  the key and slots that are empty. Probing stops at the first group that contains an empty slot,
+//  because `add` always fills the first free slot in the probe sequence, so a key can never live
+//  beyond a group that has an empty slot. Removed keys are marked with tombstones (see
+//  sx_hashtbl_remove), which keeps the probe chains intact.
+static const uint8_t k__hashtbl_first_bit[16] = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+#if SX_SIMD_NEON
+static inline uint32_t sx__hashtbl_neon_mask(uint32x4_t cmp)
+{
+    const uint32x4_t bits = { 1, 2, 4, 8 };
+    uint32x4_t b = vandq_u32(cmp, bits);
+    uint32x2_t s = vpadd_u32(vget_low_u32(b), vget_high_u32(b));
+    s = vpadd_u32(s, s);
+    return vget_lane_u32(s, 0);
+}
+#endif
+
+static inline uint32_t sx__hashtbl_match(const uint32_t* grp, uint32_t key, uint32_t* empty_mask)
+{
+#if SX_SIMD_SSE
+    __m128i keys = _mm_loadu_si128((const __m128i*)grp);
+    *empty_mask = (uint32_t)_mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(keys, _mm_setzero_si128())));
+    return (uint32_t)_mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(keys, _mm_set1_epi32((int)key))));
+#elif SX_SIMD_NEON
+    uint32x4_t keys = vld1q_u32(grp);
+    *empty_mask = sx__hashtbl_neon_mask(vceqq_u32(keys, vdupq_n_u32(0)));
+    return sx__hashtbl_neon_mask(vceqq_u32(keys, vdupq_n_u32(key)));
+#else
+    *empty_mask = (grp[0] == 0 ? 1u : 0) | (grp[1] == 0 ? 2u : 0) | (grp[2] == 0 ? 4u : 0) |
+                  (grp[3] == 0 ? 8u : 0);
+    return (grp[0] == key ? 1u : 0) | (grp[1] == key ? 2u : 0) | (grp[2] == key ? 4u : 0) |
+           (grp[3] == key ? 8u : 0);
+#endif
+}
+
+static inline uint32_t sx__hashtbl_match64(const uint64_t* grp, uint64_t key, uint32_t* empty_mask)
+{
+#if SX_SIMD_SSE
+    // SSE2 has no 64bit compare, so compare 32bit halves and AND each with its swapped neighbour
+    __m128i lo = _mm_loadu_si128((const __m128i*)grp);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(grp + 2));
+    __m128i k = _mm_set1_epi64x((int64_t)key);
+    __m128i z = _mm_setzero_si128();
+
+    __m128i klo = _mm_cmpeq_epi32(lo, k);
+    __m128i khi = _mm_cmpeq_epi32(hi, k);
+    __m128i zlo = _mm_cmpeq_epi32(lo, z);
+    __m128i zhi = _mm_cmpeq_epi32(hi, z);
+    klo = _mm_and_si128(klo, _mm_shuffle_epi32(klo, _MM_SHUFFLE(2, 3, 0, 1)));
+    khi = _mm_and_si128(khi, _mm_shuffle_epi32(khi, _MM_SHUFFLE(2, 3, 0, 1)));
+    zlo = _mm_and_si128(zlo, _mm_shuffle_epi32(zlo, _MM_SHUFFLE(2, 3, 0, 1)));
+    zhi = _mm_and_si128(zhi, _mm_shuffle_epi32(zhi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    *empty_mask = (uint32_t)(_mm_movemask_pd(_mm_castsi128_pd(zlo)) |
+                             (_mm_movemask_pd(_mm_castsi128_pd(zhi)) << 2));
+    return (uint32_t)(_mm_movemask_pd(_mm_castsi128_pd(klo)) |
+                      (_mm_movemask_pd(_mm_castsi128_pd(khi)) << 2));
+#else
+    *empty_mask = (grp[0] == 0 ? 1u : 0) | (grp[1] == 0 ? 2u : 0) | (grp[2] == 0 ? 4u : 0) |
+                  (grp[3] == 0 ? 8u : 0);
+    return (grp[0] == key ? 1u : 0) | (grp[1] == key ? 2u : 0) | (grp[2] == key ? 4u : 0) |
+           (grp[3] == key ? 8u : 0);
+#endif
+}
+
+// returns the slot index of the key, or -1 if it's not found. `num_probes` receives the number of
+// extra groups that has been visited
+static inline int sx__hashtbl_probe(const uint32_t* keys, int capacity, uint32_t h, uint32_t key,
+                                    int* num_probes)
+{
+    uint32_t gmask = ((uint32_t)capacity / SX_HASHTBL_GROUP_SIZE) - 1;
+    uint32_t g = h / SX_HASHTBL_GROUP_SIZE;
+    for (uint32_t i = 0; i <= gmask; i++) {
+        const uint32_t* grp = keys + g * SX_HASHTBL_GROUP_SIZE;
+        uint32_t empty_mask;
+        uint32_t match_mask = sx__hashtbl_match(grp, key, &empty_mask);
+        if (match_mask) {
+            *num_probes = (int)i;
+            return (int)(g * SX_HASHTBL_GROUP_SIZE + k__hashtbl_first_bit[match_mask]);
+        }
+        if (empty_mask) {
+            *num_probes = (int)i;
+            return -1;
+        }
+        g = (g + 1) & gmask;
+    }
+
+    *num_probes = (int)gmask;
+    return -1;    // table is full and the key is not in it
+}
+
+static inline int sx__hashtbl_probe64(const uint64_t* keys, int capacity, uint32_t h, uint64_t key,
+                                      int* num_probes)
+{
+    uint32_t gmask = ((uint32_t)capacity / SX_HASHTBL_GROUP_SIZE) - 1;
+    uint32_t g = h / SX_HASHTBL_GROUP_SIZE;
+    for (uint32_t i = 0; i <= gmask; i++) {
+        const uint64_t* grp = keys + g * SX_HASHTBL_GROUP_SIZE;
+        uint32_t empty_mask;
+        uint32_t match_mask = sx__hashtbl_match64(grp, key, &empty_mask);
+        if (match_mask) {
+            *num_probes = (int)i;
+            return (int)(g * SX_HASHTBL_GROUP_SIZE + k__hashtbl_first_bit[match_mask]);
+        }
+        if (empty_mask) {
+            *num_probes = (int)i;
+            return -1;
+        }
+        g = (g + 1) & gmask;
+    }
+
+    *num_probes = (int)gmask;
+    return -1;
+}
+
+// returns the first free slot (empty or tombstone) in the probe sequence of the hash
+static inline int sx__hashtbl_free_slot(const uint32_t* keys, int capacity, uint32_t h)
+{
+    uint32_t gmask = ((uint32_t)capacity / SX_HASHTBL_GROUP_SIZE) - 1;
+    uint32_t g = h / SX_HASHTBL_GROUP_SIZE;
+    for (uint32_t i = 0; i <= gmask; i++) {
+        const uint32_t* grp = keys + g * SX_HASHTBL_GROUP_SIZE;
+        uint32_t empty_mask;
+        uint32_t free_mask = sx__hashtbl_match(grp, SX_HASHTBL_TOMBSTONE, &empty_mask) | empty_mask;
+        if (free_mask) {
+            return (int)(g * SX_HASHTBL_GROUP_SIZE + k__hashtbl_first_bit[free_mask]);
+        }
+        g = (g + 1) & gmask;
+    }
+
+    sx_assert(0 && "hash-table is full");
+    return -1;
+}
+
+static inline int sx__hashtbl_free_slot64(const uint64_t* keys, int capacity, uint32_t h)
+{
+    uint32_t gmask = ((uint32_t)capacity / SX_HASHTBL_GROUP_SIZE) - 1;
+    uint32_t g = h / SX_HASHTBL_GROUP_SIZE;
+    for (uint32_t i = 0; i <= gmask; i++) {
+        const uint64_t* grp = keys + g * SX_HASHTBL_GROUP_SIZE;
+        uint32_t empty_mask;
+        uint32_t free_mask = sx__hashtbl_match64(grp, SX_HASHTBL64_TOMBSTONE, &empty_mask) | empty_mask;
+        if (free_mask) {
+            return (int)(g * SX_HASHTBL_GROUP_SIZE + k__hashtbl_first_bit[free_mask]);
+        }
+        g = (g + 1) & gmask;
+    }
+
+    sx_assert(0 && "hash-table is full");
+    return -1;
+}
+
+static inline int sx__hashtbl_valid_capacity(int capacity)
+{
+    capacity = sx__nearest_pow2(capacity);
+    return capacity > SX_HASHTBL_GROUP_SIZE ? capacity : SX_HASHTBL_GROUP_SIZE;
+}
+
+// capacity of the table that replaces a table that needs to grow: if the live keys take no more
+// than half of the max load, the load comes from tombstones, so rehash at the same capacity.
+// the rehash clears at least half of the max load worth of tombstones, which keeps it amortized
+static inline int sx__hashtbl_grow_capacity(int count, int capacity)
+{
+    return (count + 1) * 200 <= capacity * SX_CONFIG_HASHTBL_MAX_LOAD ? capacity : (capacity << 1);
+}
+
 sx_hashtbl* sx_hashtbl_create(const sx_alloc* alloc, int capacity)
 {
     sx_assert(capacity > 0);
 
-    capacity = sx__nearest_pow2(capacity);
+    capacity = sx__hashtbl_valid_capacity(capacity);
     sx_hashtbl* tbl = (sx_hashtbl*)sx_malloc(
         alloc, sizeof(sx_hashtbl) + capacity * (sizeof(uint32_t) + sizeof(int)) +
                    SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT);
@@ -291,6 +608,7 @@ sx_hashtbl* sx_hashtbl_create(const sx_alloc* alloc, int capacity)
     tbl->_bitshift = sx__calc_bitshift(capacity);
     tbl->count = 0;
     tbl->capacity = capacity;
+    tbl->_num_tombstones = 0;
 #if SX_CONFIG_HASHTBL_DEBUG
     tbl->_miss_cnt = 0;
     tbl->_probe_cnt = 0;
@@ -312,14 +630,17 @@ void sx_hashtbl_destroy(sx_hashtbl* tbl, const sx_alloc* alloc)
 bool sx_hashtbl_grow(sx_hashtbl** ptbl, const sx_alloc* alloc)
 {
     sx_hashtbl* tbl = *ptbl;
-    // Create a new table (double the size), repopulate it and replace previous one
-    sx_hashtbl* new_tbl = sx_hashtbl_create(alloc, tbl->capacity << 1);
+    // Create a new table (double the size, or same size if it's mostly tombstones), repopulate it
+    // and replace previous one
+    sx_hashtbl* new_tbl =
+        sx_hashtbl_create(alloc, sx__hashtbl_grow_capacity(tbl->count, tbl->capacity));
     if (!new_tbl)
         return false;
 
     for (int i = 0, c = tbl->capacity; i < c; i++) {
-        if (tbl->keys[i] > 0)
-            sx_hashtbl_add(new_tbl, tbl->keys[i], tbl->values[i]);
+        uint32_t key = tbl->keys[i];
+        if (key != 0 && key != SX_HASHTBL_TOMBSTONE)
+            sx_hashtbl_add(new_tbl, key, tbl->values[i]);
     }
 
     sx_hashtbl_destroy(tbl, alloc);
@@ -329,7 +650,7 @@ bool sx_hashtbl_grow(sx_hashtbl** ptbl, const sx_alloc* alloc)
 
 void sx_hashtbl_init(sx_hashtbl* tbl, int capacity, uint32_t* keys_ptr, int* values_ptr)
 {
-    sx_assert(sx__ispow2(capacity) &&
+    sx_assert(sx__ispow2(capacity) && capacity >= SX_HASHTBL_GROUP_SIZE &&
               "Table size must be power of 2, get it from sx_hashtbl_valid_capacity");
 
     sx_memset(keys_ptr, 0x0, capacity * sizeof(uint32_t));
@@ -340,6 +661,7 @@ void sx_hashtbl_init(sx_hashtbl* tbl, int capacity, uint32_t* keys_ptr, int* val
     tbl->_bitshift = sx__calc_bitshift(capacity);
     tbl->capacity = capacity;
     tbl->count = 0;
+    tbl->_num_tombstones = 0;
 #if SX_CONFIG_HASHTBL_DEBUG
     tbl->_miss_cnt = 0;
     tbl->_probe_cnt = 0;
@@ -354,55 +676,187 @@ int sx_hashtbl_fixed_size(int capacity)
 
 int sx_hashtbl_valid_capacity(int capacity)
 {
-    return sx__nearest_pow2(capacity);
+    return sx__hashtbl_valid_capacity(capacity);
 }
 
 int sx_hashtbl_add(sx_hashtbl* tbl, uint32_t key, int value)
 {
     sx_assert(tbl->count < tbl->capacity);
+    sx_assert(key != 0 && key != SX_HASHTBL_TOMBSTONE && "reserved key value");
 
-    uint32_t h = sx__fib_hash(key, tbl->_bitshift);
-    uint32_t cnt = (uint32_t)tbl->capacity;
-    while (tbl->keys[h] != 0) {
-        h = (h + 1) % cnt;
+    int index =
+        sx__hashtbl_free_slot(tbl->keys, tbl->capacity, sx__fib_hash(key, tbl->_bitshift));
+    if (tbl->keys[index] == SX_HASHTBL_TOMBSTONE) {
+        --tbl->_num_tombstones;
     }
 
-    sx_assert(tbl->keys[h] == 0);    // something went wrong!
-    tbl->keys[h] = key;
-    tbl->values[h] = value;
+    tbl->keys[index] = key;
+    tbl->values[index] = value;
     ++tbl->count;
-    return h;
+    return index;
 }
 
 int sx_hashtbl_find(const sx_hashtbl* tbl, uint32_t key)
 {
-    uint32_t h = sx__fib_hash(key, tbl->_bitshift);
-    uint32_t cnt = (uint32_t)tbl->capacity;
-    if (tbl->keys[h] == key) {
-        return h;
-    } else {
+    if (key == 0 || key == SX_HASHTBL_TOMBSTONE) {
+        return -1;
+    }
+
+    int num_probes;
+    int index = sx__hashtbl_probe(tbl->keys, tbl->capacity, sx__fib_hash(key, tbl->_bitshift), key,
+                                  &num_probes);
 #if SX_CONFIG_HASHTBL_DEBUG
+    if (num_probes > 0) {
         sx_hashtbl* _tbl = (sx_hashtbl*)tbl;
         ++_tbl->_miss_cnt;
+        _tbl->_probe_cnt += num_probes;
+    }
+#else
+    sx_unused(num_probes);
 #endif
-        // probe lineary in the keys array
-        for (uint32_t i = 1; i < cnt; i++) {
-            int idx = (h + i) % cnt;
+    return index;
+}
+
+void sx_hashtbl_clear(sx_hashtbl* tbl)
+{
+    sx_memset(tbl->keys, 0x0, sizeof(uint32_t) * tbl->capacity);
+    tbl->count = 0;
+    tbl->_num_tombstones = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+sx_hashtbl64* sx_hashtbl64_create(const sx_alloc* alloc, int capacity)
+{
+    sx_assert(capacity > 0);
+
+    capacity = sx__hashtbl_valid_capacity(capacity);
+    sx_hashtbl64* tbl = (sx_hashtbl64*)sx_malloc(
+        alloc, sizeof(sx_hashtbl64) + capacity * (sizeof(uint64_t) + sizeof(int)) +
+                   SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT);
+    if (!tbl) {
+        sx_out_of_memory();
+        return NULL;
+    }
+
+    tbl->keys = (uint64_t*)sx_align_ptr(tbl + 1, 0, SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT);
+    tbl->values = (int*)(tbl->keys + capacity);
+    tbl->_bitshift = sx__calc_bitshift(capacity);
+    tbl->count = 0;
+    tbl->capacity = capacity;
+    tbl->_num_tombstones = 0;
 #if SX_CONFIG_HASHTBL_DEBUG
-            ++_tbl->_probe_cnt;
+    tbl->_miss_cnt = 0;
+    tbl->_probe_cnt = 0;
 #endif
-            if (tbl->keys[idx] == key)
-                return idx;
-        }
 
-        return -1;    // Worst case: Not found!
+    // Reset keys
+    sx_memset(tbl->keys, 0x0, sizeof(uint64_t) * capacity);
+
+    return tbl;
+}
+
+void sx_hashtbl64_destroy(sx_hashtbl64* tbl, const sx_alloc* alloc)
+{
+    sx_assert(tbl);
+    tbl->count = tbl->capacity = 0;
+    sx_free(alloc, tbl);
+}
+
+bool sx_hashtbl64_grow(sx_hashtbl64** ptbl, const sx_alloc* alloc)
+{
+    sx_hashtbl64* tbl = *ptbl;
+    // Create a new table (double the size, or same size if it's mostly tombstones), repopulate it
+    // and replace previous one
+    sx_hashtbl64* new_tbl =
+        sx_hashtbl64_create(alloc, sx__hashtbl_grow_capacity(tbl->count, tbl->capacity));
+    if (!new_tbl)
+        return false;
+
+    for (int i = 0, c = tbl->capacity; i < c; i++) {
+        uint64_t key = tbl->keys[i];
+        if (key != 0 && key != SX_HASHTBL64_TOMBSTONE)
+            sx_hashtbl64_add(new_tbl, key, tbl->values[i]);
     }
+
+    sx_hashtbl64_destroy(tbl, alloc);
+    *ptbl = new_tbl;
+    return true;
 }
 
-void sx_hashtbl_clear(sx_hashtbl* tbl)
+void sx_hashtbl64_init(sx_hashtbl64* tbl, int capacity, uint64_t* keys_ptr, int* values_ptr)
 {
-    sx_memset(tbl->keys, 0x0, sizeof(uint32_t) * tbl->capacity);
+    sx_assert(sx__ispow2(capacity) && capacity >= SX_HASHTBL_GROUP_SIZE &&
+              "Table size must be power of 2, get it from sx_hashtbl64_valid_capacity");
+
+    sx_memset(keys_ptr, 0x0, capacity * sizeof(uint64_t));
+    sx_memset(values_ptr, 0x0, capacity * sizeof(int));
+
+    tbl->keys = keys_ptr;
+    tbl->values = values_ptr;
+    tbl->_bitshift = sx__calc_bitshift(capacity);
+    tbl->capacity = capacity;
+    tbl->count = 0;
+    tbl->_num_tombstones = 0;
+#if SX_CONFIG_HASHTBL_DEBUG
+    tbl->_miss_cnt = 0;
+    tbl->_probe_cnt = 0;
+#endif
+}
+
+int sx_hashtbl64_fixed_size(int capacity)
+{
+    int cap = sx_hashtbl64_valid_capacity(capacity);
+    return cap * (sizeof(uint64_t) + sizeof(int));
+}
+
+int sx_hashtbl64_valid_capacity(int capacity)
+{
+    return sx__hashtbl_valid_capacity(capacity);
+}
+
+int sx_hashtbl64_add(sx_hashtbl64* tbl, uint64_t key, int value)
+{
+    sx_assert(tbl->count < tbl->capacity);
+    sx_assert(key != 0 && key != SX_HASHTBL64_TOMBSTONE && "reserved key value");
+
+    int index =
+        sx__hashtbl_free_slot64(tbl->keys, tbl->capacity, sx__fib_hash64(key, tbl->_bitshift));
+    if (tbl->keys[index] == SX_HASHTBL64_TOMBSTONE) {
+        --tbl->_num_tombstones;
+    }
+
+    tbl->keys[index] = key;
+    tbl->values[index] = value;
+    ++tbl->count;
+    return index;
+}
+
+int sx_hashtbl64_find(const sx_hashtbl64* tbl, uint64_t key)
+{
+    if (key == 0 || key == SX_HASHTBL64_TOMBSTONE) {
+        return -1;
+    }
+
+    int num_probes;
+    int index = sx__hashtbl_probe64(tbl->keys, tbl->capacity, sx__fib_hash64(key, tbl->_bitshift),
+                                    key, &num_probes);
+#if SX_CONFIG_HASHTBL_DEBUG
+    if (num_probes > 0) {
+        sx_hashtbl64* _tbl = (sx_hashtbl64*)tbl;
+        ++_tbl->_miss_cnt;
+        _tbl->_probe_cnt += num_probes;
+    }
+#else
+    sx_unused(num_probes);
+#endif
+    return index;
+}
+
+void sx_hashtbl64_clear(sx_hashtbl64* tbl)
+{
+    sx_memset(tbl->keys, 0x0, sizeof(uint64_t) * tbl->capacity);
     tbl->count = 0;
+    tbl->_num_tombstones = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -410,7 +864,7 @@ sx_hashtbl_tval* sx_hashtbltval_create(const sx_alloc* alloc, int capacity, int
 {
     sx_assert(capacity > 0);
 
-    capacity = sx__nearest_pow2(capacity);
+    capacity = sx__hashtbl_valid_capacity(capacity);
     sx_hashtbl_tval* tbl = (sx_hashtbl_tval*)sx_malloc(
         alloc, sizeof(sx_hashtbl_tval) + capacity * (sizeof(uint32_t) + value_stride) +
                    SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT);
@@ -425,6 +879,7 @@ sx_hashtbl_tval* sx_hashtbltval_create(const sx_alloc* alloc, int capacity, int
     tbl->value_stride = value_stride;
     tbl->count = 0;
     tbl->capacity = capacity;
+    tbl->_num_tombstones = 0;
 #if SX_CONFIG_HASHTBL_DEBUG
     tbl->_miss_cnt = 0;
     tbl->_probe_cnt = 0;
@@ -446,15 +901,18 @@ void sx_hashtbltval_destroy(sx_hashtbl_tval* tbl, const sx_alloc* alloc)
 bool sx_hashtbltval_grow(sx_hashtbl_tval** ptbl, const sx_alloc* alloc)
 {
     sx_hashtbl_tval* tbl = *ptbl;
-    // Create a new table (double the size), repopulate it and replace previous one
-    sx_hashtbl_tval* new_tbl = sx_hashtbltval_create(alloc, tbl->capacity << 1, tbl->value_stride);
+    // Create a new table (double the size, or same size if it's mostly tombstones), repopulate it
+    // and replace previous one
+    sx_hashtbl_tval* new_tbl = sx_hashtbltval_create(
+        alloc, sx__hashtbl_grow_capacity(tbl->count, tbl->capacity), tbl->value_stride);
     if (!new_tbl) {
         return false;
     }
 
     for (int i = 0, c = tbl->capacity; i < c; i++) {
-        if (tbl->keys[i] > 0) {
-            sx_hashtbltval_add(new_tbl, tbl->keys[i], tbl->values + i*tbl->value_stride);
+        uint32_t key = tbl->keys[i];
+        if (key != 0 && key != SX_HASHTBL_TOMBSTONE) {
+            sx_hashtbltval_add(new_tbl, key, tbl->values + i*tbl->value_stride);
         }
     }
 
@@ -465,7 +923,7 @@ bool sx_hashtbltval_grow(sx_hashtbl_tval** ptbl, const sx_alloc* alloc)
 
 void sx_hashtbltval_init(sx_hashtbl_tval* tbl, int capacity, int value_stride, uint32_t* keys_ptr, void* values_ptr)
 {
-    sx_assert(sx__ispow2(capacity) &&
+    sx_assert(sx__ispow2(capacity) && capacity >= SX_HASHTBL_GROUP_SIZE &&
               "Table size must be power of 2, get it from sx_hashtbltval_valid_capacity");
 
     sx_memset(keys_ptr, 0x0, capacity * sizeof(uint32_t));
@@ -477,6 +935,7 @@ void sx_hashtbltval_init(sx_hashtbl_tval* tbl, int capacity, int value_stride, u
     tbl->value_stride = value_stride;
     tbl->capacity = capacity;
     tbl->count = 0;
+    tbl->_num_tombstones = 0;
 #if SX_CONFIG_HASHTBL_DEBUG
     tbl->_miss_cnt = 0;
     tbl->_probe_cnt = 0;
@@ -491,53 +950,335 @@ int sx_hashtbltval_fixed_size(int capacity, int value_stride)
 
 int sx_hashtbltval_valid_capacity(int capacity)
 {
-    return sx__nearest_pow2(capacity);
+    return sx__hashtbl_valid_capacity(capacity);
 }
 
 int sx_hashtbltval_add(sx_hashtbl_tval* tbl, uint32_t key, const void* value)
 {
     sx_assert(tbl->count < tbl->capacity);
+    sx_assert(key != 0 && key != SX_HASHTBL_TOMBSTONE && "reserved key value");
 
-    uint32_t h = sx__fib_hash(key, tbl->_bitshift);
-    uint32_t cnt = (uint32_t)tbl->capacity;
-    while (tbl->keys[h] != 0) {
-        h = (h + 1) % cnt;
+    int index =
+        sx__hashtbl_free_slot(tbl->keys, tbl->capacity, sx__fib_hash(key, tbl->_bitshift));
+    if (tbl->keys[index] == SX_HASHTBL_TOMBSTONE) {
+        --tbl->_num_tombstones;
     }
 
-    sx_assert(tbl->keys[h] == 0);    // something went wrong!
-    tbl->keys[h] = key;
-    sx_memcpy(tbl->values + tbl->value_stride*h, value, tbl->value_stride);
+    tbl->keys[index] = key;
+    sx_memcpy(tbl->values + tbl->value_stride*index, value, tbl->value_stride);
     ++tbl->count;
-    return h;
+    return index;
 }
 
 int sx_hashtbltval_find(const sx_hashtbl_tval* tbl, uint32_t key)
 {
-    uint32_t h = sx__fib_hash(key, tbl->_bitshift);
-    uint32_t cnt = (uint32_t)tbl->capacity;
-    if (tbl->keys[h] == key) {
-        return h;
-    } else {
+    if (key == 0 || key == SX_HASHTBL_TOMBSTONE) {
+        return -1;
+    }
+
+    int num_probes;
+    int index = sx__hashtbl_probe(tbl->keys, tbl->capacity, sx__fib_hash(key, tbl->_bitshift), key,
+                                  &num_probes);
 #if SX_CONFIG_HASHTBL_DEBUG
+    if (num_probes > 0) {
         sx_hashtbl_tval* _tbl = (sx_hashtbl_tval*)tbl;
         ++_tbl->_miss_cnt;
+        _tbl->_probe_cnt += num_probes;
+    }
+#else
+    sx_unused(num_probes);
 #endif
-        // probe lineary in the keys array
-        for (uint32_t i = 1; i < cnt; i++) {
-            int idx = (h + i) % cnt;
-#if SX_CONFIG_HASHTBL_DEBUG
-            ++_tbl->_probe_cnt;
+    return index;
+}
+
+void sx_hashtbltval_clear(sx_hashtbl_tval* tbl)
+{
+    sx_memset(tbl->keys, 0x0, sizeof(uint32_t) * tbl->capacity);
+    tbl->count = 0;
+    tbl->_num_tombstones = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Thread-safe hash table
+//  Each shard has a sequence counter that writers increment before and after modifying it (odd
+//  means a write is in progress). Readers snapshot the counter, probe the table and retry if the
+//  counter has changed. Retired tables (from growing) are kept around, because a reader may still
+//  be probing them. Tables that are full of tombstones are rebuilt in place instead (see
+//  sx__hashtbl_grow_capacity), so only a bigger capacity retires a table.
+//  sx_hashtblmt_collect stamps the retired tables with the caller's epoch the first time it sees
+//  them, and frees them on a later call, once the caller says that epoch is safe
+#define SX__HASHTBL_MT_MAX_SHARDS 64
+#define SX__HASHTBL_MT_MAX_RETIRED 32    // capacity doubles on every retire, so 32 fits any int
+
+// loads are not reordered with other loads on x86, so the readers only need to stop the compiler
+#if SX_CPU_X86
+#    define sx__hashtbl_read_barrier() sx_compiler_read_barrier()
+#else
+#    define sx__hashtbl_read_barrier() sx_memory_read_barrier()
 #endif
-            if (tbl->keys[idx] == key)
-                return idx;
+
+typedef struct sx__hashtbl_shard {
+    sx_lock_t lock;    // writers
+    sx_atomic_int seq;
+    sx_hashtbl* volatile tbl;
+    int num_retired;
+    sx_hashtbl* retired[SX__HASHTBL_MT_MAX_RETIRED];
+    uint64_t retired_epoch[SX__HASHTBL_MT_MAX_RETIRED];    // 0: not seen by collect yet
+} sx__hashtbl_shard;    // aligned to 64 (sx_lock_t), so shards don't share cache-lines
+
+typedef struct sx_hashtbl_mt {
+    const sx_alloc* alloc;
+    sx__hashtbl_shard* shards;
+    uint32_t shard_mask;
+} sx_hashtbl_mt;
+
+static inline sx__hashtbl_shard* sx__hashtblmt_shard(const sx_hashtbl_mt* tbl, uint32_t key)
+{
+    // fib hashing of the shard tables uses the high bits, so use the low bits of a different hash
+    return &tbl->shards[sx_hash_u32(key) & tbl->shard_mask];
+}
+
+static inline void sx__hashtblmt_write_begin(sx__hashtbl_shard* shard)
+{
+    sx_lock(&shard->lock);
+    sx_atomic_incr(&shard->seq);    // full barrier: odd counter is visible before any change
+}
+
+static inline void sx__hashtblmt_write_end(sx__hashtbl_shard* shard)
+{
+    sx_atomic_incr(&shard->seq);    // full barrier: all changes are visible before the even counter
+    sx_unlock(&shard->lock);
+}
+
+sx_hashtbl_mt* sx_hashtblmt_create(const sx_alloc* alloc, int capacity, int num_shards)
+{
+    sx_assert(capacity > 0);
+    sx_assert(num_shards > 0);
+
+    num_shards = sx__nearest_pow2(num_shards);
+    num_shards = num_shards < SX__HASHTBL_MT_MAX_SHARDS ? num_shards : SX__HASHTBL_MT_MAX_SHARDS;
+
+    sx_hashtbl_mt* tbl = (sx_hashtbl_mt*)sx_malloc(alloc, sizeof(sx_hashtbl_mt));
+    if (!tbl) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    tbl->alloc = alloc;
+    tbl->shard_mask = (uint32_t)num_shards - 1;
+    tbl->shards = (sx__hashtbl_shard*)sx_aligned_malloc(
+        alloc, sizeof(sx__hashtbl_shard) * num_shards, 64);
+    if (!tbl->shards) {
+        sx_free(alloc, tbl);
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(tbl->shards, 0x0, sizeof(sx__hashtbl_shard) * num_shards);
+
+    int shard_capacity = (capacity + num_shards - 1) / num_shards;
+    for (int i = 0; i < num_shards; i++) {
+        tbl->shards[i].tbl = sx_hashtbl_create(alloc, shard_capacity);
+        if (!tbl->shards[i].tbl) {
+            sx_hashtblmt_destroy(tbl, alloc);
+            return NULL;
         }
+    }
+
+    return tbl;
+}
 
-        return -1;    // Worst case: Not found!
+void sx_hashtblmt_collect(sx_hashtbl_mt* tbl, uint64_t epoch, uint64_t safe_epoch)
+{
+    sx_assert(tbl);
+    sx_assert(epoch > 0);
+    for (uint32_t i = 0; i <= tbl->shard_mask; i++) {
+        sx__hashtbl_shard* shard = &tbl->shards[i];
+        sx_lock(&shard->lock);
+        int num_retired = 0;
+        for (int k = 0; k < shard->num_retired; k++) {
+            uint64_t retired_epoch = shard->retired_epoch[k] ? shard->retired_epoch[k] : epoch;
+            if (retired_epoch <= safe_epoch) {
+                sx_hashtbl_destroy(shard->retired[k], tbl->alloc);
+            } else {
+                // keep the order, so older tables are always freed first
+                shard->retired[num_retired] = shard->retired[k];
+                shard->retired_epoch[num_retired++] = retired_epoch;
+            }
+        }
+        shard->num_retired = num_retired;
+        sx_unlock(&shard->lock);
     }
 }
 
-void sx_hashtbltval_clear(sx_hashtbl_tval* tbl)
+void sx_hashtblmt_destroy(sx_hashtbl_mt* tbl, const sx_alloc* alloc)
 {
-    sx_memset(tbl->keys, 0x0, sizeof(uint32_t) * tbl->capacity);
-    tbl->count = 0;
+    sx_assert(tbl);
+    sx_assert(tbl->alloc == alloc);
+
+    sx_hashtblmt_collect(tbl, UINT64_MAX, UINT64_MAX);
+    for (uint32_t i = 0; i <= tbl->shard_mask; i++) {
+        if (tbl->shards[i].tbl) {
+            sx_hashtbl_destroy(tbl->shards[i].tbl, alloc);
+        }
+    }
+    sx_aligned_free(alloc, tbl->shards, 64);
+    sx_free(alloc, tbl);
+}
+
+// rebuilds the table at the same capacity, without the tombstones. the keys and values arrays
+// don't move, and readers retry because the shard's counter is odd during the whole rebuild
+static bool sx__hashtblmt_rehash(sx_hashtbl* t, const sx_alloc* alloc)
+{
+    int count = t->count;
+    uint32_t* keys = NULL;
+    int* values = NULL;
+    if (count > 0) {
+        keys = (uint32_t*)sx_malloc(alloc, (sizeof(uint32_t) + sizeof(int)) * (size_t)count);
+        if (!keys) {
+            sx_out_of_memory();
+            return false;
+        }
+        values = (int*)(keys + count);
+
+        for (int i = 0, c = t->capacity, n = 0; i < c; i++) {
+            uint32_t k = t->keys[i];
+            if (k != 0 && k != SX_HASHTBL_TOMBSTONE) {
+                keys[n] = k;
+                values[n++] = t->values[i];
+            }
+        }
+    }
+
+    sx_hashtbl_clear(t);
+    for (int i = 0; i < count; i++) {
+        sx_hashtbl_add(t, keys[i], values[i]);
+    }
+
+    sx_free(alloc, keys);
+    return true;
+}
+
+bool sx_hashtblmt_add(sx_hashtbl_mt* tbl, uint32_t key, int value)
+{
+    sx_assert(key != 0 && key != SX_HASHTBL_TOMBSTONE && "reserved key value");
+
+    sx__hashtbl_shard* shard = sx__hashtblmt_shard(tbl, key);
+    sx__hashtblmt_write_begin(shard);
+
+    sx_hashtbl* t = shard->tbl;
+    int num_probes;
+    int index = sx__hashtbl_probe(t->keys, t->capacity, sx__fib_hash(key, t->_bitshift), key,
+                                  &num_probes);
+    if (index != -1) {
+        t->values[index] = value;
+        sx__hashtblmt_write_end(shard);
+        return true;
+    }
+
+    if (sx_hashtbl_needs_grow(t)) {
+        int capacity = sx__hashtbl_grow_capacity(t->count, t->capacity);
+        if (capacity == t->capacity) {
+            bool r = sx__hashtblmt_rehash(t, tbl->alloc);
+            if (r) {
+                sx_hashtbl_add(t, key, value);
+            }
+            sx__hashtblmt_write_end(shard);
+            return r;
+        }
+
+        sx_hashtbl* new_tbl = shard->num_retired < SX__HASHTBL_MT_MAX_RETIRED
+                                  ? sx_hashtbl_create(tbl->alloc, capacity)
+                                  : NULL;
+        if (!new_tbl) {
+            sx__hashtblmt_write_end(shard);
+            return false;
+        }
+
+        for (int i = 0, c = t->capacity; i < c; i++) {
+            uint32_t k = t->keys[i];
+            if (k != 0 && k != SX_HASHTBL_TOMBSTONE) {
+                sx_hashtbl_add(new_tbl, k, t->values[i]);
+            }
+        }
+
+        shard->retired_epoch[shard->num_retired] = 0;
+        shard->retired[shard->num_retired++] = t;
+        shard->tbl = t = new_tbl;
+    }
+
+    sx_hashtbl_add(t, key, value);
+    sx__hashtblmt_write_end(shard);
+    return true;
+}
+
+bool sx_hashtblmt_remove(sx_hashtbl_mt* tbl, uint32_t key)
+{
+    if (key == 0 || key == SX_HASHTBL_TOMBSTONE) {
+        return false;
+    }
+
+    sx__hashtbl_shard* shard = sx__hashtblmt_shard(tbl, key);
+    sx__hashtblmt_write_begin(shard);
+
+    sx_hashtbl* t = shard->tbl;
+    int num_probes;
+    int index = sx__hashtbl_probe(t->keys, t->capacity, sx__fib_hash(key, t->_bitshift), key,
+                                  &num_probes);
+    if (index != -1) {
+        sx_hashtbl_remove(t, index);
+    }
+
+    sx__hashtblmt_write_end(shard);
+    return index != -1;
+}
+
+int sx_hashtblmt_find_get(const sx_hashtbl_mt* tbl, uint32_t key, int not_found_val)
+{
+    if (key == 0 || key == SX_HASHTBL_TOMBSTONE) {
+        return not_found_val;
+    }
+
+    sx__hashtbl_shard* shard = sx__hashtblmt_shard(tbl, key);
+    int seq, value;
+    for (;;) {
+        seq = shard->seq;
+        if (seq & 1) {
+            sx_yield_cpu();
+            continue;
+        }
+        sx__hashtbl_read_barrier();
+
+        // the table object itself never changes after it's published (only it's keys/values),
+        // so capacity and pointers are always consistent, even if the data is being modified
+        const sx_hashtbl* t = shard->tbl;
+        int num_probes;
+        int index = sx__hashtbl_probe(t->keys, t->capacity, sx__fib_hash(key, t->_bitshift), key,
+                                      &num_probes);
+        value = index != -1 ? t->values[index] : not_found_val;
+
+        sx__hashtbl_read_barrier();
+        if (shard->seq == seq) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+int sx_hashtblmt_count(const sx_hashtbl_mt* tbl)
+{
+    int count = 0;
+    for (uint32_t i = 0; i <= tbl->shard_mask; i++) {
+        count += tbl->shards[i].tbl->count;
+    }
+    return count;
+}
+
+void sx_hashtblmt_clear(sx_hashtbl_mt* tbl)
+{
+    for (uint32_t i = 0; i <= tbl->shard_mask; i++) {
+        sx__hashtbl_shard* shard = &tbl->shards[i];
+        sx__hashtblmt_write_begin(shard);
+        sx_hashtbl_clear(shard->tbl);
+        sx__hashtblmt_write_end(shard);
+    }
 }
\ No newline at end of file
@@ -19,6 +19,7 @@
 #    include <sys/stat.h>
 #    include <sys/types.h>
 #    include <fcntl.h>
+#    include <sys/mman.h>
 #    include <unistd.h>
 #    undef _LARGEFILE64_SOURCE
 #    ifndef __O_LARGEFILE
@@ -28,6 +29,8 @@
 
 #define SIFF_SIGN sx_makefourcc('S', 'I', 'F', 'F')
 
+static void sx__file_unmap(void* data, int64_t size);
+
 sx_mem_block* sx_mem_create_block(const sx_alloc* alloc, int64_t size, const void* data, int align)
 {
     align = sx_max(align, SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT);
@@ -38,6 +41,7 @@ sx_mem_block* sx_mem_create_block(const sx_alloc* alloc, int64_t size, const voi
         mem->size = size;
         mem->align = align;
         mem->refcount = 1;
+        mem->mapped = false;
         if (data)
             sx_memcpy(mem->data, data, (size_t)size);
         return mem;
@@ -56,6 +60,7 @@ sx_mem_block* sx_mem_ref_block(const sx_alloc* alloc, int64_t size, void* data)
         mem->size = size;
         mem->align = 0;
         mem->refcount = 1;
+        mem->mapped = false;
         return mem;
     } else {
         sx_out_of_memory();
@@ -67,14 +72,21 @@ void sx_mem_destroy_block(sx_mem_block* mem)
 {
     sx_assert(mem);
 
-    if (sx_atomic_decr(&mem->refcount) == 0) {
-        if (mem->alloc) {
-            sx_free(mem->alloc, mem);
+    int refcount = sx_atomic_decr(&mem->refcount);
+    sx_assert(refcount >= 0);
+    if (refcount == 0) {
+        if (mem->mapped) {
+            sx__file_unmap(mem->data, mem->size);
+            mem->data = NULL;
+            mem->mapped = false;
+        }
+        // the block is freed with it's header, so it must not be touched after sx_free
+        const sx_alloc* alloc = mem->alloc;
+        if (alloc) {
             mem->alloc = NULL;
+            sx_free(alloc, mem);
         }
     }
-
-    sx_assert(mem->refcount >= 0);
 }
 
 void sx_mem_addref(sx_mem_block* mem)
@@ -89,6 +101,7 @@ void sx_mem_init_block_ptr(sx_mem_block* mem, void* data, int64_t size)
     mem->data = data;
     mem->size = size;
     mem->align = 0;
+    mem->mapped = false;
 }
 
 bool sx_mem_grow(sx_mem_block** pmem, int64_t size)
@@ -97,6 +110,7 @@ bool sx_mem_grow(sx_mem_block** pmem, int64_t size)
     sx_assert(mem->alloc &&
               "Growable memory must be created with an allocator - sx_mem_create_block");
     sx_assert(size > mem->size && "New size must be greater than the previous one");
+    sx_assert(!mem->mapped && "File mapped memory cannot grow");
 
     int align = mem->align;
     const sx_alloc* alloc = mem->alloc;
@@ -381,6 +395,36 @@ int64_t sx_file_size(const sx_file* file)
     return f->size;
 }
 
+static void* sx__file_map(const char* filepath, int64_t* psize)
+{
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER size = { 0 };
+    void* ptr = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        // the view keeps the mapping alive, so the handles can be closed right away
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+
+    *psize = size.QuadPart;
+    return ptr;
+}
+
+static void sx__file_unmap(void* data, int64_t size)
+{
+    sx_unused(size);
+    UnmapViewOfFile(data);
+}
+
 #elif SX_PLATFORM_POSIX // if SX_PLATFORM_WINDOWS
 
 typedef struct sx__file_posix {
@@ -512,6 +556,34 @@ int64_t sx_file_size(const sx_file* file)
     return f->size;
 }
 
+static void* sx__file_map(const char* filepath, int64_t* psize)
+{
+    int file_id = open(filepath, O_RDONLY | __O_LARGEFILE);
+    if (file_id == -1) {
+        return NULL;
+    }
+
+    struct stat _stat;
+    int64_t size = fstat(file_id, &_stat) == 0 ? (int64_t)_stat.st_size : 0;
+    void* ptr = NULL;
+    if (size > 0) {
+        ptr = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, file_id, 0);
+        if (ptr == MAP_FAILED) {
+            ptr = NULL;
+        }
+    }
+    // the mapping stays valid after the file is closed
+    close(file_id);
+
+    *psize = size;
+    return ptr;
+}
+
+static void sx__file_unmap(void* data, int64_t size)
+{
+    munmap(data, (size_t)size);
+}
+
 #endif  // elif SX_PLATFORM_POSIX
 
 
@@ -554,6 +626,23 @@ sx_mem_block* sx_file_load_bin(const sx_alloc* alloc, const char* filepath)
     return NULL;    
 }
 
+sx_mem_block* sx_file_map(const sx_alloc* alloc, const char* filepath)
+{
+    int64_t size = 0;
+    void* data = sx__file_map(filepath, &size);
+    if (!data) {
+        return NULL;
+    }
+
+    sx_mem_block* mem = sx_mem_ref_block(alloc, size, data);
+    if (!mem) {
+        sx__file_unmap(data, size);
+        return NULL;
+    }
+    mem->mapped = true;
+    return mem;
+}
+
 //
 static inline int64_t sx__iff_read(sx_iff_file* iff, void* data, int64_t size)
 {
@@ -4,45 +4,101 @@
 #include "sx/array.h"
 #include "sx/atomic.h"    // yield, sx_lock_t
 #include "sx/fiber.h"
-#include "sx/os.h"    // sx_os_minstacksz, sx_os_numcores
+#include "sx/hash.h"    // sx_hash_u32
+#include "sx/math.h"    // sx_nearest_pow2
+#include "sx/os.h"    // sx_os_minstacksz, sx_os_numcores, sx_os_cpu_topology
 #include "sx/pool.h"
 #include "sx/string.h"    // sx_snprintf
 #include "sx/threads.h"
+#include "sx/timer.h"
 
 #include <alloca.h>
-
-// TODO: job selector, should do some caching/hashing to select the same thread for the job
-//       Maybe hash sx_job_desc and assign thread_id to that
-//       Each thread has a waiting_list for themself, so if we find the hash, put the job into
-//       thread's waiting_list instead of global waiting_list. The selector, should only try once
-//       for it's own waiting_list, if not found push all local list to global list for other
-//       threads to pickup the work This method may reduce the context switches in many situations,
-//       especially in root jobs
+#include <limits.h>    // INT_MAX
+
+#if SX_CONFIG_JOB_TRACE
+#    include "sx/io.h"
+#endif
+
+// Thread affinity:
+//       Jobs that are dispatched with an affinity key are hashed to a worker thread and put into
+//       that thread's affinity list (inbox) instead of the dispatcher's deque. The selector of the
+//       target thread tries it's own affinity list first and moves all of it into it's own deque
+//       so the work can be stolen by others. Other threads only take jobs from another thread's
+//       affinity list after one failed selection attempt, so the target thread always gets the
+//       first chance to run the job on a warm cache
+//
+// Idling:
+//       Threads that can't find any jobs first spin (cpu pause) and then yield for a configurable
+//       number of tries, and after that they park themselves on `wake_epoch` (futex). Every
+//       dispatch and every finished sx_job_t bumps `wake_epoch` and wakes up the parked threads.
+//       The epoch is read before selecting a job, so if any work is submitted between the failed
+//       selection and parking, the futex wait returns immediately and no wake ups are lost
+//
+// Tracing (SX_CONFIG_JOB_TRACE=1):
+//       Every thread writes it's own events into it's own ring buffer, so recording doesn't need
+//       any locks. Runs of a job are recorded as a single slice when the job finishes or parks
+//       itself in wait mode, so overwritten events in the ring never leave unbalanced begin/end
+//       events behind
+//
+// Quiescent states:
+//       Every thread publishes `qs_seq` whenever it starts or stops running a job (including
+//       parking itself in sx_job_wait_and_del). Low bit is set while a job is running, the rest is
+//       a counter that changes on every update. A snapshot of all threads has passed when every
+//       thread was either outside a job at the time of the snapshot, or has updated it's sequence
+//       since, so any job that was running at the snapshot is done or has left the code it was
+//       running. This gives the owners of lock-free data (sx_hashtbl_mt) a grace period to free
+//       the memory that job threads may still be reading, see sx_job_quiescent_snapshot
 
 #define COUNTER_POOL_SIZE 256
+#define PARALLEL_FOR_POOL_SIZE 64
 #define DEFAULT_MAX_FIBERS 64
 #define DEFAULT_FIBER_STACK_SIZE 1048576    // 1MB
+#define DEFAULT_SPIN_COUNT 64
+#define DEFAULT_YIELD_COUNT 8
+
+typedef struct sx__job_thread_data sx__job_thread_data;
+typedef void(sx__job_done_cb)(sx_job_context* ctx, sx__job_thread_data* tdata, void* user);
 
 typedef struct sx__job {
     int job_index;
     int done;
     uint32_t owner_tid;
     uint32_t tags;
+    uint32_t flags;    // sx_job_flags
     sx_fiber_stack stack_mem;
     sx_fiber_t fiber;
     sx_fiber_t selector_fiber;
     sx_job_t counter;
     sx_job_t wait_counter;
+    sx__job_done_cb* done_cb;    // called by the thread that finishes the last job of `counter`
+    void* done_user;
     sx_job_context* ctx;
     sx_job_cb* callback;
     void* user;
     int range_start;
     int range_end;
     sx_job_priority priority;
+#if SX_CONFIG_JOB_TRACE
+    uint32_t trace_id;
+    bool trace_resumed;    // next run of the job is a continuation after wait
+    uint64_t trace_tm;     // start time of the current run
+#endif
     struct sx__job* next;
     struct sx__job* prev;
 } sx__job;
 
+// Chase-Lev work-stealing deque
+// Reference: https://www.dre.vanderbilt.edu/~schmidt/PDF/work-stealing-dequeue.pdf
+//            https://fzn.fr/readings/ppopp13.pdf
+// The owner thread pushes and pops jobs at the bottom (LIFO), other threads steal from the top
+// (FIFO). Capacity is always more than the job pool capacity, so the buffer never needs to grow
+typedef struct sx__job_deque {
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_atomic_size) top;
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_atomic_size) bottom;
+    sx__job** items;
+    int mask;
+} sx__job_deque;
+
 typedef struct sx__job_thread_data {
     sx__job* cur_job;
     sx_fiber_stack selector_stack;
@@ -51,40 +107,188 @@ typedef struct sx__job_thread_data {
     uint32_t tid;
     uint32_t tags;
     bool main_thrd;
+    int steal_index;     // last deque index that we successfully stole from
+    int select_misses;   // number of sequential selections that didn't find any jobs
+    bool select_retry;   // last selection missed a job, but trying again may find one
+    int idle_count;      // number of sequential idle steps, see sx__job_idle
+    uint64_t last_tm;    // last time that idle or busy time is accounted
+    sx_atomic_int qs_seq;    // see 'Quiescent states' above, written only by the owner thread
+    sx_job_thread_stats stats;    // written only by the owner thread
+    // jobs that are in wait mode (sx_job_wait_and_del), only the owner thread can continue them
+    // so they don't need any locks
+    sx__job* parked_list[SX_JOB_PRIORITY_COUNT];
+    sx__job* parked_list_last[SX_JOB_PRIORITY_COUNT];
 } sx__job_thread_data;
 
+// jobs that are dispatched with affinity to a specific thread, see 'Thread affinity' above
+typedef struct sx__job_inbox {
+    sx_lock_t lk;
+    sx__job* list[SX_JOB_PRIORITY_COUNT];
+    sx__job* list_last[SX_JOB_PRIORITY_COUNT];
+} sx__job_inbox;
+
+// describes a single dispatch, also used to keep the dispatches that can't be submitted yet
 typedef struct sx__job_pending {
     sx_job_t counter;
+    int num_jobs;
     int range_size;
     int range_reminder;
     sx_job_cb* callback;
     void* user;
     sx_job_priority priority;
     uint32_t tags;
+    uint32_t affinity;
+    uint32_t flags;
+    sx__job_done_cb* done_cb;
+    void* done_user;
 } sx__job_pending;
 
+#if SX_CONFIG_JOB_TRACE
+typedef enum sx__job_trace_type {
+    SX__JOB_TRACE_DISPATCH = 0,
+    SX__JOB_TRACE_RUN
+} sx__job_trace_type;
+
+typedef struct sx__job_trace_event {
+    uint64_t tm;
+    uint64_t duration;    // SX__JOB_TRACE_RUN only
+    sx_job_cb* callback;
+    uint32_t job_id;
+    uint8_t type;         // sx__job_trace_type
+    bool resumed;         // run is a continuation after wait
+    bool waited;          // run is ended by wait, instead of finishing the job
+    int range_start;
+    int range_end;
+} sx__job_trace_event;
+
+// single writer (owner thread) ring buffer
+typedef struct sx__job_trace_buffer {
+    sx_align_decl(SX_CACHE_LINE_SIZE, uint32_t) head;    // written by the owner thread only
+    uint32_t tail;                                       // written by sx_job_trace_reset only
+    sx__job_trace_event* events;    // count = SX_CONFIG_JOB_TRACE_EVENTS
+} sx__job_trace_buffer;
+#endif
+
+// shared state of a single `sx_job_parallel_for` call, all of it's jobs grab chunks from `cursor`
+typedef struct sx__job_parallel_for {
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_atomic_int) cursor;
+    int count;
+    int grain_size;
+    int num_jobs;
+    sx_job_cb* callback;
+    void* user;
+} sx__job_parallel_for;
+
+typedef struct sx__job_graph_node {
+    sx_job_cb* callback;
+    void* user;
+    int count;
+    sx_job_priority priority;
+    uint32_t tags;
+    uint32_t flags;
+    int num_preds;
+    int* successors;    // sx_array: node indices that depend on this node
+    sx_atomic_int num_preds_remaining;
+    sx_atomic_int counter;    // sx_job_t for the node's own jobs
+    sx_job_graph* graph;
+} sx__job_graph_node;
+
+typedef struct sx_job_graph {
+    const sx_alloc* alloc;
+    sx__job_graph_node* nodes;    // sx_array
+    sx_job_t counter;             // number of nodes remaining, valid after submit
+} sx_job_graph;
+
 typedef struct sx_job_context {
     const sx_alloc* alloc;
     sx_thread** threads;
     int num_threads;
     int stack_sz;
-    sx_pool* job_pool;        // sx__job: not-growable !
-    sx_pool* counter_pool;    // int: growable
-    sx__job* waiting_list[SX_JOB_PRIORITY_COUNT];
-    sx__job* waiting_list_last[SX_JOB_PRIORITY_COUNT];
-    uint32_t* tags;      // count = num_threads + 1
-    sx_lock_t job_lk;    // used for 'job_pool', 'waiting_list' and 'pending' access
-    sx_lock_t counter_lk;
+    sx_pool* job_pool;          // sx__job: not-growable !
+    sx_pool_mt* counter_pool;      // int: thread-safe, new/del don't need any locks
+    sx_pool_mt* pfor_pool;         // sx__job_parallel_for: same as 'counter_pool'
+    sx__job_deque* deques;      // count = (num_threads + 1) * SX_JOB_PRIORITY_COUNT
+    sx__job_inbox* inboxes;     // count = num_threads + 1
+    sx__job* tagged_list[SX_JOB_PRIORITY_COUNT];    // jobs with tags != 0 cannot be stolen blindly
+    sx__job* tagged_list_last[SX_JOB_PRIORITY_COUNT];
+    uint32_t* tags;             // count = num_threads + 1
+    int* thread_cpus;           // count = num_threads + 1, logical cpu of each thread if pinned
+    sx__job_thread_data** tdatas;    // count = num_threads + 1, NULL until the thread starts
+    sx_lock_t job_lk;           // used for 'job_pool' and 'pending' access
+    sx_atomic_int num_pending;
+    sx_lock_t tagged_lk;        // used for 'tagged_list' access
+    sx_atomic_int num_tagged;
+    sx_atomic_int num_parked;
+    sx_atomic_int num_inbox;
     sx_tls thread_tls;
     int dummy_counter;
-    sx_sem sem;
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_atomic_int) wake_epoch;    // see 'Idling' above
+    sx_atomic_int num_sleepers;
+    int spin_count;
+    int yield_count;
     int quit;
     sx_job_thread_init_cb* thread_init_cb;
     sx_job_thread_shutdown_cb* thread_shutdown_cb;
     void* thread_user;
     sx__job_pending* pending;
+#if SX_CONFIG_JOB_TRACE
+    sx__job_trace_buffer* traces;    // count = num_threads + 1
+    sx_atomic_int trace_id;
+    uint64_t trace_start_tm;
+#endif
 } sx_job_context;
 
+#if SX_CONFIG_JOB_TRACE
+static_assert((SX_CONFIG_JOB_TRACE_EVENTS & (SX_CONFIG_JOB_TRACE_EVENTS - 1)) == 0,
+              "SX_CONFIG_JOB_TRACE_EVENTS must be power of two");
+
+static inline void sx__job_trace_write(sx_job_context* ctx, int thread_index,
+                                       const sx__job_trace_event* e)
+{
+    sx__job_trace_buffer* buff = &ctx->traces[thread_index];
+    buff->events[buff->head & (SX_CONFIG_JOB_TRACE_EVENTS - 1)] = *e;
+    sx_compiler_write_barrier();
+    buff->head++;
+}
+
+static void sx__job_trace_dispatch(sx_job_context* ctx, int thread_index, sx__job* job)
+{
+    job->trace_id = (uint32_t)sx_atomic_incr(&ctx->trace_id);
+    job->trace_resumed = false;
+    sx__job_trace_event e = { .tm = sx_tm_now(),
+                              .callback = job->callback,
+                              .job_id = job->trace_id,
+                              .type = SX__JOB_TRACE_DISPATCH,
+                              .range_start = job->range_start,
+                              .range_end = job->range_end };
+    sx__job_trace_write(ctx, thread_index, &e);
+}
+
+static inline void sx__job_trace_begin(sx__job* job)
+{
+    job->trace_tm = sx_tm_now();
+}
+
+static void sx__job_trace_end(sx_job_context* ctx, int thread_index, sx__job* job, bool waited)
+{
+    sx__job_trace_event e = { .tm = job->trace_tm,
+                              .duration = sx_tm_since(job->trace_tm),
+                              .callback = job->callback,
+                              .job_id = job->trace_id,
+                              .type = SX__JOB_TRACE_RUN,
+                              .resumed = job->trace_resumed,
+                              .waited = waited,
+                              .range_start = job->range_start,
+                              .range_end = job->range_end };
+    sx__job_trace_write(ctx, thread_index, &e);
+    job->trace_resumed = waited;
+}
+#else
+#    define sx__job_trace_dispatch(_ctx, _thread_index, _job)
+#    define sx__job_trace_begin(_job)
+#    define sx__job_trace_end(_ctx, _thread_index, _job, _waited)
+#endif
+
 static void sx__del_job(sx_job_context* ctx, sx__job* job)
 {
     sx_lock(&ctx->job_lk);
@@ -92,6 +296,16 @@ static void sx__del_job(sx_job_context* ctx, sx__job* job)
     sx_unlock(&ctx->job_lk);
 }
 
+// every change to the running job goes through here, so the quiescent sequence stays in sync
+static inline void sx__job_set_current(sx__job_thread_data* tdata, sx__job* job)
+{
+    tdata->cur_job = job;
+    // full barrier: the running flag is visible before the job reads any shared data, and all reads
+    // of the previous job are done before the flag is cleared
+    int seq = (tdata->qs_seq & ~1) + 2;
+    sx_atomic_xchg(&tdata->qs_seq, seq | (job ? 1 : 0));
+}
+
 static void fiber_fn(sx_fiber_transfer transfer)
 {
     sx__job* job = (sx__job*)transfer.user;
@@ -112,33 +326,39 @@ static void fiber_fn(sx_fiber_transfer transfer)
     sx_fiber_switch(transfer.from, transfer.user);
 }
 
-static sx__job* sx__new_job(sx_job_context* ctx, int index, sx_job_cb* callback, void* user,
-                            int range_start, int range_end, sx_job_t counter, uint32_t tags,
-                            sx_job_priority priority)
+static sx__job* sx__new_job(sx_job_context* ctx, int index, const sx__job_pending* desc,
+                            int range_start, int range_end)
 {
     sx__job* j = (sx__job*)sx_pool_new(ctx->job_pool);
 
     if (j) {
         j->job_index = index;
         j->owner_tid = 0;
-        j->tags = tags;
+        j->tags = desc->tags;
+        j->flags = desc->flags;
         j->done = 0;
-        if (!j->stack_mem.sptr) {
-            // Initialize stack memory
-            if (!sx_fiber_stack_init(&j->stack_mem, ctx->stack_sz)) {
-                sx_out_of_memory();
-                return NULL;
+        if (!(desc->flags & SX_JOB_FLAG_LEAF)) {
+            if (!j->stack_mem.sptr) {
+                // Initialize stack memory
+                if (!sx_fiber_stack_init(&j->stack_mem, ctx->stack_sz)) {
+                    sx_out_of_memory();
+                    return NULL;
+                }
             }
+            j->fiber = sx_fiber_create(j->stack_mem, fiber_fn);
+        } else {
+            j->fiber = NULL;
         }
-        j->fiber = sx_fiber_create(j->stack_mem, fiber_fn);
-        j->counter = counter;
+        j->counter = desc->counter;
         j->wait_counter = &ctx->dummy_counter;
+        j->done_cb = desc->done_cb;
+        j->done_user = desc->done_user;
         j->ctx = ctx;
-        j->callback = callback;
-        j->user = user;
+        j->callback = desc->callback;
+        j->user = desc->user;
         j->range_start = range_start;
         j->range_end = range_end;
-        j->priority = priority;
+        j->priority = desc->priority;
         j->next = j->prev = NULL;
     }
     return j;
@@ -169,69 +389,381 @@ static inline void sx__job_remove_list(sx__job** pfirst, sx__job** plast, sx__jo
     node->prev = node->next = NULL;
 }
 
-typedef struct sx__job_select_result {  
+static bool sx__job_deque_init(sx__job_deque* d, const sx_alloc* alloc, int capacity)
+{
+    capacity = sx_nearest_pow2(capacity);
+    d->items = (sx__job**)sx_malloc(alloc, sizeof(sx__job*) * capacity);
+    if (!d->items) {
+        sx_out_of_memory();
+        return false;
+    }
+    d->top = d->bottom = 0;
+    d->mask = capacity - 1;
+    return true;
+}
+
+static void sx__job_deque_release(sx__job_deque* d, const sx_alloc* alloc)
+{
+    sx_free(alloc, d->items);
+}
+
+// owner thread only
+static void sx__job_deque_push(sx__job_deque* d, sx__job* job)
+{
+    int64_t b = d->bottom;
+    sx_assert((b - d->top) <= (int64_t)d->mask && "job deque overflow");
+    d->items[b & d->mask] = job;
+    sx_memory_write_barrier();    // item must be visible before bottom
+    d->bottom = b + 1;
+}
+
+// owner thread only
+static sx__job* sx__job_deque_pop(sx__job_deque* d)
+{
+    int64_t b = d->bottom - 1;
+    d->bottom = b;
+    sx_memory_barrier();    // publish bottom before reading top
+    int64_t t = d->top;
+
+    if (t <= b) {
+        sx__job* job = d->items[b & d->mask];
+        if (t == b) {
+            // last item in the deque, race against thieves
+            if (sx_atomic_cas_size(&d->top, t + 1, t) != t)
+                job = NULL;
+            d->bottom = b + 1;
+        }
+        return job;
+    } else {
+        // empty
+        d->bottom = b + 1;
+        return NULL;
+    }
+}
+
+// any thread, `contended` is set when we lost the race against another thread
+static sx__job* sx__job_deque_steal(sx__job_deque* d, bool* contended)
+{
+    int64_t t = d->top;
+    sx_memory_barrier();    // read top before bottom
+    int64_t b = d->bottom;
+
+    if (t < b) {
+        sx__job* job = d->items[t & d->mask];
+        if (sx_atomic_cas_size(&d->top, t + 1, t) != t) {
+            *contended = true;
+            return NULL;
+        }
+        return job;
+    }
+    return NULL;
+}
+
+static inline sx__job_deque* sx__job_get_deque(sx_job_context* ctx, int thread_index,
+                                               sx_job_priority priority)
+{
+    return &ctx->deques[thread_index * SX_JOB_PRIORITY_COUNT + priority];
+}
+
+// pushes a new job to current thread's deque, or to the shared tagged list if it has tags
+static void sx__job_push(sx_job_context* ctx, sx__job_thread_data* tdata, sx__job* job)
+{
+    if (job->tags == 0) {
+        sx__job_deque_push(sx__job_get_deque(ctx, tdata->thread_index, job->priority), job);
+    } else {
+        sx_lock(&ctx->tagged_lk);
+        sx__job_add_list(&ctx->tagged_list[job->priority], &ctx->tagged_list_last[job->priority],
+                         job);
+        sx_atomic_incr(&ctx->num_tagged);
+        sx_unlock(&ctx->tagged_lk);
+    }
+}
+
+// returns the thread index that the job (sub-job index) with `affinity` key should run on
+static inline int sx__job_affinity_thread(sx_job_context* ctx, uint32_t affinity, int index)
+{
+    if (ctx->num_threads == 0)
+        return 0;
+    // main thread only picks up jobs when it's waiting, so only target worker threads
+    return 1 + (int)((sx_hash_u32(affinity) + (uint32_t)index) % (uint32_t)ctx->num_threads);
+}
+
+static void sx__job_push_affinity(sx_job_context* ctx, sx__job_thread_data* tdata, sx__job* job,
+                                  int thread_index)
+{
+    if (job->tags != 0 || thread_index == tdata->thread_index) {
+        sx__job_push(ctx, tdata, job);
+    } else {
+        sx__job_inbox* inbox = &ctx->inboxes[thread_index];
+        sx_lock(&inbox->lk);
+        sx__job_add_list(&inbox->list[job->priority], &inbox->list_last[job->priority], job);
+        sx_atomic_incr(&ctx->num_inbox);
+        sx_unlock(&inbox->lk);
+    }
+}
+
+// moves all jobs from the thread's inbox to it's own deque, so other threads can steal them
+static void sx__job_drain_inbox(sx_job_context* ctx, sx__job_thread_data* tdata)
+{
+    sx__job_inbox* inbox = &ctx->inboxes[tdata->thread_index];
+    sx_lock(&inbox->lk);
+    // push in reverse priority order, because the owner pops in LIFO order
+    for (int pr = SX_JOB_PRIORITY_COUNT - 1; pr >= 0; pr--) {
+        sx__job* node = inbox->list[pr];
+        while (node) {
+            sx__job* next = node->next;
+            node->next = node->prev = NULL;
+            sx__job_deque_push(sx__job_get_deque(ctx, tdata->thread_index, (sx_job_priority)pr),
+                               node);
+            sx_atomic_decr(&ctx->num_inbox);
+            node = next;
+        }
+        inbox->list[pr] = inbox->list_last[pr] = NULL;
+    }
+    sx_unlock(&inbox->lk);
+}
+
+static sx__job* sx__job_steal_inbox(sx_job_context* ctx, int thread_index, int pr)
+{
+    sx__job_inbox* inbox = &ctx->inboxes[thread_index];
+    sx__job* job = NULL;
+    if (inbox->list[pr] && sx_trylock(&inbox->lk)) {
+        job = inbox->list[pr];
+        if (job) {
+            sx__job_remove_list(&inbox->list[pr], &inbox->list_last[pr], job);
+            sx_atomic_decr(&ctx->num_inbox);
+        }
+        sx_unlock(&inbox->lk);
+    }
+    return job;
+}
+
+static inline void sx__job_submit(sx_job_context* ctx, sx__job_thread_data* tdata, sx__job* job,
+                                  uint32_t affinity)
+{
+    if (affinity)
+        sx__job_push_affinity(ctx, tdata, job, sx__job_affinity_thread(ctx, affinity, job->job_index));
+    else
+        sx__job_push(ctx, tdata, job);
+}
+
+// signals idle threads that there is new work, or a sx_job_t is finished
+static inline void sx__job_wake(sx_job_context* ctx, int count)
+{
+    sx_atomic_incr(&ctx->wake_epoch);
+    if (ctx->num_sleepers > 0)
+        sx_futex_wake(&ctx->wake_epoch, count);
+}
+
+// called after a failed selection, `epoch` must be read before the selection (see 'Idling' above)
+static void sx__job_idle(sx_job_context* ctx, sx__job_thread_data* tdata, int epoch)
+{
+    uint64_t start_tm = sx_tm_now();
+    tdata->stats.spin_tm += start_tm - tdata->last_tm;
+
+    // main thread with no workers is the only one that can do the work, never park it
+    bool can_park = ctx->num_threads > 0;
+    int count = tdata->select_retry ? 0 : ++tdata->idle_count;
+    bool parked = false;
+
+    if (count <= ctx->spin_count) {
+        sx_yield_cpu();
+    } else if (count <= ctx->spin_count + ctx->yield_count || !can_park) {
+        sx_thread_yield();
+    } else {
+        sx_atomic_incr(&ctx->num_sleepers);
+        if (ctx->wake_epoch == epoch && !ctx->quit)
+            sx_futex_wait(&ctx->wake_epoch, epoch, -1);
+        sx_atomic_decr(&ctx->num_sleepers);
+        tdata->idle_count = 0;
+        tdata->stats.num_parks++;
+        parked = true;
+    }
+
+    uint64_t end_tm = sx_tm_now();
+    if (parked)
+        tdata->stats.park_tm += end_tm - start_tm;
+    else
+        tdata->stats.spin_tm += end_tm - start_tm;
+    tdata->last_tm = end_tm;
+}
+
+typedef struct sx__job_select_result {
     sx__job* job;
-    bool waiting_list_alive;
+    bool retry;    // no job is found, but we may find one if we try again right away
 } sx__job_select_result;
 
-
-static sx__job_select_result sx__job_select(sx_job_context* ctx, uint32_t tid, uint32_t tags)
+static sx__job_select_result sx__job_select(sx_job_context* ctx, sx__job_thread_data* tdata,
+                                            uint32_t tags)
 {
     sx__job_select_result r = { 0 };
-    
-    sx_lock(&ctx->job_lk);
+    int num_deques = ctx->num_threads + 1;
+    bool steal_inbox = tdata->select_misses > 0;
+
+    // jobs that are dispatched with affinity to this thread
+    sx__job_inbox* inbox = &ctx->inboxes[tdata->thread_index];
+    if (inbox->list[SX_JOB_PRIORITY_HIGH] || inbox->list[SX_JOB_PRIORITY_NORMAL] ||
+        inbox->list[SX_JOB_PRIORITY_LOW]) {
+        sx__job_drain_inbox(ctx, tdata);
+    }
+
     for (int pr = 0; pr < SX_JOB_PRIORITY_COUNT; pr++) {
-        sx__job* node = ctx->waiting_list[pr];
+        // continue our own jobs that are in wait mode, if their dependencies are done
+        sx__job* node = tdata->parked_list[pr];
         while (node) {
-            r.waiting_list_alive = true;
-            if (*node->wait_counter == 0) {    // job must not be waiting/depend on any jobs
-                if ((node->owner_tid == 0 || node->owner_tid == tid) &&
-                    (node->tags == 0 || (node->tags & tags))) {
+            if (*node->wait_counter == 0) {
+                sx__job_remove_list(&tdata->parked_list[pr], &tdata->parked_list_last[pr], node);
+                sx_atomic_decr(&ctx->num_parked);
+                r.job = node;
+                tdata->select_misses = 0;
+                return r;
+            }
+            node = node->next;
+        }
+
+        // pop from our own deque
+        r.job = sx__job_deque_pop(sx__job_get_deque(ctx, tdata->thread_index, (sx_job_priority)pr));
+        if (r.job) {
+            tdata->select_misses = 0;
+            return r;
+        }
+
+        // steal from other threads, start from the last victim we stole from
+        for (int i = 0; i < num_deques; i++) {
+            int victim = (tdata->steal_index + i) % num_deques;
+            if (victim == tdata->thread_index)
+                continue;
+
+            bool contended = false;
+            r.job = sx__job_deque_steal(sx__job_get_deque(ctx, victim, (sx_job_priority)pr),
+                                        &contended);
+            if (r.job) {
+                tdata->steal_index = victim;
+                tdata->select_misses = 0;
+                return r;
+            }
+            r.retry |= contended;
+        }
+
+        // affinity jobs of other threads, only after we failed to find anything the last time
+        if (steal_inbox && ctx->num_inbox > 0) {
+            for (int i = 0; i < num_deques; i++) {
+                if (i == tdata->thread_index)
+                    continue;
+                r.job = sx__job_steal_inbox(ctx, i, pr);
+                if (r.job) {
+                    tdata->select_misses = 0;
+                    return r;
+                }
+            }
+        }
+
+        // tagged jobs: only pick the ones that match our thread tags
+        if (ctx->num_tagged > 0) {
+            sx_lock(&ctx->tagged_lk);
+            node = ctx->tagged_list[pr];
+            while (node) {
+                if (node->tags & tags) {
+                    sx__job_remove_list(&ctx->tagged_list[pr], &ctx->tagged_list_last[pr], node);
+                    sx_atomic_decr(&ctx->num_tagged);
                     r.job = node;
-                    sx__job_remove_list(&ctx->waiting_list[pr], &ctx->waiting_list_last[pr], node);
-                    pr = SX_JOB_PRIORITY_COUNT; // break out of the outer loop
                     break;
                 }
+                node = node->next;
             }
-            node = node->next;
-        }    // while(iterate nodes)
-    }        // foreach(priority)
+            sx_unlock(&ctx->tagged_lk);
 
-    sx_unlock(&ctx->job_lk);
+            if (r.job) {
+                tdata->select_misses = 0;
+                return r;
+            }
+        }
+    }    // foreach(priority)
+
+    // there are affinity jobs of other threads that we can steal on the next try
+    // note that jobs in wait mode don't need retries, because finishing their dependencies wakes
+    // up the idle threads
+    if (!steal_inbox && ctx->num_inbox > 0)
+        r.retry = true;
 
+    tdata->select_misses++;
+    tdata->select_retry = r.retry;
     return r;
 }
 
+static void sx__job_process_pending(sx_job_context* ctx, sx__job_thread_data* tdata);
+
+static void sx__job_run(sx_job_context* ctx, sx__job_thread_data* tdata, sx__job* job)
+{
+    uint64_t start_tm = sx_tm_now();
+    tdata->stats.spin_tm += start_tm - tdata->last_tm;
+    tdata->idle_count = 0;
+
+    if (job->flags & SX_JOB_FLAG_LEAF) {
+        // Leaf jobs never wait, so run them directly on the selector's stack without any fiber
+        // switches. selector stacks are as big as job stacks, see `sx__job_create_tdata`
+        sx_assert(tdata->cur_job == NULL);
+        sx__job_set_current(tdata, job);
+        sx__job_trace_begin(job);
+        job->callback(job->range_start, job->range_end, tdata->thread_index, job->user);
+        job->done = 1;
+    } else {
+        // Job is a slave (in wait mode), get back to it and remove slave mode
+        if (job->owner_tid > 0) {
+            sx_assert(tdata->cur_job == NULL);
+            job->owner_tid = 0;
+        }
+
+        // Run the job from beginning, or continue after 'wait'
+        tdata->selector_fiber = job->selector_fiber;
+        sx__job_set_current(tdata, job);
+        sx__job_trace_begin(job);
+        job->fiber = sx_fiber_switch(job->fiber, job).from;
+    }
+
+    // Delete the job and decrement job counter if it's done
+    if (job->done) {
+        sx_job_t counter = job->counter;
+        sx__job_done_cb* done_cb = job->done_cb;
+        void* done_user = job->done_user;
+
+        sx__job_trace_end(ctx, tdata->thread_index, job, false);
+        sx__job_set_current(tdata, NULL);
+        int remaining = sx_atomic_decr(counter);
+        sx__del_job(ctx, job);
+        if (remaining == 0) {
+            if (done_cb)
+                done_cb(ctx, tdata, done_user);
+            // jobs in wait mode or threads that are waiting on the counter can continue now
+            sx__job_wake(ctx, INT_MAX);
+        }
+
+        // we have freed a job slot, so try to submit dispatches that are waiting for free slots
+        if (ctx->num_pending > 0) {
+            sx_lock(&ctx->job_lk);
+            sx__job_process_pending(ctx, tdata);
+            sx_unlock(&ctx->job_lk);
+        }
+    }
+
+    uint64_t end_tm = sx_tm_now();
+    tdata->stats.busy_tm += end_tm - start_tm;
+    tdata->last_tm = end_tm;
+}
+
 static void sx__job_selector_main_thrd(sx_fiber_transfer transfer)
 {
     sx_job_context* ctx = (sx_job_context*)transfer.user;
     sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
     sx_assert(tdata);
 
-    // Select the best job in the waiting list
+    // Select the best job in the waiting list, idling is handled by sx_job_wait_and_del
     sx__job_select_result r =
-        sx__job_select(ctx, tdata->tid, ctx->num_threads > 0 ? tdata->tags : 0xffffffff);
+        sx__job_select(ctx, tdata, ctx->num_threads > 0 ? tdata->tags : 0xffffffff);
 
     //
-    if (r.job) {
-        // Job is a slave (in wait mode), get back to it and remove slave mode
-        if (r.job->owner_tid > 0) {
-            sx_assert(tdata->cur_job == NULL);
-            r.job->owner_tid = 0;
-        }
-
-        // Run the job from beginning, or continue after 'wait'
-        tdata->selector_fiber = r.job->selector_fiber;
-        tdata->cur_job = r.job;
-        r.job->fiber = sx_fiber_switch(r.job->fiber, r.job).from;
-
-        // Delete the job and decrement job counter if it's done
-        if (r.job->done) {
-            tdata->cur_job = NULL;
-            sx_atomic_decr(r.job->counter);
-            sx__del_job(ctx, r.job);
-        }
-    }
+    if (r.job)
+        sx__job_run(ctx, tdata, r.job);
 
     // before returning, set selector to NULL, so we know that we have to recreate the fiber
     tdata->selector_fiber = NULL;       
@@ -246,55 +778,63 @@ static void sx__job_selector_fn(sx_fiber_transfer transfer)
     sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
     sx_assert(tdata);
 
+    tdata->last_tm = sx_tm_now();
     while (!ctx->quit) {
-        sx_semaphore_wait(&ctx->sem, -1);    // Wait for a job
+        int epoch = ctx->wake_epoch;
+        sx_memory_barrier();
 
         // Select the best job in the waiting list
-        sx__job_select_result r = sx__job_select(ctx, tdata->tid, tdata->tags);
-
-        //
-        if (r.job) {
-            // Job is a slave (in wait mode), get back to it and remove slave mode
-            if (r.job->owner_tid > 0) {
-                sx_assert(tdata->cur_job == NULL);
-                r.job->owner_tid = 0;
-            }
+        sx__job_select_result r = sx__job_select(ctx, tdata, tdata->tags);
 
-            // Run the job from beginning, or continue after 'wait'
-            tdata->selector_fiber = r.job->selector_fiber;
-            tdata->cur_job = r.job;
-            r.job->fiber = sx_fiber_switch(r.job->fiber, r.job).from;
-
-            // Delete the job and decrement job counter if it's done
-            if (r.job->done) {
-                tdata->cur_job = NULL;
-                sx_atomic_decr(r.job->counter);
-                sx__del_job(ctx, r.job);
-            }
-        } else if (r.waiting_list_alive) {
-            // If we have a pending job, continue this loop one more time
-            sx_semaphore_post(&ctx->sem, 1);
-            sx_yield_cpu();
-        }
+        // Run the job, or spin/yield/park until there is new work (see 'Idling' above)
+        if (r.job)
+            sx__job_run(ctx, tdata, r.job);
+        else
+            sx__job_idle(ctx, tdata, epoch);
     }
 
     // Back to caller thread
     sx_fiber_switch(transfer.from, transfer.user);
 }
 
-sx_job_t sx_job_dispatch(sx_job_context* ctx, int count, sx_job_cb* callback, void* user,
-                         sx_job_priority priority, unsigned int tags)
+// creates all the jobs of the dispatch and pushes them to the queues
+// NOTE: job_lk must be locked and pool must have enough room for `desc->num_jobs`
+static void sx__job_push_dispatch(sx_job_context* ctx, sx__job_thread_data* tdata,
+                                  const sx__job_pending* desc)
 {
-    sx_assert(count > 0);
+    int num_jobs = desc->num_jobs;
+    int range_reminder = desc->range_reminder;
+    int range_start = 0;
+    int range_end = desc->range_size + (range_reminder > 0 ? 1 : 0);
+    --range_reminder;
+
+    for (int i = 0; i < num_jobs; i++) {
+        sx__job* job = sx__new_job(ctx, i, desc, range_start, range_end);
+        sx__job_trace_dispatch(ctx, tdata->thread_index, job);
+        sx__job_submit(ctx, tdata, job, desc->affinity);
+        range_start = range_end;
+        range_end += (desc->range_size + (range_reminder > 0 ? 1 : 0));
+        --range_reminder;
+    }
+    sx_assert(range_reminder <= 0);
 
-    sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
+    // Wake up idle worker threads to start the jobs, only the matching threads can pick tagged
+    // jobs, so wake up all of them
+    sx__job_wake(ctx, desc->tags ? INT_MAX : num_jobs);
+}
+
+// `desc` should have everything except num_jobs and ranges, which are calculated by `count`
+static void sx__job_dispatch(sx_job_context* ctx, sx__job_thread_data* tdata, int count,
+                             sx__job_pending* desc)
+{
+    sx_assert(count > 0);
 
     // Divide job count into ranges
     // check which threads are eligible to execute this task (based on tags)
     int num_workers = 0;
-    if (tags != 0) {
+    if (desc->tags != 0) {
         for (int i = 0, ic = ctx->num_threads + 1; i < ic; i++) {
-            if (ctx->tags[i] & tags)
+            if (ctx->tags[i] & desc->tags)
                 num_workers++;
         }
     } else {
@@ -308,113 +848,95 @@ sx_job_t sx_job_dispatch(sx_job_context* ctx, int count, sx_job_cb* callback, vo
     sx_assert(num_jobs <= ctx->job_pool->capacity &&
               "this amount of jobs at a time cannot be done. increase max_jobs");
 
-    // Create a counter (job handle)
-    sx_lock(&ctx->counter_lk);
-    sx_job_t counter = (sx_job_t)sx_pool_new_and_grow(ctx->counter_pool, ctx->alloc);
-    sx_unlock(&ctx->counter_lk);
+    desc->num_jobs = num_jobs;
+    desc->range_size = range_size;
+    desc->range_reminder = range_reminder;
+    *desc->counter = num_jobs;
+
+    // Push jobs to the queues, so they can be collected by threads
+    sx_lock(&ctx->job_lk);
+    if (!sx_pool_fulln(ctx->job_pool, num_jobs)) {
+        sx__job_push_dispatch(ctx, tdata, desc);
+    } else {
+        sx_array_push(ctx->alloc, ctx->pending, *desc);
+        sx_atomic_incr(&ctx->num_pending);
+    }
+    sx_unlock(&ctx->job_lk);
+}
+
+static inline sx_job_t sx__job_new_counter(sx_job_context* ctx)
+{
+    return (sx_job_t)sx_poolmt_new(ctx->counter_pool);
+}
+
+static inline void sx__job_del_counter(sx_job_context* ctx, sx_job_t counter)
+{
+    sx_poolmt_del(ctx->counter_pool, (void*)counter);
+}
+
+sx_job_t sx_job_dispatch(sx_job_context* ctx, int count, sx_job_cb* callback, void* user,
+                         sx_job_priority priority, unsigned int tags, unsigned int affinity,
+                         unsigned int flags)
+{
+    sx_assert(count > 0);
+
+    sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
+    sx_assert(tdata && "Dispatch must be called within main thread or job threads");
 
+    // Create a counter (job handle)
+    sx_job_t counter = sx__job_new_counter(ctx);
     if (!counter) {
         sx_assert(0 && "Maximum job instances exceeded");
         return NULL;
     }
 
-    *counter = num_jobs;
-    sx_assert(tdata && "Dispatch must be called within main thread or job threads");
-
     // Another job is running on this thread. So depend the current running job to the new
     // dispatches
     if (tdata->cur_job)
         tdata->cur_job->wait_counter = counter;
 
-    // Push jobs to the end of the list, so they can be collected by threads
-    sx_lock(&ctx->job_lk);
-    if (!sx_pool_fulln(ctx->job_pool, num_jobs)) {
-        int range_start = 0;
-        int range_end = range_size + (range_reminder > 0 ? 1 : 0);
-        --range_reminder;
-
-        for (int i = 0; i < num_jobs; i++) {
-            sx__job_add_list(&ctx->waiting_list[priority], &ctx->waiting_list_last[priority],
-                             sx__new_job(ctx, i, callback, user, range_start, range_end, counter,
-                                         tags, priority));
-            range_start = range_end;
-            range_end += (range_size + (range_reminder > 0 ? 1 : 0));
-            --range_reminder;
-        }
-        sx_assert(range_reminder <= 0);
-
-        // Post to semaphore to worker threads start cur_job
-        sx_semaphore_post(&ctx->sem, num_jobs);
-    } else {
-        sx__job_pending pending = { .counter = counter,
-                                    .range_size = range_size,
-                                    .range_reminder = range_reminder,
-                                    .callback = callback,
-                                    .user = user,
-                                    .priority = priority,
-                                    .tags = tags };
-        sx_array_push(ctx->alloc, ctx->pending, pending);
-    }
-    sx_unlock(&ctx->job_lk);
+    sx__job_pending desc = { .counter = counter,
+                             .callback = callback,
+                             .user = user,
+                             .priority = priority,
+                             .tags = tags,
+                             .affinity = affinity,
+                             .flags = flags };
+    sx__job_dispatch(ctx, tdata, count, &desc);
 
     return counter;
 }
 
-static void sx__job_process_pending(sx_job_context* ctx)
+static void sx__job_process_pending(sx_job_context* ctx, sx__job_thread_data* tdata)
 {
     // go through all pending jobs, and push the first one that we can into the job-list
     for (int i = 0, c = sx_array_count(ctx->pending); i < c; i++) {
         sx__job_pending pending = ctx->pending[i];
 
-        if (!sx_pool_fulln(ctx->job_pool, *pending.counter)) {
-            int range_start = 0;
-            int range_end = pending.range_size + (pending.range_reminder > 0 ? 1 : 0);
-            --pending.range_reminder;
-
+        if (!sx_pool_fulln(ctx->job_pool, pending.num_jobs)) {
             sx_array_pop(ctx->pending, i);
-
-            int count = *pending.counter;
-            for (int k = 0; k < count; k++) {
-                sx__job_add_list(
-                    &ctx->waiting_list[pending.priority], &ctx->waiting_list_last[pending.priority],
-                    sx__new_job(ctx, k, pending.callback, pending.user, range_start, range_end,
-                                pending.counter, pending.tags, pending.priority));
-
-                range_start = range_end;
-                range_end += (pending.range_size + (pending.range_reminder > 0 ? 1 : 0));
-                --pending.range_reminder;
-            }
-
-            sx_semaphore_post(&ctx->sem, count);
+            sx_atomic_decr(&ctx->num_pending);
+            sx__job_push_dispatch(ctx, tdata, &pending);
             break;
         }
     }
 }
 
-static void sx__job_process_pending_single(sx_job_context* ctx, int index)
+static void sx__job_process_pending_single(sx_job_context* ctx, sx__job_thread_data* tdata,
+                                           sx_job_t counter)
 {
     sx_lock(&ctx->job_lk);
-    // unlike sx__job_process_pending, only check the specific index to push into job-list
-    sx__job_pending pending = ctx->pending[index];
-    if (!sx_pool_fulln(ctx->job_pool, *pending.counter)) {
-        sx_array_pop(ctx->pending, index);
-
-        int range_start = 0;
-        int range_end = pending.range_size + (pending.range_reminder > 0 ? 1 : 0);
-        --pending.range_reminder;
-
-        int count = *pending.counter;
-        for (int i = 0; i < count; i++) {
-            sx__job_add_list(
-                &ctx->waiting_list[pending.priority], &ctx->waiting_list_last[pending.priority],
-                sx__new_job(ctx, i, pending.callback, pending.user, range_start, range_end,
-                            pending.counter, pending.tags, pending.priority));
-
-            range_start = range_end;
-            range_end += (pending.range_size + (pending.range_reminder > 0 ? 1 : 0));
-            --pending.range_reminder;
+    // unlike sx__job_process_pending, only check the specific counter to push into job-list
+    for (int i = 0, c = sx_array_count(ctx->pending); i < c; i++) {
+        if (ctx->pending[i].counter == counter) {
+            sx__job_pending pending = ctx->pending[i];
+            if (!sx_pool_fulln(ctx->job_pool, pending.num_jobs)) {
+                sx_array_pop(ctx->pending, i);
+                sx_atomic_decr(&ctx->num_pending);
+                sx__job_push_dispatch(ctx, tdata, &pending);
+            }
+            break;
         }
-        sx_semaphore_post(&ctx->sem, count);
     }
     sx_unlock(&ctx->job_lk);
 }
@@ -422,33 +944,31 @@ static void sx__job_process_pending_single(sx_job_context* ctx, int index)
 void sx_job_wait_and_del(sx_job_context* ctx, sx_job_t job)
 {
     sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
+    sx_assert(!(tdata->cur_job && (tdata->cur_job->flags & SX_JOB_FLAG_LEAF)) &&
+              "leaf jobs (SX_JOB_FLAG_LEAF) cannot wait on other jobs");
 
-    uint64_t prev_tm = sx_cycle_clock();
+    tdata->last_tm = sx_tm_now();
     sx_compiler_read_barrier();
     while (*job > 0) {
+        int epoch = ctx->wake_epoch;
+        sx_memory_barrier();
+
         // check if the current job is the pending list
-        for (int i = 0, c = sx_array_count(ctx->pending); i < c; i++) {
-            if (ctx->pending[i].counter == job) {
-                sx__job_process_pending_single(ctx, i);
-                break;
-            }
-        }
+        if (ctx->num_pending > 0)
+            sx__job_process_pending_single(ctx, tdata, job);
 
         // If thread is running a job, make it slave to the thread so it can only be picked up by
-        // this thread And push the job back to waiting_list
+        // this thread And push the job back to thread's parked_list
         if (tdata->cur_job) {
             sx__job* cur_job = tdata->cur_job;
-            tdata->cur_job = NULL;
+            sx__job_trace_end(ctx, tdata->thread_index, cur_job, true);
+            sx__job_set_current(tdata, NULL);
             cur_job->owner_tid = tdata->tid;
 
-            sx_lock(&ctx->job_lk);
             int list_idx = cur_job->priority;
-            sx__job_add_list(&ctx->waiting_list[list_idx], &ctx->waiting_list_last[list_idx],
+            sx__job_add_list(&tdata->parked_list[list_idx], &tdata->parked_list_last[list_idx],
                              cur_job);
-            sx_unlock(&ctx->job_lk);
-
-            if (!tdata->main_thrd)
-                sx_semaphore_post(&ctx->sem, 1);
+            sx_atomic_incr(&ctx->num_parked);
         }
 
         sx_fiber_switch(tdata->selector_fiber, ctx);    // Switch to selector loop
@@ -457,22 +977,17 @@ void sx_job_wait_and_del(sx_job_context* ctx, sx_job_t job)
             tdata->selector_fiber = sx_fiber_create(tdata->selector_stack, sx__job_selector_main_thrd);
         }
 
-        uint64_t now_tm = sx_cycle_clock();
-        uint64_t diff = now_tm - prev_tm;
-        prev_tm = now_tm;
-        if (diff < SX__LOCK_MAXTIME) {
-            sx_yield_cpu();
-        }
+        // selector didn't find anything to do, spin/yield/park until there is new work
+        if (*job > 0 && tdata->select_misses > 0)
+            sx__job_idle(ctx, tdata, epoch);
     }
 
     // All jobs are done, Delete the counter
-    sx_lock(&ctx->counter_lk);
-    sx_pool_del(ctx->counter_pool, (void*)job);
-    sx_unlock(&ctx->counter_lk);
+    sx__job_del_counter(ctx, job);
 
     // auto-dispatch pending jobs
     sx_lock(&ctx->job_lk);
-    sx__job_process_pending(ctx);
+    sx__job_process_pending(ctx, tdata);
     sx_unlock(&ctx->job_lk);
 }
 
@@ -480,14 +995,15 @@ bool sx_job_test_and_del(sx_job_context* ctx, sx_job_t job)
 {
     sx_compiler_read_barrier();
     if (*job == 0) {
+        sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
+        sx_assert(tdata && "test_and_del must be called within main thread or job threads");
+
         // All jobs are done, Delete the counter
-        sx_lock(&ctx->counter_lk);
-        sx_pool_del(ctx->counter_pool, (void*)job);
-        sx_unlock(&ctx->counter_lk);
+        sx__job_del_counter(ctx, job);
 
         // auto-dispatch pending jobs
         sx_lock(&ctx->job_lk);
-        sx__job_process_pending(ctx);
+        sx__job_process_pending(ctx, tdata);
         sx_unlock(&ctx->job_lk);
         return true;
     }
@@ -495,8 +1011,214 @@ bool sx_job_test_and_del(sx_job_context* ctx, sx_job_t job)
     return false;
 }
 
+// Guided self-scheduling: every worker grabs a chunk that is proportional to the remaining
+// iterations, so chunks get smaller towards the end and idle workers can take a share of the
+// remaining work, which balances items with very different costs
+// Reference: https://dl.acm.org/doi/10.1109/TC.1987.5009495
+static void sx__job_parallel_for_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(range_start);
+    sx_unused(range_end);
+
+    sx__job_parallel_for* pfor = (sx__job_parallel_for*)user;
+    int count = pfor->count;
+    int grain_size = pfor->grain_size;
+    int divisor = pfor->num_jobs * 2;
+
+    for (;;) {
+        int remaining = count - pfor->cursor;
+        if (remaining <= 0)
+            break;
+        int chunk = sx_max(grain_size, remaining / divisor);
+        int start = sx_atomic_fetch_add(&pfor->cursor, chunk);
+        if (start >= count)
+            break;
+        int end = sx_min(start + chunk, count);
+        pfor->callback(start, end, thread_index, pfor->user);
+    }
+}
+
+static void sx__job_parallel_for_done(sx_job_context* ctx, sx__job_thread_data* tdata, void* user)
+{
+    sx_unused(tdata);
+    sx_poolmt_del(ctx->pfor_pool, user);
+}
+
+sx_job_t sx_job_parallel_for(sx_job_context* ctx, int count, int grain_size, sx_job_cb* callback,
+                             void* user, sx_job_priority priority, unsigned int tags,
+                             unsigned int flags)
+{
+    sx_assert(count > 0);
+
+    sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
+    sx_assert(tdata && "Dispatch must be called within main thread or job threads");
+
+    grain_size = sx_max(grain_size, 1);
+
+    int num_workers = 0;
+    if (tags != 0) {
+        for (int i = 0, ic = ctx->num_threads + 1; i < ic; i++) {
+            if (ctx->tags[i] & tags)
+                num_workers++;
+        }
+    } else {
+        num_workers = ctx->num_threads + 1;
+    }
+    // don't spawn more jobs than there are grains of work
+    int num_grains = (count + grain_size - 1) / grain_size;
+    int num_jobs = sx_min(num_workers, num_grains);
+    num_jobs = sx_max(num_jobs, 1);
+
+    sx_job_t counter = sx__job_new_counter(ctx);
+    sx__job_parallel_for* pfor =
+        (sx__job_parallel_for*)sx_poolmt_new(ctx->pfor_pool);
+    if (!counter || !pfor) {
+        sx_assert(0 && "Maximum job instances exceeded");
+        return NULL;
+    }
+
+    pfor->cursor = 0;
+    pfor->count = count;
+    pfor->grain_size = grain_size;
+    pfor->num_jobs = num_jobs;
+    pfor->callback = callback;
+    pfor->user = user;
+
+    if (tdata->cur_job)
+        tdata->cur_job->wait_counter = counter;
+
+    sx__job_pending desc = { .counter = counter,
+                             .callback = sx__job_parallel_for_cb,
+                             .user = pfor,
+                             .priority = priority,
+                             .tags = tags,
+                             .flags = flags,
+                             .done_cb = sx__job_parallel_for_done,
+                             .done_user = pfor };
+    sx__job_dispatch(ctx, tdata, num_jobs, &desc);
+
+    return counter;
+}
+
+sx_job_graph* sx_job_graph_create(const sx_alloc* alloc)
+{
+    sx_job_graph* graph = (sx_job_graph*)sx_malloc(alloc, sizeof(sx_job_graph));
+    if (!graph) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(graph, 0x0, sizeof(sx_job_graph));
+    graph->alloc = alloc;
+    return graph;
+}
+
+void sx_job_graph_destroy(sx_job_graph* graph, const sx_alloc* alloc)
+{
+    sx_assert(graph);
+    sx_assert(graph->alloc == alloc);
+
+    for (int i = 0, c = sx_array_count(graph->nodes); i < c; i++)
+        sx_array_free(alloc, graph->nodes[i].successors);
+    sx_array_free(alloc, graph->nodes);
+    sx_free(alloc, graph);
+}
+
+int sx_job_graph_add_node(sx_job_graph* graph, int count, sx_job_cb* callback, void* user,
+                          sx_job_priority priority, unsigned int tags, unsigned int flags)
+{
+    sx_assert(count > 0);
+    sx_assert(callback);
+
+    sx__job_graph_node node = { .callback = callback,
+                                .user = user,
+                                .count = count,
+                                .priority = priority,
+                                .tags = tags,
+                                .flags = flags };
+    sx_array_push(graph->alloc, graph->nodes, node);
+    return sx_array_count(graph->nodes) - 1;
+}
+
+void sx_job_graph_add_edge(sx_job_graph* graph, int from_node, int to_node)
+{
+    sx_assert(from_node >= 0 && from_node < sx_array_count(graph->nodes));
+    sx_assert(to_node >= 0 && to_node < sx_array_count(graph->nodes));
+    sx_assert(from_node != to_node);
+
+    sx_array_push(graph->alloc, graph->nodes[from_node].successors, to_node);
+    graph->nodes[to_node].num_preds++;
+}
+
+static void sx__job_graph_dispatch_node(sx_job_context* ctx, sx__job_thread_data* tdata,
+                                        sx__job_graph_node* node);
+
+// called by the thread that finishes the last job of the node, releases the successors
+static void sx__job_graph_node_done(sx_job_context* ctx, sx__job_thread_data* tdata, void* user)
+{
+    sx__job_graph_node* node = (sx__job_graph_node*)user;
+    sx_job_graph* graph = node->graph;
+
+    for (int i = 0, c = sx_array_count(node->successors); i < c; i++) {
+        sx__job_graph_node* succ = &graph->nodes[node->successors[i]];
+        if (sx_atomic_decr(&succ->num_preds_remaining) == 0)
+            sx__job_graph_dispatch_node(ctx, tdata, succ);
+    }
+
+    // decrement after releasing successors, so the graph counter never reaches zero early
+    sx_atomic_decr(graph->counter);
+}
+
+static void sx__job_graph_dispatch_node(sx_job_context* ctx, sx__job_thread_data* tdata,
+                                        sx__job_graph_node* node)
+{
+    sx__job_pending desc = { .counter = &node->counter,
+                             .callback = node->callback,
+                             .user = node->user,
+                             .priority = node->priority,
+                             .tags = node->tags,
+                             .flags = node->flags,
+                             .done_cb = sx__job_graph_node_done,
+                             .done_user = node };
+    sx__job_dispatch(ctx, tdata, node->count, &desc);
+}
+
+sx_job_t sx_job_graph_submit(sx_job_context* ctx, sx_job_graph* graph)
+{
+    int num_nodes = sx_array_count(graph->nodes);
+    sx_assert(num_nodes > 0);
+
+    sx__job_thread_data* tdata = (sx__job_thread_data*)sx_tls_get(ctx->thread_tls);
+    sx_assert(tdata && "Submit must be called within main thread or job threads");
+
+    sx_job_t counter = sx__job_new_counter(ctx);
+    if (!counter) {
+        sx_assert(0 && "Maximum job instances exceeded");
+        return NULL;
+    }
+    *counter = num_nodes;
+    graph->counter = counter;
+
+    if (tdata->cur_job)
+        tdata->cur_job->wait_counter = counter;
+
+    // reset all dependency counts before dispatching anything, root nodes may finish immediately
+    for (int i = 0; i < num_nodes; i++) {
+        sx__job_graph_node* node = &graph->nodes[i];
+        node->num_preds_remaining = node->num_preds;
+        node->counter = 0;
+        node->graph = graph;
+    }
+
+    for (int i = 0; i < num_nodes; i++) {
+        if (graph->nodes[i].num_preds == 0)
+            sx__job_graph_dispatch_node(ctx, tdata, &graph->nodes[i]);
+    }
+
+    return counter;
+}
+
 static sx__job_thread_data* sx__job_create_tdata(const sx_alloc* alloc, uint32_t tid, int index,
-                                                 bool main_thrd)
+                                                 bool main_thrd, int stack_sz)
 {
     sx__job_thread_data* tdata =
         (sx__job_thread_data*)sx_malloc(alloc, sizeof(sx__job_thread_data));
@@ -510,7 +1232,9 @@ static sx__job_thread_data* sx__job_create_tdata(const sx_alloc* alloc, uint32_t
     tdata->tags = 0xffffffff;
     tdata->main_thrd = main_thrd;
 
-    bool r = sx_fiber_stack_init(&tdata->selector_stack, (int)sx_os_minstacksz());
+    // selector stack is also used for running leaf jobs, so it's as big as job stacks
+    // note that stack memory is virtual and only the pages that are used get committed
+    bool r = sx_fiber_stack_init(&tdata->selector_stack, stack_sz);
     sx_assert(r && "Not enough memory for temp stacks");
     sx_unused(r);
 
@@ -532,12 +1256,21 @@ static int sx__job_thread_fn(void* user1, void* user2)
 
     // Create thread data
     // note: thread index #0 is reserved for main thread
-    sx__job_thread_data* tdata = sx__job_create_tdata(ctx->alloc, thread_id, index + 1, false);
+    sx__job_thread_data* tdata =
+        sx__job_create_tdata(ctx->alloc, thread_id, index + 1, false, ctx->stack_sz);
     if (!tdata) {
         sx_assert(tdata && "ThreadData create failed!");
         return -1;
     }
     sx_tls_set(ctx->thread_tls, tdata);
+    ctx->tdatas[index + 1] = tdata;
+
+    // pinning and topology tags, see sx__job_assign_cpus
+    if (ctx->thread_cpus) {
+        bool r = sx_thread_setaffinity(ctx->thread_cpus[index + 1]);
+        sx_unused(r);
+    }
+    tdata->tags = ctx->tags[index + 1];
 
     if (ctx->thread_init_cb)
         ctx->thread_init_cb(ctx, index, thread_id, ctx->thread_user);
@@ -547,6 +1280,7 @@ static int sx__job_thread_fn(void* user1, void* user2)
     sx_fiber_switch(fiber, ctx);
 
     sx_tls_set(ctx->thread_tls, NULL);
+    ctx->tdatas[index + 1] = NULL;
     sx__job_destroy_tdata(tdata, ctx->alloc);
     if (ctx->thread_shutdown_cb)
         ctx->thread_shutdown_cb(ctx, index, thread_id, ctx->thread_user);
@@ -554,6 +1288,41 @@ static int sx__job_thread_fn(void* user1, void* user2)
     return 0;
 }
 
+// assigns logical cpus for pinning the worker threads and their topology tags
+// slot #0 (main thread's physical core in most cases) is left for the main thread, which is
+// owned by the application and never pinned
+static bool sx__job_assign_cpus(sx_job_context* ctx, const sx_job_context_desc* desc,
+                                const sx_os_cpu* cpus, int num_cpus)
+{
+    // order: first hardware-thread of every physical core, then the second one, and so on
+    int* slots = (int*)alloca(sizeof(int) * num_cpus);
+    int num_slots = 0;
+    int max_smt = desc->pin_mode == SX_JOB_PIN_PHYSICAL ? 1 : num_cpus;
+    for (int smt = 0; smt < max_smt && num_slots < num_cpus; smt++) {
+        for (int i = 0; i < num_cpus; i++) {
+            if (cpus[i].smt == smt)
+                slots[num_slots++] = i;
+        }
+    }
+
+    ctx->thread_cpus = (int*)sx_malloc(ctx->alloc, sizeof(int) * ((size_t)ctx->num_threads + 1));
+    if (!ctx->thread_cpus) {
+        sx_out_of_memory();
+        return false;
+    }
+
+    ctx->thread_cpus[0] = -1;
+    for (int i = 1; i <= ctx->num_threads; i++) {
+        const sx_os_cpu* cpu = &cpus[slots[i % num_slots]];
+        ctx->thread_cpus[i] = cpu->id;
+        if (desc->topology_tags == SX_JOB_TOPOLOGY_TAGS_SOCKET)
+            ctx->tags[i] = 1u << (cpu->socket % 32);
+        else if (desc->topology_tags == SX_JOB_TOPOLOGY_TAGS_CACHE)
+            ctx->tags[i] = 1u << (cpu->cache % 32);
+    }
+    return true;
+}
+
 sx_job_context* sx_job_create_context(const sx_alloc* alloc, const sx_job_context_desc* desc)
 {
     sx_job_context* ctx = (sx_job_context*)sx_malloc(alloc, sizeof(sx_job_context));
@@ -564,7 +1333,23 @@ sx_job_context* sx_job_create_context(const sx_alloc* alloc, const sx_job_contex
     sx_memset(ctx, 0x0, sizeof(sx_job_context));
 
     ctx->alloc = alloc;
-    ctx->num_threads = desc->num_threads > 0 ? desc->num_threads : (sx_os_numcores() - 1);
+    int num_cpus = 0;
+    sx_os_cpu* cpus = NULL;
+    if (desc->pin_mode != SX_JOB_PIN_NONE) {
+        cpus = (sx_os_cpu*)alloca(sizeof(sx_os_cpu) * sx_os_numcores());
+        num_cpus = sx_os_cpu_topology(cpus, sx_os_numcores());
+    }
+
+    if (desc->num_threads > 0) {
+        ctx->num_threads = desc->num_threads;
+    } else if (desc->pin_mode == SX_JOB_PIN_PHYSICAL) {
+        int num_cores = 0;
+        for (int i = 0; i < num_cpus; i++)
+            num_cores += cpus[i].smt == 0 ? 1 : 0;
+        ctx->num_threads = num_cores - 1;
+    } else {
+        ctx->num_threads = sx_os_numcores() - 1;
+    }
     ctx->thread_tls = sx_tls_create();
     ctx->stack_sz = desc->fiber_stack_sz > 0 ? desc->fiber_stack_sz : DEFAULT_FIBER_STACK_SIZE;
     ctx->thread_init_cb = desc->thread_init_cb;
@@ -572,9 +1357,13 @@ sx_job_context* sx_job_create_context(const sx_alloc* alloc, const sx_job_contex
     ctx->thread_user = desc->thread_user_data;
     int max_fibers = desc->max_fibers > 0 ? desc->max_fibers : DEFAULT_MAX_FIBERS;
 
-    sx_semaphore_init(&ctx->sem);
+    ctx->spin_count = desc->spin_count > 0 ? desc->spin_count
+                                           : (desc->spin_count < 0 ? 0 : DEFAULT_SPIN_COUNT);
+    ctx->yield_count = desc->yield_count > 0 ? desc->yield_count
+                                             : (desc->yield_count < 0 ? 0 : DEFAULT_YIELD_COUNT);
 
-    sx__job_thread_data* main_tdata = sx__job_create_tdata(alloc, sx_thread_tid(), 0, true);
+    sx__job_thread_data* main_tdata =
+        sx__job_create_tdata(alloc, sx_thread_tid(), 0, true, ctx->stack_sz);
     if (!main_tdata) {
         sx_free(alloc, ctx);
         return NULL;
@@ -585,15 +1374,72 @@ sx_job_context* sx_job_create_context(const sx_alloc* alloc, const sx_job_contex
 
     // pools
     ctx->job_pool = sx_pool_create(alloc, sizeof(sx__job), max_fibers);
-    ctx->counter_pool = sx_pool_create(alloc, sizeof(int), COUNTER_POOL_SIZE);
-    if (!ctx->job_pool || !ctx->counter_pool)
+    ctx->counter_pool = sx_poolmt_create(alloc, sizeof(int), COUNTER_POOL_SIZE, 0);
+    ctx->pfor_pool =
+        sx_poolmt_create(alloc, sizeof(sx__job_parallel_for), PARALLEL_FOR_POOL_SIZE, 0);
+    if (!ctx->job_pool || !ctx->counter_pool || !ctx->pfor_pool)
         return NULL;
     sx_memset(ctx->job_pool->pages->buff, 0x0, sizeof(sx__job) * max_fibers);
 
+    // work-stealing deques: one per thread (including main thread) for each priority
+    int num_deques = (ctx->num_threads + 1) * SX_JOB_PRIORITY_COUNT;
+    ctx->deques = (sx__job_deque*)sx_aligned_malloc(alloc, sizeof(sx__job_deque) * num_deques,
+                                                    SX_CACHE_LINE_SIZE);
+    if (!ctx->deques) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(ctx->deques, 0x0, sizeof(sx__job_deque) * num_deques);
+    for (int i = 0; i < num_deques; i++) {
+        if (!sx__job_deque_init(&ctx->deques[i], alloc, ctx->job_pool->capacity + 1))
+            return NULL;
+    }
+
+    ctx->inboxes = (sx__job_inbox*)sx_aligned_malloc(
+        alloc, sizeof(sx__job_inbox) * ((size_t)ctx->num_threads + 1), SX_CACHE_LINE_SIZE);
+    if (!ctx->inboxes) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(ctx->inboxes, 0x0, sizeof(sx__job_inbox) * ((size_t)ctx->num_threads + 1));
+
     // keep tags in an array for evaluating num_jobs
     ctx->tags = sx_malloc(alloc, sizeof(uint32_t) * ((size_t)ctx->num_threads + 1));
     sx_memset(ctx->tags, 0xff, sizeof(uint32_t) * ((size_t)ctx->num_threads + 1));
 
+    if (num_cpus > 0 && ctx->num_threads > 0) {
+        if (!sx__job_assign_cpus(ctx, desc, cpus, num_cpus))
+            return NULL;
+    }
+
+    ctx->tdatas = sx_malloc(alloc, sizeof(sx__job_thread_data*) * ((size_t)ctx->num_threads + 1));
+    if (!ctx->tdatas) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(ctx->tdatas, 0x0, sizeof(sx__job_thread_data*) * ((size_t)ctx->num_threads + 1));
+    ctx->tdatas[0] = main_tdata;
+
+#if SX_CONFIG_JOB_TRACE
+    ctx->traces = (sx__job_trace_buffer*)sx_aligned_malloc(
+        alloc, sizeof(sx__job_trace_buffer) * ((size_t)ctx->num_threads + 1), SX_CACHE_LINE_SIZE);
+    if (!ctx->traces) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    for (int i = 0; i < ctx->num_threads + 1; i++) {
+        ctx->traces[i].head = 0;
+        ctx->traces[i].tail = 0;
+        ctx->traces[i].events = (sx__job_trace_event*)sx_malloc(
+            alloc, sizeof(sx__job_trace_event) * SX_CONFIG_JOB_TRACE_EVENTS);
+        if (!ctx->traces[i].events) {
+            sx_out_of_memory();
+            return NULL;
+        }
+    }
+    ctx->trace_start_tm = sx_tm_now();
+#endif
+
     // Worker threads
     if (ctx->num_threads > 0) {
         ctx->threads = (sx_thread**)sx_malloc(alloc, sizeof(sx_thread*) * ctx->num_threads);
@@ -618,8 +1464,8 @@ void sx_job_destroy_context(sx_job_context* ctx, const sx_alloc* alloc)
 
     // signal selectors to finish the job and quit
     ctx->quit = 1;
-    sx_compiler_write_barrier();
-    sx_semaphore_post(&ctx->sem, ctx->num_threads + 1);
+    sx_memory_barrier();
+    sx__job_wake(ctx, INT_MAX);
 
     // shutdown threads
     for (int i = 0; i < ctx->num_threads; i++) sx_thread_destroy(ctx->threads[i], alloc);
@@ -629,11 +1475,25 @@ void sx_job_destroy_context(sx_job_context* ctx, const sx_alloc* alloc)
 
     // TODO: destroy job_pool's stack memories
     sx_pool_destroy(ctx->job_pool, alloc);
-    sx_pool_destroy(ctx->counter_pool, alloc);
-    sx_semaphore_release(&ctx->sem);
+    sx_poolmt_destroy(ctx->counter_pool, alloc);
+    sx_poolmt_destroy(ctx->pfor_pool, alloc);
+
+    for (int i = 0, c = (ctx->num_threads + 1) * SX_JOB_PRIORITY_COUNT; i < c; i++)
+        sx__job_deque_release(&ctx->deques[i], alloc);
+    sx_aligned_free(alloc, ctx->deques, SX_CACHE_LINE_SIZE);
+    sx_aligned_free(alloc, ctx->inboxes, SX_CACHE_LINE_SIZE);
 
     sx_free(alloc, ctx->tags);
+    sx_free(alloc, ctx->tdatas);
+    if (ctx->thread_cpus)
+        sx_free(alloc, ctx->thread_cpus);
     sx_array_free(alloc, ctx->pending);
+
+#if SX_CONFIG_JOB_TRACE
+    for (int i = 0; i < ctx->num_threads + 1; i++)
+        sx_free(alloc, ctx->traces[i].events);
+    sx_aligned_free(alloc, ctx->traces, SX_CACHE_LINE_SIZE);
+#endif
     sx_free(alloc, ctx);
 }
 
@@ -663,3 +1523,138 @@ unsigned int sx_job_thread_id(sx_job_context* ctx)
     sx_assert(tdata);
     return tdata->tid;
 }
+
+void sx_job_get_thread_stats(sx_job_context* ctx, int thread_index, sx_job_thread_stats* stats)
+{
+    sx_assert(thread_index >= 0 && thread_index <= ctx->num_threads);
+    sx_assert(stats);
+
+    // stats are only written by the owner thread, so we may read slightly old values here
+    sx__job_thread_data* tdata = ctx->tdatas[thread_index];
+    if (tdata)
+        *stats = tdata->stats;
+    else
+        sx_memset(stats, 0x0, sizeof(*stats));
+}
+
+void sx_job_quiescent_snapshot(sx_job_context* ctx, int* snapshot)
+{
+    sx_assert(snapshot);
+
+    // full barrier: everything that is retired before the snapshot is visible to the jobs that
+    // start after it
+    sx_memory_barrier();
+    for (int i = 0; i <= ctx->num_threads; i++) {
+        sx__job_thread_data* tdata = ctx->tdatas[i];
+        snapshot[i] = tdata ? tdata->qs_seq : 0;
+    }
+}
+
+bool sx_job_quiescent_passed(sx_job_context* ctx, const int* snapshot)
+{
+    sx_assert(snapshot);
+
+    for (int i = 0; i <= ctx->num_threads; i++) {
+        sx__job_thread_data* tdata = ctx->tdatas[i];
+        if ((snapshot[i] & 1) && tdata && tdata->qs_seq == snapshot[i])
+            return false;
+    }
+    // full barrier: reads of the jobs are done before the caller frees anything
+    sx_memory_barrier();
+    return true;
+}
+
+#if SX_CONFIG_JOB_TRACE
+static void sx__job_trace_write_event(sx_file* f, sx_job_context* ctx, int thread_index,
+                                      const sx__job_trace_event* e, bool* first)
+{
+    char line[512];
+    int len;
+    double ts = e->tm > ctx->trace_start_tm ? sx_tm_us(e->tm - ctx->trace_start_tm) : 0;
+    const char* sep = *first ? "" : ",\n";
+    *first = false;
+
+    if (e->type == SX__JOB_TRACE_DISPATCH) {
+        // instant event on the dispatcher thread, plus the start of a flow arrow to the first run
+        len = sx_snprintf(line, sizeof(line),
+                          "%s{\"name\":\"dispatch\",\"cat\":\"job\",\"ph\":\"i\",\"s\":\"t\","
+                          "\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"job\":%u,\"range\":\"%d-%d\"}},\n"
+                          "{\"name\":\"job\",\"cat\":\"job\",\"ph\":\"s\",\"id\":%u,\"ts\":%.3f,"
+                          "\"pid\":0,\"tid\":%d}",
+                          sep, ts, thread_index, e->job_id, e->range_start, e->range_end,
+                          e->job_id, ts, thread_index);
+    } else {
+        len = sx_snprintf(line, sizeof(line),
+                          "%s{\"name\":\"job(%p)\",\"cat\":\"job\",\"ph\":\"X\",\"ts\":%.3f,"
+                          "\"dur\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"job\":%u,\"range\":\"%d-%d\","
+                          "\"begin\":\"%s\",\"end\":\"%s\"}}",
+                          sep, (void*)(uintptr_t)e->callback, ts, sx_tm_us(e->duration),
+                          thread_index, e->job_id, e->range_start, e->range_end,
+                          e->resumed ? "resume" : "start", e->waited ? "wait" : "finish");
+        if (!e->resumed && len > 0 && len < (int)sizeof(line)) {
+            len += sx_snprintf(line + len, sizeof(line) - (size_t)len,
+                               ",\n{\"name\":\"job\",\"cat\":\"job\",\"ph\":\"f\",\"bp\":\"e\","
+                               "\"id\":%u,\"ts\":%.3f,\"pid\":0,\"tid\":%d}",
+                               e->job_id, ts, thread_index);
+        }
+    }
+
+    if (len > 0)
+        sx_file_write(f, line, sx_min(len, (int)sizeof(line) - 1));
+}
+
+bool sx_job_trace_dump(sx_job_context* ctx, const char* filepath)
+{
+    sx_assert(filepath);
+
+    sx_file f;
+    if (!sx_file_open(&f, filepath, SX_FILE_WRITE))
+        return false;
+
+    sx_file_write_text(&f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (int i = 0; i < ctx->num_threads + 1; i++) {
+        char line[128];
+        int len = sx_snprintf(line, sizeof(line),
+                              "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+                              "\"args\":{\"name\":\"%s(%d)\"}}",
+                              first ? "" : ",\n", i, i == 0 ? "main" : "sx_job_thread", i);
+        sx_file_write(&f, line, len);
+        first = false;
+
+        const sx__job_trace_buffer* buff = &ctx->traces[i];
+        uint32_t head = buff->head;
+        sx_compiler_read_barrier();
+        uint32_t start = head - buff->tail > SX_CONFIG_JOB_TRACE_EVENTS
+                             ? head - SX_CONFIG_JOB_TRACE_EVENTS
+                             : buff->tail;
+        for (uint32_t k = start; k < head; k++) {
+            sx__job_trace_write_event(&f, ctx, i,
+                                      &buff->events[k & (SX_CONFIG_JOB_TRACE_EVENTS - 1)], &first);
+        }
+    }
+    sx_file_write_text(&f, "\n]}\n");
+    sx_file_close(&f);
+    return true;
+}
+
+void sx_job_trace_reset(sx_job_context* ctx)
+{
+    // only move the read position, so threads can keep writing into their buffers
+    for (int i = 0; i < ctx->num_threads + 1; i++)
+        ctx->traces[i].tail = ctx->traces[i].head;
+    ctx->trace_start_tm = sx_tm_now();
+}
+#else
+bool sx_job_trace_dump(sx_job_context* ctx, const char* filepath)
+{
+    sx_unused(ctx);
+    sx_unused(filepath);
+    return false;
+}
+
+void sx_job_trace_reset(sx_job_context* ctx)
+{
+    sx_unused(ctx);
+}
+#endif    // SX_CONFIG_JOB_TRACE
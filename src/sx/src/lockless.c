@@ -1,6 +1,8 @@
 #include "sx/lockless.h"
 #include "sx/atomic.h"
 #include "sx/allocator.h"
+#include "sx/math.h"
+#include "sx/threads.h"
 
 // single producer/single consumer - self contained queue
 // Reference:
@@ -122,10 +124,39 @@ void sx_queue_spsc_destroy(sx_queue_spsc* queue, const sx_alloc* alloc)
     sx_free(alloc, queue);
 }
 
+// consumed nodes go back to the free list of the buffer that they are allocated from, so a free
+// list never gets more than `capacity` nodes, no matter which buffer new nodes are taken from
+static void sx__queue_spsc_release(sx_queue_spsc* queue, sx__queue_spsc_node* node)
+{
+    size_t buff_sz = (sizeof(sx__queue_spsc_node) + (size_t)queue->stride) * queue->capacity;
+    uint8_t* ptr = (uint8_t*)node;
+    if (ptr >= queue->buff && ptr < queue->buff + buff_sz) {
+        sx_assert(queue->iter < queue->capacity);
+        queue->ptrs[queue->iter++] = node;
+        return;
+    }
+
+    for (sx__queue_spsc_bin* bin = queue->grow_bins; bin; bin = bin->next) {
+        if (ptr >= bin->buff && ptr < bin->buff + buff_sz) {
+            sx_assert(bin->iter < queue->capacity);
+            bin->ptrs[bin->iter++] = node;
+            return;
+        }
+    }
+    sx_assert_rel(0 && "sx_queue_spsc: node does not belong to the queue");
+}
+
 bool sx_queue_spsc_produce(sx_queue_spsc* queue, const void* data)
 {
+    // trim/remove the nodes that are consumed, before looking for a free one, so the queue only
+    // grows when it's really full
+    while (queue->first != queue->divider) {
+        sx__queue_spsc_node* first = (sx__queue_spsc_node*)queue->first;
+        queue->first = first->next;
+        sx__queue_spsc_release(queue, first);
+    }
+
     sx__queue_spsc_node* node = NULL;
-    sx__queue_spsc_bin* node_bin = NULL;
     if (queue->iter > 0) {
         node = queue->ptrs[--queue->iter];
     } else {
@@ -134,7 +165,6 @@ bool sx_queue_spsc_produce(sx_queue_spsc* queue, const void* data)
         while (bin && !node) {
             if (bin->iter > 0) {
                 node = bin->ptrs[--bin->iter];
-                node_bin = bin;
             }
             bin = bin->next;
         }
@@ -148,20 +178,6 @@ bool sx_queue_spsc_produce(sx_queue_spsc* queue, const void* data)
         last->next = node;
 
         sx_atomic_xchg_ptr(&queue->last, node);
-
-        // trim/remove un-used nodes
-        while (queue->first != queue->divider) {
-            sx__queue_spsc_node* first = (sx__queue_spsc_node*)queue->first;
-            queue->first = first->next;
-
-            if (!node_bin) {
-                sx_assert(queue->iter != queue->capacity);
-                queue->ptrs[queue->iter++] = first;
-            } else {
-                sx_assert(node_bin->iter != queue->capacity);
-                node_bin->ptrs[node_bin->iter++] = node;
-            }
-        }
         return true;
     } else {
         return false;
@@ -217,3 +233,297 @@ bool sx_queue_spsc_full(const sx_queue_spsc* queue)
 }
 
 
+// x86 does not reorder stores with older loads/stores, so publishing a cell after copying the
+// data only needs a compiler barrier
+#if SX_CPU_X86
+#    define sx__queue_publish_barrier() sx_compiler_write_barrier()
+#else
+#    define sx__queue_publish_barrier() sx_memory_write_barrier()
+#endif
+
+// multi producer/multi consumer - bounded queue
+// Every cell has a sequence number, that tells which lap of the ring the cell is ready for:
+//      seq == pos      cell is free for the producer of 'pos'
+//      seq == pos + 1  cell is filled and ready for the consumer of 'pos'
+// Positions are claimed with a CAS on enqueue_pos/dequeue_pos, and the sequence is updated after
+// the data is copied
+#if SX_ARCH_64BIT
+typedef int64_t sx__queue_pos;
+typedef uint64_t sx__queue_upos;
+#else
+typedef int sx__queue_pos;
+typedef uint32_t sx__queue_upos;
+#endif
+
+typedef struct sx_queue_mpmc {
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_atomic_size) enqueue_pos;
+    sx_align_decl(SX_CACHE_LINE_SIZE, sx_atomic_size) dequeue_pos;
+    sx_align_decl(SX_CACHE_LINE_SIZE, uint8_t*) cells;    // [seq, data] * capacity
+    int mask;
+    int item_sz;
+    int stride;
+} sx_queue_mpmc;
+
+// difference of two positions, the queue can wrap around the integer range
+static inline sx__queue_pos sx__queue_diff(sx__queue_pos a, sx__queue_pos b)
+{
+    return (sx__queue_pos)((sx__queue_upos)a - (sx__queue_upos)b);
+}
+
+static inline uint8_t* sx__queue_mpmc_cell(const sx_queue_mpmc* queue, sx__queue_pos pos)
+{
+    return queue->cells + (size_t)queue->stride * (size_t)(pos & (sx__queue_pos)queue->mask);
+}
+
+static inline sx_atomic_size* sx__queue_mpmc_seq(uint8_t* cell)
+{
+    return (sx_atomic_size*)cell;
+}
+
+static inline uint8_t* sx__queue_mpmc_data(uint8_t* cell)
+{
+    return cell + sizeof(sx_atomic_size);
+}
+
+// waits for a cell that is claimed by another thread, but it's not done copying yet
+static void sx__queue_mpmc_wait(uint8_t* cell, sx__queue_pos seq)
+{
+    int counter = 0;
+    while (*sx__queue_mpmc_seq(cell) != seq) {
+        if ((++counter & 0xf) == 0) {
+            sx_thread_yield();
+        } else {
+            sx_yield_cpu();
+        }
+    }
+}
+
+sx_queue_mpmc* sx_queue_mpmc_create(const sx_alloc* alloc, int item_sz, int capacity)
+{
+    sx_assert(item_sz > 0);
+    sx_assert(capacity > 1);
+
+    capacity = sx_nearest_pow2(capacity);
+    int stride = sx_align_mask((int)sizeof(sx_atomic_size) + item_sz, (int)sizeof(sx_atomic_size) - 1);
+    uint8_t* buff = (uint8_t*)sx_aligned_malloc(
+        alloc, sizeof(sx_queue_mpmc) + (size_t)stride * (size_t)capacity, SX_CACHE_LINE_SIZE);
+    if (!buff) {
+        sx_out_of_memory();
+        return NULL;
+    }
+
+    sx_queue_mpmc* queue = (sx_queue_mpmc*)buff;
+    sx_memset(queue, 0x0, sizeof(sx_queue_mpmc));
+    queue->cells = buff + sizeof(sx_queue_mpmc);
+    queue->mask = capacity - 1;
+    queue->item_sz = item_sz;
+    queue->stride = stride;
+
+    for (int i = 0; i < capacity; i++) {
+        *sx__queue_mpmc_seq(sx__queue_mpmc_cell(queue, i)) = i;
+    }
+
+    return queue;
+}
+
+void sx_queue_mpmc_destroy(sx_queue_mpmc* queue, const sx_alloc* alloc)
+{
+    sx_assert(queue);
+    sx_aligned_free(alloc, queue, SX_CACHE_LINE_SIZE);
+}
+
+bool sx_queue_mpmc_produce(sx_queue_mpmc* queue, const void* data)
+{
+    sx__queue_pos pos = queue->enqueue_pos;
+    uint8_t* cell;
+    for (;;) {
+        cell = sx__queue_mpmc_cell(queue, pos);
+        sx__queue_pos diff = sx__queue_diff(*sx__queue_mpmc_seq(cell), pos);
+        if (diff == 0) {
+            sx__queue_pos cur = sx_atomic_cas_size(&queue->enqueue_pos, pos + 1, pos);
+            if (cur == pos) {
+                break;
+            }
+            pos = cur;
+        } else if (diff < 0) {
+            return false;    // full
+        } else {
+            pos = queue->enqueue_pos;
+        }
+    }
+
+    sx_memcpy(sx__queue_mpmc_data(cell), data, queue->item_sz);
+    sx__queue_publish_barrier();
+    *sx__queue_mpmc_seq(cell) = pos + 1;
+    return true;
+}
+
+bool sx_queue_mpmc_consume(sx_queue_mpmc* queue, void* data)
+{
+    sx__queue_pos pos = queue->dequeue_pos;
+    uint8_t* cell;
+    for (;;) {
+        cell = sx__queue_mpmc_cell(queue, pos);
+        sx__queue_pos diff = sx__queue_diff(*sx__queue_mpmc_seq(cell), pos + 1);
+        if (diff == 0) {
+            sx__queue_pos cur = sx_atomic_cas_size(&queue->dequeue_pos, pos + 1, pos);
+            if (cur == pos) {
+                break;
+            }
+            pos = cur;
+        } else if (diff < 0) {
+            return false;    // empty
+        } else {
+            pos = queue->dequeue_pos;
+        }
+    }
+
+    sx_memcpy(data, sx__queue_mpmc_data(cell), queue->item_sz);
+    sx__queue_publish_barrier();
+    *sx__queue_mpmc_seq(cell) = pos + queue->mask + 1;
+    return true;
+}
+
+int sx_queue_mpmc_produce_batch(sx_queue_mpmc* queue, const void* items, int count)
+{
+    sx__queue_pos pos = queue->enqueue_pos;
+    int n;
+    for (;;) {
+        // consumers may still be copying some of the claimed cells, we wait for them below
+        sx__queue_pos used = sx__queue_diff(pos, queue->dequeue_pos);
+        n = (int)sx_min((sx__queue_pos)count, (sx__queue_pos)queue->mask + 1 - used);
+        if (n <= 0) {
+            return 0;
+        }
+
+        sx__queue_pos cur = sx_atomic_cas_size(&queue->enqueue_pos, pos + n, pos);
+        if (cur == pos) {
+            break;
+        }
+        pos = cur;
+    }
+
+    for (int i = 0; i < n; i++) {
+        sx__queue_mpmc_wait(sx__queue_mpmc_cell(queue, pos + i), pos + i);
+    }
+    sx_memory_barrier();    // consumers' reads of the last lap must complete before we overwrite
+
+    const uint8_t* src = (const uint8_t*)items;
+    for (int i = 0; i < n; i++) {
+        sx_memcpy(sx__queue_mpmc_data(sx__queue_mpmc_cell(queue, pos + i)), src, queue->item_sz);
+        src += queue->item_sz;
+    }
+    sx__queue_publish_barrier();
+    for (int i = 0; i < n; i++) {
+        *sx__queue_mpmc_seq(sx__queue_mpmc_cell(queue, pos + i)) = pos + i + 1;
+    }
+    return n;
+}
+
+int sx_queue_mpmc_consume_batch(sx_queue_mpmc* queue, void* items, int count)
+{
+    sx__queue_pos pos = queue->dequeue_pos;
+    int n;
+    for (;;) {
+        // producers may still be copying some of the claimed cells, we wait for them below
+        sx__queue_pos avail = sx__queue_diff(queue->enqueue_pos, pos);
+        n = (int)sx_min((sx__queue_pos)count, avail);
+        if (n <= 0) {
+            return 0;
+        }
+
+        sx__queue_pos cur = sx_atomic_cas_size(&queue->dequeue_pos, pos + n, pos);
+        if (cur == pos) {
+            break;
+        }
+        pos = cur;
+    }
+
+    for (int i = 0; i < n; i++) {
+        sx__queue_mpmc_wait(sx__queue_mpmc_cell(queue, pos + i), pos + i + 1);
+    }
+    sx_memory_read_barrier();
+
+    uint8_t* dst = (uint8_t*)items;
+    for (int i = 0; i < n; i++) {
+        sx_memcpy(dst, sx__queue_mpmc_data(sx__queue_mpmc_cell(queue, pos + i)), queue->item_sz);
+        dst += queue->item_sz;
+    }
+    sx__queue_publish_barrier();
+    for (int i = 0; i < n; i++) {
+        *sx__queue_mpmc_seq(sx__queue_mpmc_cell(queue, pos + i)) = pos + i + queue->mask + 1;
+    }
+    return n;
+}
+
+int sx_queue_mpmc_count(const sx_queue_mpmc* queue)
+{
+    sx__queue_pos count = sx__queue_diff(queue->enqueue_pos, queue->dequeue_pos);
+    return (int)sx_clamp(count, (sx__queue_pos)0, (sx__queue_pos)queue->mask + 1);
+}
+
+// multi producer/single consumer - intrusive node based queue
+// producers only do a single exchange on 'head', the consumer owns 'tail'. 'stub' is put back into
+// the queue whenever the consumer reaches the last node, so the last node can be consumed too
+void sx_queue_mpsc_init(sx_queue_mpsc* queue)
+{
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+void sx_queue_mpsc_produce_batch(sx_queue_mpsc* queue, sx_queue_mpsc_node* first,
+                                 sx_queue_mpsc_node* last)
+{
+    last->next = NULL;
+    sx_queue_mpsc_node* prev =
+        (sx_queue_mpsc_node*)sx_atomic_xchg_ptr((sx_atomic_ptr*)&queue->head, last);
+    // the queue is 'broken' between the exchange and this store, consume returns NULL meanwhile
+    prev->next = first;
+}
+
+void sx_queue_mpsc_produce(sx_queue_mpsc* queue, sx_queue_mpsc_node* node)
+{
+    sx_queue_mpsc_produce_batch(queue, node, node);
+}
+
+sx_queue_mpsc_node* sx_queue_mpsc_consume(sx_queue_mpsc* queue)
+{
+    sx_queue_mpsc_node* tail = queue->tail;
+    sx_queue_mpsc_node* next = tail->next;
+    if (tail == &queue->stub) {
+        if (!next) {
+            return NULL;
+        }
+        queue->tail = next;
+        tail = next;
+        next = next->next;
+    }
+
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+
+    if (tail != queue->head) {
+        return NULL;    // a producer is not done yet
+    }
+
+    sx_queue_mpsc_produce(queue, &queue->stub);
+    next = tail->next;
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+int sx_queue_mpsc_consume_batch(sx_queue_mpsc* queue, sx_queue_mpsc_node** nodes, int count)
+{
+    int n = 0;
+    sx_queue_mpsc_node* node;
+    while (n < count && (node = sx_queue_mpsc_consume(queue)) != NULL) {
+        nodes[n++] = node;
+    }
+    return n;
+}
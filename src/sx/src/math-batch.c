@@ -0,0 +1,1068 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+#include "sx/math-batch.h"
+#include "sx/os.h"
+
+#include <string.h>    // memcpy
+
+// Kernels are written once for 4-wide vectors (sx__f4), which maps to SSE2 or NEON.
+// On x86, there is another set of 8-wide kernels that is compiled for AVX2+FMA and selected at
+// runtime. Every kernel takes the start index and returns the index that it stopped at, so the
+// remaining items are passed to the narrower kernel, and finally to scalar code.
+#if !SX_CONFIG_SIMD_DISABLE && \
+    (defined(__SSE2__) || (SX_COMPILER_MSVC && (SX_ARCH_64BIT || _M_IX86_FP >= 2)))
+#    include <emmintrin.h>
+#    define SX__BATCH_SSE2 1
+#    define SX__BATCH_NEON 0
+#    if SX_COMPILER_GCC || SX_COMPILER_CLANG
+#        include <immintrin.h>
+#        define SX__BATCH_AVX2 1
+#        define SX__BATCH_TARGET_AVX2 __attribute__((__target__("avx2,fma")))
+#    elif SX_COMPILER_MSVC
+#        include <immintrin.h>
+#        define SX__BATCH_AVX2 1
+#        define SX__BATCH_TARGET_AVX2
+#    else
+#        define SX__BATCH_AVX2 0
+#    endif
+#elif !SX_CONFIG_SIMD_DISABLE && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#    include <arm_neon.h>
+#    define SX__BATCH_SSE2 0
+#    define SX__BATCH_NEON 1
+#    define SX__BATCH_AVX2 0
+#else
+#    define SX__BATCH_SSE2 0
+#    define SX__BATCH_NEON 0
+#    define SX__BATCH_AVX2 0
+#endif
+
+#define SX__BATCH_SIMD (SX__BATCH_SSE2 || SX__BATCH_NEON)
+
+static_assert(sizeof(sx_tx3d) == 48, "sx_tx3d should be 12 tightly packed floats");
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// scalar
+static inline void sx__aabb_transform_scalar(float* dst, const float* src, const sx_mat4* m)
+{
+    float cx = (src[0] + src[3]) * 0.5f;
+    float cy = (src[1] + src[4]) * 0.5f;
+    float cz = (src[2] + src[5]) * 0.5f;
+    float ex = (src[3] - src[0]) * 0.5f;
+    float ey = (src[4] - src[1]) * 0.5f;
+    float ez = (src[5] - src[2]) * 0.5f;
+
+    float ncx = m->m11 * cx + m->m12 * cy + m->m13 * cz + m->m14;
+    float ncy = m->m21 * cx + m->m22 * cy + m->m23 * cz + m->m24;
+    float ncz = m->m31 * cx + m->m32 * cy + m->m33 * cz + m->m34;
+    float nex = sx_abs(m->m11) * ex + sx_abs(m->m12) * ey + sx_abs(m->m13) * ez;
+    float ney = sx_abs(m->m21) * ex + sx_abs(m->m22) * ey + sx_abs(m->m23) * ez;
+    float nez = sx_abs(m->m31) * ex + sx_abs(m->m32) * ey + sx_abs(m->m33) * ez;
+
+    dst[0] = ncx - nex;
+    dst[1] = ncy - ney;
+    dst[2] = ncz - nez;
+    dst[3] = ncx + nex;
+    dst[4] = ncy + ney;
+    dst[5] = ncz + nez;
+}
+
+#define SX__CULL_MAX_PLANES 16
+
+// sel: for aabbs and rects, index of the min or max component that is farthest along the normal
+//      (p-vertex), so the item is outside if the p-vertex is behind the plane
+typedef struct sx__cull_plane {
+    float n[3];
+    float d;
+    int sel[3];
+} sx__cull_plane;
+
+static void sx__cull_prepare_planes(sx__cull_plane* cplanes, const sx_plane* planes,
+                                    int num_planes, bool rect)
+{
+    sx_assert(num_planes > 0 && num_planes <= SX__CULL_MAX_PLANES);
+    for (int i = 0; i < num_planes; i++) {
+        const sx_plane* p = &planes[i];
+        sx__cull_plane* cp = &cplanes[i];
+        cp->n[0] = p->normal.x;
+        cp->n[1] = p->normal.y;
+        cp->n[2] = p->normal.z;
+        cp->d = p->dist;
+        if (!rect) {    // aabb: (xmin, ymin, zmin, xmax, ymax, zmax)
+            cp->sel[0] = p->normal.x > 0 ? 3 : 0;
+            cp->sel[1] = p->normal.y > 0 ? 4 : 1;
+            cp->sel[2] = p->normal.z > 0 ? 5 : 2;
+        } else {    // rect: (xmin, ymin, xmax, ymax), z is always zero
+            cp->sel[0] = p->normal.x > 0 ? 2 : 0;
+            cp->sel[1] = p->normal.y > 0 ? 3 : 1;
+            cp->sel[2] = 0;
+        }
+    }
+}
+
+// All culling paths (scalar, 4-wide and 8-wide) evaluate the plane distance in the same order and
+// without FMA: d = ((d [+ radius]) + x*nx) + y*ny) + z*nz, so their results are bit-exact and
+// don't depend on the cpu, or the position of the item in the array (kernel or scalar tail).
+// math-batch.c is compiled with -ffp-contract=off, so the compiler doesn't fuse them either
+static inline bool sx__aabb_visible_scalar(const float* f, const sx__cull_plane* planes,
+                                           int num_planes)
+{
+    for (int p = 0; p < num_planes; p++) {
+        const sx__cull_plane* cp = &planes[p];
+        float d = f[cp->sel[0]] * cp->n[0] + cp->d;
+        d = f[cp->sel[1]] * cp->n[1] + d;
+        d = f[cp->sel[2]] * cp->n[2] + d;
+        if (d < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline bool sx__sphere_visible_scalar(const float* f, const sx__cull_plane* planes,
+                                             int num_planes)
+{
+    for (int p = 0; p < num_planes; p++) {
+        const sx__cull_plane* cp = &planes[p];
+        float d = f[0] * cp->n[0] + (cp->d + f[3]);
+        d = f[1] * cp->n[1] + d;
+        d = f[2] * cp->n[2] + d;
+        if (d < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline bool sx__rect_visible_scalar(const float* f, const sx__cull_plane* planes,
+                                           int num_planes)
+{
+    for (int p = 0; p < num_planes; p++) {
+        const sx__cull_plane* cp = &planes[p];
+        float d = f[cp->sel[0]] * cp->n[0] + cp->d;
+        d = f[cp->sel[1]] * cp->n[1] + d;
+        if (d < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// 4-wide (SSE2/NEON)
+#if SX__BATCH_SSE2
+typedef __m128 sx__f4;
+
+#    define sx__f4_load(_p) _mm_loadu_ps(_p)
+#    define sx__f4_store(_p, _a) _mm_storeu_ps(_p, _a)
+#    define sx__f4_splat(_f) _mm_set1_ps(_f)
+#    define sx__f4_add(_a, _b) _mm_add_ps(_a, _b)
+#    define sx__f4_sub(_a, _b) _mm_sub_ps(_a, _b)
+#    define sx__f4_mul(_a, _b) _mm_mul_ps(_a, _b)
+#    define sx__f4_madd(_a, _b, _c) _mm_add_ps(_mm_mul_ps(_a, _b), _c)    // a*b + c
+#    define sx__f4_abs(_a) _mm_andnot_ps(_mm_set1_ps(-0.0f), _a)
+#    define sx__f4_splat_x(_a) _mm_shuffle_ps(_a, _a, _MM_SHUFFLE(0, 0, 0, 0))
+#    define sx__f4_splat_y(_a) _mm_shuffle_ps(_a, _a, _MM_SHUFFLE(1, 1, 1, 1))
+#    define sx__f4_splat_z(_a) _mm_shuffle_ps(_a, _a, _MM_SHUFFLE(2, 2, 2, 2))
+#    define sx__f4_dup_even(_a) _mm_shuffle_ps(_a, _a, _MM_SHUFFLE(2, 2, 0, 0))
+#    define sx__f4_dup_odd(_a) _mm_shuffle_ps(_a, _a, _MM_SHUFFLE(3, 3, 1, 1))
+
+// xyz loads/stores don't touch the 4th float, which can be outside of the array
+static inline sx__f4 sx__f4_load3(const float* p)
+{
+    return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p), _mm_load_ss(p + 2));
+}
+
+static inline void sx__f4_store3(float* p, sx__f4 a)
+{
+    _mm_storel_pi((__m64*)p, a);
+    _mm_store_ss(p + 2, _mm_movehl_ps(a, a));
+}
+
+// 4 tightly packed xyz vectors <-> (xxxx, yyyy, zzzz)
+static inline void sx__f4_load3x4(const float* p, sx__f4* x, sx__f4* y, sx__f4* z)
+{
+    __m128 a = _mm_loadu_ps(p);        // x0 y0 z0 x1
+    __m128 b = _mm_loadu_ps(p + 4);    // y1 z1 x2 y2
+    __m128 c = _mm_loadu_ps(p + 8);    // z2 x3 y3 z3
+    *x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    *y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                        _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    *z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+}
+
+static inline void sx__f4_store3x4(float* p, sx__f4 x, sx__f4 y, sx__f4 z)
+{
+    _mm_storeu_ps(p, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                    _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                                    _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(p + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                                        _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                                        _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(p + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                                        _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                                        _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+typedef __m128 sx__f4_mask;
+
+#    define sx__f4_mask_zero() _mm_setzero_ps()
+#    define sx__f4_mask_or(_a, _b) _mm_or_ps(_a, _b)
+#    define sx__f4_mask_bits(_m) _mm_movemask_ps(_m)
+#    define sx__f4_cmplt(_a, _b) _mm_cmplt_ps(_a, _b)
+
+// 4 aabbs -> (xmin, ymin, zmin, xmax, ymax, zmax), each one holds 4 items
+static inline void sx__f4_load_aabb4(const float* p, sx__f4 b[6])
+{
+    sx__f4 x0, y0, z0, x1, y1, z1;
+    sx__f4_load3x4(p, &x0, &y0, &z0);         // (min0, max0, min1, max1)
+    sx__f4_load3x4(p + 12, &x1, &y1, &z1);    // (min2, max2, min3, max3)
+    b[0] = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(2, 0, 2, 0));
+    b[1] = _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(2, 0, 2, 0));
+    b[2] = _mm_shuffle_ps(z0, z1, _MM_SHUFFLE(2, 0, 2, 0));
+    b[3] = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(3, 1, 3, 1));
+    b[4] = _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(3, 1, 3, 1));
+    b[5] = _mm_shuffle_ps(z0, z1, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// 4 items of 4 floats -> 4 vectors, each one holds a component of 4 items
+static inline void sx__f4_load_transpose4(const float* p, sx__f4 b[4])
+{
+    b[0] = _mm_loadu_ps(p);
+    b[1] = _mm_loadu_ps(p + 4);
+    b[2] = _mm_loadu_ps(p + 8);
+    b[3] = _mm_loadu_ps(p + 12);
+    _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+}
+#elif SX__BATCH_NEON
+typedef float32x4_t sx__f4;
+
+#    define sx__f4_load(_p) vld1q_f32(_p)
+#    define sx__f4_store(_p, _a) vst1q_f32(_p, _a)
+#    define sx__f4_splat(_f) vdupq_n_f32(_f)
+#    define sx__f4_add(_a, _b) vaddq_f32(_a, _b)
+#    define sx__f4_sub(_a, _b) vsubq_f32(_a, _b)
+#    define sx__f4_mul(_a, _b) vmulq_f32(_a, _b)
+#    define sx__f4_madd(_a, _b, _c) vmlaq_f32(_c, _a, _b)    // a*b + c
+#    define sx__f4_abs(_a) vabsq_f32(_a)
+#    define sx__f4_splat_x(_a) vdupq_lane_f32(vget_low_f32(_a), 0)
+#    define sx__f4_splat_y(_a) vdupq_lane_f32(vget_low_f32(_a), 1)
+#    define sx__f4_splat_z(_a) vdupq_lane_f32(vget_high_f32(_a), 0)
+#    define sx__f4_dup_even(_a) vtrnq_f32(_a, _a).val[0]
+#    define sx__f4_dup_odd(_a) vtrnq_f32(_a, _a).val[1]
+
+static inline sx__f4 sx__f4_load3(const float* p)
+{
+    return vcombine_f32(vld1_f32(p), vld1_dup_f32(p + 2));
+}
+
+static inline void sx__f4_store3(float* p, sx__f4 a)
+{
+    vst1_f32(p, vget_low_f32(a));
+    vst1q_lane_f32(p + 2, a, 2);
+}
+
+static inline void sx__f4_load3x4(const float* p, sx__f4* x, sx__f4* y, sx__f4* z)
+{
+    float32x4x3_t v = vld3q_f32(p);
+    *x = v.val[0];
+    *y = v.val[1];
+    *z = v.val[2];
+}
+
+static inline void sx__f4_store3x4(float* p, sx__f4 x, sx__f4 y, sx__f4 z)
+{
+    float32x4x3_t v = { { x, y, z } };
+    vst3q_f32(p, v);
+}
+
+typedef uint32x4_t sx__f4_mask;
+
+#    define sx__f4_mask_zero() vdupq_n_u32(0)
+#    define sx__f4_mask_or(_a, _b) vorrq_u32(_a, _b)
+#    define sx__f4_cmplt(_a, _b) vcltq_f32(_a, _b)
+
+static inline int sx__f4_mask_bits(sx__f4_mask m)
+{
+    const int32_t shifts[4] = { 0, 1, 2, 3 };
+    uint32x4_t bits = vshlq_u32(vshrq_n_u32(m, 31), vld1q_s32(shifts));
+    uint32x2_t t = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return (int)(vget_lane_u32(t, 0) | vget_lane_u32(t, 1));
+}
+
+static inline void sx__f4_load_aabb4(const float* p, sx__f4 b[6])
+{
+    float32x4x3_t v0 = vld3q_f32(p);         // (min0, max0, min1, max1)
+    float32x4x3_t v1 = vld3q_f32(p + 12);    // (min2, max2, min3, max3)
+    for (int i = 0; i < 3; i++) {
+        float32x4x2_t u = vuzpq_f32(v0.val[i], v1.val[i]);
+        b[i] = u.val[0];
+        b[i + 3] = u.val[1];
+    }
+}
+
+static inline void sx__f4_load_transpose4(const float* p, sx__f4 b[4])
+{
+    float32x4x4_t v = vld4q_f32(p);
+    b[0] = v.val[0];
+    b[1] = v.val[1];
+    b[2] = v.val[2];
+    b[3] = v.val[3];
+}
+#endif
+
+#if SX__BATCH_SIMD
+static int sx__mat4_mul_vec3_batch_f4(sx_vec3* dst, const sx_vec3* src, int i, int count,
+                                      const sx_mat4* mat)
+{
+    sx__f4 m11 = sx__f4_splat(mat->m11), m12 = sx__f4_splat(mat->m12);
+    sx__f4 m13 = sx__f4_splat(mat->m13), m14 = sx__f4_splat(mat->m14);
+    sx__f4 m21 = sx__f4_splat(mat->m21), m22 = sx__f4_splat(mat->m22);
+    sx__f4 m23 = sx__f4_splat(mat->m23), m24 = sx__f4_splat(mat->m24);
+    sx__f4 m31 = sx__f4_splat(mat->m31), m32 = sx__f4_splat(mat->m32);
+    sx__f4 m33 = sx__f4_splat(mat->m33), m34 = sx__f4_splat(mat->m34);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 x, y, z;
+        sx__f4_load3x4(src[i].f, &x, &y, &z);
+        sx__f4_store3x4(dst[i].f,
+                        sx__f4_madd(x, m11, sx__f4_madd(y, m12, sx__f4_madd(z, m13, m14))),
+                        sx__f4_madd(x, m21, sx__f4_madd(y, m22, sx__f4_madd(z, m23, m24))),
+                        sx__f4_madd(x, m31, sx__f4_madd(y, m32, sx__f4_madd(z, m33, m34))));
+    }
+    return i;
+}
+
+static int sx__mat4_mul_vec3_soa_f4(sx_vec3_soa dst, sx_vec3_soa src, int i, int count,
+                                    const sx_mat4* mat)
+{
+    sx__f4 m11 = sx__f4_splat(mat->m11), m12 = sx__f4_splat(mat->m12);
+    sx__f4 m13 = sx__f4_splat(mat->m13), m14 = sx__f4_splat(mat->m14);
+    sx__f4 m21 = sx__f4_splat(mat->m21), m22 = sx__f4_splat(mat->m22);
+    sx__f4 m23 = sx__f4_splat(mat->m23), m24 = sx__f4_splat(mat->m24);
+    sx__f4 m31 = sx__f4_splat(mat->m31), m32 = sx__f4_splat(mat->m32);
+    sx__f4 m33 = sx__f4_splat(mat->m33), m34 = sx__f4_splat(mat->m34);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 x = sx__f4_load(src.x + i);
+        sx__f4 y = sx__f4_load(src.y + i);
+        sx__f4 z = sx__f4_load(src.z + i);
+        sx__f4_store(dst.x + i, sx__f4_madd(x, m11, sx__f4_madd(y, m12, sx__f4_madd(z, m13, m14))));
+        sx__f4_store(dst.y + i, sx__f4_madd(x, m21, sx__f4_madd(y, m22, sx__f4_madd(z, m23, m24))));
+        sx__f4_store(dst.z + i, sx__f4_madd(x, m31, sx__f4_madd(y, m32, sx__f4_madd(z, m33, m34))));
+    }
+    return i;
+}
+
+// two points per vector: (x0, y0, x1, y1)
+static int sx__mat3_mul_vec2_batch_f4(sx_vec2* dst, const sx_vec2* src, int i, int count,
+                                      const sx_mat3* mat)
+{
+    float c1f[4] = { mat->m11, mat->m21, mat->m11, mat->m21 };
+    float c2f[4] = { mat->m12, mat->m22, mat->m12, mat->m22 };
+    float tf[4] = { mat->m13, mat->m23, mat->m13, mat->m23 };
+    sx__f4 c1 = sx__f4_load(c1f);
+    sx__f4 c2 = sx__f4_load(c2f);
+    sx__f4 t = sx__f4_load(tf);
+
+    for (; i + 2 <= count; i += 2) {
+        sx__f4 v = sx__f4_load(src[i].f);
+        sx__f4 r = sx__f4_madd(sx__f4_dup_even(v), c1, sx__f4_madd(sx__f4_dup_odd(v), c2, t));
+        sx__f4_store(dst[i].f, r);
+    }
+    return i;
+}
+
+static int sx__mat3_mul_vec2_soa_f4(sx_vec2_soa dst, sx_vec2_soa src, int i, int count,
+                                    const sx_mat3* mat)
+{
+    sx__f4 m11 = sx__f4_splat(mat->m11), m12 = sx__f4_splat(mat->m12);
+    sx__f4 m13 = sx__f4_splat(mat->m13);
+    sx__f4 m21 = sx__f4_splat(mat->m21), m22 = sx__f4_splat(mat->m22);
+    sx__f4 m23 = sx__f4_splat(mat->m23);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 x = sx__f4_load(src.x + i);
+        sx__f4 y = sx__f4_load(src.y + i);
+        sx__f4_store(dst.x + i, sx__f4_madd(x, m11, sx__f4_madd(y, m12, m13)));
+        sx__f4_store(dst.y + i, sx__f4_madd(x, m21, sx__f4_madd(y, m22, m23)));
+    }
+    return i;
+}
+
+static int sx__aabb_transform_batch_f4(sx_aabb* dst, const sx_aabb* src, const sx_mat4* mats,
+                                       int i, int count)
+{
+    sx__f4 half = sx__f4_splat(0.5f);
+
+    for (; i < count; i++) {
+        const sx_mat4* m = &mats[i];
+        sx__f4 c1 = sx__f4_load(m->col1.f);
+        sx__f4 c2 = sx__f4_load(m->col2.f);
+        sx__f4 c3 = sx__f4_load(m->col3.f);
+        sx__f4 c4 = sx__f4_load(m->col4.f);
+
+        sx__f4 vmin = sx__f4_load3(src[i].f);
+        sx__f4 vmax = sx__f4_load3(src[i].f + 3);
+        sx__f4 center = sx__f4_mul(sx__f4_add(vmin, vmax), half);
+        sx__f4 extents = sx__f4_mul(sx__f4_sub(vmax, vmin), half);
+
+        sx__f4 nc = sx__f4_madd(c1, sx__f4_splat_x(center), c4);
+        nc = sx__f4_madd(c2, sx__f4_splat_y(center), nc);
+        nc = sx__f4_madd(c3, sx__f4_splat_z(center), nc);
+        sx__f4 ne = sx__f4_mul(sx__f4_abs(c1), sx__f4_splat_x(extents));
+        ne = sx__f4_madd(sx__f4_abs(c2), sx__f4_splat_y(extents), ne);
+        ne = sx__f4_madd(sx__f4_abs(c3), sx__f4_splat_z(extents), ne);
+
+        sx__f4_store3(dst[i].f, sx__f4_sub(nc, ne));
+        sx__f4_store3(dst[i].f + 3, sx__f4_add(nc, ne));
+    }
+    return i;
+}
+
+static int sx__aabb_transform_soa_f4(sx_aabb_soa dst, sx_aabb_soa src, int i, int count,
+                                     const sx_mat4* mat)
+{
+    sx__f4 m11 = sx__f4_splat(mat->m11), m12 = sx__f4_splat(mat->m12);
+    sx__f4 m13 = sx__f4_splat(mat->m13), m14 = sx__f4_splat(mat->m14);
+    sx__f4 m21 = sx__f4_splat(mat->m21), m22 = sx__f4_splat(mat->m22);
+    sx__f4 m23 = sx__f4_splat(mat->m23), m24 = sx__f4_splat(mat->m24);
+    sx__f4 m31 = sx__f4_splat(mat->m31), m32 = sx__f4_splat(mat->m32);
+    sx__f4 m33 = sx__f4_splat(mat->m33), m34 = sx__f4_splat(mat->m34);
+    sx__f4 a11 = sx__f4_abs(m11), a12 = sx__f4_abs(m12), a13 = sx__f4_abs(m13);
+    sx__f4 a21 = sx__f4_abs(m21), a22 = sx__f4_abs(m22), a23 = sx__f4_abs(m23);
+    sx__f4 a31 = sx__f4_abs(m31), a32 = sx__f4_abs(m32), a33 = sx__f4_abs(m33);
+    sx__f4 half = sx__f4_splat(0.5f);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 xmin = sx__f4_load(src.xmin + i), xmax = sx__f4_load(src.xmax + i);
+        sx__f4 ymin = sx__f4_load(src.ymin + i), ymax = sx__f4_load(src.ymax + i);
+        sx__f4 zmin = sx__f4_load(src.zmin + i), zmax = sx__f4_load(src.zmax + i);
+        sx__f4 cx = sx__f4_mul(sx__f4_add(xmin, xmax), half);
+        sx__f4 cy = sx__f4_mul(sx__f4_add(ymin, ymax), half);
+        sx__f4 cz = sx__f4_mul(sx__f4_add(zmin, zmax), half);
+        sx__f4 ex = sx__f4_mul(sx__f4_sub(xmax, xmin), half);
+        sx__f4 ey = sx__f4_mul(sx__f4_sub(ymax, ymin), half);
+        sx__f4 ez = sx__f4_mul(sx__f4_sub(zmax, zmin), half);
+
+        sx__f4 ncx = sx__f4_madd(cx, m11, sx__f4_madd(cy, m12, sx__f4_madd(cz, m13, m14)));
+        sx__f4 ncy = sx__f4_madd(cx, m21, sx__f4_madd(cy, m22, sx__f4_madd(cz, m23, m24)));
+        sx__f4 ncz = sx__f4_madd(cx, m31, sx__f4_madd(cy, m32, sx__f4_madd(cz, m33, m34)));
+        sx__f4 nex = sx__f4_madd(ex, a11, sx__f4_madd(ey, a12, sx__f4_mul(ez, a13)));
+        sx__f4 ney = sx__f4_madd(ex, a21, sx__f4_madd(ey, a22, sx__f4_mul(ez, a23)));
+        sx__f4 nez = sx__f4_madd(ex, a31, sx__f4_madd(ey, a32, sx__f4_mul(ez, a33)));
+
+        sx__f4_store(dst.xmin + i, sx__f4_sub(ncx, nex));
+        sx__f4_store(dst.ymin + i, sx__f4_sub(ncy, ney));
+        sx__f4_store(dst.zmin + i, sx__f4_sub(ncz, nez));
+        sx__f4_store(dst.xmax + i, sx__f4_add(ncx, nex));
+        sx__f4_store(dst.ymax + i, sx__f4_add(ncy, ney));
+        sx__f4_store(dst.zmax + i, sx__f4_add(ncz, nez));
+    }
+    return i;
+}
+
+static int sx__mat4_mul_batch_f4(sx_mat4* dst, const sx_mat4* a, const sx_mat4* b, int i,
+                                 int count)
+{
+    for (; i < count; i++) {
+        sx__f4 a1 = sx__f4_load(a[i].col1.f);
+        sx__f4 a2 = sx__f4_load(a[i].col2.f);
+        sx__f4 a3 = sx__f4_load(a[i].col3.f);
+        sx__f4 a4 = sx__f4_load(a[i].col4.f);
+        const float* bf = b[i].f;
+        float* df = dst[i].f;
+        // each column is written after it's read, so dst can be the same as b
+        for (int c = 0; c < 16; c += 4) {
+            sx__f4 r = sx__f4_mul(a1, sx__f4_splat(bf[c]));
+            r = sx__f4_madd(a2, sx__f4_splat(bf[c + 1]), r);
+            r = sx__f4_madd(a3, sx__f4_splat(bf[c + 2]), r);
+            r = sx__f4_madd(a4, sx__f4_splat(bf[c + 3]), r);
+            sx__f4_store(df + c, r);
+        }
+    }
+    return i;
+}
+
+// culling kernels process 4 items per iteration, and test them against all planes
+// planes are splatted once, so the inner loop has no shuffles
+static int sx__aabb_cull_f4(uint32_t* bits, const sx_aabb* aabbs, int i, int count,
+                            const sx__cull_plane* planes, int num_planes)
+{
+    sx__f4 pv[SX__CULL_MAX_PLANES * 4];
+    for (int p = 0; p < num_planes; p++) {
+        pv[p * 4] = sx__f4_splat(planes[p].n[0]);
+        pv[p * 4 + 1] = sx__f4_splat(planes[p].n[1]);
+        pv[p * 4 + 2] = sx__f4_splat(planes[p].n[2]);
+        pv[p * 4 + 3] = sx__f4_splat(planes[p].d);
+    }
+    sx__f4 zero = sx__f4_splat(0.0f);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 b[6];
+        sx__f4_load_aabb4(aabbs[i].f, b);
+        sx__f4_mask outside = sx__f4_mask_zero();
+        for (int p = 0; p < num_planes; p++) {
+            const int* sel = planes[p].sel;
+            const sx__f4* v = &pv[p * 4];
+            sx__f4 d = sx__f4_madd(b[sel[0]], v[0], v[3]);
+            d = sx__f4_madd(b[sel[1]], v[1], d);
+            d = sx__f4_madd(b[sel[2]], v[2], d);
+            outside = sx__f4_mask_or(outside, sx__f4_cmplt(d, zero));
+        }
+        bits[i >> 5] |= (uint32_t)(~sx__f4_mask_bits(outside) & 0xf) << (i & 31);
+    }
+    return i;
+}
+
+static int sx__sphere_cull_f4(uint32_t* bits, const sx_vec4* spheres, int i, int count,
+                              const sx__cull_plane* planes, int num_planes)
+{
+    sx__f4 pv[SX__CULL_MAX_PLANES * 4];
+    for (int p = 0; p < num_planes; p++) {
+        pv[p * 4] = sx__f4_splat(planes[p].n[0]);
+        pv[p * 4 + 1] = sx__f4_splat(planes[p].n[1]);
+        pv[p * 4 + 2] = sx__f4_splat(planes[p].n[2]);
+        pv[p * 4 + 3] = sx__f4_splat(planes[p].d);
+    }
+    sx__f4 zero = sx__f4_splat(0.0f);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 b[4];    // (x, y, z, radius)
+        sx__f4_load_transpose4(spheres[i].f, b);
+        sx__f4_mask outside = sx__f4_mask_zero();
+        for (int p = 0; p < num_planes; p++) {
+            const sx__f4* v = &pv[p * 4];
+            sx__f4 d = sx__f4_madd(b[0], v[0], sx__f4_add(v[3], b[3]));
+            d = sx__f4_madd(b[1], v[1], d);
+            d = sx__f4_madd(b[2], v[2], d);
+            outside = sx__f4_mask_or(outside, sx__f4_cmplt(d, zero));
+        }
+        bits[i >> 5] |= (uint32_t)(~sx__f4_mask_bits(outside) & 0xf) << (i & 31);
+    }
+    return i;
+}
+
+static int sx__rect_cull_f4(uint32_t* bits, const sx_rect* rects, int i, int count,
+                            const sx__cull_plane* planes, int num_planes)
+{
+    sx__f4 pv[SX__CULL_MAX_PLANES * 3];
+    for (int p = 0; p < num_planes; p++) {
+        pv[p * 3] = sx__f4_splat(planes[p].n[0]);
+        pv[p * 3 + 1] = sx__f4_splat(planes[p].n[1]);
+        pv[p * 3 + 2] = sx__f4_splat(planes[p].d);
+    }
+    sx__f4 zero = sx__f4_splat(0.0f);
+
+    for (; i + 4 <= count; i += 4) {
+        sx__f4 b[4];    // (xmin, ymin, xmax, ymax)
+        sx__f4_load_transpose4(rects[i].f, b);
+        sx__f4_mask outside = sx__f4_mask_zero();
+        for (int p = 0; p < num_planes; p++) {
+            const int* sel = planes[p].sel;
+            const sx__f4* v = &pv[p * 3];
+            sx__f4 d = sx__f4_madd(b[sel[0]], v[0], v[2]);
+            d = sx__f4_madd(b[sel[1]], v[1], d);
+            outside = sx__f4_mask_or(outside, sx__f4_cmplt(d, zero));
+        }
+        bits[i >> 5] |= (uint32_t)(~sx__f4_mask_bits(outside) & 0xf) << (i & 31);
+    }
+    return i;
+}
+#endif    // SX__BATCH_SIMD
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// 8-wide (AVX2+FMA)
+#if SX__BATCH_AVX2
+static inline bool sx__batch_use_avx2(void)
+{
+    const sx_cpu_features mask = SX_CPU_FEATURE_AVX2 | SX_CPU_FEATURE_FMA;
+    return (sx_os_cpu_features() & mask) == mask;
+}
+
+// x*a + y*b + z*c + d
+#    define sx__f8_fma3(_x, _a, _y, _b, _z, _c, _d) \
+        _mm256_fmadd_ps(_x, _a, _mm256_fmadd_ps(_y, _b, _mm256_fmadd_ps(_z, _c, _d)))
+
+// a*b + c, rounded twice (not fused), for the culling kernels, see sx__aabb_visible_scalar
+#    define sx__f8_madd(_a, _b, _c) _mm256_add_ps(_mm256_mul_ps(_a, _b), _c)
+
+// same vec4 in both 128bit lanes
+#    define sx__f8_dup4(_p) \
+        _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(_p)), _mm_loadu_ps(_p), 1)
+
+// points are deinterleaved 4 at a time with SSE shuffles, and lanes are combined for the math
+SX__BATCH_TARGET_AVX2 static int sx__mat4_mul_vec3_batch_avx2(sx_vec3* dst, const sx_vec3* src,
+                                                              int i, int count,
+                                                              const sx_mat4* mat)
+{
+    __m256 m11 = _mm256_set1_ps(mat->m11), m12 = _mm256_set1_ps(mat->m12);
+    __m256 m13 = _mm256_set1_ps(mat->m13), m14 = _mm256_set1_ps(mat->m14);
+    __m256 m21 = _mm256_set1_ps(mat->m21), m22 = _mm256_set1_ps(mat->m22);
+    __m256 m23 = _mm256_set1_ps(mat->m23), m24 = _mm256_set1_ps(mat->m24);
+    __m256 m31 = _mm256_set1_ps(mat->m31), m32 = _mm256_set1_ps(mat->m32);
+    __m256 m33 = _mm256_set1_ps(mat->m33), m34 = _mm256_set1_ps(mat->m34);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 x0, y0, z0, x1, y1, z1;
+        sx__f4_load3x4(src[i].f, &x0, &y0, &z0);
+        sx__f4_load3x4(src[i + 4].f, &x1, &y1, &z1);
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+        __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+        __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+        __m256 rx = sx__f8_fma3(x, m11, y, m12, z, m13, m14);
+        __m256 ry = sx__f8_fma3(x, m21, y, m22, z, m23, m24);
+        __m256 rz = sx__f8_fma3(x, m31, y, m32, z, m33, m34);
+        sx__f4_store3x4(dst[i].f, _mm256_castps256_ps128(rx), _mm256_castps256_ps128(ry),
+                        _mm256_castps256_ps128(rz));
+        sx__f4_store3x4(dst[i + 4].f, _mm256_extractf128_ps(rx, 1), _mm256_extractf128_ps(ry, 1),
+                        _mm256_extractf128_ps(rz, 1));
+    }
+    return i;
+}
+
+SX__BATCH_TARGET_AVX2 static int sx__mat4_mul_vec3_soa_avx2(sx_vec3_soa dst, sx_vec3_soa src,
+                                                            int i, int count, const sx_mat4* mat)
+{
+    __m256 m11 = _mm256_set1_ps(mat->m11), m12 = _mm256_set1_ps(mat->m12);
+    __m256 m13 = _mm256_set1_ps(mat->m13), m14 = _mm256_set1_ps(mat->m14);
+    __m256 m21 = _mm256_set1_ps(mat->m21), m22 = _mm256_set1_ps(mat->m22);
+    __m256 m23 = _mm256_set1_ps(mat->m23), m24 = _mm256_set1_ps(mat->m24);
+    __m256 m31 = _mm256_set1_ps(mat->m31), m32 = _mm256_set1_ps(mat->m32);
+    __m256 m33 = _mm256_set1_ps(mat->m33), m34 = _mm256_set1_ps(mat->m34);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(src.x + i);
+        __m256 y = _mm256_loadu_ps(src.y + i);
+        __m256 z = _mm256_loadu_ps(src.z + i);
+        _mm256_storeu_ps(dst.x + i, sx__f8_fma3(x, m11, y, m12, z, m13, m14));
+        _mm256_storeu_ps(dst.y + i, sx__f8_fma3(x, m21, y, m22, z, m23, m24));
+        _mm256_storeu_ps(dst.z + i, sx__f8_fma3(x, m31, y, m32, z, m33, m34));
+    }
+    return i;
+}
+
+// four points per vector: (x0, y0, x1, y1, x2, y2, x3, y3)
+SX__BATCH_TARGET_AVX2 static int sx__mat3_mul_vec2_batch_avx2(sx_vec2* dst, const sx_vec2* src,
+                                                              int i, int count,
+                                                              const sx_mat3* mat)
+{
+    __m256 c1 = _mm256_setr_ps(mat->m11, mat->m21, mat->m11, mat->m21, mat->m11, mat->m21,
+                               mat->m11, mat->m21);
+    __m256 c2 = _mm256_setr_ps(mat->m12, mat->m22, mat->m12, mat->m22, mat->m12, mat->m22,
+                               mat->m12, mat->m22);
+    __m256 t = _mm256_setr_ps(mat->m13, mat->m23, mat->m13, mat->m23, mat->m13, mat->m23,
+                              mat->m13, mat->m23);
+
+    for (; i + 4 <= count; i += 4) {
+        __m256 v = _mm256_loadu_ps(src[i].f);
+        __m256 r = _mm256_fmadd_ps(_mm256_moveldup_ps(v), c1,
+                                   _mm256_fmadd_ps(_mm256_movehdup_ps(v), c2, t));
+        _mm256_storeu_ps(dst[i].f, r);
+    }
+    return i;
+}
+
+SX__BATCH_TARGET_AVX2 static int sx__mat3_mul_vec2_soa_avx2(sx_vec2_soa dst, sx_vec2_soa src,
+                                                            int i, int count, const sx_mat3* mat)
+{
+    __m256 m11 = _mm256_set1_ps(mat->m11), m12 = _mm256_set1_ps(mat->m12);
+    __m256 m13 = _mm256_set1_ps(mat->m13);
+    __m256 m21 = _mm256_set1_ps(mat->m21), m22 = _mm256_set1_ps(mat->m22);
+    __m256 m23 = _mm256_set1_ps(mat->m23);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(src.x + i);
+        __m256 y = _mm256_loadu_ps(src.y + i);
+        _mm256_storeu_ps(dst.x + i, _mm256_fmadd_ps(x, m11, _mm256_fmadd_ps(y, m12, m13)));
+        _mm256_storeu_ps(dst.y + i, _mm256_fmadd_ps(x, m21, _mm256_fmadd_ps(y, m22, m23)));
+    }
+    return i;
+}
+
+SX__BATCH_TARGET_AVX2 static int sx__aabb_transform_soa_avx2(sx_aabb_soa dst, sx_aabb_soa src,
+                                                             int i, int count, const sx_mat4* mat)
+{
+    __m256 m11 = _mm256_set1_ps(mat->m11), m12 = _mm256_set1_ps(mat->m12);
+    __m256 m13 = _mm256_set1_ps(mat->m13), m14 = _mm256_set1_ps(mat->m14);
+    __m256 m21 = _mm256_set1_ps(mat->m21), m22 = _mm256_set1_ps(mat->m22);
+    __m256 m23 = _mm256_set1_ps(mat->m23), m24 = _mm256_set1_ps(mat->m24);
+    __m256 m31 = _mm256_set1_ps(mat->m31), m32 = _mm256_set1_ps(mat->m32);
+    __m256 m33 = _mm256_set1_ps(mat->m33), m34 = _mm256_set1_ps(mat->m34);
+    __m256 a11 = _mm256_set1_ps(sx_abs(mat->m11)), a12 = _mm256_set1_ps(sx_abs(mat->m12));
+    __m256 a13 = _mm256_set1_ps(sx_abs(mat->m13));
+    __m256 a21 = _mm256_set1_ps(sx_abs(mat->m21)), a22 = _mm256_set1_ps(sx_abs(mat->m22));
+    __m256 a23 = _mm256_set1_ps(sx_abs(mat->m23));
+    __m256 a31 = _mm256_set1_ps(sx_abs(mat->m31)), a32 = _mm256_set1_ps(sx_abs(mat->m32));
+    __m256 a33 = _mm256_set1_ps(sx_abs(mat->m33));
+    __m256 half = _mm256_set1_ps(0.5f);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 xmin = _mm256_loadu_ps(src.xmin + i), xmax = _mm256_loadu_ps(src.xmax + i);
+        __m256 ymin = _mm256_loadu_ps(src.ymin + i), ymax = _mm256_loadu_ps(src.ymax + i);
+        __m256 zmin = _mm256_loadu_ps(src.zmin + i), zmax = _mm256_loadu_ps(src.zmax + i);
+        __m256 cx = _mm256_mul_ps(_mm256_add_ps(xmin, xmax), half);
+        __m256 cy = _mm256_mul_ps(_mm256_add_ps(ymin, ymax), half);
+        __m256 cz = _mm256_mul_ps(_mm256_add_ps(zmin, zmax), half);
+        __m256 ex = _mm256_mul_ps(_mm256_sub_ps(xmax, xmin), half);
+        __m256 ey = _mm256_mul_ps(_mm256_sub_ps(ymax, ymin), half);
+        __m256 ez = _mm256_mul_ps(_mm256_sub_ps(zmax, zmin), half);
+
+        __m256 ncx = sx__f8_fma3(cx, m11, cy, m12, cz, m13, m14);
+        __m256 ncy = sx__f8_fma3(cx, m21, cy, m22, cz, m23, m24);
+        __m256 ncz = sx__f8_fma3(cx, m31, cy, m32, cz, m33, m34);
+        __m256 nex = _mm256_fmadd_ps(ex, a11, _mm256_fmadd_ps(ey, a12, _mm256_mul_ps(ez, a13)));
+        __m256 ney = _mm256_fmadd_ps(ex, a21, _mm256_fmadd_ps(ey, a22, _mm256_mul_ps(ez, a23)));
+        __m256 nez = _mm256_fmadd_ps(ex, a31, _mm256_fmadd_ps(ey, a32, _mm256_mul_ps(ez, a33)));
+
+        _mm256_storeu_ps(dst.xmin + i, _mm256_sub_ps(ncx, nex));
+        _mm256_storeu_ps(dst.ymin + i, _mm256_sub_ps(ncy, ney));
+        _mm256_storeu_ps(dst.zmin + i, _mm256_sub_ps(ncz, nez));
+        _mm256_storeu_ps(dst.xmax + i, _mm256_add_ps(ncx, nex));
+        _mm256_storeu_ps(dst.ymax + i, _mm256_add_ps(ncy, ney));
+        _mm256_storeu_ps(dst.zmax + i, _mm256_add_ps(ncz, nez));
+    }
+    return i;
+}
+
+// two columns of the result per vector, columns of 'a' are duplicated in both lanes and
+// each lane broadcasts the elements of it's own column of 'b'
+SX__BATCH_TARGET_AVX2 static int sx__mat4_mul_batch_avx2(sx_mat4* dst, const sx_mat4* a,
+                                                         const sx_mat4* b, int i, int count)
+{
+    for (; i < count; i++) {
+        __m256 a1 = sx__f8_dup4(a[i].col1.f);
+        __m256 a2 = sx__f8_dup4(a[i].col2.f);
+        __m256 a3 = sx__f8_dup4(a[i].col3.f);
+        __m256 a4 = sx__f8_dup4(a[i].col4.f);
+        __m256 b12 = _mm256_loadu_ps(b[i].f);
+        __m256 b34 = _mm256_loadu_ps(b[i].f + 8);
+
+        __m256 r12 = _mm256_mul_ps(a1, _mm256_permute_ps(b12, 0x00));
+        __m256 r34 = _mm256_mul_ps(a1, _mm256_permute_ps(b34, 0x00));
+        r12 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b12, 0x55), r12);
+        r34 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b34, 0x55), r34);
+        r12 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b12, 0xaa), r12);
+        r34 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b34, 0xaa), r34);
+        r12 = _mm256_fmadd_ps(a4, _mm256_permute_ps(b12, 0xff), r12);
+        r34 = _mm256_fmadd_ps(a4, _mm256_permute_ps(b34, 0xff), r34);
+        _mm256_storeu_ps(dst[i].f, r12);
+        _mm256_storeu_ps(dst[i].f + 8, r34);
+    }
+    return i;
+}
+
+#    define sx__f8_combine(_a, _b) _mm256_insertf128_ps(_mm256_castps128_ps256(_a), _b, 1)
+
+SX__BATCH_TARGET_AVX2 static int sx__aabb_cull_avx2(uint32_t* bits, const sx_aabb* aabbs, int i,
+                                                    int count, const sx__cull_plane* planes,
+                                                    int num_planes)
+{
+    __m256 pv[SX__CULL_MAX_PLANES * 4];
+    for (int p = 0; p < num_planes; p++) {
+        pv[p * 4] = _mm256_set1_ps(planes[p].n[0]);
+        pv[p * 4 + 1] = _mm256_set1_ps(planes[p].n[1]);
+        pv[p * 4 + 2] = _mm256_set1_ps(planes[p].n[2]);
+        pv[p * 4 + 3] = _mm256_set1_ps(planes[p].d);
+    }
+    __m256 zero = _mm256_setzero_ps();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 b0[6], b1[6];
+        __m256 b[6];
+        sx__f4_load_aabb4(aabbs[i].f, b0);
+        sx__f4_load_aabb4(aabbs[i + 4].f, b1);
+        for (int k = 0; k < 6; k++) {
+            b[k] = sx__f8_combine(b0[k], b1[k]);
+        }
+
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < num_planes; p++) {
+            const int* sel = planes[p].sel;
+            const __m256* v = &pv[p * 4];
+            __m256 d = sx__f8_madd(b[sel[0]], v[0], v[3]);
+            d = sx__f8_madd(b[sel[1]], v[1], d);
+            d = sx__f8_madd(b[sel[2]], v[2], d);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+        }
+        bits[i >> 5] |= (uint32_t)(~_mm256_movemask_ps(outside) & 0xff) << (i & 31);
+    }
+    return i;
+}
+
+SX__BATCH_TARGET_AVX2 static int sx__sphere_cull_avx2(uint32_t* bits, const sx_vec4* spheres,
+                                                      int i, int count,
+                                                      const sx__cull_plane* planes,
+                                                      int num_planes)
+{
+    __m256 pv[SX__CULL_MAX_PLANES * 4];
+    for (int p = 0; p < num_planes; p++) {
+        pv[p * 4] = _mm256_set1_ps(planes[p].n[0]);
+        pv[p * 4 + 1] = _mm256_set1_ps(planes[p].n[1]);
+        pv[p * 4 + 2] = _mm256_set1_ps(planes[p].n[2]);
+        pv[p * 4 + 3] = _mm256_set1_ps(planes[p].d);
+    }
+    __m256 zero = _mm256_setzero_ps();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 b0[4], b1[4];
+        sx__f4_load_transpose4(spheres[i].f, b0);
+        sx__f4_load_transpose4(spheres[i + 4].f, b1);
+        __m256 x = sx__f8_combine(b0[0], b1[0]);
+        __m256 y = sx__f8_combine(b0[1], b1[1]);
+        __m256 z = sx__f8_combine(b0[2], b1[2]);
+        __m256 r = sx__f8_combine(b0[3], b1[3]);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < num_planes; p++) {
+            const __m256* v = &pv[p * 4];
+            __m256 d = sx__f8_madd(x, v[0], _mm256_add_ps(v[3], r));
+            d = sx__f8_madd(y, v[1], d);
+            d = sx__f8_madd(z, v[2], d);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+        }
+        bits[i >> 5] |= (uint32_t)(~_mm256_movemask_ps(outside) & 0xff) << (i & 31);
+    }
+    return i;
+}
+
+SX__BATCH_TARGET_AVX2 static int sx__rect_cull_avx2(uint32_t* bits, const sx_rect* rects, int i,
+                                                    int count, const sx__cull_plane* planes,
+                                                    int num_planes)
+{
+    __m256 pv[SX__CULL_MAX_PLANES * 3];
+    for (int p = 0; p < num_planes; p++) {
+        pv[p * 3] = _mm256_set1_ps(planes[p].n[0]);
+        pv[p * 3 + 1] = _mm256_set1_ps(planes[p].n[1]);
+        pv[p * 3 + 2] = _mm256_set1_ps(planes[p].d);
+    }
+    __m256 zero = _mm256_setzero_ps();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 b0[4], b1[4];
+        __m256 b[4];
+        sx__f4_load_transpose4(rects[i].f, b0);
+        sx__f4_load_transpose4(rects[i + 4].f, b1);
+        for (int k = 0; k < 4; k++) {
+            b[k] = sx__f8_combine(b0[k], b1[k]);
+        }
+
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < num_planes; p++) {
+            const int* sel = planes[p].sel;
+            const __m256* v = &pv[p * 3];
+            __m256 d = sx__f8_madd(b[sel[0]], v[0], v[2]);
+            d = sx__f8_madd(b[sel[1]], v[1], d);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+        }
+        bits[i >> 5] |= (uint32_t)(~_mm256_movemask_ps(outside) & 0xff) << (i & 31);
+    }
+    return i;
+}
+#endif    // SX__BATCH_AVX2
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void sx_mat4_mul_vec3_batch(sx_vec3* dst, const sx_vec3* src, int count, const sx_mat4* mat)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__mat4_mul_vec3_batch_avx2(dst, src, i, count, mat);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__mat4_mul_vec3_batch_f4(dst, src, i, count, mat);
+#endif
+    for (; i < count; i++) {
+        dst[i] = sx_mat4_mul_vec3(mat, src[i]);
+    }
+}
+
+void sx_mat4_mul_vec3_soa(sx_vec3_soa dst, sx_vec3_soa src, int count, const sx_mat4* mat)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__mat4_mul_vec3_soa_avx2(dst, src, i, count, mat);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__mat4_mul_vec3_soa_f4(dst, src, i, count, mat);
+#endif
+    for (; i < count; i++) {
+        sx_vec3 v = sx_mat4_mul_vec3(mat, sx_vec3f(src.x[i], src.y[i], src.z[i]));
+        dst.x[i] = v.x;
+        dst.y[i] = v.y;
+        dst.z[i] = v.z;
+    }
+}
+
+void sx_mat3_mul_vec2_batch(sx_vec2* dst, const sx_vec2* src, int count, const sx_mat3* mat)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__mat3_mul_vec2_batch_avx2(dst, src, i, count, mat);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__mat3_mul_vec2_batch_f4(dst, src, i, count, mat);
+#endif
+    for (; i < count; i++) {
+        dst[i] = sx_mat3_mul_vec2(mat, src[i]);
+    }
+}
+
+void sx_mat3_mul_vec2_soa(sx_vec2_soa dst, sx_vec2_soa src, int count, const sx_mat3* mat)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__mat3_mul_vec2_soa_avx2(dst, src, i, count, mat);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__mat3_mul_vec2_soa_f4(dst, src, i, count, mat);
+#endif
+    for (; i < count; i++) {
+        sx_vec2 v = sx_mat3_mul_vec2(mat, sx_vec2f(src.x[i], src.y[i]));
+        dst.x[i] = v.x;
+        dst.y[i] = v.y;
+    }
+}
+
+void sx_aabb_transform_batch(sx_aabb* dst, const sx_aabb* src, const sx_mat4* mats, int count)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_SIMD
+    i = sx__aabb_transform_batch_f4(dst, src, mats, i, count);
+#endif
+    for (; i < count; i++) {
+        sx__aabb_transform_scalar(dst[i].f, src[i].f, &mats[i]);
+    }
+}
+
+void sx_aabb_transform_soa(sx_aabb_soa dst, sx_aabb_soa src, int count, const sx_mat4* mat)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__aabb_transform_soa_avx2(dst, src, i, count, mat);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__aabb_transform_soa_f4(dst, src, i, count, mat);
+#endif
+    for (; i < count; i++) {
+        float s[6] = { src.xmin[i], src.ymin[i], src.zmin[i],
+                       src.xmax[i], src.ymax[i], src.zmax[i] };
+        float d[6];
+        sx__aabb_transform_scalar(d, s, mat);
+        dst.xmin[i] = d[0];
+        dst.ymin[i] = d[1];
+        dst.zmin[i] = d[2];
+        dst.xmax[i] = d[3];
+        dst.ymax[i] = d[4];
+        dst.zmax[i] = d[5];
+    }
+}
+
+void sx_mat4_mul_batch(sx_mat4* dst, const sx_mat4* a, const sx_mat4* b, int count)
+{
+    sx_assert(count >= 0);
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__mat4_mul_batch_avx2(dst, a, b, i, count);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__mat4_mul_batch_f4(dst, a, b, i, count);
+#endif
+    for (; i < count; i++) {
+        dst[i] = sx_mat4_mul(&a[i], &b[i]);
+    }
+}
+
+// sx_tx3d is already laid out as the 3 rows (pos, rot.col1, rot.col2, rot.col3), so packing is
+// a fixed size copy, which compilers turn into three unaligned 16 byte loads/stores
+void sx_tx3d_pack_batch(void* dst, int dst_stride, const sx_tx3d* src, int src_stride,
+                        int count)
+{
+    sx_assert(count >= 0);
+    sx_assert(dst_stride >= (int)sizeof(sx_tx3d));
+    sx_assert(src_stride >= (int)sizeof(sx_tx3d));
+
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    for (int i = 0; i < count; i++, d += dst_stride, s += src_stride) {
+        memcpy(d, s, sizeof(sx_tx3d));
+    }
+}
+
+void sx_aabb_cull_batch(uint32_t* visible_bits, const sx_aabb* aabbs, int count,
+                        const sx_plane* planes, int num_planes)
+{
+    sx_assert(count >= 0);
+    sx__cull_plane cplanes[SX__CULL_MAX_PLANES];
+    sx__cull_prepare_planes(cplanes, planes, num_planes, false);
+    memset(visible_bits, 0x0, sizeof(uint32_t) * (size_t)((count + 31) / 32));
+
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__aabb_cull_avx2(visible_bits, aabbs, i, count, cplanes, num_planes);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__aabb_cull_f4(visible_bits, aabbs, i, count, cplanes, num_planes);
+#endif
+    for (; i < count; i++) {
+        if (sx__aabb_visible_scalar(aabbs[i].f, cplanes, num_planes))
+            visible_bits[i >> 5] |= 1u << (i & 31);
+    }
+}
+
+void sx_sphere_cull_batch(uint32_t* visible_bits, const sx_vec4* spheres, int count,
+                          const sx_plane* planes, int num_planes)
+{
+    sx_assert(count >= 0);
+    sx__cull_plane cplanes[SX__CULL_MAX_PLANES];
+    sx__cull_prepare_planes(cplanes, planes, num_planes, false);
+    memset(visible_bits, 0x0, sizeof(uint32_t) * (size_t)((count + 31) / 32));
+
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__sphere_cull_avx2(visible_bits, spheres, i, count, cplanes, num_planes);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__sphere_cull_f4(visible_bits, spheres, i, count, cplanes, num_planes);
+#endif
+    for (; i < count; i++) {
+        if (sx__sphere_visible_scalar(spheres[i].f, cplanes, num_planes))
+            visible_bits[i >> 5] |= 1u << (i & 31);
+    }
+}
+
+void sx_rect_cull_batch(uint32_t* visible_bits, const sx_rect* rects, int count,
+                        const sx_plane* planes, int num_planes)
+{
+    sx_assert(count >= 0);
+    sx__cull_plane cplanes[SX__CULL_MAX_PLANES];
+    sx__cull_prepare_planes(cplanes, planes, num_planes, true);
+    memset(visible_bits, 0x0, sizeof(uint32_t) * (size_t)((count + 31) / 32));
+
+    int i = 0;
+#if SX__BATCH_AVX2
+    if (sx__batch_use_avx2())
+        i = sx__rect_cull_avx2(visible_bits, rects, i, count, cplanes, num_planes);
+#endif
+#if SX__BATCH_SIMD
+    i = sx__rect_cull_f4(visible_bits, rects, i, count, cplanes, num_planes);
+#endif
+    for (; i < count; i++) {
+        if (sx__rect_visible_scalar(rects[i].f, cplanes, num_planes))
+            visible_bits[i >> 5] |= 1u << (i & 31);
+    }
+}
@@ -16,6 +16,9 @@
 #    include <windows.h>
 #    include <direct.h>    // _getcwd
 #    include <Psapi.h>
+#    if SX_CPU_X86
+#        include <intrin.h>    // __cpuid
+#    endif
 // clang-format on
 #elif SX_PLATFORM_POSIX
 #    include <dirent.h>    // S_IFREG
@@ -671,3 +674,265 @@ int sx_os_numcores()
     return 1;
 #endif
 }
+
+#if SX_PLATFORM_LINUX || SX_PLATFORM_RPI || SX_PLATFORM_ANDROID
+static int sx__os_read_sysfs_int(const char* path, int default_value)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return default_value;
+    int value;
+    int r = fscanf(f, "%d", &value);
+    fclose(f);
+    return r == 1 ? value : default_value;
+}
+#endif
+
+// converts raw os ids of core/socket/cache to compact indexes and assigns smt indexes
+static void sx__os_cpu_topology_compact(sx_os_cpu* cpus, int count)
+{
+    int* cores = (int*)alloca(sizeof(int) * count);
+    int* sockets = (int*)alloca(sizeof(int) * count);
+    int* caches = (int*)alloca(sizeof(int) * count);
+    int num_cores = 0, num_sockets = 0, num_caches = 0;
+
+    for (int i = 0; i < count; i++) {
+        sx_os_cpu* cpu = &cpus[i];
+        cores[i] = sockets[i] = caches[i] = -1;
+        cpu->smt = 0;
+        for (int j = 0; j < i; j++) {
+            const sx_os_cpu* prev = &cpus[j];
+            if (prev->socket == cpu->socket) {
+                sockets[i] = sockets[j];
+                if (prev->core == cpu->core) {
+                    cores[i] = cores[j];
+                    cpu->smt++;
+                }
+            }
+            if (prev->cache == cpu->cache)
+                caches[i] = caches[j];
+        }
+        if (cores[i] == -1)
+            cores[i] = num_cores++;
+        if (sockets[i] == -1)
+            sockets[i] = num_sockets++;
+        if (caches[i] == -1)
+            caches[i] = num_caches++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        cpus[i].core = cores[i];
+        cpus[i].socket = sockets[i];
+        cpus[i].cache = caches[i];
+    }
+}
+
+int sx_os_cpu_topology(sx_os_cpu* cpus, int max_cpus)
+{
+    sx_assert(cpus);
+    int count = 0;
+
+#if SX_PLATFORM_LINUX || SX_PLATFORM_RPI || SX_PLATFORM_ANDROID
+    char path[128];
+    int num_conf = (int)sysconf(_SC_NPROCESSORS_CONF);
+    for (int i = 0; i < num_conf && count < max_cpus; i++) {
+        // cpu0 usually doesn't have 'online' file, because it cannot be taken offline
+        sx_snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/online", i);
+        if (!sx__os_read_sysfs_int(path, 1))
+            continue;
+
+        sx_os_cpu* cpu = &cpus[count];
+        cpu->id = i;
+        sx_snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", i);
+        cpu->core = sx__os_read_sysfs_int(path, i);
+        sx_snprintf(path, sizeof(path),
+                    "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
+        cpu->socket = sx__os_read_sysfs_int(path, 0);
+
+        // last-level cache domain is identified by the first cpu that shares the cache
+        int max_level = 0;
+        cpu->cache = 0;
+        for (int k = 0; k < 16; k++) {
+            sx_snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level",
+                        i, k);
+            int level = sx__os_read_sysfs_int(path, -1);
+            if (level == -1)
+                break;
+            if (level > max_level) {
+                max_level = level;
+                sx_snprintf(path, sizeof(path),
+                            "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", i, k);
+                cpu->cache = sx__os_read_sysfs_int(path, 0);
+            }
+        }
+        count++;
+    }
+#elif SX_PLATFORM_WINDOWS
+    DWORD size = 0;
+    GetLogicalProcessorInformationEx(RelationAll, NULL, &size);
+    uint8_t* buff = (uint8_t*)malloc(size);
+    if (buff && GetLogicalProcessorInformationEx(
+                    RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buff, &size)) {
+        // cores: create logical processors, raw core/socket/cache ids are the entry indexes
+        int core_idx = 0;
+        for (DWORD offset = 0; offset < size;) {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info =
+                (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buff + offset);
+            if (info->Relationship == RelationProcessorCore) {
+                for (WORD g = 0; g < info->Processor.GroupCount; g++) {
+                    const GROUP_AFFINITY* ga = &info->Processor.GroupMask[g];
+                    for (int bit = 0; bit < 64 && count < max_cpus; bit++) {
+                        if (ga->Mask & ((KAFFINITY)1 << bit)) {
+                            sx_os_cpu* cpu = &cpus[count++];
+                            cpu->id = (int)ga->Group * 64 + bit;
+                            cpu->core = core_idx;
+                            cpu->socket = 0;
+                            cpu->cache = 0;
+                        }
+                    }
+                }
+                core_idx++;
+            }
+            offset += info->Size;
+        }
+
+        // sockets and last-level caches
+        int max_level = 0;
+        for (DWORD offset = 0; offset < size;) {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info =
+                (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buff + offset);
+            if (info->Relationship == RelationCache && info->Cache.Level > max_level)
+                max_level = info->Cache.Level;
+            offset += info->Size;
+        }
+
+        int socket_idx = 0, cache_idx = 0;
+        for (DWORD offset = 0; offset < size;) {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info =
+                (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buff + offset);
+            const GROUP_AFFINITY* masks = NULL;
+            int num_masks = 0;
+            int value = 0;
+            bool package = info->Relationship == RelationProcessorPackage;
+            if (package) {
+                masks = info->Processor.GroupMask;
+                num_masks = info->Processor.GroupCount;
+                value = socket_idx++;
+            } else if (info->Relationship == RelationCache && info->Cache.Level == max_level &&
+                       info->Cache.Type != CacheInstruction) {
+                masks = &info->Cache.GroupMask;
+                num_masks = 1;
+                value = cache_idx++;
+            }
+
+            for (int m = 0; m < num_masks; m++) {
+                for (int i = 0; i < count; i++) {
+                    sx_os_cpu* cpu = &cpus[i];
+                    if (cpu->id / 64 == masks[m].Group &&
+                        (masks[m].Mask & ((KAFFINITY)1 << (cpu->id % 64)))) {
+                        if (package)
+                            cpu->socket = value;
+                        else
+                            cpu->cache = value;
+                    }
+                }
+            }
+            offset += info->Size;
+        }
+    }
+    free(buff);
+
+    // keep the same order as other platforms
+    for (int i = 1; i < count; i++) {
+        sx_os_cpu tmp = cpus[i];
+        int j = i - 1;
+        for (; j >= 0 && cpus[j].id > tmp.id; j--)
+            cpus[j + 1] = cpus[j];
+        cpus[j + 1] = tmp;
+    }
+#endif
+
+    // fallback: no topology information, every logical processor is a separate core
+    if (count == 0) {
+        count = sx_min(sx_os_numcores(), max_cpus);
+        for (int i = 0; i < count; i++) {
+            cpus[i] = (sx_os_cpu){ .id = i, .core = i };
+        }
+    }
+
+    sx__os_cpu_topology_compact(cpus, count);
+    return count;
+}
+
+#if SX_CPU_X86 && SX_COMPILER_MSVC
+static sx_cpu_features sx__os_detect_cpu_features(void)
+{
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    sx_cpu_features features = 0;
+    __cpuid(info, 1);
+    if (info[3] & (1 << 26))
+        features |= SX_CPU_FEATURE_SSE2;
+    if (info[2] & (1 << 19))
+        features |= SX_CPU_FEATURE_SSE41;
+
+    // OSXSAVE + the OS saves XMM and YMM registers
+    if ((info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6) {
+        if (info[2] & (1 << 28))
+            features |= SX_CPU_FEATURE_AVX;
+        if (info[2] & (1 << 12))
+            features |= SX_CPU_FEATURE_FMA;
+        if (max_leaf >= 7) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5))
+                features |= SX_CPU_FEATURE_AVX2;
+        }
+    }
+    return features;
+}
+#elif SX_CPU_X86 && (SX_COMPILER_GCC || SX_COMPILER_CLANG)
+static sx_cpu_features sx__os_detect_cpu_features(void)
+{
+    // __builtin_cpu_supports also checks that the OS saves YMM registers for avx features
+    __builtin_cpu_init();
+    sx_cpu_features features = 0;
+    if (__builtin_cpu_supports("sse2"))
+        features |= SX_CPU_FEATURE_SSE2;
+    if (__builtin_cpu_supports("sse4.1"))
+        features |= SX_CPU_FEATURE_SSE41;
+    if (__builtin_cpu_supports("avx"))
+        features |= SX_CPU_FEATURE_AVX;
+    if (__builtin_cpu_supports("avx2"))
+        features |= SX_CPU_FEATURE_AVX2;
+    if (__builtin_cpu_supports("fma"))
+        features |= SX_CPU_FEATURE_FMA;
+    return features;
+}
+#else
+static sx_cpu_features sx__os_detect_cpu_features(void)
+{
+#    if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return SX_CPU_FEATURE_NEON;
+#    else
+    return 0;
+#    endif
+}
+#endif
+
+static int64_t g_sx_cpu_features = -1;
+
+// detection is cheap and idempotent, so a race on the first call is harmless
+sx_cpu_features sx_os_cpu_features(void)
+{
+    if (g_sx_cpu_features == -1) {
+        g_sx_cpu_features = (int64_t)sx__os_detect_cpu_features();
+    }
+    return (sx_cpu_features)g_sx_cpu_features;
+}
+
+void sx_os_disable_cpu_features(sx_cpu_features features)
+{
+    g_sx_cpu_features = (int64_t)(sx_os_cpu_features() & ~features);
+}
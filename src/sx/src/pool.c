@@ -0,0 +1,320 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+#include "sx/allocator.h"
+#include "sx/pool.h"
+
+#include "sx/atomic.h"
+#include "sx/os.h"
+#include "sx/threads.h"
+#include "sx/vmem.h"
+
+#define SX__POOLMT_CACHE_SIZE 64
+#define SX__POOLMT_BATCH_SIZE (SX__POOLMT_CACHE_SIZE / 2)
+#define SX__POOLMT_DEFAULT_MAX_ITEMS 0x100000
+
+// overlaps the first bytes of free objects
+// 'next' chains the objects of a batch, 'next_batch' is only valid for the first object of a batch
+// and is the index+1 of the next batch's first object in the global list (0 = end)
+typedef struct sx__poolmt_node {
+    struct sx__poolmt_node* next;
+    uint32_t next_batch;
+} sx__poolmt_node;
+
+typedef struct sx__poolmt_cache {
+    int count;
+    struct sx__poolmt_cache* next;
+    void* items[SX__POOLMT_CACHE_SIZE];
+} sx__poolmt_cache;
+
+typedef struct sx_pool_mt {
+    const sx_alloc* alloc;
+    int id;
+    sx_tls tls;
+    int stride;
+    int grow_items;
+    int max_items;
+    sx_vmem_context vmem;      // objects are allocated contiguously, so index <-> pointer is cheap
+
+    // global free list of batches
+    // on 64bit: [index+1 of the first batch: lower 32 bits][ABA tag: upper 32 bits]
+#if SX_ARCH_64BIT
+    sx_atomic_int64 head;
+#else
+    sx_lock_t head_lk;
+    uint32_t head;
+#endif
+
+    sx_atomic_int num_items;    // committed objects
+    sx_lock_t grow_lk;          // protects 'vmem' when growing
+    sx_lock_t cache_lk;         // protects 'caches'
+    sx__poolmt_cache* caches;
+} sx_pool_mt;
+
+// one entry cache in front of sx_tls_get, same as slab-alloc.c
+static sx_atomic_int g__poolmt_id;
+static thread_local int t__poolmt_last_id;
+static thread_local sx__poolmt_cache* t__poolmt_last_cache;
+
+static inline uint8_t* sx__poolmt_items(const sx_pool_mt* pool)
+{
+    return (uint8_t*)pool->vmem.ptr;
+}
+
+static inline sx__poolmt_node* sx__poolmt_node_at(const sx_pool_mt* pool, uint32_t index)
+{
+    return (sx__poolmt_node*)(sx__poolmt_items(pool) + (size_t)index * (size_t)pool->stride);
+}
+
+static inline uint32_t sx__poolmt_index(const sx_pool_mt* pool, const void* ptr)
+{
+    return (uint32_t)(((const uint8_t*)ptr - sx__poolmt_items(pool)) / pool->stride);
+}
+
+// 'first' to 'last' must be linked with 'next' and last->next must be NULL
+static void sx__poolmt_push_batch(sx_pool_mt* pool, sx__poolmt_node* first)
+{
+    uint32_t first_idx = sx__poolmt_index(pool, first) + 1;
+#if SX_ARCH_64BIT
+    for (;;) {
+        int64_t head = pool->head;
+        first->next_batch = (uint32_t)(head & 0xffffffff);
+        int64_t new_head = (int64_t)(((uint64_t)head & 0xffffffff00000000ull) + 0x100000000ull) |
+                           (int64_t)first_idx;
+        if (sx_atomic_cas64(&pool->head, new_head, head) == head) {
+            break;
+        }
+        sx_yield_cpu();
+    }
+#else
+    sx_lock(&pool->head_lk);
+    first->next_batch = pool->head;
+    pool->head = first_idx;
+    sx_unlock(&pool->head_lk);
+#endif
+}
+
+static sx__poolmt_node* sx__poolmt_pop_batch(sx_pool_mt* pool)
+{
+#if SX_ARCH_64BIT
+    for (;;) {
+        int64_t head = pool->head;
+        uint32_t first_idx = (uint32_t)(head & 0xffffffff);
+        if (first_idx == 0) {
+            return NULL;
+        }
+
+        // objects are never decommitted, so reading a node that is popped by another thread in
+        // the meantime is safe, the tag makes the CAS fail in that case
+        sx__poolmt_node* first = sx__poolmt_node_at(pool, first_idx - 1);
+        uint32_t next_idx = ((volatile sx__poolmt_node*)first)->next_batch;
+        int64_t new_head = (int64_t)(((uint64_t)head & 0xffffffff00000000ull) + 0x100000000ull) |
+                           (int64_t)next_idx;
+        if (sx_atomic_cas64(&pool->head, new_head, head) == head) {
+            return first;
+        }
+        sx_yield_cpu();
+    }
+#else
+    sx__poolmt_node* first = NULL;
+    sx_lock(&pool->head_lk);
+    if (pool->head) {
+        first = sx__poolmt_node_at(pool, pool->head - 1);
+        pool->head = first->next_batch;
+    }
+    sx_unlock(&pool->head_lk);
+    return first;
+#endif
+}
+
+static sx__poolmt_cache* sx__poolmt_thread_cache(sx_pool_mt* pool)
+{
+    if (t__poolmt_last_id == pool->id) {
+        return t__poolmt_last_cache;
+    }
+
+    sx__poolmt_cache* cache = (sx__poolmt_cache*)sx_tls_get(pool->tls);
+    if (!cache) {
+        cache = (sx__poolmt_cache*)sx_aligned_malloc(pool->alloc, sizeof(sx__poolmt_cache),
+                                                     SX_CACHE_LINE_SIZE);
+        if (!cache) {
+            sx_out_of_memory();
+            return NULL;
+        }
+        cache->count = 0;
+
+        sx_lock(&pool->cache_lk);
+        cache->next = pool->caches;
+        pool->caches = cache;
+        sx_unlock(&pool->cache_lk);
+
+        sx_tls_set(pool->tls, cache);
+    }
+
+    t__poolmt_last_id = pool->id;
+    t__poolmt_last_cache = cache;
+    return cache;
+}
+
+// commits 'grow_items' more objects, fills the cache with a batch and pushes the rest to the
+// global list. Only committing memory is serialized, linking the objects is not
+static bool sx__poolmt_grow(sx_pool_mt* pool, sx__poolmt_cache* cache)
+{
+    sx_lock(&pool->grow_lk);
+    // another thread may have grown the pool while we were waiting
+    sx__poolmt_node* batch = sx__poolmt_pop_batch(pool);
+    if (batch) {
+        sx_unlock(&pool->grow_lk);
+        for (sx__poolmt_node* node = batch; node; node = node->next) {
+            cache->items[cache->count++] = node;
+        }
+        return true;
+    }
+
+    int start = pool->num_items;
+    int end = sx_min(start + pool->grow_items, pool->max_items);
+    if (start == end) {
+        sx_unlock(&pool->grow_lk);
+        return false;
+    }
+
+    int num_pages = sx_vmem_get_needed_pages((size_t)end * (size_t)pool->stride);
+    if (num_pages > pool->vmem.num_pages &&
+        !sx_vmem_commit_pages(&pool->vmem, pool->vmem.num_pages,
+                              num_pages - pool->vmem.num_pages)) {
+        sx_unlock(&pool->grow_lk);
+        sx_out_of_memory();
+        return false;
+    }
+    // use the remaining space of the last page as well
+    end = sx_min((int)(sx_vmem_commit_size(&pool->vmem) / (size_t)pool->stride), pool->max_items);
+    sx_atomic_xchg(&pool->num_items, end);
+    sx_unlock(&pool->grow_lk);
+
+    // keep the first batch (in reverse, so objects are fetched in address order)
+    int idx = sx_min(start + SX__POOLMT_BATCH_SIZE, end);
+    for (int i = idx - 1; i >= start; i--) {
+        cache->items[cache->count++] = sx__poolmt_node_at(pool, (uint32_t)i);
+    }
+
+    while (idx < end) {
+        int batch_end = sx_min(idx + SX__POOLMT_BATCH_SIZE, end);
+        sx__poolmt_node* first = sx__poolmt_node_at(pool, (uint32_t)idx);
+        for (int i = idx; i < batch_end - 1; i++) {
+            sx__poolmt_node_at(pool, (uint32_t)i)->next = sx__poolmt_node_at(pool, (uint32_t)i + 1);
+        }
+        sx__poolmt_node_at(pool, (uint32_t)batch_end - 1)->next = NULL;
+        sx__poolmt_push_batch(pool, first);
+        idx = batch_end;
+    }
+
+    return true;
+}
+
+sx_pool_mt* sx_poolmt_create(const sx_alloc* alloc, int item_sz, int capacity, int max_items)
+{
+    sx_assert(item_sz > 0 && "Item size should not be zero");
+    sx_assert(capacity > 0);
+
+    sx_pool_mt* pool = (sx_pool_mt*)sx_aligned_malloc(alloc, sizeof(sx_pool_mt), SX_CACHE_LINE_SIZE);
+    if (!pool) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(pool, 0x0, sizeof(sx_pool_mt));
+
+    if (max_items <= 0) {
+        max_items = sx_max(SX__POOLMT_DEFAULT_MAX_ITEMS, capacity);
+    }
+
+    pool->alloc = alloc;
+    pool->id = sx_atomic_incr(&g__poolmt_id);
+    pool->stride = (int)sx_align_mask(sx_max(item_sz, (int)sizeof(sx__poolmt_node)),
+                                      (int)sizeof(void*) - 1);
+    pool->grow_items = sx_align_mask(capacity, 15);
+    pool->max_items = sx_max(max_items, pool->grow_items);
+
+    if (!sx_vmem_init(&pool->vmem, 0,
+                      sx_vmem_get_needed_pages((size_t)pool->max_items * (size_t)pool->stride))) {
+        sx_aligned_free(alloc, pool, SX_CACHE_LINE_SIZE);
+        sx_out_of_memory();
+        return NULL;
+    }
+    pool->tls = sx_tls_create();
+
+    return pool;
+}
+
+void sx_poolmt_destroy(sx_pool_mt* pool, const sx_alloc* alloc)
+{
+    sx_assert(pool);
+
+    sx__poolmt_cache* cache = pool->caches;
+    while (cache) {
+        sx__poolmt_cache* next = cache->next;
+        sx_aligned_free(pool->alloc, cache, SX_CACHE_LINE_SIZE);
+        cache = next;
+    }
+
+    sx_vmem_release(&pool->vmem);
+    sx_tls_destroy(pool->tls);
+    sx_aligned_free(alloc, pool, SX_CACHE_LINE_SIZE);
+}
+
+void* sx_poolmt_new(sx_pool_mt* pool)
+{
+    sx__poolmt_cache* cache = sx__poolmt_thread_cache(pool);
+    if (!cache) {
+        return NULL;
+    }
+
+    if (cache->count == 0) {
+        sx__poolmt_node* batch = sx__poolmt_pop_batch(pool);
+        if (batch) {
+            for (sx__poolmt_node* node = batch; node; node = node->next) {
+                cache->items[cache->count++] = node;
+            }
+        } else if (!sx__poolmt_grow(pool, cache)) {
+            return NULL;
+        }
+    }
+
+    return cache->items[--cache->count];
+}
+
+void sx_poolmt_del(sx_pool_mt* pool, void* ptr)
+{
+    sx_assert(sx_poolmt_valid_ptr(pool, ptr) && "pointer does not belong to the pool");
+
+    sx__poolmt_cache* cache = sx__poolmt_thread_cache(pool);
+    if (!cache) {
+        // no thread cache, put it straight into the global list as a single object batch
+        sx__poolmt_node* node = (sx__poolmt_node*)ptr;
+        node->next = NULL;
+        sx__poolmt_push_batch(pool, node);
+        return;
+    }
+
+    if (cache->count == SX__POOLMT_CACHE_SIZE) {
+        // move the older half of the cache to the global list
+        sx__poolmt_node* first = (sx__poolmt_node*)cache->items[0];
+        for (int i = 0; i < SX__POOLMT_BATCH_SIZE - 1; i++) {
+            ((sx__poolmt_node*)cache->items[i])->next = (sx__poolmt_node*)cache->items[i + 1];
+        }
+        ((sx__poolmt_node*)cache->items[SX__POOLMT_BATCH_SIZE - 1])->next = NULL;
+        sx__poolmt_push_batch(pool, first);
+
+        sx_memcpy(cache->items, cache->items + SX__POOLMT_BATCH_SIZE,
+                  sizeof(void*) * (SX__POOLMT_CACHE_SIZE - SX__POOLMT_BATCH_SIZE));
+        cache->count -= SX__POOLMT_BATCH_SIZE;
+    }
+    cache->items[cache->count++] = ptr;
+}
+
+bool sx_poolmt_valid_ptr(const sx_pool_mt* pool, const void* ptr)
+{
+    uintptr_t offset = (uintptr_t)ptr - (uintptr_t)sx__poolmt_items(pool);
+    return offset < (uintptr_t)pool->num_items * (uintptr_t)pool->stride &&
+           offset % (uintptr_t)pool->stride == 0;
+}
@@ -0,0 +1,493 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+#include "sx/slab-alloc.h"
+
+#include "sx/atomic.h"
+#include "sx/os.h"
+#include "sx/threads.h"
+#include "sx/vmem.h"
+
+#define SX__SLAB_SPAN_SIZE 65536
+#define SX__SLAB_SPAN_HEADER 64
+#define SX__SLAB_MAX_SMALL 8192
+#define SX__SLAB_NUM_CLASSES 32
+#define SX__SLAB_LARGE_ALIGN 16
+
+#if SX_ARCH_64BIT
+#    define SX__SLAB_DEFAULT_MAX_SPAN_MEM 0x40000000    // 1GB
+#else
+#    define SX__SLAB_DEFAULT_MAX_SPAN_MEM 0x8000000     // 128MB
+#endif
+
+// 16 byte steps up to 128, then 4 classes per power of two
+static const uint32_t k__slab_class_sizes[SX__SLAB_NUM_CLASSES] = {
+    16,   32,   48,   64,   80,   96,   112,  128,     //
+    160,  192,  224,  256,  320,  384,  448,  512,     //
+    640,  768,  896,  1024, 1280, 1536, 1792, 2048,    //
+    2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192     //
+};
+
+typedef struct sx__slab_span sx__slab_span;
+typedef struct sx__slab_heap sx__slab_heap;
+
+// Lives at the start of every span, blocks follow right after it
+// A span is linked in it's heap's bin only while it has free blocks (num_used < num_blocks)
+struct sx__slab_span {
+    sx__slab_heap* heap;    // owner, only changes when the span goes back to the shared pool
+    sx__slab_span* next;
+    sx__slab_span* prev;
+    void* free_list;        // owner thread only
+    uint32_t block_size;
+    int class_idx;
+    int num_blocks;
+    int num_used;
+    int num_bumped;         // blocks after this index are never touched yet
+};
+
+// Per-thread cache, everything except 'remote_free' is only touched by the owner thread
+// stats fields are read without locks in sx_slaballoc_get_stats
+struct sx__slab_heap {
+    sx__slab_span* bins[SX__SLAB_NUM_CLASSES];
+    sx__slab_heap* next;
+    int64_t size;
+    int64_t count;
+    int64_t large_size;
+    uint8_t _pad[SX_CACHE_LINE_SIZE];
+    sx_atomic_ptr remote_free;    // blocks freed by other threads (lock-free stack)
+};
+
+typedef struct sx__slab_large_header {
+    uint64_t size;
+    uint32_t ptr_offset;
+    uint32_t _reserved;
+} sx__slab_large_header;
+
+typedef struct sx_slaballoc {
+    sx_alloc alloc;
+    const sx_alloc* backing;
+    int id;
+    sx_tls tls;
+    sx_vmem_context vmem;
+    uintptr_t span_base;    // first span, aligned to SX__SLAB_SPAN_SIZE
+    size_t span_range;      // bytes of reserved span memory after span_base (0 = not reserved)
+    int max_spans;
+
+    sx_lock_t lock;         // protects everything below
+    int num_spans;          // committed spans
+    sx__slab_span* free_spans;
+    sx__slab_heap* heaps;
+    int num_heaps;
+    int64_t peak;
+
+    uint8_t class_lut[SX__SLAB_MAX_SMALL / 16 + 1];    // (size + 15)/16 -> class index
+} sx_slaballoc;
+
+static inline sx__slab_span* sx__slab_find_span(const sx_slaballoc* slab, const void* ptr)
+{
+    uintptr_t offset = (uintptr_t)ptr - slab->span_base;
+    if (offset >= slab->span_range) {
+        return NULL;
+    }
+    return (sx__slab_span*)(slab->span_base + (offset & ~(uintptr_t)(SX__SLAB_SPAN_SIZE - 1)));
+}
+
+// one entry cache in front of sx_tls_get, for the common case of a single slab allocator
+// keyed by a unique id instead of the pointer, so a destroyed allocator can never be matched
+static sx_atomic_int g__slab_id;
+static thread_local int t__slab_last_id;
+static thread_local sx__slab_heap* t__slab_last_heap;
+
+static sx__slab_heap* sx__slab_thread_heap(sx_slaballoc* slab)
+{
+    if (t__slab_last_id == slab->id) {
+        return t__slab_last_heap;
+    }
+
+    sx__slab_heap* heap = (sx__slab_heap*)sx_tls_get(slab->tls);
+    if (heap) {
+        t__slab_last_id = slab->id;
+        t__slab_last_heap = heap;
+        return heap;
+    }
+
+    heap = (sx__slab_heap*)sx_aligned_malloc(slab->backing, sizeof(sx__slab_heap),
+                                             SX_CACHE_LINE_SIZE);
+    if (!heap) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(heap, 0x0, sizeof(sx__slab_heap));
+
+    sx_lock(&slab->lock);
+    heap->next = slab->heaps;
+    slab->heaps = heap;
+    ++slab->num_heaps;
+    sx_unlock(&slab->lock);
+
+    sx_tls_set(slab->tls, heap);
+    t__slab_last_id = slab->id;
+    t__slab_last_heap = heap;
+    return heap;
+}
+
+static inline void sx__slab_bin_push(sx__slab_heap* heap, sx__slab_span* span)
+{
+    sx__slab_span* head = heap->bins[span->class_idx];
+    span->prev = NULL;
+    span->next = head;
+    if (head) {
+        head->prev = span;
+    }
+    heap->bins[span->class_idx] = span;
+}
+
+static inline void sx__slab_bin_remove(sx__slab_heap* heap, sx__slab_span* span)
+{
+    if (span->prev) {
+        span->prev->next = span->next;
+    } else {
+        heap->bins[span->class_idx] = span->next;
+    }
+    if (span->next) {
+        span->next->prev = span->prev;
+    }
+    span->next = span->prev = NULL;
+}
+
+static sx__slab_span* sx__slab_new_span(sx_slaballoc* slab, sx__slab_heap* heap, int class_idx)
+{
+    sx__slab_span* span = NULL;
+
+    sx_lock(&slab->lock);
+    if (slab->free_spans) {
+        span = slab->free_spans;
+        slab->free_spans = span->next;
+    } else if (slab->num_spans < slab->max_spans) {
+        uintptr_t addr = slab->span_base + (size_t)slab->num_spans * SX__SLAB_SPAN_SIZE;
+        int page_id = (int)((addr - (uintptr_t)slab->vmem.ptr) / (size_t)slab->vmem.page_size);
+        span = (sx__slab_span*)sx_vmem_commit_pages(&slab->vmem, page_id,
+                                                    SX__SLAB_SPAN_SIZE / slab->vmem.page_size);
+        if (span) {
+            ++slab->num_spans;
+        }
+    }
+    sx_unlock(&slab->lock);
+
+    if (!span) {
+        return NULL;
+    }
+
+    uint32_t block_size = k__slab_class_sizes[class_idx];
+    span->heap = heap;
+    span->free_list = NULL;
+    span->block_size = block_size;
+    span->class_idx = class_idx;
+    span->num_blocks = (int)((SX__SLAB_SPAN_SIZE - SX__SLAB_SPAN_HEADER) / block_size);
+    span->num_used = 0;
+    span->num_bumped = 0;
+    sx__slab_bin_push(heap, span);
+    return span;
+}
+
+static void sx__slab_release_span(sx_slaballoc* slab, sx__slab_span* span)
+{
+    span->heap = NULL;
+    sx_lock(&slab->lock);
+    span->next = slab->free_spans;
+    slab->free_spans = span;
+    sx_unlock(&slab->lock);
+}
+
+// owner thread only
+static void sx__slab_free_block(sx_slaballoc* slab, sx__slab_heap* heap, sx__slab_span* span,
+                                void* ptr)
+{
+    *(void**)ptr = span->free_list;
+    span->free_list = ptr;
+
+    if (span->num_used == span->num_blocks) {
+        sx__slab_bin_push(heap, span);
+    }
+
+    // keep the last span of each class around, so we don't ping-pong the shared pool
+    if (--span->num_used == 0 && (span->prev || span->next)) {
+        sx__slab_bin_remove(heap, span);
+        sx__slab_release_span(slab, span);
+    }
+}
+
+static void sx__slab_free_remote(sx__slab_heap* heap, void* ptr)
+{
+    void* head;
+    do {
+        head = heap->remote_free;
+        *(void**)ptr = head;
+    } while (sx_atomic_cas_ptr(&heap->remote_free, ptr, head) != head);
+}
+
+static void sx__slab_collect_remote(sx_slaballoc* slab, sx__slab_heap* heap)
+{
+    if (!heap->remote_free) {
+        return;
+    }
+
+    void* ptr = sx_atomic_xchg_ptr(&heap->remote_free, NULL);
+    while (ptr) {
+        void* next = *(void**)ptr;
+        sx__slab_span* span = sx__slab_find_span(slab, ptr);
+        sx_assert(span && span->heap == heap);
+        sx__slab_free_block(slab, heap, span, ptr);
+        ptr = next;
+    }
+}
+
+static void* sx__slab_alloc_block(sx_slaballoc* slab, sx__slab_heap* heap, int class_idx)
+{
+    sx__slab_span* span = heap->bins[class_idx];
+    if (!span) {
+        sx__slab_collect_remote(slab, heap);
+        span = heap->bins[class_idx];
+        if (!span) {
+            span = sx__slab_new_span(slab, heap, class_idx);
+            if (!span) {
+                return NULL;
+            }
+        }
+    }
+
+    void* ptr = span->free_list;
+    if (ptr) {
+        span->free_list = *(void**)ptr;
+    } else {
+        sx_assert(span->num_bumped < span->num_blocks);
+        ptr = (uint8_t*)span + SX__SLAB_SPAN_HEADER + (size_t)span->num_bumped * span->block_size;
+        ++span->num_bumped;
+    }
+
+    if (++span->num_used == span->num_blocks) {
+        sx__slab_bin_remove(heap, span);
+    }
+    return ptr;
+}
+
+static void* sx__slab_malloc_large(sx_slaballoc* slab, sx__slab_heap* heap, size_t size)
+{
+    size_t total = size + sizeof(sx__slab_large_header) + SX__SLAB_LARGE_ALIGN;
+    uint8_t* ptr = (uint8_t*)sx_malloc(slab->backing, total);
+    if (!ptr) {
+        sx_out_of_memory();
+        return NULL;
+    }
+
+    uint8_t* aligned =
+        (uint8_t*)sx_align_ptr(ptr, sizeof(sx__slab_large_header), SX__SLAB_LARGE_ALIGN);
+    sx__slab_large_header* hdr = (sx__slab_large_header*)aligned - 1;
+    hdr->size = size;
+    hdr->ptr_offset = (uint32_t)(uintptr_t)(aligned - ptr);
+
+    heap->size += (int64_t)size;
+    heap->large_size += (int64_t)size;
+    ++heap->count;
+    return aligned;
+}
+
+static void* sx__slab_malloc(sx_slaballoc* slab, size_t size)
+{
+    sx__slab_heap* heap = sx__slab_thread_heap(slab);
+    if (size <= SX__SLAB_MAX_SMALL) {
+        int class_idx = slab->class_lut[(size + 15) >> 4];
+        void* ptr = sx__slab_alloc_block(slab, heap, class_idx);
+        if (ptr) {
+            heap->size += k__slab_class_sizes[class_idx];
+            ++heap->count;
+            return ptr;
+        }
+        // span memory is exhausted, fallback to backing allocator
+    }
+
+    return sx__slab_malloc_large(slab, heap, size);
+}
+
+static void sx__slab_free(sx_slaballoc* slab, void* ptr)
+{
+    sx__slab_heap* heap = sx__slab_thread_heap(slab);
+    sx__slab_span* span = sx__slab_find_span(slab, ptr);
+    if (span) {
+        heap->size -= span->block_size;
+        --heap->count;
+        if (span->heap == heap) {
+            sx__slab_free_block(slab, heap, span, ptr);
+        } else {
+            sx__slab_free_remote(span->heap, ptr);
+        }
+    } else {
+        sx__slab_large_header* hdr = (sx__slab_large_header*)ptr - 1;
+        heap->size -= (int64_t)hdr->size;
+        heap->large_size -= (int64_t)hdr->size;
+        --heap->count;
+        sx_free(slab->backing, (uint8_t*)ptr - hdr->ptr_offset);
+    }
+}
+
+static void* sx__slab_realloc(sx_slaballoc* slab, void* ptr, size_t size)
+{
+    sx__slab_span* span = sx__slab_find_span(slab, ptr);
+    size_t old_size;
+    if (span) {
+        if (size <= SX__SLAB_MAX_SMALL && slab->class_lut[(size + 15) >> 4] == span->class_idx) {
+            return ptr;
+        }
+        old_size = span->block_size;
+    } else {
+        sx__slab_large_header* hdr = (sx__slab_large_header*)ptr - 1;
+        old_size = (size_t)hdr->size;
+
+        if (size > SX__SLAB_MAX_SMALL) {
+            // big to big, let the backing allocator resize in place if it can
+            sx__slab_heap* heap = sx__slab_thread_heap(slab);
+            uint32_t offset = hdr->ptr_offset;
+            size_t total = size + sizeof(sx__slab_large_header) + SX__SLAB_LARGE_ALIGN;
+            uint8_t* new_ptr = (uint8_t*)sx_realloc(slab->backing, (uint8_t*)ptr - offset, total);
+            if (!new_ptr) {
+                sx_out_of_memory();
+                return NULL;
+            }
+
+            uint8_t* aligned =
+                (uint8_t*)sx_align_ptr(new_ptr, sizeof(sx__slab_large_header), SX__SLAB_LARGE_ALIGN);
+            if (aligned != new_ptr + offset) {
+                sx_memmove(aligned, new_ptr + offset, sx_min(old_size, size));
+            }
+            hdr = (sx__slab_large_header*)aligned - 1;
+            hdr->size = size;
+            hdr->ptr_offset = (uint32_t)(uintptr_t)(aligned - new_ptr);
+
+            int64_t size_diff = (int64_t)size - (int64_t)old_size;
+            heap->size += size_diff;
+            heap->large_size += size_diff;
+            return aligned;
+        }
+    }
+
+    void* new_ptr = sx__slab_malloc(slab, size);
+    if (new_ptr) {
+        sx_memcpy(new_ptr, ptr, sx_min(old_size, size));
+        sx__slab_free(slab, ptr);
+    }
+    return new_ptr;
+}
+
+static void* sx__slaballoc_cb(void* ptr, size_t size, uint32_t align, const char* file,
+                              const char* func, uint32_t line, void* user_data)
+{
+    sx_slaballoc* slab = (sx_slaballoc*)user_data;
+
+    if (size == 0) {
+        if (ptr) {
+            if (align <= SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT) {
+                sx__slab_free(slab, ptr);
+            } else {
+                sx__aligned_free(&slab->alloc, ptr, file, func, line);
+            }
+        }
+        return NULL;
+    } else if (ptr == NULL) {
+        if (align <= SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT) {
+            return sx__slab_malloc(slab, size);
+        }
+        return sx__aligned_alloc(&slab->alloc, size, align, file, func, line);
+    } else {
+        if (align <= SX_CONFIG_ALLOCATOR_NATURAL_ALIGNMENT) {
+            return sx__slab_realloc(slab, ptr, size);
+        }
+        return sx__aligned_realloc(&slab->alloc, ptr, size, align, file, func, line);
+    }
+}
+
+sx_slaballoc* sx_slaballoc_create(const sx_alloc* alloc, size_t max_span_mem)
+{
+    sx_slaballoc* slab = (sx_slaballoc*)sx_malloc(alloc, sizeof(sx_slaballoc));
+    if (!slab) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(slab, 0x0, sizeof(sx_slaballoc));
+
+    slab->alloc = (sx_alloc){ .alloc_cb = sx__slaballoc_cb, .user_data = slab };
+    slab->backing = alloc;
+    slab->id = sx_atomic_incr(&g__slab_id);
+    slab->tls = sx_tls_create();
+
+    for (int i = 0, class_idx = 0; i < (int)sizeof(slab->class_lut); i++) {
+        while (k__slab_class_sizes[class_idx] < (uint32_t)i * 16) {
+            ++class_idx;
+        }
+        slab->class_lut[i] = (uint8_t)class_idx;
+    }
+
+    // reserve virtual memory for spans, with an extra span for alignment
+    // if the reservation fails, all allocations will go to the backing allocator
+    if (max_span_mem == 0) {
+        max_span_mem = SX__SLAB_DEFAULT_MAX_SPAN_MEM;
+    }
+    int max_spans = (int)(max_span_mem / SX__SLAB_SPAN_SIZE);
+    if (max_spans > 0 && SX__SLAB_SPAN_SIZE % sx_os_pagesz() == 0 &&
+        sx_vmem_init(&slab->vmem, 0,
+                     sx_vmem_get_needed_pages((size_t)(max_spans + 1) * SX__SLAB_SPAN_SIZE))) {
+        slab->span_base = sx_align_mask((uintptr_t)slab->vmem.ptr, (uintptr_t)SX__SLAB_SPAN_SIZE - 1);
+        slab->span_range = (size_t)max_spans * SX__SLAB_SPAN_SIZE;
+        slab->max_spans = max_spans;
+    }
+
+    return slab;
+}
+
+void sx_slaballoc_destroy(sx_slaballoc* slab, const sx_alloc* alloc)
+{
+    sx_assert(slab);
+
+    sx__slab_heap* heap = slab->heaps;
+    while (heap) {
+        sx__slab_heap* next = heap->next;
+        sx_aligned_free(slab->backing, heap, SX_CACHE_LINE_SIZE);
+        heap = next;
+    }
+
+    if (slab->vmem.ptr) {
+        sx_vmem_release(&slab->vmem);
+    }
+    sx_tls_destroy(slab->tls);
+    sx_free(alloc, slab);
+}
+
+const sx_alloc* sx_slaballoc_alloc(sx_slaballoc* slab)
+{
+    return &slab->alloc;
+}
+
+size_t sx_slaballoc_usable_size(const sx_slaballoc* slab, const void* ptr)
+{
+    sx_assert(ptr);
+    const sx__slab_span* span = sx__slab_find_span(slab, ptr);
+    return span ? span->block_size : (size_t)((const sx__slab_large_header*)ptr - 1)->size;
+}
+
+void sx_slaballoc_get_stats(sx_slaballoc* slab, sx_slaballoc_stats* stats)
+{
+    sx_memset(stats, 0x0, sizeof(sx_slaballoc_stats));
+
+    int64_t large_size = 0;
+    sx_lock(&slab->lock);
+    for (sx__slab_heap* heap = slab->heaps; heap; heap = heap->next) {
+        stats->size += heap->size;
+        stats->count += heap->count;
+        large_size += heap->large_size;
+    }
+    slab->peak = sx_max(slab->peak, stats->size);
+    stats->peak = slab->peak;
+    stats->reserved = (int64_t)slab->num_spans * SX__SLAB_SPAN_SIZE + large_size;
+    stats->num_threads = slab->num_heaps;
+    sx_unlock(&slab->lock);
+}
@@ -6,6 +6,9 @@
 #include "sx/string.h"
 #include "sx/allocator.h"
 #include "sx/array.h"
+#include "sx/atomic.h"
+#include "sx/hash.h"
+#include "sx/threads.h"
 
 #define STB_SPRINTF_IMPLEMENTATION
 #define STB_SPRINTF_STATIC
@@ -838,3 +841,215 @@ void sx_strpool_collate_free(const sx_strpool* sp, sx_strpool_collate_data data)
     sx_assert(data.first);
     strpool_free_collated(sp, data.first);
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// sx_strtbl
+// entries are stored in fixed-size chunks that are never moved, so readers can access them without
+// locking. Strings with the same hash are chained, the hash-table keeps the head of the chain
+#define SX__STRTBL_CHUNK_BITS 10
+#define SX__STRTBL_CHUNK_SIZE (1 << SX__STRTBL_CHUNK_BITS)
+#define SX__STRTBL_MAX_CHUNKS 1024    // 1M strings, same as the default index bits of sx_strpool
+
+typedef struct sx__strtbl_entry {
+    const char* cstr;
+    uint32_t hash;
+    int len;
+    sx_istr_t next;    // next entry with the same hash
+} sx__strtbl_entry;
+
+typedef struct sx_strtbl {
+    const sx_alloc* alloc;
+    sx_strpool* pool;
+    sx_hashtbl_mt* tbl;    // hash -> id of the first entry
+    sx__strtbl_entry* chunks[SX__STRTBL_MAX_CHUNKS];
+    int count;
+    sx_lock_t lock;
+} sx_strtbl;
+
+static sx_strtbl* g_sx_intern;
+
+// keys 0 and SX_HASHTBL_TOMBSTONE are reserved in hash-tables
+static inline uint32_t sx__strtbl_key(uint32_t hash)
+{
+    return (hash == 0 || hash == SX_HASHTBL_TOMBSTONE) ? 1 : hash;
+}
+
+static inline const sx__strtbl_entry* sx__strtbl_entry_at(const sx_strtbl* tbl, sx_istr_t id)
+{
+    uint32_t index = id - 1;
+    sx_assert(id > 0 && (int)index < tbl->count);
+    return &tbl->chunks[index >> SX__STRTBL_CHUNK_BITS][index & (SX__STRTBL_CHUNK_SIZE - 1)];
+}
+
+static sx_istr_t sx__strtbl_find(const sx_strtbl* tbl, const char* str, int len, uint32_t hash)
+{
+    sx_istr_t id = (sx_istr_t)sx_hashtblmt_find_get(tbl->tbl, sx__strtbl_key(hash), 0);
+    while (id) {
+        const sx__strtbl_entry* e = sx__strtbl_entry_at(tbl, id);
+        if (e->hash == hash && e->len == len && sx_memcmp(e->cstr, str, len) == 0) {
+            return id;
+        }
+        id = e->next;
+    }
+    return 0;
+}
+
+sx_strtbl* sx_strtbl_create(const sx_alloc* alloc)
+{
+    sx_strtbl* tbl = sx_malloc(alloc, sizeof(sx_strtbl));
+    if (!tbl) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_memset(tbl, 0x0, sizeof(sx_strtbl));
+    tbl->alloc = alloc;
+
+    tbl->pool = sx_strpool_create(alloc, NULL);
+    tbl->tbl = sx_hashtblmt_create(alloc, SX__STRTBL_CHUNK_SIZE, 8);
+    if (!tbl->pool || !tbl->tbl) {
+        sx_strtbl_destroy(tbl, alloc);
+        return NULL;
+    }
+
+    return tbl;
+}
+
+void sx_strtbl_destroy(sx_strtbl* tbl, const sx_alloc* alloc)
+{
+    sx_assert(tbl);
+
+    for (int i = 0; i < SX__STRTBL_MAX_CHUNKS && tbl->chunks[i]; i++) {
+        sx_free(alloc, tbl->chunks[i]);
+    }
+    if (tbl->tbl) {
+        sx_hashtblmt_destroy(tbl->tbl, alloc);
+    }
+    if (tbl->pool) {
+        sx_strpool_destroy(tbl->pool, alloc);
+    }
+    sx_free(alloc, tbl);
+}
+
+sx_istr_t sx_strtbl_add(sx_strtbl* tbl, const char* str, int len)
+{
+    sx_assert(str);
+    if (len < 0) {
+        len = sx_strlen(str);
+    }
+
+    uint32_t hash = sx_hash_fnv32(str, (size_t)len);
+    sx_istr_t id = sx__strtbl_find(tbl, str, len, hash);
+    if (id) {
+        return id;
+    }
+
+    sx_lock(&tbl->lock);
+    // another thread may have added the string before we got the lock
+    id = sx__strtbl_find(tbl, str, len, hash);
+    if (id) {
+        sx_unlock(&tbl->lock);
+        return id;
+    }
+
+    int index = tbl->count;
+    int chunk = index >> SX__STRTBL_CHUNK_BITS;
+    if (chunk >= SX__STRTBL_MAX_CHUNKS) {
+        sx_unlock(&tbl->lock);
+        sx_assert(0 && "sx_strtbl: maximum number of strings exceeded");
+        return 0;
+    }
+
+    if (!tbl->chunks[chunk]) {
+        tbl->chunks[chunk] =
+            sx_malloc(tbl->alloc, sizeof(sx__strtbl_entry) * SX__STRTBL_CHUNK_SIZE);
+        if (!tbl->chunks[chunk]) {
+            sx_unlock(&tbl->lock);
+            sx_out_of_memory();
+            return 0;
+        }
+    }
+
+    // the string data of strpool is never moved, unless it's defragmented (which we never do)
+    sx_str_t handle = sx_strpool_add(tbl->pool, str, len);
+    if (!handle) {
+        sx_unlock(&tbl->lock);
+        sx_out_of_memory();
+        return 0;
+    }
+
+    uint32_t key = sx__strtbl_key(hash);
+    id = (sx_istr_t)(index + 1);
+    tbl->chunks[chunk][index & (SX__STRTBL_CHUNK_SIZE - 1)] = (sx__strtbl_entry){
+        .cstr = sx_strpool_cstr(tbl->pool, handle),
+        .hash = hash,
+        .len = len,
+        .next = (sx_istr_t)sx_hashtblmt_find_get(tbl->tbl, key, 0)
+    };
+    tbl->count = index + 1;
+    sx_memory_write_barrier();    // entry must be complete before it's published to readers
+
+    bool added = sx_hashtblmt_add(tbl->tbl, key, (int)id);
+    sx_unlock(&tbl->lock);
+
+    if (!added) {
+        sx_out_of_memory();
+        return 0;
+    }
+    return id;
+}
+
+sx_istr_t sx_strtbl_find(const sx_strtbl* tbl, const char* str, int len)
+{
+    sx_assert(str);
+    if (len < 0) {
+        len = sx_strlen(str);
+    }
+    return sx__strtbl_find(tbl, str, len, sx_hash_fnv32(str, (size_t)len));
+}
+
+const char* sx_strtbl_cstr(const sx_strtbl* tbl, sx_istr_t id)
+{
+    return id ? sx__strtbl_entry_at(tbl, id)->cstr : "";
+}
+
+uint32_t sx_strtbl_hash(const sx_strtbl* tbl, sx_istr_t id)
+{
+    return id ? sx__strtbl_entry_at(tbl, id)->hash : 0;
+}
+
+int sx_strtbl_len(const sx_strtbl* tbl, sx_istr_t id)
+{
+    return id ? sx__strtbl_entry_at(tbl, id)->len : 0;
+}
+
+int sx_strtbl_count(const sx_strtbl* tbl)
+{
+    return tbl->count;
+}
+
+void sx_strtbl_collect(sx_strtbl* tbl, uint64_t epoch, uint64_t safe_epoch)
+{
+    sx_assert(tbl);
+    sx_hashtblmt_collect(tbl->tbl, epoch, safe_epoch);
+}
+
+bool sx_intern_init(const sx_alloc* alloc)
+{
+    sx_assert(!g_sx_intern && "sx_intern is already initialized");
+    g_sx_intern = sx_strtbl_create(alloc);
+    return g_sx_intern != NULL;
+}
+
+void sx_intern_release(void)
+{
+    if (g_sx_intern) {
+        sx_strtbl_destroy(g_sx_intern, g_sx_intern->alloc);
+        g_sx_intern = NULL;
+    }
+}
+
+sx_strtbl* sx_intern_tbl(void)
+{
+    sx_assert(g_sx_intern && "sx_intern_init is not called");
+    return g_sx_intern;
+}
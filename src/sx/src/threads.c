@@ -26,7 +26,9 @@
 #    if defined(__FreeBSD__)
 #        include <pthread_np.h>
 #    endif
-#    if SX_PLATFORM_LINUX || SX_PLATFORM_RPI
+#    if SX_PLATFORM_LINUX || SX_PLATFORM_RPI || SX_PLATFORM_ANDROID
+#        include <linux/futex.h>    // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#        include <sched.h>          // sched_setaffinity
 #        include <sys/syscall.h>    // syscall
 #    endif
 #elif SX_PLATFORM_WINDOWS
@@ -714,3 +716,135 @@ uint32_t sx_thread_tid()
     sx_assert(0 && "Tid not implemented");
 #endif    // SX_PLATFORM_
 }
+
+bool sx_thread_setaffinity(int cpu_id)
+{
+    sx_assert(cpu_id >= 0);
+#if SX_PLATFORM_WINDOWS
+    GROUP_AFFINITY ga;
+    sx_memset(&ga, 0x0, sizeof(ga));
+    ga.Group = (WORD)(cpu_id / 64);
+    ga.Mask = (KAFFINITY)1 << (cpu_id % 64);
+    return SetThreadGroupAffinity(GetCurrentThread(), &ga, NULL) != 0;
+#elif SX_PLATFORM_LINUX || SX_PLATFORM_RPI || SX_PLATFORM_ANDROID
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_id, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    // not supported (apple platforms only accept affinity hints)
+    sx_unused(cpu_id);
+    return false;
+#endif
+}
+
+// Futex
+#if SX_PLATFORM_LINUX || SX_PLATFORM_RPI || SX_PLATFORM_ANDROID
+bool sx_futex_wait(sx_atomic_int* addr, int expected, int msecs)
+{
+    struct timespec ts;
+    struct timespec* pts = NULL;
+    if (msecs >= 0) {
+        ts.tv_sec = msecs / 1000;
+        ts.tv_nsec = (long)(msecs % 1000) * 1000000;
+        pts = &ts;
+    }
+
+    long r = syscall(SYS_futex, (int*)addr, FUTEX_WAIT_PRIVATE, expected, pts, NULL, 0);
+    return r == 0 || errno != ETIMEDOUT;
+}
+
+void sx_futex_wake(sx_atomic_int* addr, int count)
+{
+    syscall(SYS_futex, (int*)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+#elif SX_PLATFORM_WINDOWS && _WIN32_WINNT >= 0x0602
+bool sx_futex_wait(sx_atomic_int* addr, int expected, int msecs)
+{
+    BOOL r = WaitOnAddress((volatile VOID*)addr, &expected, sizeof(int),
+                           msecs >= 0 ? (DWORD)msecs : INFINITE);
+    return r || GetLastError() != ERROR_TIMEOUT;
+}
+
+void sx_futex_wake(sx_atomic_int* addr, int count)
+{
+    if (count == 1)
+        WakeByAddressSingle((PVOID)addr);
+    else
+        WakeByAddressAll((PVOID)addr);
+}
+#elif SX_PLATFORM_POSIX
+// No futex on this platform: waiters are hashed by address into a fixed number of buckets
+// (parking lot), and wake ups are broadcasted to all waiters of the bucket
+#    define SX__FUTEX_NUM_BUCKETS 64
+
+typedef struct sx__futex_bucket {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} sx__futex_bucket;
+
+static sx__futex_bucket g_futex_buckets[SX__FUTEX_NUM_BUCKETS];
+static pthread_once_t g_futex_once = PTHREAD_ONCE_INIT;
+
+static void sx__futex_init(void)
+{
+    for (int i = 0; i < SX__FUTEX_NUM_BUCKETS; i++) {
+        pthread_mutex_init(&g_futex_buckets[i].mutex, NULL);
+        pthread_cond_init(&g_futex_buckets[i].cond, NULL);
+    }
+}
+
+static sx__futex_bucket* sx__futex_get_bucket(sx_atomic_int* addr)
+{
+    pthread_once(&g_futex_once, sx__futex_init);
+    uintptr_t h = (uintptr_t)addr;
+    h ^= h >> 17;
+    return &g_futex_buckets[(h >> 2) % SX__FUTEX_NUM_BUCKETS];
+}
+
+bool sx_futex_wait(sx_atomic_int* addr, int expected, int msecs)
+{
+    sx__futex_bucket* b = sx__futex_get_bucket(addr);
+    int r = 0;
+    pthread_mutex_lock(&b->mutex);
+    if (*addr == expected) {
+        if (msecs < 0) {
+            r = pthread_cond_wait(&b->cond, &b->mutex);
+        } else {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            sx__tm_add(&ts, msecs);
+            r = pthread_cond_timedwait(&b->cond, &b->mutex, &ts);
+        }
+    }
+    pthread_mutex_unlock(&b->mutex);
+    return r != ETIMEDOUT;
+}
+
+void sx_futex_wake(sx_atomic_int* addr, int count)
+{
+    sx_unused(count);
+    sx__futex_bucket* b = sx__futex_get_bucket(addr);
+    pthread_mutex_lock(&b->mutex);
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->mutex);
+}
+#else
+// fallback for older windows versions: poll the value
+bool sx_futex_wait(sx_atomic_int* addr, int expected, int msecs)
+{
+    DWORD start = GetTickCount();
+    while (*addr == expected) {
+        if (msecs >= 0 && (int)(GetTickCount() - start) >= msecs)
+            return false;
+        SwitchToThread();
+    }
+    return true;
+}
+
+void sx_futex_wake(sx_atomic_int* addr, int count)
+{
+    sx_unused(addr);
+    sx_unused(count);
+}
+#endif    // SX_PLATFORM_
@@ -0,0 +1,165 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-cull.c: frustum culling of 1M items, batch kernels vs. a loop of scalar tests
+//      The scalar loop is the usual per-item p-vertex test with early-out. Items are spread
+//      around a perspective frustum, so about a quarter of them are visible.
+//      Run it on release builds
+//
+#include "sx/allocator.h"
+#include "sx/math-batch.h"
+#include "sx/rng.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+
+#define NUM_ITEMS (1024 * 1024)
+#define NUM_REPEATS 20
+#define NUM_PLANES 6
+
+static sx_rng g_rng;
+
+static float rand_float(float _min, float _max)
+{
+    return _min + sx_rng_gen_f(&g_rng) * (_max - _min);
+}
+
+static bool aabb_visible(const sx_aabb* b, const sx_plane* planes)
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        const sx_plane* p = &planes[i];
+        float x = p->normal.x > 0 ? b->xmax : b->xmin;
+        float y = p->normal.y > 0 ? b->ymax : b->ymin;
+        float z = p->normal.z > 0 ? b->zmax : b->zmin;
+        if (x * p->normal.x + y * p->normal.y + z * p->normal.z + p->dist < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sphere_visible(const sx_vec4* s, const sx_plane* planes)
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        const sx_plane* p = &planes[i];
+        if (s->x * p->normal.x + s->y * p->normal.y + s->z * p->normal.z + p->dist + s->w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool rect_visible(const sx_rect* r, const sx_plane* planes)
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        const sx_plane* p = &planes[i];
+        float x = p->normal.x > 0 ? r->xmax : r->xmin;
+        float y = p->normal.y > 0 ? r->ymax : r->ymin;
+        if (x * p->normal.x + y * p->normal.y + p->dist < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void report(const char* name, uint64_t scalar_tm, uint64_t batch_tm)
+{
+    double scalar_ms = sx_tm_ms(scalar_tm) / NUM_REPEATS;
+    double batch_ms = sx_tm_ms(batch_tm) / NUM_REPEATS;
+    printf("%-8s %12.3f %12.3f %8.2fx\n", name, scalar_ms, batch_ms, scalar_ms / batch_ms);
+}
+
+// frustum of a camera at the origin looking down +y (fov ~90), near = 0.1, far = 100
+static void make_frustum(sx_plane* planes)
+{
+    const float k = 0.70710678f;
+    planes[0] = (sx_plane){ .normal = sx_vec3f(0, 1.0f, 0), .dist = -0.1f };     // near
+    planes[1] = (sx_plane){ .normal = sx_vec3f(0, -1.0f, 0), .dist = 100.0f };   // far
+    planes[2] = (sx_plane){ .normal = sx_vec3f(k, k, 0), .dist = 0 };            // left
+    planes[3] = (sx_plane){ .normal = sx_vec3f(-k, k, 0), .dist = 0 };           // right
+    planes[4] = (sx_plane){ .normal = sx_vec3f(0, k, k), .dist = 0 };            // bottom
+    planes[5] = (sx_plane){ .normal = sx_vec3f(0, k, -k), .dist = 0 };           // top
+}
+
+int main(void)
+{
+    sx_tm_init();
+    sx_rng_seed(&g_rng, 0x5eed);
+    const sx_alloc* alloc = sx_alloc_malloc();
+
+    sx_plane planes[NUM_PLANES];
+    make_frustum(planes);
+
+    sx_aabb* aabbs = sx_malloc(alloc, sizeof(sx_aabb) * NUM_ITEMS);
+    sx_vec4* spheres = sx_malloc(alloc, sizeof(sx_vec4) * NUM_ITEMS);
+    sx_rect* rects = sx_malloc(alloc, sizeof(sx_rect) * NUM_ITEMS);
+    uint32_t* bits = sx_malloc(alloc, sizeof(uint32_t) * (NUM_ITEMS / 32));
+    uint8_t* visible = sx_malloc(alloc, NUM_ITEMS);
+    sx_assert_rel(aabbs && spheres && rects && bits && visible);
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        sx_vec3 c = sx_vec3f(rand_float(-100.0f, 100.0f), rand_float(-20.0f, 110.0f),
+                             rand_float(-100.0f, 100.0f));
+        sx_vec3 e = sx_vec3f(rand_float(0.1f, 2.0f), rand_float(0.1f, 2.0f), rand_float(0.1f, 2.0f));
+        aabbs[i] = sx_aabbv(sx_vec3_sub(c, e), sx_vec3_add(c, e));
+        spheres[i] = sx_vec4f(c.x, c.y, c.z, sx_vec3_len(e));
+        rects[i] = sx_rectv(sx_vec2f(c.x - e.x, c.y - e.y), sx_vec2f(c.x + e.x, c.y + e.y));
+    }
+
+    printf("%d items, %d planes, time per call (ms)\n", NUM_ITEMS, NUM_PLANES);
+    printf("%-8s %12s %12s %9s\n", "items", "scalar", "batch", "speedup");
+
+    uint64_t tm = sx_tm_now();
+    for (int r = 0; r < NUM_REPEATS; r++) {
+        for (int i = 0; i < NUM_ITEMS; i++) {
+            visible[i] = aabb_visible(&aabbs[i], planes);
+        }
+    }
+    uint64_t scalar_tm = sx_tm_since(tm);
+    tm = sx_tm_now();
+    for (int r = 0; r < NUM_REPEATS; r++) {
+        sx_aabb_cull_batch(bits, aabbs, NUM_ITEMS, planes, NUM_PLANES);
+    }
+    report("aabbs", scalar_tm, sx_tm_since(tm));
+
+    int num_visible = 0;
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        num_visible += visible[i];
+    }
+
+    tm = sx_tm_now();
+    for (int r = 0; r < NUM_REPEATS; r++) {
+        for (int i = 0; i < NUM_ITEMS; i++) {
+            visible[i] = sphere_visible(&spheres[i], planes);
+        }
+    }
+    scalar_tm = sx_tm_since(tm);
+    tm = sx_tm_now();
+    for (int r = 0; r < NUM_REPEATS; r++) {
+        sx_sphere_cull_batch(bits, spheres, NUM_ITEMS, planes, NUM_PLANES);
+    }
+    report("spheres", scalar_tm, sx_tm_since(tm));
+
+    tm = sx_tm_now();
+    for (int r = 0; r < NUM_REPEATS; r++) {
+        for (int i = 0; i < NUM_ITEMS; i++) {
+            visible[i] = rect_visible(&rects[i], planes);
+        }
+    }
+    scalar_tm = sx_tm_since(tm);
+    tm = sx_tm_now();
+    for (int r = 0; r < NUM_REPEATS; r++) {
+        sx_rect_cull_batch(bits, rects, NUM_ITEMS, planes, NUM_PLANES);
+    }
+    report("rects", scalar_tm, sx_tm_since(tm));
+
+    printf("visible aabbs: %.1f%%\n", 100.0 * num_visible / NUM_ITEMS);
+
+    sx_free(alloc, aabbs);
+    sx_free(alloc, spheres);
+    sx_free(alloc, rects);
+    sx_free(alloc, bits);
+    sx_free(alloc, visible);
+    return 0;
+}
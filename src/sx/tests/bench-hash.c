@@ -0,0 +1,147 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-hash.c: throughput of the sx hash functions on small, medium and large inputs
+//      Every function hashes the same buffer over and over until ~256mb is hashed, results are
+//      reported in GB/s. xxh3 runs one-shot and streaming (4kb updates for inputs that are bigger
+//      than that), first on the path that the cpu supports (AVX2), and then again after AVX2 is
+//      disabled with sx_os_disable_cpu_features (SSE2)
+//      Run it on release builds
+//
+#include "sx/allocator.h"
+#include "sx/hash.h"
+#include "sx/os.h"
+#include "sx/rng.h"
+#include "sx/string.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+
+#define TOTAL_BYTES (256 * 1024 * 1024)
+#define STREAM_CHUNK 4096
+
+static const int k_sizes[] = { 16, 256, 4096, 1024 * 1024 };
+#define NUM_SIZES ((int)(sizeof(k_sizes) / sizeof(int)))
+
+static volatile uint64_t g_sink;
+static sx_hash_xxh3_t* g_state;
+
+typedef uint64_t(bench_hash_cb)(const uint8_t* data, int len);
+
+static uint64_t hash_xxh32(const uint8_t* data, int len)
+{
+    return sx_hash_xxh32(data, (size_t)len, 0);
+}
+
+static uint64_t hash_xxh64(const uint8_t* data, int len)
+{
+    return sx_hash_xxh64(data, (size_t)len, 0);
+}
+
+static uint64_t hash_xxh3_64(const uint8_t* data, int len)
+{
+    return sx_hash_xxh3_64(data, (size_t)len, 0);
+}
+
+static uint64_t hash_xxh3_128(const uint8_t* data, int len)
+{
+    return sx_hash_xxh3_128(data, (size_t)len, 0).low;
+}
+
+static uint64_t hash_xxh3_stream(const uint8_t* data, int len)
+{
+    sx_hash_xxh3_init(g_state, 0);
+    for (int offset = 0; offset < len; offset += STREAM_CHUNK) {
+        sx_hash_xxh3_update(g_state, data + offset, (size_t)sx_min(STREAM_CHUNK, len - offset));
+    }
+    return sx_hash_xxh3_digest64(g_state);
+}
+
+static uint64_t hash_fnv32(const uint8_t* data, int len)
+{
+    return sx_hash_fnv32(data, (size_t)len);
+}
+
+static uint64_t hash_crc32(const uint8_t* data, int len)
+{
+    return sx_hash_crc32(data, (size_t)len, 0);
+}
+
+// returns GB/s
+static double bench(bench_hash_cb* hash_cb, const uint8_t* data, int len)
+{
+    int count = TOTAL_BYTES / len;
+    uint64_t sum = 0;
+    for (int i = 0; i < count / 16; i++) {    // warm up
+        sum += hash_cb(data, len);
+    }
+
+    uint64_t tm = sx_tm_now();
+    for (int i = 0; i < count; i++) {
+        sum += hash_cb(data, len);
+    }
+    tm = sx_tm_since(tm);
+    g_sink += sum;
+    return (double)count * (double)len / sx_tm_sec(tm) / 1e9;
+}
+
+static void run(const char* name, bench_hash_cb* hash_cb, const uint8_t* data)
+{
+    printf("%-16s", name);
+    for (int i = 0; i < NUM_SIZES; i++) {
+        printf(" %10.2f", bench(hash_cb, data, k_sizes[i]));
+    }
+    puts("");
+}
+
+static void run_xxh3(const char* path, const uint8_t* data)
+{
+    char name[32];
+    sx_snprintf(name, sizeof(name), "xxh3_64 %s", path);
+    run(name, hash_xxh3_64, data);
+    sx_snprintf(name, sizeof(name), "xxh3_128 %s", path);
+    run(name, hash_xxh3_128, data);
+    sx_snprintf(name, sizeof(name), "xxh3_st %s", path);
+    run(name, hash_xxh3_stream, data);
+}
+
+int main(void)
+{
+    sx_tm_init();
+    const sx_alloc* alloc = sx_alloc_malloc();
+    const int max_size = k_sizes[NUM_SIZES - 1];
+    uint8_t* data = sx_malloc(alloc, (size_t)max_size);
+    g_state = sx_hash_create_xxh3(alloc);
+    sx_assert_rel(data && g_state);
+
+    sx_rng rng;
+    sx_rng_seed(&rng, 0x5eed);
+    for (int i = 0; i < max_size; i++) {
+        data[i] = (uint8_t)sx_rng_gen(&rng);
+    }
+
+    printf("throughput (GB/s)\n%-16s", "hash");
+    for (int i = 0; i < NUM_SIZES; i++) {
+        printf(" %9db", k_sizes[i]);
+    }
+    puts("");
+
+    run("xxh32", hash_xxh32, data);
+    run("xxh64", hash_xxh64, data);
+#if SX_CPU_X86
+    if (sx_os_cpu_features() & SX_CPU_FEATURE_AVX2) {
+        run_xxh3("avx2", data);
+    }
+    sx_os_disable_cpu_features(SX_CPU_FEATURE_AVX2);
+    run_xxh3("sse2", data);
+#else
+    run_xxh3("", data);
+#endif
+    run("fnv32", hash_fnv32, data);
+    run("crc32", hash_crc32, data);
+
+    sx_hash_destroy_xxh3(g_state, alloc);
+    sx_free(alloc, data);
+    return 0;
+}
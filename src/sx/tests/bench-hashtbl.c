@@ -0,0 +1,142 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-hashtbl.c: sx_hashtbl and sx_hashtbl64 lookup cost for hits and misses
+//      Tables are filled to 50% and 90% of their capacity (90% is above SX_CONFIG_HASHTBL_MAX_LOAD,
+//      so keys are added without growing), then looked up with random keys in a random order.
+//      Small tables fit in L1/L2, large ones don't. Reported as ns per lookup
+//      Run it on release builds
+//
+#include "sx/allocator.h"
+#include "sx/hash.h"
+#include "sx/rng.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+
+#define NUM_LOOKUPS (4 * 1024 * 1024)
+
+static const int k_capacities[] = { 4096, 4 * 1024 * 1024 };
+static const int k_loads[] = { 50, 90 };
+
+static sx_rng g_rng;
+static volatile int g_sink;
+
+static uint32_t rand_key(void)
+{
+    uint32_t key;
+    do {
+        key = sx_rng_gen(&g_rng);
+    } while (key == 0 || key == SX_HASHTBL_TOMBSTONE);
+    return key;
+}
+
+static uint64_t rand_key64(void)
+{
+    return ((uint64_t)sx_rng_gen(&g_rng) << 32) | rand_key();
+}
+
+static double lookup32(const sx_hashtbl* tbl, const uint32_t* keys)
+{
+    int sum = 0;
+    uint64_t tm = sx_tm_now();
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        sum += sx_hashtbl_find_get(tbl, keys[i], 1);
+    }
+    tm = sx_tm_since(tm);
+    g_sink += sum;
+    return sx_tm_ns(tm) / NUM_LOOKUPS;
+}
+
+static double lookup64(const sx_hashtbl64* tbl, const uint64_t* keys)
+{
+    int sum = 0;
+    uint64_t tm = sx_tm_now();
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        sum += sx_hashtbl64_find_get(tbl, keys[i], 1);
+    }
+    tm = sx_tm_since(tm);
+    g_sink += sum;
+    return sx_tm_ns(tm) / NUM_LOOKUPS;
+}
+
+static void bench32(const sx_alloc* alloc, int capacity, int load, uint32_t* keys, uint32_t* hits,
+                    uint32_t* misses)
+{
+    sx_hashtbl* tbl = sx_hashtbl_create(alloc, capacity);
+    sx_assert_rel(tbl);
+    int count = (int)((int64_t)tbl->capacity * load / 100);
+    for (int i = 0; i < count; i++) {
+        keys[i] = rand_key();
+        sx_hashtbl_add(tbl, keys[i], i);
+    }
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        hits[i] = keys[sx_rng_gen(&g_rng) % (uint32_t)count];
+        uint32_t key;
+        do {
+            key = rand_key();
+        } while (sx_hashtbl_find(tbl, key) != -1);
+        misses[i] = key;
+    }
+
+    lookup32(tbl, hits);    // warm up
+    double hit_ns = lookup32(tbl, hits);
+    double miss_ns = lookup32(tbl, misses);
+    printf("%-10s %10d %5d%% %10.2f %10.2f\n", "hashtbl", tbl->capacity, load, hit_ns, miss_ns);
+    sx_hashtbl_destroy(tbl, alloc);
+}
+
+static void bench64(const sx_alloc* alloc, int capacity, int load, uint64_t* keys, uint64_t* hits,
+                    uint64_t* misses)
+{
+    sx_hashtbl64* tbl = sx_hashtbl64_create(alloc, capacity);
+    sx_assert_rel(tbl);
+    int count = (int)((int64_t)tbl->capacity * load / 100);
+    for (int i = 0; i < count; i++) {
+        keys[i] = rand_key64();
+        sx_hashtbl64_add(tbl, keys[i], i);
+    }
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        hits[i] = keys[sx_rng_gen(&g_rng) % (uint32_t)count];
+        uint64_t key;
+        do {
+            key = rand_key64();
+        } while (sx_hashtbl64_find(tbl, key) != -1);
+        misses[i] = key;
+    }
+
+    lookup64(tbl, hits);    // warm up
+    double hit_ns = lookup64(tbl, hits);
+    double miss_ns = lookup64(tbl, misses);
+    printf("%-10s %10d %5d%% %10.2f %10.2f\n", "hashtbl64", tbl->capacity, load, hit_ns, miss_ns);
+    sx_hashtbl64_destroy(tbl, alloc);
+}
+
+int main(void)
+{
+    sx_tm_init();
+    sx_rng_seed(&g_rng, 0x5eed);
+    const sx_alloc* alloc = sx_alloc_malloc();
+
+    const int max_capacity = k_capacities[sizeof(k_capacities) / sizeof(int) - 1];
+    uint64_t* keys = sx_malloc(alloc, sizeof(uint64_t) * max_capacity);
+    uint64_t* hits = sx_malloc(alloc, sizeof(uint64_t) * NUM_LOOKUPS);
+    uint64_t* misses = sx_malloc(alloc, sizeof(uint64_t) * NUM_LOOKUPS);
+    sx_assert_rel(keys && hits && misses);
+
+    printf("%d lookups, time per lookup (ns)\n", NUM_LOOKUPS);
+    printf("%-10s %10s %6s %10s %10s\n", "table", "capacity", "load", "hit", "miss");
+    for (int c = 0; c < (int)(sizeof(k_capacities) / sizeof(int)); c++) {
+        for (int l = 0; l < (int)(sizeof(k_loads) / sizeof(int)); l++) {
+            bench32(alloc, k_capacities[c], k_loads[l], (uint32_t*)keys, (uint32_t*)hits,
+                    (uint32_t*)misses);
+            bench64(alloc, k_capacities[c], k_loads[l], keys, hits, misses);
+        }
+    }
+
+    sx_free(alloc, keys);
+    sx_free(alloc, hits);
+    sx_free(alloc, misses);
+    return 0;
+}
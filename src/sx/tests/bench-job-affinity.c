@@ -0,0 +1,125 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-job-affinity.c: cache-miss heavy workload with and without job affinity keys
+//      Simulates per-object systems that touch the same data every frame: each object owns a
+//      shuffled linked list (pointer chase, so every step is a dependent load) that is walked by
+//      one job per frame. With affinity, jobs of the same object are keyed to the same worker,
+//      so the object's working set stays in that core's caches between frames.
+//      Arguments: [num_threads] [num_objects] [object_kb]
+//
+#include "sx/allocator.h"
+#include "sx/jobs.h"
+#include "sx/os.h"
+#include "sx/rng.h"
+#include "sx/sx.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_FRAMES 200
+
+typedef struct object_data {
+    uint32_t* next;    // shuffled cycle: next[i] is the index of the node after i
+    int num_nodes;
+    uint32_t sum;
+} object_data;
+
+static void object_walk_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(thread_index);
+    object_data* objs = user;
+    for (int i = range_start; i < range_end; i++) {
+        object_data* obj = &objs[i];
+        uint32_t idx = 0, sum = 0;
+        for (int k = 0; k < obj->num_nodes; k++) {
+            idx = obj->next[idx];
+            sum += idx;
+        }
+        obj->sum += sum;
+    }
+}
+
+// returns average frame time in microseconds
+static double run_frames(sx_job_context* ctx, object_data* objs, int num_objects, bool affinity)
+{
+    sx_job_t* jobs = sx_malloc(sx_alloc_malloc(), sizeof(sx_job_t) * num_objects);
+    sx_assert_rel(jobs);
+    uint64_t start_tm = sx_tm_now();
+    for (int f = 0; f < NUM_FRAMES; f++) {
+        for (int i = 0; i < num_objects; i++) {
+            // one job per object, user data is offset so the range is always [0, 1)
+            jobs[i] = sx_job_dispatch(ctx, 1, object_walk_cb, &objs[i], SX_JOB_PRIORITY_NORMAL, 0,
+                                      affinity ? (unsigned int)(i + 1) : 0, SX_JOB_FLAG_LEAF);
+        }
+        for (int i = 0; i < num_objects; i++) {
+            sx_job_wait_and_del(ctx, jobs[i]);
+        }
+    }
+    double frame_us = sx_tm_us(sx_tm_since(start_tm)) / (double)NUM_FRAMES;
+    sx_free(sx_alloc_malloc(), jobs);
+    return frame_us;
+}
+
+int main(int argc, char* argv[])
+{
+    sx_tm_init();
+    const sx_alloc* alloc = sx_alloc_malloc();
+    int num_threads = argc > 1 ? atoi(argv[1]) : sx_os_numcores();
+    int num_objects = argc > 2 ? atoi(argv[2]) : 16;
+    int object_kb = argc > 3 ? atoi(argv[3]) : 256;
+    num_threads = sx_max(num_threads, 1);
+    num_objects = sx_max(num_objects, 1);
+    object_kb = sx_max(object_kb, 1);
+
+    sx_rng rng;
+    sx_rng_seed(&rng, 0x5eed);
+
+    // Sattolo's shuffle, to make a single cycle that visits every node of the object
+    int num_nodes = object_kb * 1024 / (int)sizeof(uint32_t);
+    object_data* objs = sx_malloc(alloc, sizeof(object_data) * num_objects);
+    sx_assert_rel(objs);
+    for (int i = 0; i < num_objects; i++) {
+        uint32_t* perm = sx_malloc(alloc, sizeof(uint32_t) * num_nodes);
+        uint32_t* next = sx_malloc(alloc, sizeof(uint32_t) * num_nodes);
+        sx_assert_rel(perm && next);
+        for (int k = 0; k < num_nodes; k++) {
+            perm[k] = (uint32_t)k;
+        }
+        for (int k = num_nodes - 1; k > 0; k--) {
+            int j = (int)(sx_rng_gen(&rng) % (uint32_t)k);
+            sx_swap(perm[k], perm[j], uint32_t);
+        }
+        for (int k = 0; k < num_nodes; k++) {
+            next[perm[k]] = perm[(k + 1) % num_nodes];
+        }
+        sx_free(alloc, perm);
+        objs[i] = (object_data){ .next = next, .num_nodes = num_nodes };
+    }
+
+    sx_job_context* ctx = sx_job_create_context(
+        alloc, &(sx_job_context_desc){ .num_threads = num_threads - 1,
+                                       .max_fibers = num_objects * 2 });
+    if (!ctx) {
+        puts("creating job context failed");
+        return 1;
+    }
+
+    printf("cores: %d, threads: %d, objects: %d x %d kb\n", sx_os_numcores(), num_threads,
+           num_objects, object_kb);
+
+    run_frames(ctx, objs, num_objects, false);    // warm up
+    double no_affinity = run_frames(ctx, objs, num_objects, false);
+    double with_affinity = run_frames(ctx, objs, num_objects, true);
+    printf("no affinity:   %10.1f us/frame\n", no_affinity);
+    printf("with affinity: %10.1f us/frame (%.2fx)\n", with_affinity, no_affinity / with_affinity);
+
+    sx_job_destroy_context(ctx, alloc);
+    for (int i = 0; i < num_objects; i++) {
+        sx_free(alloc, objs[i].next);
+    }
+    sx_free(alloc, objs);
+    return 0;
+}
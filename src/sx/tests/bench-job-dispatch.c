@@ -0,0 +1,191 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-job-dispatch.c: cost of job counter allocation and dispatch
+//      1) counters: bursts of N allocations followed by N frees, from 1..T threads at the same
+//         time (default: number of cores, or first argument). Compares the locked sx_pool that
+//         sx_job used for counters before (one lock per new/del), with sx_pool_mt (per-thread
+//         caches of 64 items, refilled and drained in batches of 32).
+//         Bursts bigger than the cache size go through the refill/drain path on every burst
+//      2) dispatch: bursts of N single-item leaf jobs, dispatched and then waited by the main
+//         thread, with 0 and T-1 workers. Reported as ns per job (dispatch + run + wait + del)
+//      Run it on release builds
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/jobs.h"
+#include "sx/os.h"
+#include "sx/pool.h"
+#include "sx/threads.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_OPS (1024 * 1024)    // counter allocations per thread
+#define NUM_JOBS (256 * 1024)    // jobs per dispatch run
+#define MAX_BURST 256
+#define MAX_THREADS 64
+
+static const int k_bursts[] = { 1, 16, 64, 256 };
+#define NUM_BURSTS ((int)(sizeof(k_bursts) / sizeof(int)))
+
+typedef struct counter_bench {
+    sx_pool* pool;    // 'locked' mode
+    sx_lock_t lock;
+    sx_pool_mt* pool_mt;    // 'mt' mode
+    int burst;
+    sx_atomic_int ready;
+    sx_atomic_int go;
+} counter_bench;
+
+static void counter_burst_locked(counter_bench* b, void** items)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    for (int i = 0; i < b->burst; i++) {
+        sx_lock(&b->lock);
+        items[i] = sx_pool_new_and_grow(b->pool, alloc);
+        sx_unlock(&b->lock);
+    }
+    for (int i = 0; i < b->burst; i++) {
+        sx_lock(&b->lock);
+        sx_pool_del(b->pool, items[i]);
+        sx_unlock(&b->lock);
+    }
+}
+
+static void counter_burst_mt(counter_bench* b, void** items)
+{
+    for (int i = 0; i < b->burst; i++) {
+        items[i] = sx_poolmt_new(b->pool_mt);
+    }
+    for (int i = 0; i < b->burst; i++) {
+        sx_poolmt_del(b->pool_mt, items[i]);
+    }
+}
+
+static int counter_thread_cb(void* user1, void* user2)
+{
+    sx_unused(user2);
+    counter_bench* b = user1;
+    void* items[MAX_BURST];
+
+    sx_atomic_incr(&b->ready);
+    while (!b->go) {
+        sx_thread_yield();
+    }
+
+    for (int i = 0, c = NUM_OPS / b->burst; i < c; i++) {
+        if (b->pool) {
+            counter_burst_locked(b, items);
+        } else {
+            counter_burst_mt(b, items);
+        }
+    }
+    return 0;
+}
+
+// returns ns per new+del pair
+static double run_counters(bool mt, int burst, int num_threads)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    counter_bench b = { .burst = burst };
+    if (mt) {
+        b.pool_mt = sx_poolmt_create(alloc, sizeof(int), 256, 0);
+    } else {
+        b.pool = sx_pool_create(alloc, sizeof(int), 256);
+    }
+
+    sx_thread* threads[MAX_THREADS];
+    for (int i = 1; i < num_threads; i++) {
+        threads[i] = sx_thread_create(alloc, counter_thread_cb, &b, 0, "bench", NULL);
+    }
+    while (b.ready != num_threads - 1) {
+        sx_thread_yield();
+    }
+
+    uint64_t start_tm = sx_tm_now();
+    sx_atomic_xchg(&b.go, 1);
+    counter_thread_cb(&b, NULL);
+    for (int i = 1; i < num_threads; i++) {
+        sx_thread_destroy(threads[i], alloc);
+    }
+    double ns = (double)sx_tm_ns(sx_tm_since(start_tm)) / (double)(NUM_OPS / burst * burst);
+
+    if (mt) {
+        sx_poolmt_destroy(b.pool_mt, alloc);
+    } else {
+        sx_pool_destroy(b.pool, alloc);
+    }
+    return ns;
+}
+
+static void job_empty_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(range_start);
+    sx_unused(range_end);
+    sx_unused(thread_index);
+    sx_unused(user);
+}
+
+// returns ns per job
+static double run_dispatch(sx_job_context* ctx, int burst)
+{
+    sx_job_t jobs[MAX_BURST];
+    int num_bursts = NUM_JOBS / burst;
+    uint64_t start_tm = sx_tm_now();
+    for (int b = 0; b < num_bursts; b++) {
+        for (int i = 0; i < burst; i++) {
+            jobs[i] = sx_job_dispatch(ctx, 1, job_empty_cb, NULL, SX_JOB_PRIORITY_NORMAL, 0, 0,
+                                      SX_JOB_FLAG_LEAF);
+        }
+        for (int i = 0; i < burst; i++) {
+            sx_job_wait_and_del(ctx, jobs[i]);
+        }
+    }
+    return (double)sx_tm_ns(sx_tm_since(start_tm)) / (double)(num_bursts * burst);
+}
+
+int main(int argc, char* argv[])
+{
+    sx_tm_init();
+    const sx_alloc* alloc = sx_alloc_malloc();
+    int max_threads = argc > 1 ? atoi(argv[1]) : sx_os_numcores();
+    max_threads = sx_clamp(max_threads, 1, MAX_THREADS);
+
+    printf("cores: %d\n", sx_os_numcores());
+    puts("counters: ns per new+del");
+    printf("%8s %8s %10s %10s %9s\n", "threads", "burst", "locked", "pool_mt", "speedup");
+    for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+        for (int i = 0; i < NUM_BURSTS; i++) {
+            double locked = run_counters(false, k_bursts[i], num_threads);
+            double mt = run_counters(true, k_bursts[i], num_threads);
+            printf("%8d %8d %10.2f %10.2f %8.2fx\n", num_threads, k_bursts[i], locked, mt,
+                   locked / mt);
+        }
+    }
+
+    puts("\ndispatch: ns per leaf job (dispatch + run + wait + del)");
+    printf("%8s %8s %10s\n", "threads", "burst", "ns/job");
+    for (int num_threads = 1; num_threads <= max_threads;
+         num_threads = num_threads < max_threads ? max_threads : num_threads + 1) {
+        sx_job_context* ctx = sx_job_create_context(
+            alloc, &(sx_job_context_desc){ .num_threads = num_threads - 1,
+                                           .max_fibers = MAX_BURST * 2,
+                                           .fiber_stack_sz = 64 * 1024 });
+        if (!ctx) {
+            puts("creating job context failed");
+            return 1;
+        }
+
+        run_dispatch(ctx, 64);    // warm up
+        for (int i = 0; i < NUM_BURSTS; i++) {
+            printf("%8d %8d %10.1f\n", num_threads, k_bursts[i], run_dispatch(ctx, k_bursts[i]));
+        }
+
+        sx_job_destroy_context(ctx, alloc);
+    }
+
+    return 0;
+}
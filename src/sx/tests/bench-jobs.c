@@ -0,0 +1,99 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-jobs.c: job scheduler contention benchmark
+//      Dispatches batches of small jobs and measures how throughput scales with the number of
+//      threads (main + workers), from 1 to N (default: number of cores, or first argument).
+//      Each workload is run with:
+//          - empty jobs: only measures the cost of dispatching, selecting and stealing jobs
+//          - ~1us jobs: small, but real work per job
+//
+#include "sx/allocator.h"
+#include "sx/jobs.h"
+#include "sx/os.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_JOBS_PER_BATCH 64
+#define NUM_BATCHES 2000
+
+static volatile uint32_t g_sink;
+
+static void job_empty_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(range_start);
+    sx_unused(range_end);
+    sx_unused(thread_index);
+    sx_unused(user);
+}
+
+static void job_work_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(thread_index);
+    sx_unused(user);
+    uint32_t x = (uint32_t)range_start;
+    for (int i = range_start; i < range_end; i++) {
+        for (int k = 0; k < 400; k++) {
+            x = x * 1664525u + 1013904223u;
+        }
+    }
+    g_sink += x;
+}
+
+// returns jobs per millisecond
+static double run_batches(sx_job_context* ctx, sx_job_cb* callback)
+{
+    sx_job_t jobs[NUM_JOBS_PER_BATCH];
+    uint64_t start_tm = sx_tm_now();
+    for (int b = 0; b < NUM_BATCHES; b++) {
+        for (int i = 0; i < NUM_JOBS_PER_BATCH; i++) {
+            jobs[i] = sx_job_dispatch(ctx, 1, callback, NULL, SX_JOB_PRIORITY_NORMAL, 0, 0,
+                                      SX_JOB_FLAG_LEAF);
+        }
+        for (int i = 0; i < NUM_JOBS_PER_BATCH; i++) {
+            sx_job_wait_and_del(ctx, jobs[i]);
+        }
+    }
+    return (double)(NUM_JOBS_PER_BATCH * NUM_BATCHES) / sx_tm_ms(sx_tm_since(start_tm));
+}
+
+int main(int argc, char* argv[])
+{
+    sx_tm_init();
+    const sx_alloc* alloc = sx_alloc_malloc();
+    int max_threads = argc > 1 ? atoi(argv[1]) : sx_os_numcores();
+    max_threads = sx_max(max_threads, 1);
+
+    printf("cores: %d\n", sx_os_numcores());
+    printf("%8s %16s %9s %16s %9s\n", "threads", "empty (jobs/ms)", "scaling", "1us (jobs/ms)",
+           "scaling");
+
+    double base_empty = 0, base_work = 0;
+    for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+        sx_job_context* ctx = sx_job_create_context(
+            alloc, &(sx_job_context_desc){ .num_threads = num_threads - 1,
+                                           .max_fibers = NUM_JOBS_PER_BATCH * 2,
+                                           .fiber_stack_sz = 64 * 1024 });
+        if (!ctx) {
+            puts("creating job context failed");
+            return 1;
+        }
+
+        run_batches(ctx, job_empty_cb);    // warm up
+        double empty = run_batches(ctx, job_empty_cb);
+        double work = run_batches(ctx, job_work_cb);
+        if (num_threads == 1) {
+            base_empty = empty;
+            base_work = work;
+        }
+        printf("%8d %16.1f %8.2fx %16.1f %8.2fx\n", num_threads, empty, empty / base_empty, work,
+               work / base_work);
+
+        sx_job_destroy_context(ctx, alloc);
+    }
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-math-batch.c: math-batch.h kernels vs. loops of the scalar math.h functions
+//      Each kernel processes NUM_ITEMS items (cache resident) NUM_REPEATS times, and the time per
+//      item is reported. Run it on release builds
+//
+#include "sx/allocator.h"
+#include "sx/math-batch.h"
+#include "sx/os.h"
+#include "sx/rng.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+
+#define NUM_ITEMS 4096
+#define NUM_REPEATS 500
+// padded, so the soa streams start at different offsets within 4k pages. otherwise loads alias
+// with recent stores of other streams (4k aliasing) and the soa kernels are measured much slower
+#define SOA_STRIDE (NUM_ITEMS + 272)
+
+static sx_rng g_rng;
+static volatile float g_sink;
+
+static void rand_floats(float* f, int count, float _min, float _max)
+{
+    for (int i = 0; i < count; i++) {
+        f[i] = _min + sx_rng_gen_f(&g_rng) * (_max - _min);
+    }
+}
+
+static double ns_per_item(uint64_t tm)
+{
+    return sx_tm_us(tm) * 1000.0 / ((double)NUM_ITEMS * NUM_REPEATS);
+}
+
+static void report(const char* name, uint64_t scalar_tm, uint64_t batch_tm)
+{
+    double scalar_ns = ns_per_item(scalar_tm);
+    double batch_ns = ns_per_item(batch_tm);
+    printf("%-26s %10.2f %10.2f %8.2fx\n", name, scalar_ns, batch_ns, scalar_ns / batch_ns);
+}
+
+int main(void)
+{
+    sx_tm_init();
+    sx_rng_seed(&g_rng, 0x5eed);
+    const sx_alloc* alloc = sx_alloc_malloc();
+
+    sx_cpu_features features = sx_os_cpu_features();
+    printf("cpu: avx2=%d fma=%d\n", (features & SX_CPU_FEATURE_AVX2) ? 1 : 0,
+           (features & SX_CPU_FEATURE_FMA) ? 1 : 0);
+    printf("%-26s %10s %10s %9s\n", "kernel", "scalar(ns)", "batch(ns)", "speedup");
+
+    // big enough for 3 arrays of the biggest item (sx_mat4)
+    float* buff = sx_malloc(alloc, sizeof(sx_mat4) * NUM_ITEMS * 3);
+    sx_assert_rel(buff);
+    rand_floats(buff, NUM_ITEMS * 16 * 3, -2.0f, 2.0f);
+    uint8_t* p0 = (uint8_t*)buff;
+    uint8_t* p1 = p0 + sizeof(sx_mat4) * NUM_ITEMS;
+    uint8_t* p2 = p1 + sizeof(sx_mat4) * NUM_ITEMS;
+
+    sx_mat4 mat;
+    sx_mat3 mat3;
+    rand_floats(mat.f, 16, -2.0f, 2.0f);
+    rand_floats(mat3.f, 9, -2.0f, 2.0f);
+    uint64_t tm;
+
+    {
+        sx_vec3* src = (sx_vec3*)p0;
+        sx_vec3* dst = (sx_vec3*)p1;
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                dst[i] = sx_mat4_mul_vec3(&mat, src[i]);
+            }
+            g_sink += dst[r].x;
+        }
+        uint64_t scalar_tm = sx_tm_since(tm);
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_mat4_mul_vec3_batch(dst, src, NUM_ITEMS, &mat);
+            g_sink += dst[r].x;
+        }
+        report("sx_mat4_mul_vec3_batch", scalar_tm, sx_tm_since(tm));
+
+        float* f = (float*)p0;
+        sx_vec3_soa s = { f, f + SOA_STRIDE, f + SOA_STRIDE * 2 };
+        sx_vec3_soa d = { f + SOA_STRIDE * 3, f + SOA_STRIDE * 4, f + SOA_STRIDE * 5 };
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_mat4_mul_vec3_soa(d, s, NUM_ITEMS, &mat);
+            g_sink += d.x[r];
+        }
+        report("sx_mat4_mul_vec3_soa", scalar_tm, sx_tm_since(tm));
+    }
+
+    {
+        sx_vec2* src = (sx_vec2*)p0;
+        sx_vec2* dst = (sx_vec2*)p1;
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                dst[i] = sx_mat3_mul_vec2(&mat3, src[i]);
+            }
+            g_sink += dst[r].x;
+        }
+        uint64_t scalar_tm = sx_tm_since(tm);
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_mat3_mul_vec2_batch(dst, src, NUM_ITEMS, &mat3);
+            g_sink += dst[r].x;
+        }
+        report("sx_mat3_mul_vec2_batch", scalar_tm, sx_tm_since(tm));
+
+        float* f = (float*)p0;
+        sx_vec2_soa s = { f, f + SOA_STRIDE };
+        sx_vec2_soa d = { f + SOA_STRIDE * 2, f + SOA_STRIDE * 3 };
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_mat3_mul_vec2_soa(d, s, NUM_ITEMS, &mat3);
+            g_sink += d.x[r];
+        }
+        report("sx_mat3_mul_vec2_soa", scalar_tm, sx_tm_since(tm));
+    }
+
+    {
+        sx_aabb* src = (sx_aabb*)p0;
+        sx_aabb* dst = (sx_aabb*)p1;
+        sx_mat4* mats = (sx_mat4*)p2;
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                dst[i] = sx_aabb_transform(&src[i], &mats[i]);
+            }
+            g_sink += dst[r].xmin;
+        }
+        uint64_t scalar_tm = sx_tm_since(tm);
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_aabb_transform_batch(dst, src, mats, NUM_ITEMS);
+            g_sink += dst[r].xmin;
+        }
+        report("sx_aabb_transform_batch", scalar_tm, sx_tm_since(tm));
+
+        // soa version uses a single matrix, so the scalar loop is measured again
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                dst[i] = sx_aabb_transform(&src[i], &mat);
+            }
+            g_sink += dst[r].xmin;
+        }
+        scalar_tm = sx_tm_since(tm);
+
+        float* f = (float*)p1;
+        sx_aabb_soa s = { f,
+                          f + SOA_STRIDE,
+                          f + SOA_STRIDE * 2,
+                          f + SOA_STRIDE * 3,
+                          f + SOA_STRIDE * 4,
+                          f + SOA_STRIDE * 5 };
+        sx_aabb_soa d = { f + SOA_STRIDE * 6, f + SOA_STRIDE * 7,  f + SOA_STRIDE * 8,
+                          f + SOA_STRIDE * 9, f + SOA_STRIDE * 10, f + SOA_STRIDE * 11 };
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_aabb_transform_soa(d, s, NUM_ITEMS, &mat);
+            g_sink += d.xmin[r];
+        }
+        report("sx_aabb_transform_soa", scalar_tm, sx_tm_since(tm));
+    }
+
+    {
+        sx_mat4* a = (sx_mat4*)p0;
+        sx_mat4* b = (sx_mat4*)p1;
+        sx_mat4* dst = (sx_mat4*)p2;
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                dst[i] = sx_mat4_mul(&a[i], &b[i]);
+            }
+            g_sink += dst[r].m11;
+        }
+        uint64_t scalar_tm = sx_tm_since(tm);
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_mat4_mul_batch(dst, a, b, NUM_ITEMS);
+            g_sink += dst[r].m11;
+        }
+        report("sx_mat4_mul_batch", scalar_tm, sx_tm_since(tm));
+    }
+
+    {
+        const sx_box* src = (const sx_box*)p0;
+        sx_vec4* dst = (sx_vec4*)p1;
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                const sx_tx3d* tx = &src[i].tx;
+                sx_vec4* rows = &dst[i * 3];
+                rows[0] = sx_vec4f(tx->pos.x, tx->pos.y, tx->pos.z, tx->rot.m11);
+                rows[1] = sx_vec4f(tx->rot.m21, tx->rot.m31, tx->rot.m12, tx->rot.m22);
+                rows[2] = sx_vec4f(tx->rot.m32, tx->rot.m13, tx->rot.m23, tx->rot.m33);
+            }
+            g_sink += dst[r].x;
+        }
+        uint64_t scalar_tm = sx_tm_since(tm);
+        tm = sx_tm_now();
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            sx_tx3d_pack_batch(dst, sizeof(sx_vec4) * 3, &src[0].tx, sizeof(sx_box), NUM_ITEMS);
+            g_sink += dst[r].x;
+        }
+        report("sx_tx3d_pack_batch", scalar_tm, sx_tm_since(tm));
+    }
+
+    sx_free(alloc, buff);
+    return 0;
+}
@@ -0,0 +1,171 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// bench-queue.c: throughput of the lock-free queues
+//      Producer threads push small items to a single consumer (main thread):
+//          - spsc: sx_queue_spsc, one producer, created with room for all items (nodes are only
+//                  recycled by a successful produce, so a full spsc queue never drains)
+//          - mpmc: sx_queue_mpmc, bounded (producers yield when it's full)
+//          - mpsc: sx_queue_mpsc, intrusive and unbounded, items are preallocated
+//      Arguments: [num_producers] (default: 4) for the multi-producer runs
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/lockless.h"
+#include "sx/threads.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_ITEMS 2000000    // total, split between producers
+#define QUEUE_CAPACITY 1024
+
+typedef enum { QUEUE_SPSC, QUEUE_MPMC, QUEUE_MPSC } queue_type;
+
+typedef struct item {
+    sx_queue_mpsc_node node;
+    int value;
+} item;
+
+typedef struct bench_context {
+    queue_type type;
+    int num_producers;
+    int items_per_producer;
+    sx_queue_spsc* spsc;
+    sx_queue_mpmc* mpmc;
+    sx_queue_mpsc mpsc;
+    item* items;
+    sx_atomic_int start;
+} bench_context;
+
+static int producer_thread(void* user1, void* user2)
+{
+    bench_context* ctx = user1;
+    int p = (int)(intptr_t)user2;
+    int first = p * ctx->items_per_producer;
+    int end = first + ctx->items_per_producer;
+
+    while (!ctx->start) {
+        sx_thread_yield();
+    }
+
+    for (int i = first; i < end; i++) {
+        switch (ctx->type) {
+        case QUEUE_SPSC:
+            sx_queue_spsc_produce(ctx->spsc, &i);
+            break;
+        case QUEUE_MPMC:
+            while (!sx_queue_mpmc_produce(ctx->mpmc, &i)) {
+                sx_thread_yield();
+            }
+            break;
+        case QUEUE_MPSC:
+            sx_queue_mpsc_produce(&ctx->mpsc, &ctx->items[i].node);
+            break;
+        }
+    }
+    return 0;
+}
+
+// returns items per millisecond
+static double run_bench(queue_type type, int num_producers)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    bench_context* ctx = sx_malloc(alloc, sizeof(bench_context));
+    sx_assert_rel(ctx);
+    sx_memset(ctx, 0x0, sizeof(bench_context));
+    ctx->type = type;
+    ctx->num_producers = num_producers;
+    ctx->items_per_producer = NUM_ITEMS / num_producers;
+    int num_items = ctx->items_per_producer * num_producers;
+
+    switch (type) {
+    case QUEUE_SPSC:
+        ctx->spsc = sx_queue_spsc_create(alloc, sizeof(int), num_items + 1);
+        break;
+    case QUEUE_MPMC:
+        ctx->mpmc = sx_queue_mpmc_create(alloc, sizeof(int), QUEUE_CAPACITY);
+        break;
+    case QUEUE_MPSC:
+        sx_queue_mpsc_init(&ctx->mpsc);
+        ctx->items = sx_malloc(alloc, sizeof(item) * num_items);
+        sx_assert_rel(ctx->items);
+        for (int i = 0; i < num_items; i++) {
+            ctx->items[i].value = i;
+        }
+        break;
+    }
+
+    sx_thread* threads[64];
+    for (int p = 0; p < num_producers; p++) {
+        threads[p] = sx_thread_create(alloc, producer_thread, ctx, 0, "producer", (void*)(intptr_t)p);
+    }
+
+    uint64_t start_tm = sx_tm_now();
+    sx_atomic_xchg(&ctx->start, 1);
+
+    int64_t sum = 0;
+    int count = 0;
+    while (count < num_items) {
+        int value;
+        bool consumed = false;
+        switch (type) {
+        case QUEUE_SPSC:
+            consumed = sx_queue_spsc_consume(ctx->spsc, &value);
+            break;
+        case QUEUE_MPMC:
+            consumed = sx_queue_mpmc_consume(ctx->mpmc, &value);
+            break;
+        case QUEUE_MPSC: {
+            item* it = (item*)sx_queue_mpsc_consume(&ctx->mpsc);
+            if (it) {
+                value = it->value;
+                consumed = true;
+            }
+            break;
+        }
+        }
+
+        if (consumed) {
+            sum += value;
+            ++count;
+        } else {
+            sx_thread_yield();
+        }
+    }
+    double elapsed_ms = sx_tm_ms(sx_tm_since(start_tm));
+
+    for (int p = 0; p < num_producers; p++) {
+        sx_thread_destroy(threads[p], alloc);
+    }
+
+    sx_assert_rel(sum == (int64_t)num_items * (num_items - 1) / 2);
+    if (ctx->spsc) {
+        sx_queue_spsc_destroy(ctx->spsc, alloc);
+    }
+    if (ctx->mpmc) {
+        sx_queue_mpmc_destroy(ctx->mpmc, alloc);
+    }
+    sx_free(alloc, ctx->items);
+    sx_free(alloc, ctx);
+
+    return (double)num_items / elapsed_ms;
+}
+
+int main(int argc, char* argv[])
+{
+    sx_tm_init();
+    int num_producers = argc > 1 ? atoi(argv[1]) : 4;
+    num_producers = sx_clamp(num_producers, 1, 64);
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    printf("%-6s %10s %16s\n", "queue", "producers", "items/ms");
+    printf("%-6s %10d %16.1f\n", "spsc", 1, run_bench(QUEUE_SPSC, 1));
+    printf("%-6s %10d %16.1f\n", "mpmc", 1, run_bench(QUEUE_MPMC, 1));
+    printf("%-6s %10d %16.1f\n", "mpsc", 1, run_bench(QUEUE_MPSC, 1));
+    printf("%-6s %10d %16.1f\n", "mpmc", num_producers, run_bench(QUEUE_MPMC, num_producers));
+    printf("%-6s %10d %16.1f\n", "mpsc", num_producers, run_bench(QUEUE_MPSC, num_producers));
+    return 0;
+}
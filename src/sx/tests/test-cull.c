@@ -0,0 +1,193 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-cull.c: culling kernels of math-batch.h must be bit-exact with the scalar reference
+//      Items are random, and many of them are placed right on a plane (off by a few ulps), so
+//      the result depends on rounding. SIMD kernels, the scalar tail and the reference below all
+//      evaluate the plane distance in the same order, without FMA, so no bit may differ
+//
+#include "sx/allocator.h"
+#include "sx/math-batch.h"
+#include "sx/rng.h"
+
+#include <stdio.h>
+
+#define NUM_ITEMS 100003    // not a multiple of 32, so the scalar tail is also tested
+#define NUM_PLANES 6
+
+static sx_rng g_rng;
+
+static float rand_float(float _min, float _max)
+{
+    return _min + sx_rng_gen_f(&g_rng) * (_max - _min);
+}
+
+// reference: d = ((plane.d [+ radius]) + x*nx) + y*ny) + z*nz, every operation is rounded
+static float plane_dist(const sx_plane* p, float x, float y, float z, float radius)
+{
+    float d = p->dist + radius;
+    float t = x * p->normal.x;
+    d = t + d;
+    t = y * p->normal.y;
+    d = t + d;
+    t = z * p->normal.z;
+    d = t + d;
+    return d;
+}
+
+static bool aabb_visible_ref(const sx_aabb* b, const sx_plane* planes)
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        const sx_plane* p = &planes[i];
+        float x = p->normal.x > 0 ? b->xmax : b->xmin;
+        float y = p->normal.y > 0 ? b->ymax : b->ymin;
+        float z = p->normal.z > 0 ? b->zmax : b->zmin;
+        if (plane_dist(p, x, y, z, 0) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sphere_visible_ref(const sx_vec4* s, const sx_plane* planes)
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        if (plane_dist(&planes[i], s->x, s->y, s->z, s->w) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool rect_visible_ref(const sx_rect* r, const sx_plane* planes)
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        const sx_plane* p = &planes[i];
+        float x = p->normal.x > 0 ? r->xmax : r->xmin;
+        float y = p->normal.y > 0 ? r->ymax : r->ymin;
+        if (plane_dist(p, x, y, 0, 0) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// nudges v to a point on the plane along the axis with the biggest normal component
+static sx_vec3 snap_to_plane(sx_vec3 v, const sx_plane* p)
+{
+    int axis = 0;
+    for (int i = 1; i < 3; i++) {
+        if (sx_abs(p->normal.f[i]) > sx_abs(p->normal.f[axis])) {
+            axis = i;
+        }
+    }
+    float rest = p->dist;
+    for (int i = 0; i < 3; i++) {
+        if (i != axis) {
+            rest += v.f[i] * p->normal.f[i];
+        }
+    }
+    v.f[axis] = -rest / p->normal.f[axis];
+    return v;
+}
+
+static int check_bits(const char* name, const uint32_t* bits, const bool* expected, int count)
+{
+    int num_errors = 0;
+    for (int i = 0; i < count; i++) {
+        bool visible = (bits[i >> 5] >> (i & 31)) & 1;
+        if (visible != expected[i]) {
+            if (++num_errors <= 5) {
+                printf("%s: item %d is %s, expected %s\n", name, i,
+                       visible ? "visible" : "culled", expected[i] ? "visible" : "culled");
+            }
+        }
+    }
+    return num_errors;
+}
+
+int main(void)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    sx_rng_seed(&g_rng, 0x5eed);
+
+    sx_plane planes[NUM_PLANES];
+    for (int i = 0; i < NUM_PLANES; i++) {
+        sx_vec3 n = sx_vec3_norm(
+            sx_vec3f(rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f)));
+        planes[i].normal = n;
+        planes[i].dist = rand_float(10.0f, 50.0f);
+    }
+
+    sx_aabb* aabbs = sx_malloc(alloc, sizeof(sx_aabb) * NUM_ITEMS);
+    sx_vec4* spheres = sx_malloc(alloc, sizeof(sx_vec4) * NUM_ITEMS);
+    sx_rect* rects = sx_malloc(alloc, sizeof(sx_rect) * NUM_ITEMS);
+    bool* expected = sx_malloc(alloc, sizeof(bool) * NUM_ITEMS);
+    uint32_t* bits = sx_malloc(alloc, sizeof(uint32_t) * ((NUM_ITEMS + 31) / 32));
+    sx_assert_rel(aabbs && spheres && rects && expected && bits);
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        sx_vec3 c = sx_vec3f(rand_float(-60.0f, 60.0f), rand_float(-60.0f, 60.0f),
+                             rand_float(-60.0f, 60.0f));
+        sx_vec3 e = sx_vec3f(rand_float(0.0f, 5.0f), rand_float(0.0f, 5.0f), rand_float(0.0f, 5.0f));
+        float radius = rand_float(0.0f, 5.0f);
+
+        // half of the items touch a plane: p-vertex (or the nearest point of the sphere) is on it
+        if (i & 1) {
+            const sx_plane* p = &planes[sx_rng_gen(&g_rng) % NUM_PLANES];
+            sx_vec3 pv = sx_vec3f(p->normal.x > 0 ? e.x : -e.x, p->normal.y > 0 ? e.y : -e.y,
+                                  p->normal.z > 0 ? e.z : -e.z);
+            c = sx_vec3_sub(snap_to_plane(sx_vec3_add(c, pv), p), pv);
+        }
+        aabbs[i] = sx_aabbv(sx_vec3_sub(c, e), sx_vec3_add(c, e));
+        rects[i] = sx_rectv(sx_vec2f(c.x - e.x, c.y - e.y), sx_vec2f(c.x + e.x, c.y + e.y));
+        spheres[i] = sx_vec4f(c.x, c.y, c.z, radius);
+    }
+
+    int num_errors = 0;
+    int num_visible = 0;
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        expected[i] = aabb_visible_ref(&aabbs[i], planes);
+        num_visible += expected[i] ? 1 : 0;
+    }
+    sx_aabb_cull_batch(bits, aabbs, NUM_ITEMS, planes, NUM_PLANES);
+    num_errors += check_bits("sx_aabb_cull_batch", bits, expected, NUM_ITEMS);
+    printf("aabbs: %d/%d visible\n", num_visible, NUM_ITEMS);
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        expected[i] = sphere_visible_ref(&spheres[i], planes);
+    }
+    sx_sphere_cull_batch(bits, spheres, NUM_ITEMS, planes, NUM_PLANES);
+    num_errors += check_bits("sx_sphere_cull_batch", bits, expected, NUM_ITEMS);
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        expected[i] = rect_visible_ref(&rects[i], planes);
+    }
+    sx_rect_cull_batch(bits, rects, NUM_ITEMS, planes, NUM_PLANES);
+    num_errors += check_bits("sx_rect_cull_batch", bits, expected, NUM_ITEMS);
+
+    // sub-ranges that start at multiples of 32, like jobs would split the work
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        expected[i] = aabb_visible_ref(&aabbs[i], planes);
+    }
+    for (int start = 0; start < NUM_ITEMS; start += 32 * 37) {
+        int count = sx_min(32 * 37, NUM_ITEMS - start);
+        sx_aabb_cull_batch(bits + start / 32, aabbs + start, count, planes, NUM_PLANES);
+    }
+    num_errors += check_bits("sx_aabb_cull_batch (ranges)", bits, expected, NUM_ITEMS);
+
+    sx_free(alloc, aabbs);
+    sx_free(alloc, spheres);
+    sx_free(alloc, rects);
+    sx_free(alloc, expected);
+    sx_free(alloc, bits);
+
+    if (num_errors > 0) {
+        printf("%d errors\n", num_errors);
+        return 1;
+    }
+    puts("ok");
+    return 0;
+}
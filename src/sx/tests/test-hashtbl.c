@@ -0,0 +1,367 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-hashtbl.c: sx_hashtbl, sx_hashtbl64 and sx_hashtbl_mt
+//      churn: keeps a constant number of live keys while adding and removing many more. The table
+//             must keep finding every live key, and tombstones alone must not grow its capacity.
+//             sx_hashtbl_mt runs the same churn without ever calling collect, while another
+//             thread keeps reading a set of fixed keys
+//      probing: keys that collide on the last group must wrap around to the first group, stay
+//               findable through tombstones, and misses must stop at the first group that has an
+//               empty slot (checked with the SX_CONFIG_HASHTBL_DEBUG probe counters)
+//      hashtbl64: add/find/remove/grow with keys that only differ in their upper 32 bits
+//      collect: sx_hashtbl_mt tables that are retired by growing are freed only when their epoch
+//               is safe, and destroy frees the ones that are still waiting (checked by counting
+//               the live allocations)
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/hash.h"
+#include "sx/rng.h"
+#include "sx/threads.h"
+
+#include <stdio.h>
+
+#define NUM_LIVE 90
+#define NUM_ROUNDS 100000
+#define NUM_FIXED 16    // sx_hashtbl_mt keys that are never removed, checked by the reader thread
+#define NUM_MT_LIVE (NUM_LIVE - NUM_FIXED)    // same load as the sx_hashtbl test
+
+static uint32_t g_keys[NUM_ROUNDS + NUM_LIVE + NUM_FIXED];
+
+// random keys, so groups fill up and removes leave tombstones behind
+static uint32_t key_of(int i)
+{
+    return g_keys[i];
+}
+
+static bool test_churn(const sx_alloc* alloc)
+{
+    sx_hashtbl* tbl = sx_hashtbl_create(alloc, 256);
+    int capacity = tbl->capacity;
+
+    for (int i = 0; i < NUM_LIVE; i++) {
+        sx_hashtbl_add_and_grow(tbl, key_of(i), i, alloc);
+    }
+
+    for (int r = 0; r < NUM_ROUNDS; r++) {
+        // remove the oldest key, add a new one
+        int index = sx_hashtbl_find(tbl, key_of(r));
+        if (index == -1 || sx_hashtbl_get(tbl, index) != r) {
+            printf("key %d not found\n", r);
+            return false;
+        }
+        sx_hashtbl_remove(tbl, index);
+        sx_hashtbl_add_and_grow(tbl, key_of(r + NUM_LIVE), r + NUM_LIVE, alloc);
+
+        if (tbl->count != NUM_LIVE) {
+            printf("count mismatch: %d\n", tbl->count);
+            return false;
+        }
+    }
+
+    for (int i = NUM_ROUNDS; i < NUM_ROUNDS + NUM_LIVE; i++) {
+        int index = sx_hashtbl_find(tbl, key_of(i));
+        if (index == -1 || sx_hashtbl_get(tbl, index) != i) {
+            printf("key %d not found\n", i);
+            return false;
+        }
+    }
+
+    if (tbl->capacity != capacity) {
+        printf("table grew from %d to %d with %d live keys\n", capacity, tbl->capacity, NUM_LIVE);
+        return false;
+    }
+
+    sx_hashtbl_destroy(tbl, alloc);
+    return true;
+}
+
+// index of the group that the key hashes to: the first free slot in an empty table is the first
+// slot of that group
+static int home_group(sx_hashtbl* tbl, uint32_t key)
+{
+    sx_hashtbl_clear(tbl);
+    int group = sx_hashtbl_add(tbl, key, 0) / SX_HASHTBL_GROUP_SIZE;
+    sx_hashtbl_clear(tbl);
+    return group;
+}
+
+static bool test_probing(const sx_alloc* alloc)
+{
+    sx_hashtbl* tbl = sx_hashtbl_create(alloc, 16);
+    const int num_groups = tbl->capacity / SX_HASHTBL_GROUP_SIZE;
+    const int last_group = num_groups - 1;
+
+    // GROUP_SIZE+1 keys that hash to the last group, and one missing key for each group
+    uint32_t colliding[SX_HASHTBL_GROUP_SIZE + 1];
+    uint32_t missing[16];
+    int num_colliding = 0;
+    uint32_t missing_mask = 0;
+    for (int i = 0; i < NUM_ROUNDS; i++) {
+        int group = home_group(tbl, key_of(i));
+        if (group == last_group && num_colliding < SX_HASHTBL_GROUP_SIZE + 1) {
+            colliding[num_colliding++] = key_of(i);
+        } else if (!(missing_mask & (1u << group))) {
+            missing[group] = key_of(i);
+            missing_mask |= 1u << group;
+        }
+    }
+    if (num_colliding != SX_HASHTBL_GROUP_SIZE + 1 || missing_mask != (1u << num_groups) - 1) {
+        puts("probing: not enough keys for the test");
+        return false;
+    }
+
+    for (int i = 0; i < num_colliding; i++) {
+        sx_hashtbl_add(tbl, colliding[i], i);
+    }
+
+    // the last group is full, so the extra key wraps around to group 0
+    int index = sx_hashtbl_find(tbl, colliding[SX_HASHTBL_GROUP_SIZE]);
+    if (index / SX_HASHTBL_GROUP_SIZE != 0 || sx_hashtbl_get(tbl, index) != SX_HASHTBL_GROUP_SIZE) {
+        printf("probing: wrapped key found at %d\n", index);
+        return false;
+    }
+
+#if SX_CONFIG_HASHTBL_DEBUG
+    // miss on an empty home group: no extra groups are probed
+    int probe_cnt = tbl->_probe_cnt;
+    if (sx_hashtbl_find(tbl, missing[1]) != -1 || tbl->_probe_cnt != probe_cnt) {
+        puts("probing: miss on an empty group probed other groups");
+        return false;
+    }
+
+    // miss on the full last group: stops at group 0, which has empty slots
+    if (sx_hashtbl_find(tbl, missing[last_group]) != -1 || tbl->_probe_cnt != probe_cnt + 1) {
+        printf("probing: miss on a full group probed %d groups\n", tbl->_probe_cnt - probe_cnt);
+        return false;
+    }
+#endif
+
+    // removing from the full group leaves a tombstone, the wrapped key must still be found
+    sx_hashtbl_remove(tbl, sx_hashtbl_find(tbl, colliding[0]));
+    if (tbl->_num_tombstones != 1 ||
+        sx_hashtbl_find_get(tbl, colliding[SX_HASHTBL_GROUP_SIZE], -1) != SX_HASHTBL_GROUP_SIZE) {
+        puts("probing: wrapped key is lost after a remove");
+        return false;
+    }
+    // re-adding reuses the tombstone of the home group
+    index = sx_hashtbl_add(tbl, colliding[0], 0);
+    if (index / SX_HASHTBL_GROUP_SIZE != last_group || tbl->_num_tombstones != 0) {
+        printf("probing: re-added key at %d\n", index);
+        return false;
+    }
+
+    // full table: a miss must probe every group once and stop
+    for (int i = 0; sx_hashtbl_find(tbl, missing[1]) == -1 && !sx_hashtbl_full(tbl); i++) {
+        sx_hashtbl_add(tbl, key_of(NUM_ROUNDS + i), i);
+    }
+    if (sx_hashtbl_find(tbl, missing[1]) != -1) {
+        puts("probing: missing key found in a full table");
+        return false;
+    }
+
+    sx_hashtbl_destroy(tbl, alloc);
+    return true;
+}
+
+static bool test_hashtbl64(const sx_alloc* alloc)
+{
+    const int num_keys = 5000;
+    sx_hashtbl64* tbl = sx_hashtbl64_create(alloc, 16);
+
+    // pairs of keys with the same lower 32 bits
+    for (int i = 0; i < num_keys; i++) {
+        uint64_t lo = key_of(i);
+        sx_hashtbl64_add_and_grow(tbl, lo, i, alloc);
+        sx_hashtbl64_add_and_grow(tbl, lo | ((uint64_t)(i + 1) << 32), num_keys + i, alloc);
+    }
+    if (tbl->count != num_keys * 2) {
+        printf("hashtbl64: count mismatch: %d\n", tbl->count);
+        return false;
+    }
+
+    // remove the upper half of each pair and check that the lower one stays
+    for (int i = 0; i < num_keys; i++) {
+        uint64_t lo = key_of(i);
+        uint64_t hi = lo | ((uint64_t)(i + 1) << 32);
+        if (sx_hashtbl64_find_get(tbl, lo, -1) != i ||
+            sx_hashtbl64_find_get(tbl, hi, -1) != num_keys + i) {
+            printf("hashtbl64: key %d not found\n", i);
+            return false;
+        }
+        sx_hashtbl64_remove_if_found(tbl, hi);
+    }
+    for (int i = 0; i < num_keys; i++) {
+        uint64_t lo = key_of(i);
+        if (sx_hashtbl64_find_get(tbl, lo, -1) != i ||
+            sx_hashtbl64_find(tbl, lo | ((uint64_t)(i + 1) << 32)) != -1) {
+            printf("hashtbl64: key %d mismatch after remove\n", i);
+            return false;
+        }
+    }
+
+    sx_hashtbl64_destroy(tbl, alloc);
+    return true;
+}
+
+typedef struct mt_reader {
+    sx_hashtbl_mt* tbl;
+    sx_atomic_int quit;
+    sx_atomic_int num_errors;
+} mt_reader;
+
+// fixed keys are the last NUM_FIXED of g_keys, their values are their index in g_keys
+static int mt_reader_cb(void* user1, void* user2)
+{
+    sx_unused(user2);
+    mt_reader* r = user1;
+    const int first = NUM_ROUNDS + NUM_LIVE;
+    while (!r->quit) {
+        for (int i = first; i < first + NUM_FIXED; i++) {
+            if (sx_hashtblmt_find_get(r->tbl, key_of(i), -1) != i) {
+                sx_atomic_incr(&r->num_errors);
+            }
+        }
+        sx_thread_yield();
+    }
+    return 0;
+}
+
+static bool test_mt_churn(const sx_alloc* alloc)
+{
+    mt_reader reader = { .tbl = sx_hashtblmt_create(alloc, 256, 1) };
+    if (!reader.tbl) {
+        return false;
+    }
+
+    const int first_fixed = NUM_ROUNDS + NUM_LIVE;
+    for (int i = first_fixed; i < first_fixed + NUM_FIXED; i++) {
+        sx_hashtblmt_add(reader.tbl, key_of(i), i);
+    }
+    for (int i = 0; i < NUM_MT_LIVE; i++) {
+        sx_hashtblmt_add(reader.tbl, key_of(i), i);
+    }
+
+    sx_thread* thrd = sx_thread_create(alloc, mt_reader_cb, &reader, 0, "reader", NULL);
+    bool ok = true;
+    for (int r = 0; r < NUM_ROUNDS && ok; r++) {
+        if (sx_hashtblmt_find_get(reader.tbl, key_of(r), -1) != r) {
+            printf("mt: key %d not found\n", r);
+            ok = false;
+        }
+        sx_hashtblmt_remove(reader.tbl, key_of(r));
+        if (!sx_hashtblmt_add(reader.tbl, key_of(r + NUM_MT_LIVE), r + NUM_MT_LIVE)) {
+            printf("mt: add failed at round %d\n", r);
+            ok = false;
+        }
+    }
+    sx_atomic_xchg(&reader.quit, 1);
+    sx_thread_destroy(thrd, alloc);
+
+    if (reader.num_errors > 0) {
+        printf("mt: reader missed fixed keys %d times\n", reader.num_errors);
+        ok = false;
+    }
+    if (ok && sx_hashtblmt_count(reader.tbl) != NUM_LIVE) {
+        printf("mt: count mismatch: %d\n", sx_hashtblmt_count(reader.tbl));
+        ok = false;
+    }
+
+    sx_hashtblmt_destroy(reader.tbl, alloc);
+    return ok;
+}
+
+static int g_num_allocs;
+
+static void* counting_alloc_cb(void* ptr, size_t size, uint32_t align, const char* file,
+                               const char* func, uint32_t line, void* user_data)
+{
+    sx_unused(user_data);
+    if (!ptr && size > 0) {
+        ++g_num_allocs;
+    } else if (ptr && size == 0) {
+        --g_num_allocs;
+    }
+    const sx_alloc* heap = sx_alloc_malloc();
+    return heap->alloc_cb(ptr, size, align, file, func, line, heap->user_data);
+}
+
+// adds new keys until the shard table grows once, so the old table is retired
+static void mt_grow(sx_hashtbl_mt* tbl, int* num_keys)
+{
+    int num_allocs = g_num_allocs;
+    while (g_num_allocs == num_allocs) {
+        sx_hashtblmt_add(tbl, key_of(*num_keys), *num_keys);
+        ++*num_keys;
+    }
+}
+
+static bool test_mt_collect(void)
+{
+    const sx_alloc alloc = { .alloc_cb = counting_alloc_cb };
+    sx_hashtbl_mt* tbl = sx_hashtblmt_create(&alloc, 16, 1);
+    if (!tbl) {
+        return false;
+    }
+
+    int num_keys = 0;
+    mt_grow(tbl, &num_keys);
+    mt_grow(tbl, &num_keys);
+    int num_allocs = g_num_allocs;
+
+    // collect stamps the two retired tables with epoch 1, nothing is safe yet
+    sx_hashtblmt_collect(tbl, 1, 0);
+    bool ok = g_num_allocs == num_allocs;
+
+    // epoch 1 is safe: only the first two are freed, the new one is stamped with 2
+    mt_grow(tbl, &num_keys);
+    sx_hashtblmt_collect(tbl, 2, 1);
+    ok = ok && g_num_allocs == num_allocs - 1;
+    sx_hashtblmt_collect(tbl, 3, 1);
+    ok = ok && g_num_allocs == num_allocs - 1;
+    sx_hashtblmt_collect(tbl, 4, 2);
+    ok = ok && g_num_allocs == num_allocs - 2;
+    if (!ok) {
+        printf("collect: retired tables are freed before their epoch is safe\n");
+    }
+
+    for (int i = 0; i < num_keys && ok; i++) {
+        if (sx_hashtblmt_find_get(tbl, key_of(i), -1) != i) {
+            printf("collect: key %d not found\n", i);
+            ok = false;
+        }
+    }
+
+    // one more that is never collected
+    mt_grow(tbl, &num_keys);
+    sx_hashtblmt_destroy(tbl, &alloc);
+    if (g_num_allocs != 0) {
+        printf("collect: %d allocations are leaked\n", g_num_allocs);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    sx_rng rng;
+    sx_rng_seed(&rng, 0x5eed);
+    for (int i = 0; i < NUM_ROUNDS + NUM_LIVE + NUM_FIXED; i++) {
+        uint32_t key;
+        do {
+            key = sx_rng_gen(&rng);
+        } while (key == 0 || key == SX_HASHTBL_TOMBSTONE);
+        g_keys[i] = key;
+    }
+
+    if (!test_churn(alloc) || !test_probing(alloc) || !test_hashtbl64(alloc) ||
+        !test_mt_churn(alloc) || !test_mt_collect()) {
+        return 1;
+    }
+
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,147 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-job-quiescent.c: grace periods of sx_job_quiescent_snapshot/sx_job_quiescent_passed
+//      idle: a snapshot of idle threads has passed right away
+//      running: a snapshot that is taken while a job is running must not pass until the job is
+//               done, no matter how long it takes
+//      parked: a job that parks itself in sx_job_wait_and_del has left the code it was running at
+//              the snapshot, so the snapshot passes while the job it waits on is still running
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/jobs.h"
+#include "sx/os.h"
+#include "sx/threads.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+
+#define NUM_WORKERS 2
+#define TIMEOUT_MS 5000
+
+typedef struct test_state {
+    sx_job_context* ctx;
+    sx_atomic_int started;
+    sx_atomic_int go_wait;    // parent job dispatches the child and waits on it
+    sx_atomic_int release;    // spinning jobs can return
+    sx_atomic_int child_started;
+} test_state;
+
+static test_state g_state;
+
+static void spin_job_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(range_start);
+    sx_unused(range_end);
+    sx_unused(thread_index);
+    sx_atomic_int* started = user;
+    sx_atomic_xchg(started, 1);
+    while (!g_state.release) {
+        sx_thread_yield();
+    }
+}
+
+static void parent_job_cb(int range_start, int range_end, int thread_index, void* user)
+{
+    sx_unused(range_start);
+    sx_unused(range_end);
+    sx_unused(thread_index);
+    sx_unused(user);
+    sx_atomic_xchg(&g_state.started, 1);
+    while (!g_state.go_wait) {
+        sx_thread_yield();
+    }
+    sx_job_t child = sx_job_dispatch(g_state.ctx, 1, spin_job_cb, (void*)&g_state.child_started,
+                                     SX_JOB_PRIORITY_NORMAL, 0, 0, SX_JOB_FLAG_LEAF);
+    sx_job_wait_and_del(g_state.ctx, child);
+}
+
+static void wait_flag(sx_atomic_int* flag)
+{
+    while (!*flag) {
+        sx_thread_yield();
+    }
+}
+
+// polls the snapshot for `ms` milliseconds, returns True as soon as it has passed
+static bool poll_passed(const int* snapshot, int ms)
+{
+    uint64_t start_tm = sx_tm_now();
+    do {
+        if (sx_job_quiescent_passed(g_state.ctx, snapshot)) {
+            return true;
+        }
+        sx_os_sleep(1);
+    } while (sx_tm_ms(sx_tm_since(start_tm)) < ms);
+    return false;
+}
+
+static void reset_state(void)
+{
+    g_state.started = g_state.go_wait = g_state.release = g_state.child_started = 0;
+}
+
+int main(void)
+{
+    sx_tm_init();
+    const sx_alloc* alloc = sx_alloc_malloc();
+    g_state.ctx = sx_job_create_context(
+        alloc, &(sx_job_context_desc){ .num_threads = NUM_WORKERS, .max_fibers = 16 });
+    if (!g_state.ctx) {
+        puts("creating job context failed");
+        return 1;
+    }
+    int snapshot[NUM_WORKERS + 1];
+    bool ok = true;
+
+    // idle
+    sx_job_quiescent_snapshot(g_state.ctx, snapshot);
+    if (!poll_passed(snapshot, TIMEOUT_MS)) {
+        puts("idle: snapshot has not passed");
+        ok = false;
+    }
+
+    // running
+    reset_state();
+    sx_job_t job = sx_job_dispatch(g_state.ctx, 1, spin_job_cb, (void*)&g_state.started,
+                                   SX_JOB_PRIORITY_NORMAL, 0, 0, SX_JOB_FLAG_LEAF);
+    wait_flag(&g_state.started);
+    sx_job_quiescent_snapshot(g_state.ctx, snapshot);
+    if (poll_passed(snapshot, 100)) {
+        puts("running: snapshot has passed while the job is still running");
+        ok = false;
+    }
+    sx_atomic_xchg(&g_state.release, 1);
+    sx_job_wait_and_del(g_state.ctx, job);
+    if (!poll_passed(snapshot, TIMEOUT_MS)) {
+        puts("running: snapshot has not passed after the job is done");
+        ok = false;
+    }
+
+    // parked
+    reset_state();
+    job = sx_job_dispatch(g_state.ctx, 1, parent_job_cb, NULL, SX_JOB_PRIORITY_NORMAL, 0, 0, 0);
+    wait_flag(&g_state.started);
+    sx_job_quiescent_snapshot(g_state.ctx, snapshot);
+    if (poll_passed(snapshot, 100)) {
+        puts("parked: snapshot has passed before the job has parked");
+        ok = false;
+    }
+    sx_atomic_xchg(&g_state.go_wait, 1);
+    wait_flag(&g_state.child_started);
+    if (!poll_passed(snapshot, TIMEOUT_MS)) {
+        puts("parked: snapshot has not passed after the job has parked");
+        ok = false;
+    }
+    sx_atomic_xchg(&g_state.release, 1);
+    sx_job_wait_and_del(g_state.ctx, job);
+
+    sx_job_destroy_context(g_state.ctx, alloc);
+    if (!ok) {
+        return 1;
+    }
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,245 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-math-batch.c: compares math-batch.h kernels with the scalar math.h functions
+//      Every kernel runs on many counts, so the wide kernels, the 4-wide kernels and the scalar
+//      tails are all covered. Results must match within rounding errors (FMA and the
+//      center/extents AABB transform don't round the same way as math.h), sx_tx3d_pack_batch
+//      must match exactly
+//
+#include "sx/allocator.h"
+#include "sx/math-batch.h"
+#include "sx/os.h"
+#include "sx/rng.h"
+
+#include <stdio.h>
+
+#define MAX_COUNT 1027
+
+// magnitude of the terms for the random ranges below (matrices: [-2, 2], points: [-100, 100])
+#define MAG_VEC3 (2.0f * 100.0f * 3.0f + 2.0f)
+#define MAG_VEC2 (2.0f * 100.0f * 2.0f + 2.0f)
+#define MAG_AABB (2.0f * 110.0f * 3.0f * 2.0f + 2.0f)
+#define MAG_MAT4 (2.0f * 2.0f * 4.0f)
+
+static sx_rng g_rng;
+static int g_num_errors;
+
+static float rand_float(float _min, float _max)
+{
+    return _min + sx_rng_gen_f(&g_rng) * (_max - _min);
+}
+
+static void rand_floats(float* f, int count, float _min, float _max)
+{
+    for (int i = 0; i < count; i++) {
+        f[i] = rand_float(_min, _max);
+    }
+}
+
+// mag: magnitude of the biggest terms that are summed for each component. results can be much
+//      smaller than their terms (cancellation), so the rounding error is relative to the terms
+static bool check_floats(const char* name, int count, int index, const float* a, const float* b,
+                         int num, float mag)
+{
+    for (int i = 0; i < num; i++) {
+        if (sx_abs(a[i] - b[i]) > 1e-6f * mag) {
+            if (++g_num_errors <= 10) {
+                printf("%s (count=%d): item %d, component %d: %f != %f\n", name, count, index, i,
+                       a[i], b[i]);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_mat4_mul_vec3(int count, sx_vec3* src, sx_vec3* dst)
+{
+    sx_mat4 mat;
+    rand_floats(mat.f, 16, -2.0f, 2.0f);
+    rand_floats(src[0].f, count * 3, -100.0f, 100.0f);
+
+    sx_mat4_mul_vec3_batch(dst, src, count, &mat);
+    for (int i = 0; i < count; i++) {
+        sx_vec3 r = sx_mat4_mul_vec3(&mat, src[i]);
+        if (!check_floats("sx_mat4_mul_vec3_batch", count, i, r.f, dst[i].f, 3, MAG_VEC3)) {
+            break;
+        }
+    }
+
+    // soa: the same data, split into components
+    float* f = sx_malloc(sx_alloc_malloc(), sizeof(float) * count * 6 + 1);
+    sx_assert_rel(f);
+    sx_vec3_soa s = { f, f + count, f + count * 2 };
+    sx_vec3_soa d = { f + count * 3, f + count * 4, f + count * 5 };
+    for (int i = 0; i < count; i++) {
+        s.x[i] = src[i].x;
+        s.y[i] = src[i].y;
+        s.z[i] = src[i].z;
+    }
+    sx_mat4_mul_vec3_soa(d, s, count, &mat);
+    for (int i = 0; i < count; i++) {
+        sx_vec3 r = sx_mat4_mul_vec3(&mat, src[i]);
+        if (!check_floats("sx_mat4_mul_vec3_soa", count, i, r.f,
+                          (float[]){ d.x[i], d.y[i], d.z[i] }, 3, MAG_VEC3)) {
+            break;
+        }
+    }
+    sx_free(sx_alloc_malloc(), f);
+}
+
+static void test_mat3_mul_vec2(int count, sx_vec2* src, sx_vec2* dst)
+{
+    sx_mat3 mat;
+    rand_floats(mat.f, 9, -2.0f, 2.0f);
+    rand_floats(src[0].f, count * 2, -100.0f, 100.0f);
+
+    sx_mat3_mul_vec2_batch(dst, src, count, &mat);
+    for (int i = 0; i < count; i++) {
+        sx_vec2 r = sx_mat3_mul_vec2(&mat, src[i]);
+        if (!check_floats("sx_mat3_mul_vec2_batch", count, i, r.f, dst[i].f, 2, MAG_VEC2)) {
+            break;
+        }
+    }
+
+    float* f = sx_malloc(sx_alloc_malloc(), sizeof(float) * count * 4 + 1);
+    sx_assert_rel(f);
+    sx_vec2_soa s = { f, f + count };
+    sx_vec2_soa d = { f + count * 2, f + count * 3 };
+    for (int i = 0; i < count; i++) {
+        s.x[i] = src[i].x;
+        s.y[i] = src[i].y;
+    }
+    sx_mat3_mul_vec2_soa(d, s, count, &mat);
+    for (int i = 0; i < count; i++) {
+        sx_vec2 r = sx_mat3_mul_vec2(&mat, src[i]);
+        if (!check_floats("sx_mat3_mul_vec2_soa", count, i, r.f, (float[]){ d.x[i], d.y[i] }, 2,
+                          MAG_VEC2)) {
+            break;
+        }
+    }
+    sx_free(sx_alloc_malloc(), f);
+}
+
+static sx_aabb rand_aabb(void)
+{
+    sx_vec3 center = sx_vec3f(rand_float(-100.0f, 100.0f), rand_float(-100.0f, 100.0f),
+                              rand_float(-100.0f, 100.0f));
+    sx_vec3 extents =
+        sx_vec3f(rand_float(0.0f, 10.0f), rand_float(0.0f, 10.0f), rand_float(0.0f, 10.0f));
+    return sx_aabbv(sx_vec3_sub(center, extents), sx_vec3_add(center, extents));
+}
+
+static void test_aabb_transform(int count, sx_aabb* src, sx_aabb* dst, sx_mat4* mats)
+{
+    for (int i = 0; i < count; i++) {
+        src[i] = rand_aabb();
+        rand_floats(mats[i].f, 16, -2.0f, 2.0f);
+    }
+
+    sx_aabb_transform_batch(dst, src, mats, count);
+    for (int i = 0; i < count; i++) {
+        sx_aabb r = sx_aabb_transform(&src[i], &mats[i]);
+        if (!check_floats("sx_aabb_transform_batch", count, i, r.f, dst[i].f, 6, MAG_AABB)) {
+            break;
+        }
+    }
+
+    float* f = sx_malloc(sx_alloc_malloc(), sizeof(float) * count * 12 + 1);
+    sx_assert_rel(f);
+    sx_aabb_soa s = { f, f + count, f + count * 2, f + count * 3, f + count * 4, f + count * 5 };
+    sx_aabb_soa d = { f + count * 6,  f + count * 7,  f + count * 8,
+                      f + count * 9,  f + count * 10, f + count * 11 };
+    for (int i = 0; i < count; i++) {
+        s.xmin[i] = src[i].xmin;
+        s.ymin[i] = src[i].ymin;
+        s.zmin[i] = src[i].zmin;
+        s.xmax[i] = src[i].xmax;
+        s.ymax[i] = src[i].ymax;
+        s.zmax[i] = src[i].zmax;
+    }
+    sx_aabb_transform_soa(d, s, count, &mats[0]);
+    for (int i = 0; i < count; i++) {
+        sx_aabb r = sx_aabb_transform(&src[i], &mats[0]);
+        float df[6] = { d.xmin[i], d.ymin[i], d.zmin[i], d.xmax[i], d.ymax[i], d.zmax[i] };
+        if (!check_floats("sx_aabb_transform_soa", count, i, r.f, df, 6, MAG_AABB)) {
+            break;
+        }
+    }
+    sx_free(sx_alloc_malloc(), f);
+}
+
+static void test_mat4_mul(int count, sx_mat4* a, sx_mat4* b, sx_mat4* dst)
+{
+    rand_floats(a[0].f, count * 16, -2.0f, 2.0f);
+    rand_floats(b[0].f, count * 16, -2.0f, 2.0f);
+
+    sx_mat4_mul_batch(dst, a, b, count);
+    for (int i = 0; i < count; i++) {
+        sx_mat4 r = sx_mat4_mul(&a[i], &b[i]);
+        if (!check_floats("sx_mat4_mul_batch", count, i, r.f, dst[i].f, 16, MAG_MAT4)) {
+            break;
+        }
+    }
+}
+
+static void test_tx3d_pack(int count, sx_box* src, sx_vec4* dst)
+{
+    rand_floats((float*)src, count * (int)(sizeof(sx_box) / sizeof(float)), -10.0f, 10.0f);
+
+    // read from a bigger struct, write with a stride bigger than 3 rows
+    const int dst_stride = sizeof(sx_vec4) * 4;
+    sx_tx3d_pack_batch(dst, dst_stride, &src[0].tx, sizeof(sx_box), count);
+    for (int i = 0; i < count; i++) {
+        const sx_tx3d* tx = &src[i].tx;
+        const sx_vec4* rows = &dst[i * 4];
+        float expected[12] = { tx->pos.x,   tx->pos.y,   tx->pos.z,   tx->rot.m11,
+                               tx->rot.m21, tx->rot.m31, tx->rot.m12, tx->rot.m22,
+                               tx->rot.m32, tx->rot.m13, tx->rot.m23, tx->rot.m33 };
+        if (sx_memcmp(expected, rows, sizeof(expected)) != 0) {
+            if (++g_num_errors <= 10) {
+                printf("sx_tx3d_pack_batch (count=%d): item %d doesn't match\n", count, i);
+            }
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    sx_rng_seed(&g_rng, 0x5eed);
+
+    sx_cpu_features features = sx_os_cpu_features();
+    printf("cpu: sse2=%d avx2=%d fma=%d neon=%d\n", (features & SX_CPU_FEATURE_SSE2) ? 1 : 0,
+           (features & SX_CPU_FEATURE_AVX2) ? 1 : 0, (features & SX_CPU_FEATURE_FMA) ? 1 : 0,
+           (features & SX_CPU_FEATURE_NEON) ? 1 : 0);
+
+    // one buffer that is big enough for every test, offset by one float, so kernels are tested
+    // with unaligned arrays
+    size_t buff_size = sizeof(sx_mat4) * MAX_COUNT * 4 + sizeof(float);
+    uint8_t* buff = sx_malloc(alloc, buff_size);
+    sx_assert_rel(buff);
+    sx_memset(buff, 0x0, buff_size);
+    uint8_t* p = buff + sizeof(float);
+    size_t part = sizeof(sx_mat4) * MAX_COUNT;
+
+    for (int count = 0; count <= MAX_COUNT; count = count < 40 ? count + 1 : count + 331) {
+        test_mat4_mul_vec3(count, (sx_vec3*)p, (sx_vec3*)(p + part));
+        test_mat3_mul_vec2(count, (sx_vec2*)p, (sx_vec2*)(p + part));
+        test_aabb_transform(count, (sx_aabb*)p, (sx_aabb*)(p + part), (sx_mat4*)(p + part * 2));
+        test_mat4_mul(count, (sx_mat4*)p, (sx_mat4*)(p + part), (sx_mat4*)(p + part * 2));
+        test_tx3d_pack(count, (sx_box*)p, (sx_vec4*)(p + part));
+    }
+
+    sx_free(alloc, buff);
+
+    if (g_num_errors > 0) {
+        printf("%d errors\n", g_num_errors);
+        return 1;
+    }
+    puts("ok");
+    return 0;
+}
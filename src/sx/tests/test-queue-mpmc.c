@@ -0,0 +1,175 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-queue-mpmc.c: sx_queue_mpmc stress test
+//      Several producer threads push their own sequence of items into a small queue while several
+//      consumer threads pop them, both with single and batch calls (batches may be partial when
+//      the queue is full or empty). Every item must arrive exactly once, and every consumer must
+//      see the items of each producer in the order they were pushed
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/lockless.h"
+#include "sx/threads.h"
+
+#include <stdio.h>
+
+#define NUM_PRODUCERS 3
+#define NUM_CONSUMERS 3
+#define NUM_ITEMS 200000    // per producer
+#define CAPACITY 256
+#define BATCH_SIZE 8
+
+typedef struct item {
+    int producer;
+    int seq;
+} item;
+
+typedef struct consumer {
+    int last_seq[NUM_PRODUCERS];
+    int num_errors;
+} consumer;
+
+static sx_queue_mpmc* g_queue;
+static sx_atomic_int g_start;
+static sx_atomic_int g_num_consumed;
+static sx_atomic_int* g_received;    // count = NUM_PRODUCERS*NUM_ITEMS, times each item is consumed
+static consumer g_consumers[NUM_CONSUMERS];
+
+static int producer_thread(void* user1, void* user2)
+{
+    sx_unused(user2);
+    int p = (int)(intptr_t)user1;
+
+    while (!g_start) {
+        sx_thread_yield();
+    }
+
+    int i = 0;
+    while (i < NUM_ITEMS) {
+        if ((i & 63) < BATCH_SIZE * 4) {
+            item items[BATCH_SIZE];
+            int count = sx_min(BATCH_SIZE, NUM_ITEMS - i);
+            for (int k = 0; k < count; k++) {
+                items[k] = (item){ .producer = p, .seq = i + k };
+            }
+            int n = sx_queue_mpmc_produce_batch(g_queue, items, count);
+            i += n;
+            if (n == 0) {
+                sx_thread_yield();
+            }
+        } else {
+            item it = { .producer = p, .seq = i };
+            if (sx_queue_mpmc_produce(g_queue, &it)) {
+                i++;
+            } else {
+                sx_thread_yield();
+            }
+        }
+    }
+    return 0;
+}
+
+static void consume_item(consumer* c, const item* it)
+{
+    if (it->producer < 0 || it->producer >= NUM_PRODUCERS || it->seq < 0 ||
+        it->seq >= NUM_ITEMS) {
+        ++c->num_errors;
+        return;
+    }
+    if (it->seq <= c->last_seq[it->producer]) {
+        ++c->num_errors;
+    }
+    c->last_seq[it->producer] = it->seq;
+    sx_atomic_incr(&g_received[it->producer * NUM_ITEMS + it->seq]);
+}
+
+static int consumer_thread(void* user1, void* user2)
+{
+    sx_unused(user2);
+    consumer* c = user1;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        c->last_seq[p] = -1;
+    }
+
+    while (!g_start) {
+        sx_thread_yield();
+    }
+
+    int round = 0;
+    while (g_num_consumed < NUM_PRODUCERS * NUM_ITEMS) {
+        item items[BATCH_SIZE];
+        int n;
+        if ((++round & 1) == 0) {
+            n = sx_queue_mpmc_consume_batch(g_queue, items, BATCH_SIZE);
+        } else {
+            n = sx_queue_mpmc_consume(g_queue, &items[0]) ? 1 : 0;
+        }
+
+        if (n > 0) {
+            for (int i = 0; i < n; i++) {
+                consume_item(c, &items[i]);
+            }
+            sx_atomic_add_fetch(&g_num_consumed, n);
+        } else {
+            sx_thread_yield();
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    g_queue = sx_queue_mpmc_create(alloc, sizeof(item), CAPACITY);
+    g_received = sx_malloc(alloc, sizeof(sx_atomic_int) * NUM_PRODUCERS * NUM_ITEMS);
+    sx_assert_rel(g_queue && g_received);
+    sx_memset((void*)g_received, 0x0, sizeof(sx_atomic_int) * NUM_PRODUCERS * NUM_ITEMS);
+
+    sx_thread* producers[NUM_PRODUCERS];
+    sx_thread* consumers[NUM_CONSUMERS];
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers[p] = sx_thread_create(alloc, producer_thread, (void*)(intptr_t)p, 0, "producer",
+                                        NULL);
+    }
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        consumers[c] = sx_thread_create(alloc, consumer_thread, &g_consumers[c], 0, "consumer",
+                                        NULL);
+    }
+    sx_atomic_xchg(&g_start, 1);
+
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        sx_thread_destroy(producers[p], alloc);
+    }
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        sx_thread_destroy(consumers[c], alloc);
+    }
+
+    bool ok = true;
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        if (g_consumers[c].num_errors > 0) {
+            printf("consumer %d: %d items are out of order or invalid\n", c,
+                   g_consumers[c].num_errors);
+            ok = false;
+        }
+    }
+    for (int i = 0; i < NUM_PRODUCERS * NUM_ITEMS && ok; i++) {
+        if (g_received[i] != 1) {
+            printf("producer %d: item %d is consumed %d times\n", i / NUM_ITEMS, i % NUM_ITEMS,
+                   g_received[i]);
+            ok = false;
+        }
+    }
+
+    item it;
+    if (ok && (sx_queue_mpmc_consume(g_queue, &it) || sx_queue_mpmc_count(g_queue) != 0)) {
+        puts("queue is not empty after consuming all the items");
+        ok = false;
+    }
+
+    sx_free(alloc, (void*)g_received);
+    sx_queue_mpmc_destroy(g_queue, alloc);
+    puts(ok ? "ok" : "failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-queue-mpsc.c: sx_queue_mpsc stress test
+//      Several producer threads push their own sequence of items while a single consumer pops
+//      them, with single and batch calls. Every item must arrive exactly once, and the items of
+//      each producer must arrive in the order they were pushed
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/lockless.h"
+#include "sx/threads.h"
+
+#include <stdio.h>
+
+#define NUM_PRODUCERS 4
+#define NUM_ITEMS 200000    // per producer
+#define BATCH_SIZE 8
+
+typedef struct item {
+    sx_queue_mpsc_node node;
+    int producer;
+    int seq;
+} item;
+
+static sx_queue_mpsc g_queue;
+static item* g_items[NUM_PRODUCERS];
+static sx_atomic_int g_start;
+
+static int producer_thread(void* user1, void* user2)
+{
+    sx_unused(user2);
+    int p = (int)(intptr_t)user1;
+    item* items = g_items[p];
+
+    while (!g_start) {
+        sx_thread_yield();
+    }
+
+    // push most of them one by one, and some as linked batches
+    int i = 0;
+    while (i < NUM_ITEMS) {
+        if ((i & 63) == 0 && i + BATCH_SIZE <= NUM_ITEMS) {
+            for (int k = 0; k < BATCH_SIZE - 1; k++) {
+                items[i + k].node.next = &items[i + k + 1].node;
+            }
+            sx_queue_mpsc_produce_batch(&g_queue, &items[i].node, &items[i + BATCH_SIZE - 1].node);
+            i += BATCH_SIZE;
+        } else {
+            sx_queue_mpsc_produce(&g_queue, &items[i].node);
+            i++;
+        }
+    }
+    return 0;
+}
+
+static bool consume_item(const item* it, int* next_seq)
+{
+    if (it->producer < 0 || it->producer >= NUM_PRODUCERS) {
+        printf("invalid item\n");
+        return false;
+    }
+    if (it->seq != next_seq[it->producer]) {
+        printf("producer %d: expected item %d, got %d\n", it->producer, next_seq[it->producer],
+               it->seq);
+        return false;
+    }
+    ++next_seq[it->producer];
+    return true;
+}
+
+int main(void)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    sx_queue_mpsc_init(&g_queue);
+
+    sx_thread* threads[NUM_PRODUCERS];
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        g_items[p] = sx_malloc(alloc, sizeof(item) * NUM_ITEMS);
+        sx_assert_rel(g_items[p]);
+        for (int i = 0; i < NUM_ITEMS; i++) {
+            g_items[p][i] = (item){ .producer = p, .seq = i };
+        }
+        threads[p] = sx_thread_create(alloc, producer_thread, (void*)(intptr_t)p, 0, "producer",
+                                      NULL);
+    }
+    sx_atomic_xchg(&g_start, 1);
+
+    int next_seq[NUM_PRODUCERS] = { 0 };
+    int total = 0;
+    bool ok = true;
+    while (ok && total < NUM_PRODUCERS * NUM_ITEMS) {
+        sx_queue_mpsc_node* nodes[BATCH_SIZE];
+        int n;
+        if (total & 1) {
+            n = sx_queue_mpsc_consume_batch(&g_queue, nodes, BATCH_SIZE);
+        } else {
+            nodes[0] = sx_queue_mpsc_consume(&g_queue);
+            n = nodes[0] ? 1 : 0;
+        }
+
+        for (int i = 0; i < n && ok; i++) {
+            ok = consume_item((const item*)nodes[i], next_seq);
+        }
+        total += n;
+    }
+
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        sx_thread_destroy(threads[p], alloc);
+    }
+
+    if (ok && sx_queue_mpsc_consume(&g_queue)) {
+        puts("queue is not empty after consuming all the items");
+        ok = false;
+    }
+
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        sx_free(alloc, g_items[p]);
+    }
+
+    puts(ok ? "ok" : "failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-queue-spsc.c: sx_queue_spsc stress test with growing
+//      A producer thread pushes a sequence of items into a small queue with
+//      sx_queue_spsc_produce_and_grow, while the consumer pops them and stalls every now and then,
+//      so the queue keeps growing and then drains again while nodes of the grown bins are still
+//      in use. Every item must arrive exactly once and in order
+//
+#include "sx/allocator.h"
+#include "sx/atomic.h"
+#include "sx/lockless.h"
+#include "sx/threads.h"
+
+#include <stdio.h>
+
+#define NUM_ITEMS 500000
+#define CAPACITY 16
+#define STALL_EVERY 4096    // consumer yields for a while after this many items
+
+typedef struct item {
+    int seq;
+    int check;    // ~seq, catches items that are overwritten while they are in the queue
+} item;
+
+static sx_queue_spsc* g_queue;
+static sx_atomic_int g_start;
+
+static int producer_thread(void* user1, void* user2)
+{
+    sx_unused(user1);
+    sx_unused(user2);
+    const sx_alloc* alloc = sx_alloc_malloc();
+
+    while (!g_start) {
+        sx_thread_yield();
+    }
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        item it = { .seq = i, .check = ~i };
+        sx_queue_spsc_produce_and_grow(g_queue, &it, alloc);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    g_queue = sx_queue_spsc_create(alloc, sizeof(item), CAPACITY);
+    sx_assert_rel(g_queue);
+
+    sx_thread* thrd = sx_thread_create(alloc, producer_thread, NULL, 0, "producer", NULL);
+    sx_atomic_xchg(&g_start, 1);
+
+    int next_seq = 0;
+    bool ok = true;
+    while (ok && next_seq < NUM_ITEMS) {
+        item it;
+        if (!sx_queue_spsc_consume(g_queue, &it)) {
+            continue;
+        }
+
+        if (it.seq != next_seq || it.check != ~next_seq) {
+            printf("expected item %d, got %d (check: %x)\n", next_seq, it.seq, it.check);
+            ok = false;
+        }
+        ++next_seq;
+
+        if ((next_seq % STALL_EVERY) == 0) {
+            for (int i = 0; i < 16; i++) {
+                sx_thread_yield();
+            }
+        }
+    }
+
+    sx_thread_destroy(thrd, alloc);
+
+    item it;
+    if (ok && sx_queue_spsc_consume(g_queue, &it)) {
+        puts("queue is not empty after consuming all the items");
+        ok = false;
+    }
+
+    sx_queue_spsc_destroy(g_queue, alloc);
+    puts(ok ? "ok" : "failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/sx#license-bsd-2-clause
+//
+// test-xxh3.c: sx_hash_xxh3_64/128 and streaming xxh3 against the reference vectors of xxHash
+//      Vectors are the sanity checks of xxhsum (xsum_sanity_check.c), on the same generated buffer.
+//      Lengths above 240 bytes go through the long-input loops that are dispatched at runtime, so
+//      everything runs twice on x86: with AVX2 (if the cpu has it) and again after AVX2 is
+//      disabled with sx_os_disable_cpu_features (SSE2). Streaming feeds the buffer in uneven
+//      chunks, so the internal buffering and stripe boundaries are crossed at different offsets
+//
+#include "sx/allocator.h"
+#include "sx/hash.h"
+#include "sx/os.h"
+
+#include <stdio.h>
+
+#define PRIME32 2654435761u
+#define PRIME64 11400714785074694797ull
+#define BUFFER_SIZE 2367
+
+typedef struct xxh3_vector {
+    int len;
+    uint64_t seed;
+    uint64_t h64;
+    sx_hash128 h128;
+} xxh3_vector;
+
+// clang-format off
+static const xxh3_vector k_vectors[] = {
+    { 0,    0,       0x2D06800538D394C2ull, { 0x6001C324468D497Full, 0x99AA06D3014798D8ull } },
+    { 0,    PRIME64, 0xA8A6B918B2F0364Aull, { 0xA986DFC5D7605BFEull, 0x00FEAA732A3CE25Eull } },
+    { 1,    0,       0xC44BDFF4074EECDBull, { 0xC44BDFF4074EECDBull, 0xA6CD5E9392000F6Aull } },
+    { 1,    PRIME64, 0x032BE332DD766EF8ull, { 0x032BE332DD766EF8ull, 0x20E49ABCC53B3842ull } },
+    { 6,    0,       0x27B56A84CD2D7325ull, { 0x3E7039BDDA43CFC6ull, 0x082AFE0B8162D12Aull } },
+    { 6,    PRIME64, 0x84589C116AB59AB9ull, { 0xC5B54D56038E4E40ull, 0x014BD95A51CA5DDBull } },
+    { 12,   0,       0xA713DAF0DFBB77E7ull, { 0x061A192713F69AD9ull, 0x6E3EFD8FC7802B18ull } },
+    { 12,   PRIME64, 0xE7303E1B2336DE0Eull, { 0x5D92B5D7190B12D1ull, 0xFF0D60ACD02ED401ull } },
+    { 24,   0,       0xA3FE70BF9D3510EBull, { 0x1E7044D28B1B901Dull, 0x0CE966E4678D3761ull } },
+    { 24,   PRIME64, 0x850E80FC35BDD690ull, { 0xC6CBF92A70680B19ull, 0xD7895DED1F62559Dull } },
+    { 48,   0,       0x397DA259ECBA1F11ull, { 0xF942219AED80F67Bull, 0xA002AC4E5478227Eull } },
+    { 48,   PRIME64, 0xADC2CBAA44ACC616ull, { 0x3A94D91333ED395Aull, 0xBC689F4C0152FB44ull } },
+    { 80,   0,       0xBCDEFBBB2C47C90Aull, { 0x454AE6BF7A8A532Dull, 0xFDF2CEFDE9EAAC8Aull } },
+    { 80,   PRIME64, 0xC6DD0CB699532E73ull, { 0xA5EAC764D1FF1166ull, 0x19BF02D69BC56833ull } },
+    { 195,  0,       0xCD94217EE362EC3Aull, { 0x3FB593C086A66075ull, 0x7729543A26B207EEull } },
+    { 195,  PRIME64, 0xBA68003D370CB3D9ull, { 0xCF9D9EC2C8C9913Full, 0x0326104C4D4849E7ull } },
+    { 403,  0,       0xCDEB804D65C6DEA4ull, { 0xCDEB804D65C6DEA4ull, 0x1B6DE21E332DD73Dull } },
+    { 403,  PRIME64, 0x6259F6ECFD6443FDull, { 0x6259F6ECFD6443FDull, 0xBED311971E0BE8F2ull } },
+    { 512,  0,       0x617E49599013CB6Bull, { 0x617E49599013CB6Bull, 0x18D2D110DCC9BCA1ull } },
+    { 512,  PRIME64, 0x3CE457DE14C27708ull, { 0x3CE457DE14C27708ull, 0x925D06B8EC5B8040ull } },
+    { 2048, 0,       0xDD59E2C3A5F038E0ull, { 0xDD59E2C3A5F038E0ull, 0xF736557FD47073A5ull } },
+    { 2048, PRIME64, 0x66F81670669ABABCull, { 0x66F81670669ABABCull, 0x23CC3A2E75EBAAEAull } },
+    { 2240, 0,       0x6E73A90539CF2948ull, { 0x6E73A90539CF2948ull, 0xCCB134FBFA7CE49Dull } },
+    { 2240, PRIME64, 0x757BA8487D1B5247ull, { 0x757BA8487D1B5247ull, 0xE40842F585875BA9ull } },
+    { 2367, 0,       0xCB37AEB9E5D361EDull, { 0xCB37AEB9E5D361EDull, 0xE89C0F6FF369B427ull } },
+    { 2367, PRIME64, 0xD2DB3415B942B42Aull, { 0xD2DB3415B942B42Aull, 0xCCB7A94CCA1A6496ull } },
+};
+// clang-format on
+
+#define NUM_VECTORS ((int)(sizeof(k_vectors) / sizeof(xxh3_vector)))
+
+static const int k_chunks[] = { 1, 7, 64, 100, 256, 1000 };
+#define NUM_CHUNKS ((int)(sizeof(k_chunks) / sizeof(int)))
+
+static uint8_t g_buffer[BUFFER_SIZE];
+static int g_num_errors;
+
+static void check(const char* path, const char* what, const xxh3_vector* v, uint64_t h64,
+                  sx_hash128 h128)
+{
+    if (h64 != v->h64 || h128.low != v->h128.low || h128.high != v->h128.high) {
+        printf("%s: %s mismatch (len=%d, seed=%llx)\n", path, what, v->len,
+               (unsigned long long)v->seed);
+        ++g_num_errors;
+    }
+}
+
+static void test_vectors(const char* path, sx_hash_xxh3_t* state)
+{
+    for (int i = 0; i < NUM_VECTORS; i++) {
+        const xxh3_vector* v = &k_vectors[i];
+        check(path, "one-shot", v, sx_hash_xxh3_64(g_buffer, (size_t)v->len, v->seed),
+              sx_hash_xxh3_128(g_buffer, (size_t)v->len, v->seed));
+
+        for (int c = 0; c < NUM_CHUNKS; c++) {
+            sx_hash_xxh3_init(state, v->seed);
+            for (int offset = 0; offset < v->len; offset += k_chunks[c]) {
+                int len = sx_min(k_chunks[c], v->len - offset);
+                sx_hash_xxh3_update(state, g_buffer + offset, (size_t)len);
+            }
+            check(path, "streaming", v, sx_hash_xxh3_digest64(state),
+                  sx_hash_xxh3_digest128(state));
+        }
+    }
+}
+
+int main(void)
+{
+    uint64_t byte_gen = PRIME32;
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        g_buffer[i] = (uint8_t)(byte_gen >> 56);
+        byte_gen *= PRIME64;
+    }
+
+    sx_hash_xxh3_t* state = sx_hash_create_xxh3(sx_alloc_malloc());
+    sx_assert_rel(state);
+
+#if SX_CPU_X86
+    if (sx_os_cpu_features() & SX_CPU_FEATURE_AVX2) {
+        test_vectors("avx2", state);
+    } else {
+        puts("avx2: not supported by the cpu, skipped");
+    }
+    sx_os_disable_cpu_features(SX_CPU_FEATURE_AVX2);
+    test_vectors("sse2", state);
+#else
+    test_vectors("native", state);
+#endif
+
+    sx_hash_destroy_xxh3(state, sx_alloc_malloc());
+    if (g_num_errors > 0) {
+        printf("%d errors\n", g_num_errors);
+        return 1;
+    }
+    puts("ok");
+    return 0;
+}